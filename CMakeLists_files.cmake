@@ -29,6 +29,7 @@ list (APPEND MAIN_SOURCE_FILES
   opm/autodiff/GridHelpers.cpp
   opm/autodiff/ImpesTPFAAD.cpp
   opm/autodiff/LinearisedBlackoilResidual.cpp
+  opm/autodiff/LinearSystemCapture.cpp
   opm/autodiff/multiPhaseUpwind.cpp
   opm/autodiff/NewtonIterationBlackoilCPR.cpp
   opm/autodiff/NewtonIterationBlackoilSimple.cpp
@@ -40,6 +41,7 @@ list (APPEND MAIN_SOURCE_FILES
   opm/autodiff/VFPInjPropertiesLegacy.cpp
   opm/autodiff/VFPProdPropertiesLegacy.cpp
   opm/autodiff/WellDensitySegmented.cpp
+  opm/autodiff/WellSchurComplement.cpp
   opm/core/flowdiagnostics/AnisotropicEikonal.cpp
   opm/core/flowdiagnostics/DGBasis.cpp
   opm/core/flowdiagnostics/FlowDiagnostics.cpp
@@ -74,6 +76,7 @@ list (APPEND MAIN_SOURCE_FILES
   opm/core/simulator/BlackoilState.cpp
   opm/core/simulator/TwophaseState.cpp
   opm/core/transport/TransportSolverTwophaseInterface.cpp
+  opm/core/transport/reorder/ReorderSequenceCache.cpp
   opm/core/transport/reorder/ReorderSolverInterface.cpp
   opm/core/transport/reorder/TransportSolverCompressibleTwophaseReorder.cpp
   opm/core/transport/reorder/TransportSolverTwophaseReorder.cpp
@@ -115,9 +118,23 @@ list (APPEND TEST_SOURCE_FILES
   tests/test_dgbasis.cpp
   tests/test_flowdiagnostics.cpp
   tests/test_linearsolver.cpp
+  tests/test_preconditionerreuse.cpp
+  tests/test_mixedprecisionpreconditioner.cpp
+  tests/test_blockcprpreconditioner.cpp
+  tests/test_krylovrecycling.cpp
+  tests/test_linearsystemcapture.cpp
   tests/test_satfunc.cpp
   tests/test_anisotropiceikonal.cpp
   tests/test_blackoilstate.cpp
+  tests/test_block.cpp
+  tests/test_autodiffmatrix.cpp
+  tests/test_autodiffhelpers.cpp
+  tests/test_blocksparsejacobian.cpp
+  tests/test_sparsitypatterncache.cpp
+  tests/test_wellschurcomplement.cpp
+  tests/test_uniformgridtable.cpp
+  tests/test_reordersequence.cpp
+  tests/test_nonlinearsolver.cpp
 )
 
 if(MPI_FOUND)
@@ -127,6 +144,7 @@ endif()
 list (APPEND TEST_DATA_FILES
   tests/fluid.data
   tests/satfuncStandard.DATA
+  tests/satfuncRegions.DATA
   tests/satfuncEPSBase.DATA
   tests/satfuncEPS_A.DATA
   tests/satfuncEPS_C.DATA
@@ -150,6 +168,8 @@ list (APPEND EXAMPLE_SOURCE_FILES
   examples/compute_initial_state.cpp
   examples/compute_tof_from_files.cpp
   examples/diagnose_relperm.cpp
+  examples/benchmark_diagonal_ad.cpp
+  examples/benchmark_linear_systems.cpp
   tutorials/sim_tutorial1.cpp
 )
 
@@ -175,6 +195,8 @@ list (APPEND PROGRAM_SOURCE_FILES
 # originally generated with the command:
 # find opm -name '*.h*' -a ! -name '*-pch.hpp' -printf '\t%p\n' | sort
 list (APPEND PUBLIC_HEADER_FILES
+  opm/autodiff/AutoDiffArena.hpp
+  opm/autodiff/AutoDiffBlockExpr.hpp
   opm/autodiff/BlackoilLegacyDetails.hpp
   opm/autodiff/BlackoilModel.hpp
   opm/autodiff/BlackoilModelBase.hpp
@@ -187,8 +209,11 @@ list (APPEND PUBLIC_HEADER_FILES
   opm/autodiff/BlackoilSequentialModel.hpp
   opm/autodiff/BlackoilReorderingTransportModel.hpp
   opm/autodiff/BlackoilTransportModel.hpp
+  opm/autodiff/BlockCPRPreconditioner.hpp
+  opm/autodiff/BlockSparseJacobian.hpp
   opm/autodiff/Compat.hpp
   opm/autodiff/DebugTimeReport.hpp
+  opm/autodiff/DiagonalKernels.hpp
   opm/autodiff/DuneMatrix.hpp
   opm/autodiff/fastSparseOperations.hpp
   opm/autodiff/FlowMain.hpp
@@ -198,15 +223,19 @@ list (APPEND PUBLIC_HEADER_FILES
   opm/autodiff/GridInit.hpp
   opm/autodiff/ImpesTPFAAD.hpp
   opm/autodiff/ISTLSolver.hpp
+  opm/autodiff/KrylovRecycling.hpp
   opm/autodiff/multiPhaseUpwind.hpp
   opm/autodiff/NewtonIterationBlackoilCPR.hpp
   opm/autodiff/NewtonIterationBlackoilInterface.hpp
   opm/autodiff/NewtonIterationBlackoilInterleaved.hpp
   opm/autodiff/NewtonIterationBlackoilSimple.hpp
+  opm/autodiff/MixedPrecisionPreconditioner.hpp
   opm/autodiff/NewtonIterationUtilities.hpp
+  opm/autodiff/PreconditionerReuse.hpp
   opm/autodiff/NonlinearSolver.hpp
   opm/autodiff/NonlinearSolver_impl.hpp
   opm/autodiff/LinearisedBlackoilResidual.hpp
+  opm/autodiff/LinearSystemCapture.hpp
   opm/autodiff/ParallelDebugOutput.hpp
   opm/autodiff/RateConverterLegacy.hpp
   opm/autodiff/RedistributeDataHandles.hpp
@@ -215,8 +244,11 @@ list (APPEND PUBLIC_HEADER_FILES
   opm/autodiff/SimulatorFullyImplicitBlackoil.hpp
   opm/autodiff/SimulatorIncompTwophaseAd.hpp
   opm/autodiff/SimulatorSequentialBlackoil.hpp
+  opm/autodiff/SparsityPatternCache.hpp
+  opm/autodiff/StencilOps.hpp
   opm/autodiff/TransportSolverTwophaseAd.hpp
   opm/autodiff/WellDensitySegmented.hpp
+  opm/autodiff/WellSchurComplement.hpp
   opm/autodiff/SimulatorFullyImplicitBlackoilOutput.hpp
   opm/autodiff/ThreadHandle.hpp
   opm/autodiff/VFPHelpersLegacy.hpp
@@ -278,6 +310,7 @@ list (APPEND PUBLIC_HEADER_FILES
   opm/core/simulator/initStateEquil_impl.hpp
   opm/core/simulator/initState_impl.hpp
   opm/core/transport/TransportSolverTwophaseInterface.hpp
+  opm/core/transport/reorder/ReorderSequenceCache.hpp
   opm/core/transport/reorder/ReorderSolverInterface.hpp
   opm/core/transport/reorder/TransportSolverCompressibleTwophaseReorder.hpp
   opm/core/transport/reorder/TransportSolverTwophaseReorder.hpp
@@ -291,6 +324,7 @@ list (APPEND PUBLIC_HEADER_FILES
   opm/core/utility/miscUtilities_impl.hpp
   opm/core/utility/NullStream.hpp
   opm/core/utility/share_obj.hpp
+  opm/core/utility/UniformGridTable.hpp
   opm/polymer/CompressibleTpfaPolymer.hpp
   opm/polymer/GravityColumnSolverPolymer.hpp
   opm/polymer/GravityColumnSolverPolymer_impl.hpp
@@ -0,0 +1,142 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark of the diagonal Jacobian arithmetic of AutoDiffBlock.
+//
+// Usage: benchmark_diagonal_ad [num_cells] [repetitions]
+//
+// Times the explicitly vectorized DiagonalKernels against plain loops
+// compiled with the same optimization flags (and therefore possibly
+// vectorized by the compiler), and the AutoDiffBlock operations built on
+// them for a typical property evaluation with two primary variables.
+
+#include <config.h>
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/autodiff/DiagonalKernels.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    void loopMultiply(double* y, const double* x, const int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            y[i] *= x[i];
+        }
+    }
+
+    void loopAdd(double* y, const double* x, const int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            y[i] += x[i];
+        }
+    }
+
+    void loopAddProduct(double* y, const double* a, const double* x, const int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            y[i] += a[i] * x[i];
+        }
+    }
+
+    // Average time in microseconds of f() over the given number of repetitions.
+    double timeIt(const std::function<void()>& f, const int repetitions)
+    {
+        f(); // Warm up.
+        const auto start = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < repetitions; ++rep) {
+            f();
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::micro>(stop - start).count() / repetitions;
+    }
+
+    void report(const std::string& name, const double loop_time, const double kernel_time)
+    {
+        std::cout << std::setw(24) << std::left << name
+                  << std::setw(12) << std::right << std::fixed << std::setprecision(1) << loop_time
+                  << std::setw(12) << kernel_time
+                  << std::setw(10) << std::setprecision(2) << loop_time / kernel_time << "x\n";
+    }
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+    typedef Opm::AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    std::cout << "Cells: " << n << ", repetitions: " << repetitions
+              << ", instruction set: " << Opm::DiagonalKernels::instructionSet() << "\n\n";
+
+    std::vector<double> a(n), x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = 1.0 + 1e-6 * i;
+        x[i] = 1.0 - 1e-7 * i;
+        y[i] = 0.5;
+    }
+
+    std::cout << std::setw(24) << std::left << "kernel"
+              << std::setw(12) << std::right << "loop [us]"
+              << std::setw(12) << "kernel [us]"
+              << std::setw(11) << "speedup" << '\n';
+    report("y *= x",
+           timeIt([&]() { loopMultiply(y.data(), x.data(), n); }, repetitions),
+           timeIt([&]() { Opm::DiagonalKernels::multiply(y.data(), x.data(), n); }, repetitions));
+    report("y += x",
+           timeIt([&]() { loopAdd(y.data(), x.data(), n); }, repetitions),
+           timeIt([&]() { Opm::DiagonalKernels::add(y.data(), x.data(), n); }, repetitions));
+    report("y += a * x",
+           timeIt([&]() { loopAddProduct(y.data(), a.data(), x.data(), n); }, repetitions),
+           timeIt([&]() { Opm::DiagonalKernels::addProduct(y.data(), a.data(), x.data(), n); }, repetitions));
+
+    // Property evaluation with two primary variables, all Jacobians diagonal.
+    const V p0 = V::Constant(n, 200.0);
+    const V s0 = V::Constant(n, 0.3);
+    std::vector<ADB> vars = ADB::variables(std::vector<V>{ p0, s0 });
+    const ADB& p = vars[0];
+    const ADB& s = vars[1];
+    const ADB b = p * 1e-4 + s * 0.1 + V::Ones(n);
+    const ADB c = p * 2e-4 + s;
+    ADB result = b;
+    std::cout << '\n';
+    std::cout << std::setw(24) << std::left << "ADB b * c"
+              << std::setw(24) << std::right << std::fixed << std::setprecision(1)
+              << timeIt([&]() { result = b * c; }, repetitions) << '\n';
+    std::cout << std::setw(24) << std::left << "ADB b * c + c"
+              << std::setw(24) << std::right
+              << timeIt([&]() { result = b * c + c; }, repetitions) << '\n';
+    std::cout << std::setw(24) << std::left << "ADB (b * c) * 2.0"
+              << std::setw(24) << std::right
+              << timeIt([&]() { result = (b * c) * 2.0; }, repetitions) << '\n';
+
+    return 0;
+}
@@ -0,0 +1,308 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Replay of captured linear systems through the available linear solvers.
+//
+// Usage: benchmark_linear_systems systems=a.linsys,b.linsys [solvers=bicgstab,gmres]
+//            [preconditioners=ilu0,ilu0_float,amg,cpr] [reduction=1e-2] [maxiter=200]
+//            [restart=40] [cpr_* parameters]
+//
+// The systems are written by the interleaved and CPR Newton solvers when
+// run with linear_system_capture_prefix=<prefix> (see LinearSystemCapture).
+// Each system is solved with every combination of the given Krylov
+// solvers and preconditioners, reporting the preconditioner setup time,
+// the solve time and the number of iterations. The cpr preconditioner is
+// controlled by the same cpr_* parameters as in the simulator.
+
+#include <config.h>
+
+// Define making clear that the simulator supports AMG
+#define FLOW_SUPPORT_AMG !defined(HAVE_UMFPACK)
+
+#include <opm/autodiff/BlockCPRPreconditioner.hpp>
+#include <opm/autodiff/CPRPreconditioner.hpp>
+#include <opm/autodiff/LinearSystemCapture.hpp>
+#include <opm/autodiff/MatrixBlock.hpp>
+#include <opm/autodiff/MixedPrecisionPreconditioner.hpp>
+#include <opm/autodiff/ParallelOverlappingILU0.hpp>
+#include <opm/common/utility/parameters/ParameterGroup.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/solvers.hh>
+
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+    // Comma separated list of names.
+    std::vector<std::string> splitList(const std::string& list)
+    {
+        std::vector<std::string> names;
+        std::istringstream is(list);
+        std::string name;
+        while (std::getline(is, name, ',')) {
+            if (!name.empty()) {
+                names.push_back(name);
+            }
+        }
+        return names;
+    }
+
+    struct Settings
+    {
+        explicit Settings(const Opm::ParameterGroup& param)
+            : systems(splitList(param.get<std::string>("systems"))),
+              solvers(splitList(param.getDefault<std::string>("solvers", "bicgstab,gmres"))),
+              preconditioners(splitList(param.getDefault<std::string>("preconditioners", "ilu0,ilu0_float,amg,cpr"))),
+              reduction(param.getDefault("reduction", 1e-2)),
+              maxiter(param.getDefault("maxiter", 200)),
+              restart(param.getDefault("restart", 40)),
+              cpr(param)
+        {
+        }
+
+        std::vector<std::string> systems;
+        std::vector<std::string> solvers;
+        std::vector<std::string> preconditioners;
+        double reduction;
+        int maxiter;
+        int restart;
+        Opm::CPRParameter cpr;
+    };
+
+    double millisecondsSince(const std::chrono::steady_clock::time_point& start)
+    {
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count();
+    }
+
+    template <int bs>
+    struct Benchmark
+    {
+        typedef Dune::MatrixBlock<double, bs, bs> Block;
+        typedef Dune::BCRSMatrix<Block> Matrix;
+        typedef Dune::BlockVector< Dune::FieldVector<double, bs> > Vector;
+        typedef Dune::MatrixAdapter<Matrix, Vector, Vector> Operator;
+        typedef Dune::Preconditioner<Vector, Vector> Preconditioner;
+        typedef std::function<std::unique_ptr<Preconditioner>(Operator&)> Factory;
+        typedef Opm::ParallelOverlappingILU0<Matrix, Vector, Vector> ILU;
+
+        typedef Dune::BCRSMatrix< Dune::MatrixBlock<float, bs, bs> > FloatMatrix;
+        typedef Opm::MixedPrecisionPreconditioner<FloatMatrix, Vector> MixedPreconditioner;
+        typedef typename MixedPreconditioner::OperatorF FloatOperator;
+        typedef typename MixedPreconditioner::VectorF FloatVector;
+        typedef typename MixedPreconditioner::InnerPreconditioner FloatInner;
+
+        static std::unique_ptr<Matrix> makeMatrix(const Opm::CapturedLinearSystem& sys)
+        {
+            const int n = sys.size();
+            std::unique_ptr<Matrix> A(new Matrix(n, n, sys.col_index.size(), Matrix::row_wise));
+            for (auto row = A->createbegin(); row != A->createend(); ++row) {
+                const int r = row.index();
+                for (int k = sys.row_start[r]; k < sys.row_start[r + 1]; ++k) {
+                    row.insert(sys.col_index[k]);
+                }
+            }
+            for (int r = 0; r < n; ++r) {
+                auto col = (*A)[r].begin();
+                for (int k = sys.row_start[r]; k < sys.row_start[r + 1]; ++k, ++col) {
+                    const double* values = sys.values.data() + k * bs * bs;
+                    for (int i = 0; i < bs; ++i) {
+                        for (int j = 0; j < bs; ++j) {
+                            (*col)[i][j] = values[i * bs + j];
+                        }
+                    }
+                }
+            }
+            return A;
+        }
+
+        static std::vector< std::pair<std::string, Factory> > preconditioners(const Settings& settings)
+        {
+            std::vector< std::pair<std::string, Factory> > precs;
+            precs.emplace_back("ilu0", [](Operator& op) {
+                    return std::unique_ptr<Preconditioner>(new ILU(op.getmat(), 0, 1.0, MILU_VARIANT::ILU, false, false));
+                });
+            precs.emplace_back("ilu0_float", [](Operator& op) {
+                    auto createILU = [](FloatOperator& opF) {
+                        typedef Opm::ParallelOverlappingILU0<FloatMatrix, FloatVector, FloatVector> FloatILU;
+                        return std::unique_ptr<FloatInner>(new FloatILU(opF.getmat(), 0, 1.0, MILU_VARIANT::ILU, false, false));
+                    };
+                    return std::unique_ptr<Preconditioner>(new MixedPreconditioner(op.getmat(), createILU));
+                });
+#if FLOW_SUPPORT_AMG
+            precs.emplace_back("amg", [](Operator& op) {
+                    typedef typename Opm::ISTLUtility::CPRSelector<Matrix, Vector, Vector,
+                                                                   Dune::Amg::SequentialInformation>::AMG AMG;
+                    Dune::Amg::SequentialInformation info;
+                    std::unique_ptr<AMG> amg;
+                    Opm::ISTLUtility::template createAMGPreconditionerPointer<0>(op, 1.0, MILU_VARIANT::ILU, info, amg);
+                    return std::unique_ptr<Preconditioner>(std::move(amg));
+                });
+#endif
+            const Opm::CPRParameter& cpr = settings.cpr;
+            precs.emplace_back("cpr", [&cpr](Operator& op) {
+                    typedef Opm::BlockCPRPreconditioner<Matrix, Vector, 0> CPR;
+                    const Matrix& A = op.getmat();
+                    std::unique_ptr<Preconditioner> ilu(new ILU(A, cpr.cpr_ilu_n_, cpr.cpr_relax_, cpr.cpr_ilu_milu_,
+                                                                cpr.cpr_ilu_redblack_, cpr.cpr_ilu_reorder_sphere_));
+                    return std::unique_ptr<Preconditioner>(new CPR(A, CPR::quasiImpesWeights(A), std::move(ilu), cpr));
+                });
+            return precs;
+        }
+
+        // The requested preconditioners, in the requested order.
+        static std::vector< std::pair<std::string, Factory> > selectedPreconditioners(const Settings& settings)
+        {
+            const std::vector< std::pair<std::string, Factory> > available = preconditioners(settings);
+            std::vector< std::pair<std::string, Factory> > selected;
+            for (const std::string& name : settings.preconditioners) {
+                auto prec = std::find_if(available.begin(), available.end(),
+                                         [&name](const std::pair<std::string, Factory>& p) { return p.first == name; });
+                if (prec == available.end()) {
+                    std::cout << "Preconditioner " << name << " not available.\n";
+                } else {
+                    selected.push_back(*prec);
+                }
+            }
+            return selected;
+        }
+
+        static void run(const std::string& name, const Opm::CapturedLinearSystem& sys, const Settings& settings)
+        {
+            const std::unique_ptr<Matrix> A = makeMatrix(sys);
+            Operator op(*A);
+            const int n = sys.size();
+            Vector rhs(n);
+            for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < bs; ++j) {
+                    rhs[i][j] = sys.rhs[i * bs + j];
+                }
+            }
+
+            for (const auto& prec : selectedPreconditioners(settings)) {
+                for (const std::string& solver_name : settings.solvers) {
+                    const bool gmres = solver_name == "gmres";
+                    if (!gmres && solver_name != "bicgstab") {
+                        std::cout << "Solver " << solver_name << " not available.\n";
+                        continue;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    std::unique_ptr<Preconditioner> precond;
+                    try {
+                        precond = prec.second(op);
+                    } catch (const std::exception& e) {
+                        std::cout << name << ": " << prec.first << " setup failed: " << e.what() << '\n';
+                        break;
+                    }
+                    const double setup = millisecondsSince(start);
+
+                    Vector x(n);
+                    x = 0.0;
+                    Vector b = rhs;
+                    Dune::InverseOperatorResult result;
+                    start = std::chrono::steady_clock::now();
+                    if (gmres) {
+                        Dune::RestartedGMResSolver<Vector> solver(op, *precond, settings.reduction,
+                                                                  settings.restart, settings.maxiter, 0);
+                        solver.apply(x, b, result);
+                    } else {
+                        Dune::BiCGSTABSolver<Vector> solver(op, *precond, settings.reduction,
+                                                            settings.maxiter, 0);
+                        solver.apply(x, b, result);
+                    }
+                    const double solve = millisecondsSince(start);
+
+                    std::cout << std::setw(32) << std::left << name
+                              << std::setw(10) << solver_name
+                              << std::setw(12) << prec.first
+                              << std::setw(12) << std::right << std::fixed << std::setprecision(1) << setup
+                              << std::setw(12) << solve
+                              << std::setw(8) << result.iterations
+                              << std::setw(6) << (result.converged ? "yes" : "no") << '\n';
+                }
+            }
+        }
+    };
+
+    void run(const std::string& name, const Opm::CapturedLinearSystem& sys, const Settings& settings)
+    {
+        switch (sys.block_size) {
+        case 1: Benchmark<1>::run(name, sys, settings); break;
+        case 2: Benchmark<2>::run(name, sys, settings); break;
+        case 3: Benchmark<3>::run(name, sys, settings); break;
+        case 4: Benchmark<4>::run(name, sys, settings); break;
+        default:
+            std::cout << name << ": block size " << sys.block_size << " not supported.\n";
+        }
+    }
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+try
+{
+    const Opm::ParameterGroup param(argc, argv, false);
+    if (!param.has("systems")) {
+        std::cerr << "Usage: " << argv[0]
+                  << " systems=a.linsys,b.linsys [solvers=bicgstab,gmres]"
+                  << " [preconditioners=ilu0,ilu0_float,amg,cpr] [reduction=1e-2]"
+                  << " [maxiter=200] [restart=40] [cpr_* parameters]\n";
+        return EXIT_FAILURE;
+    }
+    const Settings settings(param);
+
+    std::cout << std::setw(32) << std::left << "system"
+              << std::setw(10) << "solver"
+              << std::setw(12) << "precond"
+              << std::setw(12) << std::right << "setup [ms]"
+              << std::setw(12) << "solve [ms]"
+              << std::setw(8) << "its"
+              << std::setw(6) << "conv" << '\n';
+    for (const std::string& file : settings.systems) {
+        const Opm::CapturedLinearSystem sys = Opm::readLinearSystem(file);
+        std::cout << file << ": " << sys.size() << " block rows of size " << sys.block_size
+                  << ", " << sys.col_index.size() << " blocks"
+                  << (sys.wells_eliminated ? ", wells eliminated" : "") << '\n';
+        run(file, sys, settings);
+    }
+    return EXIT_SUCCESS;
+}
+catch (const std::exception& e) {
+    std::cerr << "Program threw an exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,345 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_AUTODIFFARENA_HEADER_INCLUDED
+#define OPM_AUTODIFFARENA_HEADER_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Arena allocator for the temporaries created by the automatic
+    /// differentiation classes.
+    ///
+    /// Each thread allocates by bumping a pointer in its current chunk of
+    /// memory, and freeing memory only decrements the live count of the
+    /// chunk it came from. A chunk is reset and reused as a whole once all
+    /// allocations from it have been freed. This avoids going through the
+    /// global heap (and its locks) for the many short lived arrays created
+    /// by AutoDiffBlock arithmetic.
+    ///
+    /// A single allocation that stays alive keeps its whole chunk from
+    /// being reused. The arena should therefore only be enabled while a
+    /// system is linearized, as BlackoilModelBase does: the temporaries are
+    /// freed within the assembly, and the stored equations when they are
+    /// replaced by the next assembly, so the chunks are recycled once per
+    /// Newton iteration. AutoDiffArenaAllocator decides when it is created
+    /// whether to use the arena, so containers created while the arena is
+    /// disabled use the heap directly, without any overhead.
+    ///
+    /// The allocation counters are kept per thread, so that counting does
+    /// not contend on shared cache lines, and summed when queried.
+    class AutoDiffArena
+    {
+    public:
+        /// Allocation counters.
+        struct Statistics
+        {
+            /// Number of arena allocations since the last beginLinearization().
+            std::size_t allocations;
+            /// Number of bytes requested from the arena since the last
+            /// beginLinearization().
+            std::size_t bytes;
+            /// Number of bytes currently held in arena chunks.
+            std::size_t reserved;
+        };
+
+        /// Select whether allocators created from now on should draw from
+        /// the arena.
+        static void setEnabled(const bool enabled)
+        {
+            state().enabled = enabled;
+        }
+
+        /// Whether allocators created now draw from the arena.
+        static bool enabled()
+        {
+            return state().enabled;
+        }
+
+        /// Mark the start of a new linearization, resetting the counters.
+        static void beginLinearization()
+        {
+            GlobalState& gs = state();
+            std::lock_guard<std::mutex> lock(gs.mutex);
+            gs.totals(gs.base_allocations, gs.base_bytes);
+        }
+
+        /// Counters since the last call to beginLinearization().
+        static Statistics statistics()
+        {
+            GlobalState& gs = state();
+            std::lock_guard<std::mutex> lock(gs.mutex);
+            Statistics s;
+            gs.totals(s.allocations, s.bytes);
+            s.allocations -= gs.base_allocations;
+            s.bytes -= gs.base_bytes;
+            s.reserved = gs.reserved;
+            return s;
+        }
+
+        /// Allocate bytes from the arena of the calling thread, aligned
+        /// for any fundamental type. Each allocation is preceded by a
+        /// header recording its chunk.
+        static void* allocate(const std::size_t bytes)
+        {
+            ThreadArena& ta = threadArena();
+            ta.count(bytes);
+
+            const std::size_t n = HeaderSize + roundUp(bytes);
+            Chunk* chunk = ta.current;
+            if (chunk == nullptr || chunk->top + n > chunk->end) {
+                chunk = ta.acquire(n);
+            }
+            char* p = chunk->top;
+            chunk->top += n;
+            chunk->live.fetch_add(1, std::memory_order_relaxed);
+            *reinterpret_cast<Chunk**>(p) = chunk;
+            return p + HeaderSize;
+        }
+
+        /// Release memory obtained from allocate(), from any thread.
+        static void deallocate(void* ptr)
+        {
+            if (ptr == nullptr) {
+                return;
+            }
+            char* p = static_cast<char*>(ptr) - HeaderSize;
+            release(*reinterpret_cast<Chunk**>(p));
+        }
+
+    private:
+        enum { Alignment = alignof(std::max_align_t) > 16 ? alignof(std::max_align_t) : 16 };
+        enum { HeaderSize = Alignment };
+        enum { DefaultChunkSize = 4 << 20 };
+
+        struct Chunk
+        {
+            explicit Chunk(const std::size_t size)
+                : data(new char[size]),
+                  end(data.get() + size),
+                  top(data.get()),
+                  live(1) // The owning thread holds one reference.
+            {
+            }
+            std::unique_ptr<char[]> data;
+            char* end;
+            char* top;
+            std::atomic<long> live;
+        };
+
+        struct ThreadArena
+        {
+            ThreadArena()
+                : current(nullptr), allocations(0), bytes(0)
+            {
+                GlobalState& gs = state();
+                std::lock_guard<std::mutex> lock(gs.mutex);
+                gs.arenas.push_back(this);
+            }
+
+            ~ThreadArena()
+            {
+                // Chunks with live allocations are deleted by the
+                // deallocation that releases their last allocation.
+                for (Chunk* chunk : chunks) {
+                    release(chunk);
+                }
+                GlobalState& gs = state();
+                std::lock_guard<std::mutex> lock(gs.mutex);
+                gs.retired_allocations += allocations;
+                gs.retired_bytes += bytes;
+                gs.arenas.erase(std::find(gs.arenas.begin(), gs.arenas.end(), this));
+            }
+
+            // Only the owning thread writes the counters, so a relaxed
+            // load and store is enough, and cheaper than fetch_add().
+            void count(const std::size_t n)
+            {
+                allocations.store(allocations.load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+                bytes.store(bytes.load(std::memory_order_relaxed) + n,
+                            std::memory_order_relaxed);
+            }
+
+            // Find or create a chunk with room for n bytes.
+            Chunk* acquire(const std::size_t n)
+            {
+                for (Chunk* chunk : chunks) {
+                    if (chunk->live.load(std::memory_order_acquire) == 1
+                        && std::size_t(chunk->end - chunk->data.get()) >= n) {
+                        chunk->top = chunk->data.get();
+                        current = chunk;
+                        return chunk;
+                    }
+                }
+                const std::size_t size = std::max(std::size_t(DefaultChunkSize), n);
+                state().reserved.fetch_add(size, std::memory_order_relaxed);
+                chunks.push_back(new Chunk(size));
+                current = chunks.back();
+                return current;
+            }
+
+            std::vector<Chunk*> chunks;
+            Chunk* current;
+            std::atomic<std::size_t> allocations;
+            std::atomic<std::size_t> bytes;
+        };
+
+        // The counters of all threads only ever grow; statistics() reports
+        // their sum relative to the sum at the last beginLinearization().
+        struct GlobalState
+        {
+            GlobalState()
+                : enabled(false), reserved(0),
+                  retired_allocations(0), retired_bytes(0),
+                  base_allocations(0), base_bytes(0)
+            {
+            }
+
+            // Sum of the counters of all threads, also those that have
+            // exited. The mutex must be held.
+            void totals(std::size_t& total_allocations, std::size_t& total_bytes) const
+            {
+                total_allocations = retired_allocations;
+                total_bytes = retired_bytes;
+                for (const ThreadArena* ta : arenas) {
+                    total_allocations += ta->allocations.load(std::memory_order_relaxed);
+                    total_bytes += ta->bytes.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::atomic<bool> enabled;
+            std::atomic<std::size_t> reserved;
+            std::mutex mutex;
+            std::vector<const ThreadArena*> arenas;
+            std::size_t retired_allocations;
+            std::size_t retired_bytes;
+            std::size_t base_allocations;
+            std::size_t base_bytes;
+        };
+
+        static GlobalState& state()
+        {
+            static GlobalState gs;
+            return gs;
+        }
+
+        static ThreadArena& threadArena()
+        {
+            static thread_local ThreadArena ta;
+            return ta;
+        }
+
+        static void release(Chunk* chunk)
+        {
+            if (chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                state().reserved.fetch_sub(chunk->end - chunk->data.get(), std::memory_order_relaxed);
+                delete chunk;
+            }
+        }
+
+        static std::size_t roundUp(const std::size_t bytes)
+        {
+            return (bytes + Alignment - 1) / Alignment * Alignment;
+        }
+    };
+
+
+
+    /// Standard conforming allocator drawing from AutoDiffArena if the
+    /// arena is enabled when the allocator is created, and from
+    /// std::allocator otherwise. The allocator moves with the memory it
+    /// has allocated, and copies of a container choose anew.
+    template <class T>
+    class AutoDiffArenaAllocator
+    {
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        AutoDiffArenaAllocator()
+            : arena_(AutoDiffArena::enabled())
+        {
+        }
+
+        template <class U>
+        AutoDiffArenaAllocator(const AutoDiffArenaAllocator<U>& other)
+            : arena_(other.usesArena())
+        {
+        }
+
+        AutoDiffArenaAllocator select_on_container_copy_construction() const
+        {
+            return AutoDiffArenaAllocator();
+        }
+
+        /// Whether this allocator draws from the arena.
+        bool usesArena() const
+        {
+            return arena_;
+        }
+
+        T* allocate(const std::size_t n)
+        {
+            if (arena_) {
+                return static_cast<T*>(AutoDiffArena::allocate(n * sizeof(T)));
+            }
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* p, const std::size_t n)
+        {
+            if (arena_) {
+                AutoDiffArena::deallocate(p);
+            } else {
+                std::allocator<T>().deallocate(p, n);
+            }
+        }
+
+        template <class U>
+        bool operator==(const AutoDiffArenaAllocator<U>& other) const
+        {
+            return arena_ == other.usesArena();
+        }
+
+        template <class U>
+        bool operator!=(const AutoDiffArenaAllocator<U>& other) const
+        {
+            return arena_ != other.usesArena();
+        }
+
+    private:
+        bool arena_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_AUTODIFFARENA_HEADER_INCLUDED
@@ -355,8 +355,11 @@ namespace Opm
                     jac[block] = D2*jac_[block];
                 }
                 else {
-                    jac[block]  = D2*jac_[block];
-                    jac[block] += D1*rhs.jac_[block];
+                    // Accumulated in place, which for diagonal Jacobians
+                    // avoids the temporaries of D2*jac + D1*rhs.jac.
+                    jac[block] = M( D2.rows(), jac_[block].cols() );
+                    jac[block].addDiagonalProduct(rhs.val_, jac_[block]);
+                    jac[block].addDiagonalProduct(val_, rhs.jac_[block]);
                 }
             }
             return function(val_ * rhs.val_, std::move(jac));
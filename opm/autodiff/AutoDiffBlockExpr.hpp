@@ -0,0 +1,452 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_AUTODIFFBLOCKEXPR_HEADER_INCLUDED
+#define OPM_AUTODIFFBLOCKEXPR_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+
+#include <vector>
+#include <cassert>
+
+namespace Opm
+{
+
+    /// Lazy expression templates for elementwise AutoDiffBlock arithmetic.
+    ///
+    /// The regular AutoDiffBlock operators evaluate eagerly, so that an
+    /// expression like a*b*c creates a temporary value vector and a
+    /// temporary set of Jacobian blocks for a*b before multiplying by c.
+    /// Wrapping one of the operands with lazy() instead builds an
+    /// expression tree that is only evaluated when it is converted to an
+    /// AutoDiffBlock (typically on assignment):
+    ///
+    ///     ADB accum = lazy(pv_mult) * b * s;
+    ///
+    /// The value is then computed in a single pass over the elements, and
+    /// the Jacobian is formed by the chain rule as the sum over all
+    /// non-constant operands x_k of diag(d(expr)/d(x_k)) * jac(x_k), where
+    /// diagonal (and identity) Jacobian blocks are accumulated in place.
+    ///
+    /// Expression objects store references to their operands, they must
+    /// therefore not outlive the full expression in which they are created.
+    /// In other words, never store an expression in an 'auto' variable.
+    template <typename Scalar, class Derived>
+    class AutoDiffBlockExpr
+    {
+    public:
+        const Derived& derived() const
+        {
+            return static_cast<const Derived&>(*this);
+        }
+
+        /// Evaluate the expression.
+        AutoDiffBlock<Scalar> evaluate() const
+        {
+            typedef AutoDiffBlock<Scalar> ADB;
+            const Derived& expr = derived();
+            const int n = expr.size();
+            typename ADB::V val(n);
+            for (int i = 0; i < n; ++i) {
+                val[i] = expr.coeff(i);
+            }
+            const ADB* var = expr.firstVariable();
+            if (var == nullptr) {
+                return ADB::constant(std::move(val));
+            }
+            const std::vector<int> bp = var->blockPattern();
+            const int num_blocks = bp.size();
+            std::vector<typename ADB::M> jac(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jac[block] = typename ADB::M(n, bp[block]);
+            }
+            expr.accumulateJacobian(ADB::V::Ones(n), jac);
+            return ADB::function(std::move(val), std::move(jac));
+        }
+
+        /// Implicit conversion evaluates the expression.
+        operator AutoDiffBlock<Scalar>() const
+        {
+            return evaluate();
+        }
+    };
+
+
+
+    /// Expression leaf referring to an AutoDiffBlock.
+    template <typename ScalarT>
+    class AutoDiffBlockExprLeaf : public AutoDiffBlockExpr< ScalarT, AutoDiffBlockExprLeaf<ScalarT> >
+    {
+    public:
+        typedef ScalarT Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        explicit AutoDiffBlockExprLeaf(const ADB& x)
+            : x_(x)
+        {
+        }
+
+        int size() const { return x_.size(); }
+        Scalar coeff(const int i) const { return x_.value()[i]; }
+
+        const ADB* firstVariable() const
+        {
+            return x_.derivative().empty() ? nullptr : &x_;
+        }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed& seed, std::vector<typename ADB::M>& jac) const
+        {
+            const int num_blocks = x_.numBlocks();
+            if (num_blocks == 0) {
+                return;
+            }
+            assert(num_blocks == int(jac.size()));
+            for (int block = 0; block < num_blocks; ++block) {
+                jac[block].addDiagonalProduct(seed, x_.derivative()[block]);
+            }
+        }
+
+    private:
+        const ADB& x_;
+    };
+
+
+
+    /// Expression leaf referring to a constant vector.
+    template <typename ScalarT>
+    class AutoDiffBlockExprConstant : public AutoDiffBlockExpr< ScalarT, AutoDiffBlockExprConstant<ScalarT> >
+    {
+    public:
+        typedef ScalarT Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        explicit AutoDiffBlockExprConstant(const typename ADB::V& x)
+            : x_(x)
+        {
+        }
+
+        int size() const { return x_.size(); }
+        Scalar coeff(const int i) const { return x_[i]; }
+        const ADB* firstVariable() const { return nullptr; }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed&, std::vector<typename ADB::M>&) const
+        {
+        }
+
+    private:
+        const typename ADB::V& x_;
+    };
+
+
+
+    /// Expression leaf holding a single scalar, broadcast to any size.
+    template <typename ScalarT>
+    class AutoDiffBlockExprScalar : public AutoDiffBlockExpr< ScalarT, AutoDiffBlockExprScalar<ScalarT> >
+    {
+    public:
+        typedef ScalarT Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        explicit AutoDiffBlockExprScalar(const Scalar x, const int n)
+            : x_(x), n_(n)
+        {
+        }
+
+        int size() const { return n_; }
+        Scalar coeff(const int) const { return x_; }
+        const ADB* firstVariable() const { return nullptr; }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed&, std::vector<typename ADB::M>&) const
+        {
+        }
+
+    private:
+        Scalar x_;
+        int n_;
+    };
+
+
+
+    namespace AutoDiffBlockExprDetail
+    {
+        /// Evaluate the values of an expression into a vector.
+        template <class Expr>
+        typename AutoDiffBlock<typename Expr::Scalar>::V
+        values(const Expr& expr)
+        {
+            const int n = expr.size();
+            typename AutoDiffBlock<typename Expr::Scalar>::V val(n);
+            for (int i = 0; i < n; ++i) {
+                val[i] = expr.coeff(i);
+            }
+            return val;
+        }
+
+        template <class Lhs, class Rhs>
+        const AutoDiffBlock<typename Lhs::Scalar>*
+        firstVariable(const Lhs& lhs, const Rhs& rhs)
+        {
+            const AutoDiffBlock<typename Lhs::Scalar>* var = lhs.firstVariable();
+            return var ? var : rhs.firstVariable();
+        }
+    } // namespace AutoDiffBlockExprDetail
+
+
+
+    /// Elementwise sum of two expressions.
+    template <class Lhs, class Rhs>
+    class AutoDiffBlockExprSum : public AutoDiffBlockExpr< typename Lhs::Scalar, AutoDiffBlockExprSum<Lhs, Rhs> >
+    {
+    public:
+        typedef typename Lhs::Scalar Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        AutoDiffBlockExprSum(const Lhs& lhs, const Rhs& rhs)
+            : lhs_(lhs), rhs_(rhs)
+        {
+            assert(lhs_.size() == rhs_.size());
+        }
+
+        int size() const { return lhs_.size(); }
+        Scalar coeff(const int i) const { return lhs_.coeff(i) + rhs_.coeff(i); }
+
+        const ADB* firstVariable() const
+        {
+            return AutoDiffBlockExprDetail::firstVariable(lhs_, rhs_);
+        }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed& seed, std::vector<typename ADB::M>& jac) const
+        {
+            lhs_.accumulateJacobian(seed, jac);
+            rhs_.accumulateJacobian(seed, jac);
+        }
+
+    private:
+        Lhs lhs_;
+        Rhs rhs_;
+    };
+
+
+
+    /// Elementwise difference of two expressions.
+    template <class Lhs, class Rhs>
+    class AutoDiffBlockExprDifference : public AutoDiffBlockExpr< typename Lhs::Scalar, AutoDiffBlockExprDifference<Lhs, Rhs> >
+    {
+    public:
+        typedef typename Lhs::Scalar Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        AutoDiffBlockExprDifference(const Lhs& lhs, const Rhs& rhs)
+            : lhs_(lhs), rhs_(rhs)
+        {
+            assert(lhs_.size() == rhs_.size());
+        }
+
+        int size() const { return lhs_.size(); }
+        Scalar coeff(const int i) const { return lhs_.coeff(i) - rhs_.coeff(i); }
+
+        const ADB* firstVariable() const
+        {
+            return AutoDiffBlockExprDetail::firstVariable(lhs_, rhs_);
+        }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed& seed, std::vector<typename ADB::M>& jac) const
+        {
+            lhs_.accumulateJacobian(seed, jac);
+            if (rhs_.firstVariable()) {
+                const typename ADB::V neg_seed = -seed;
+                rhs_.accumulateJacobian(neg_seed, jac);
+            }
+        }
+
+    private:
+        Lhs lhs_;
+        Rhs rhs_;
+    };
+
+
+
+    /// Elementwise product of two expressions.
+    template <class Lhs, class Rhs>
+    class AutoDiffBlockExprProduct : public AutoDiffBlockExpr< typename Lhs::Scalar, AutoDiffBlockExprProduct<Lhs, Rhs> >
+    {
+    public:
+        typedef typename Lhs::Scalar Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        AutoDiffBlockExprProduct(const Lhs& lhs, const Rhs& rhs)
+            : lhs_(lhs), rhs_(rhs)
+        {
+            assert(lhs_.size() == rhs_.size());
+        }
+
+        int size() const { return lhs_.size(); }
+        Scalar coeff(const int i) const { return lhs_.coeff(i) * rhs_.coeff(i); }
+
+        const ADB* firstVariable() const
+        {
+            return AutoDiffBlockExprDetail::firstVariable(lhs_, rhs_);
+        }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed& seed, std::vector<typename ADB::M>& jac) const
+        {
+            // d(l*r) = r*dl + l*dr
+            if (lhs_.firstVariable()) {
+                const typename ADB::V lhs_seed = seed * AutoDiffBlockExprDetail::values(rhs_);
+                lhs_.accumulateJacobian(lhs_seed, jac);
+            }
+            if (rhs_.firstVariable()) {
+                const typename ADB::V rhs_seed = seed * AutoDiffBlockExprDetail::values(lhs_);
+                rhs_.accumulateJacobian(rhs_seed, jac);
+            }
+        }
+
+    private:
+        Lhs lhs_;
+        Rhs rhs_;
+    };
+
+
+
+    /// Elementwise quotient of two expressions.
+    template <class Lhs, class Rhs>
+    class AutoDiffBlockExprQuotient : public AutoDiffBlockExpr< typename Lhs::Scalar, AutoDiffBlockExprQuotient<Lhs, Rhs> >
+    {
+    public:
+        typedef typename Lhs::Scalar Scalar;
+        typedef AutoDiffBlock<Scalar> ADB;
+
+        AutoDiffBlockExprQuotient(const Lhs& lhs, const Rhs& rhs)
+            : lhs_(lhs), rhs_(rhs)
+        {
+            assert(lhs_.size() == rhs_.size());
+        }
+
+        int size() const { return lhs_.size(); }
+        Scalar coeff(const int i) const { return lhs_.coeff(i) / rhs_.coeff(i); }
+
+        const ADB* firstVariable() const
+        {
+            return AutoDiffBlockExprDetail::firstVariable(lhs_, rhs_);
+        }
+
+        template <class Seed>
+        void accumulateJacobian(const Seed& seed, std::vector<typename ADB::M>& jac) const
+        {
+            // d(l/r) = dl/r - l*dr/r^2
+            const typename ADB::V rval = AutoDiffBlockExprDetail::values(rhs_);
+            if (lhs_.firstVariable()) {
+                const typename ADB::V lhs_seed = seed / rval;
+                lhs_.accumulateJacobian(lhs_seed, jac);
+            }
+            if (rhs_.firstVariable()) {
+                const typename ADB::V rhs_seed
+                    = -seed * AutoDiffBlockExprDetail::values(lhs_) / (rval * rval);
+                rhs_.accumulateJacobian(rhs_seed, jac);
+            }
+        }
+
+    private:
+        Lhs lhs_;
+        Rhs rhs_;
+    };
+
+
+
+    // ---------  Free functions and operators for AutoDiffBlockExpr  ---------
+
+    /// Start a lazily evaluated expression.
+    template <typename Scalar>
+    AutoDiffBlockExprLeaf<Scalar> lazy(const AutoDiffBlock<Scalar>& x)
+    {
+        return AutoDiffBlockExprLeaf<Scalar>(x);
+    }
+
+
+#define OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR(OP, NODE)                                             \
+    template <typename S, class L, class R>                                                         \
+    NODE<L, R> operator OP(const AutoDiffBlockExpr<S, L>& lhs, const AutoDiffBlockExpr<S, R>& rhs)  \
+    {                                                                                               \
+        return NODE<L, R>(lhs.derived(), rhs.derived());                                            \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class L>                                                                  \
+    NODE<L, AutoDiffBlockExprLeaf<S> >                                                              \
+    operator OP(const AutoDiffBlockExpr<S, L>& lhs, const AutoDiffBlock<S>& rhs)                    \
+    {                                                                                               \
+        return NODE<L, AutoDiffBlockExprLeaf<S> >(lhs.derived(), AutoDiffBlockExprLeaf<S>(rhs));    \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class R>                                                                  \
+    NODE<AutoDiffBlockExprLeaf<S>, R>                                                               \
+    operator OP(const AutoDiffBlock<S>& lhs, const AutoDiffBlockExpr<S, R>& rhs)                    \
+    {                                                                                               \
+        return NODE<AutoDiffBlockExprLeaf<S>, R>(AutoDiffBlockExprLeaf<S>(lhs), rhs.derived());     \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class L>                                                                  \
+    NODE<L, AutoDiffBlockExprConstant<S> >                                                          \
+    operator OP(const AutoDiffBlockExpr<S, L>& lhs, const typename AutoDiffBlock<S>::V& rhs)        \
+    {                                                                                               \
+        typedef AutoDiffBlockExprConstant<S> R;                                                     \
+        return NODE<L, R>(lhs.derived(), R(rhs));                                                   \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class R>                                                                  \
+    NODE<AutoDiffBlockExprConstant<S>, R>                                                           \
+    operator OP(const typename AutoDiffBlock<S>::V& lhs, const AutoDiffBlockExpr<S, R>& rhs)        \
+    {                                                                                               \
+        typedef AutoDiffBlockExprConstant<S> L;                                                     \
+        return NODE<L, R>(L(lhs), rhs.derived());                                                   \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class L>                                                                  \
+    NODE<L, AutoDiffBlockExprScalar<S> >                                                            \
+    operator OP(const AutoDiffBlockExpr<S, L>& lhs, const typename AutoDiffBlock<S>::V::Scalar rhs) \
+    {                                                                                               \
+        typedef AutoDiffBlockExprScalar<S> R;                                                       \
+        return NODE<L, R>(lhs.derived(), R(rhs, lhs.derived().size()));                             \
+    }                                                                                               \
+                                                                                                    \
+    template <typename S, class R>                                                                  \
+    NODE<AutoDiffBlockExprScalar<S>, R>                                                             \
+    operator OP(const typename AutoDiffBlock<S>::V::Scalar lhs, const AutoDiffBlockExpr<S, R>& rhs) \
+    {                                                                                               \
+        typedef AutoDiffBlockExprScalar<S> L;                                                       \
+        return NODE<L, R>(L(lhs, rhs.derived().size()), rhs.derived());                             \
+    }
+
+    OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR(+, AutoDiffBlockExprSum)
+    OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR(-, AutoDiffBlockExprDifference)
+    OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR(*, AutoDiffBlockExprProduct)
+    OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR(/, AutoDiffBlockExprQuotient)
+
+#undef OPM_AUTODIFFBLOCKEXPR_BINARY_OPERATOR
+
+} // namespace Opm
+
+
+
+#endif // OPM_AUTODIFFBLOCKEXPR_HEADER_INCLUDED
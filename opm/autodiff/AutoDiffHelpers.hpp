@@ -186,6 +186,7 @@ struct HelperOps
         UpwindSelector(const Grid& g,
                        const HelperOps&        h,
                        const typename ADB::V&  ifaceflux)
+            : upwind_rows_(std::vector<int>(), 0)
         {
             using namespace AutoDiffGrid;
             typedef HelperOps::IFaces::Index IFIndex;
@@ -198,9 +199,8 @@ struct HelperOps
             int num_connections = nif + num_nnc;
             assert(num_connections == ifaceflux.size());
 
-            // Define selector structure.
-            typedef typename Eigen::Triplet<Scalar> Triplet;
-            std::vector<Triplet> s;  s.reserve(num_connections);
+            // Define selector structure: the upwind cell of each connection.
+            std::vector<int> upwind_cells(num_connections);
             for (IFIndex iface = 0; iface < nif; ++iface) {
                 const int f  = h.internal_faces[iface];
                 const int c1 = face_cells(f,0);
@@ -209,20 +209,17 @@ struct HelperOps
                 assert ((c1 >= 0) && (c2 >= 0));
 
                 // Select upwind cell.
-                const int c = (ifaceflux[iface] >= 0) ? c1 : c2;
-
-                s.push_back(Triplet(iface, c, Scalar(1)));
+                upwind_cells[iface] = (ifaceflux[iface] >= 0) ? c1 : c2;
             }
             if (num_nnc > 0) {
                 for (int i = 0; i < num_nnc; ++i) {
-                    const int c = (ifaceflux[i+nif] >= 0) ? h.nnc_cells(i,0) : h.nnc_cells(i,1);
-                    s.push_back(Triplet(i+nif,c,Scalar(1)));
+                    upwind_cells[i+nif] = (ifaceflux[i+nif] >= 0) ? h.nnc_cells(i,0) : h.nnc_cells(i,1);
                 }
             }
 
-            // Assemble explicit selector operator.
-            select_.resize(num_connections, numCells(g));
-            select_.setFromTriplets(s.begin(), s.end());
+            // The row selection is set up once, and applied to all
+            // Jacobian blocks of all selected quantities.
+            upwind_rows_ = RowSelection(upwind_cells, numCells(g));
         }
 
         /// Apply selector to multiple per-cell quantities.
@@ -236,7 +233,7 @@ struct HelperOps
             for (typename std::vector<ADB>::const_iterator
                      b = xc.begin(), e = xc.end(); b != e; ++b)
             {
-                xf.push_back(select_ * (*b));
+                xf.push_back(select(*b));
             }
 
             return xf;
@@ -245,17 +242,30 @@ struct HelperOps
         /// Apply selector to single per-cell ADB quantity.
         ADB select(const ADB& xc) const
         {
-            return select_*xc;
+            typename ADB::V val = select(xc.value());
+            const int num_blocks = xc.numBlocks();
+            std::vector<typename ADB::M> jac;
+            jac.reserve(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jac.push_back(xc.derivative()[block].selectRows(upwind_rows_));
+            }
+            return ADB::function(std::move(val), std::move(jac));
         }
 
         /// Apply selector to single per-cell constant quantity.
         typename ADB::V select(const typename ADB::V& xc) const
         {
-            return (select_*xc.matrix()).array();
+            const int num_connections = upwind_rows_.size();
+            typename ADB::V xf(num_connections);
+            for (int i = 0; i < num_connections; ++i) {
+                xf[i] = xc[upwind_rows_[i]];
+            }
+            return xf;
         }
 
     private:
-        Eigen::SparseMatrix<double> select_;
+        // Upwind cell of each connection, as a row selection.
+        RowSelection upwind_rows_;
     };
 
 
@@ -286,6 +296,102 @@ namespace {
 
 
 
+/// Precomputed index maps for repeated subset() and superset() calls
+/// with the same indices, such as the perforated cells of the wells.
+///
+/// With a plan, selecting from identity or diagonal Jacobians costs
+/// O(size() + number of columns), and superset() of any Jacobian
+/// O(nonzeros of x + number of columns). Selecting rows from a general
+/// sparse Jacobian visits all its nonzeros, since it is stored by column.
+class SubsetPlan
+{
+public:
+    /// Construct an empty plan.
+    SubsetPlan()
+        : full_size_(0),
+          subset_rows_(std::vector<int>(), 0),
+          superset_rows_(std::vector<int>(), 0)
+    {
+    }
+
+    /// Construct the plan for selecting indices out of full_size elements.
+    template <class IntVec>
+    SubsetPlan(const IntVec& indices, const int full_size)
+        : indices_(toVector(indices)),
+          full_size_(full_size),
+          subset_rows_(indices_, full_size),
+          superset_rows_(supersetRows(indices_, full_size), indices_.size())
+    {
+    }
+
+    /// The selected indices.
+    const std::vector<int>& indices() const
+    {
+        return indices_;
+    }
+
+    /// Size of the subset.
+    int size() const
+    {
+        return indices_.size();
+    }
+
+    /// Size of the full set.
+    int fullSize() const
+    {
+        return full_size_;
+    }
+
+    /// Row selection performing the subset operation.
+    const RowSelection& subsetRows() const
+    {
+        return subset_rows_;
+    }
+
+    /// Row selection performing the superset operation, valid if
+    /// unique() is true.
+    const RowSelection& supersetRows() const
+    {
+        return superset_rows_;
+    }
+
+    /// True if no index is repeated.
+    bool unique() const
+    {
+        return subset_rows_.unique();
+    }
+
+private:
+    std::vector<int> indices_;
+    int full_size_;
+    RowSelection subset_rows_;
+    RowSelection superset_rows_;
+
+    template <class IntVec>
+    static std::vector<int> toVector(const IntVec& indices)
+    {
+        const int size = indices.size();
+        std::vector<int> v(size);
+        for (int i = 0; i < size; ++i) {
+            v[i] = indices[i];
+        }
+        return v;
+    }
+
+    // For each element of the full set, its position in the subset (the
+    // last one if repeated), or -1.
+    static std::vector<int> supersetRows(const std::vector<int>& indices, const int full_size)
+    {
+        std::vector<int> rows(full_size, -1);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            rows[indices[i]] = i;
+        }
+        return rows;
+    }
+};
+
+
+
 /// Returns x(indices).
 template <typename Scalar, class IntVec>
 Eigen::Array<Scalar, Eigen::Dynamic, 1>
@@ -307,9 +413,80 @@ AutoDiffBlock<Scalar>
 subset(const AutoDiffBlock<Scalar>& x,
        const IntVec& indices)
 {
-    const Eigen::SparseMatrix<Scalar> sub
-        = constructSupersetSparseMatrix<Scalar>(x.value().size(), indices).transpose().eval();
-    return sub * x;
+    return subset(x, RowSelection(indices, x.size()));
+}
+
+/// Returns x(indices), where indices are given by a row selection.
+template <typename Scalar>
+AutoDiffBlock<Scalar>
+subset(const AutoDiffBlock<Scalar>& x,
+       const RowSelection& rows)
+{
+    typedef AutoDiffBlock<Scalar> ADB;
+    const int size = rows.size();
+    typename ADB::V val(size);
+    for (int i = 0; i < size; ++i) {
+        val[i] = (rows[i] >= 0) ? x.value()[rows[i]] : Scalar(0);
+    }
+    const int num_blocks = x.numBlocks();
+    std::vector<typename ADB::M> jac;
+    jac.reserve(num_blocks);
+    for (int block = 0; block < num_blocks; ++block) {
+        jac.push_back(x.derivative()[block].selectRows(rows));
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+/// Returns x(plan.indices()).
+template <typename Scalar>
+Eigen::Array<Scalar, Eigen::Dynamic, 1>
+subset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
+       const SubsetPlan& plan)
+{
+    return subset(x, plan.indices());
+}
+
+/// Returns x(plan.indices()).
+template <typename Scalar>
+AutoDiffBlock<Scalar>
+subset(const AutoDiffBlock<Scalar>& x,
+       const SubsetPlan& plan)
+{
+    assert(x.size() == plan.fullSize());
+    return subset(x, plan.subsetRows());
+}
+
+
+/// Returns v where v(plan.indices()) == x, v(!plan.indices()) == 0
+/// and v.size() == plan.fullSize().
+template <typename Scalar>
+AutoDiffBlock<Scalar>
+superset(const AutoDiffBlock<Scalar>& x,
+         const SubsetPlan& plan)
+{
+    assert(x.size() == plan.size());
+    if (!plan.unique()) {
+        // Repeated indices sum their contributions.
+        return constructSupersetSparseMatrix<Scalar>(plan.fullSize(), plan.indices()) * x;
+    }
+    return subset(x, plan.supersetRows());
+}
+
+
+/// Returns v where v(plan.indices()) == x, v(!plan.indices()) == 0
+/// and v.size() == plan.fullSize().
+template <typename Scalar>
+Eigen::Array<Scalar, Eigen::Dynamic, 1>
+superset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
+         const SubsetPlan& plan)
+{
+    assert(x.size() == plan.size());
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ret = Eigen::Array<Scalar, Eigen::Dynamic, 1>::Zero(plan.fullSize());
+    const std::vector<int>& indices = plan.indices();
+    for (int i = 0; i < plan.size(); ++i) {
+        ret[indices[i]] += x[i];
+    }
+    return ret;
 }
 
 
@@ -320,7 +497,7 @@ superset(const AutoDiffBlock<Scalar>& x,
          const IntVec& indices,
          const int n)
 {
-    return constructSupersetSparseMatrix<Scalar>(n, indices) * x;
+    return superset(x, SubsetPlan(indices, n));
 }
 
 
@@ -332,7 +509,12 @@ superset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
          const IntVec& indices,
          const int n)
 {
-    return constructSupersetSparseMatrix<Scalar>(n, indices) * x.matrix();
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ret = Eigen::Array<Scalar, Eigen::Dynamic, 1>::Zero(n);
+    const int size = indices.size();
+    for (int i = 0; i < size; ++i) {
+        ret[indices[i]] += x[i];
+    }
+    return ret;
 }
 
 
@@ -369,6 +551,8 @@ spdiag(const AutoDiffBlock<double>::V& d)
 
         Selector(const typename ADB::V& selection_basis,
                  CriterionForLeftElement crit = GreaterEqualZero)
+            : left_rows_(std::vector<int>(), 0),
+              right_rows_(std::vector<int>(), 0)
         {
             using std::isnan;
             // Define selector structure.
@@ -376,6 +560,8 @@ spdiag(const AutoDiffBlock<double>::V& d)
             // Over-reserving so we do not have to count.
             left_elems_.reserve(n);
             right_elems_.reserve(n);
+            std::vector<int> left_rows(n);
+            std::vector<int> right_rows(n);
             for (int i = 0; i < n; ++i) {
                 bool chooseleft = false;
                 switch (crit) {
@@ -411,7 +597,13 @@ spdiag(const AutoDiffBlock<double>::V& d)
                 } else {
                     right_elems_.push_back(i);
                 }
+                left_rows[i] = chooseleft ? i : -1;
+                right_rows[i] = chooseleft ? -1 : i;
             }
+            // The row selections are set up once, and applied to all
+            // Jacobian blocks in select().
+            left_rows_ = RowSelection(left_rows, n);
+            right_rows_ = RowSelection(right_rows, n);
         }
 
         /// Apply selector to ADB quantities.
@@ -422,8 +614,7 @@ spdiag(const AutoDiffBlock<double>::V& d)
             } else if (left_elems_.empty()) {
                 return x2;
             } else {
-                return superset(subset(x1, left_elems_), left_elems_, x1.size())
-                    + superset(subset(x2, right_elems_), right_elems_, x2.size());
+                return mask(x1, left_rows_) + mask(x2, right_rows_);
             }
         }
 
@@ -435,14 +626,40 @@ spdiag(const AutoDiffBlock<double>::V& d)
             } else if (left_elems_.empty()) {
                 return x2;
             } else {
-                return superset(subset(x1, left_elems_), left_elems_, x1.size())
-                    + superset(subset(x2, right_elems_), right_elems_, x2.size());
+                const int n = left_rows_.size();
+                typename ADB::V x(n);
+                for (int i = 0; i < n; ++i) {
+                    x[i] = (left_rows_[i] >= 0) ? x1[i] : x2[i];
+                }
+                return x;
             }
         }
 
     private:
         std::vector<int> left_elems_;
         std::vector<int> right_elems_;
+        // For each element, its own index if selected from the left
+        // (right) argument, and -1 otherwise.
+        RowSelection left_rows_;
+        RowSelection right_rows_;
+
+        // Zero the elements (and Jacobian rows) of x not selected by rows.
+        static ADB mask(const ADB& x, const RowSelection& rows)
+        {
+            const int n = rows.size();
+            assert(x.size() == n);
+            typename ADB::V val(n);
+            for (int i = 0; i < n; ++i) {
+                val[i] = (rows[i] >= 0) ? x.value()[i] : 0.0;
+            }
+            const int num_blocks = x.numBlocks();
+            std::vector<typename ADB::M> jac;
+            jac.reserve(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jac.push_back(x.derivative()[block].selectRows(rows));
+            }
+            return ADB::function(std::move(val), std::move(jac));
+        }
     };
 
 
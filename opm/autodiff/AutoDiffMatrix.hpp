@@ -28,13 +28,127 @@
 #include <opm/common/utility/platform_dependent/reenable_warnings.h>
 
 #include <opm/common/ErrorMacros.hpp>
+#include <opm/autodiff/AutoDiffArena.hpp>
+#include <opm/autodiff/DiagonalKernels.hpp>
+#include <opm/autodiff/SparsityPatternCache.hpp>
 #include <opm/autodiff/fastSparseOperations.hpp>
+#include <algorithm>
 #include <vector>
 
 
 namespace Opm
 {
 
+    /**
+     * A selection of rows, as used by AutoDiffMatrix::selectRows(). Row i
+     * of the selection is source row rows[i], or zero if rows[i] is
+     * negative. The inverse map from source rows to selected rows is
+     * precomputed, so that a selection applied to several matrices is
+     * only set up once.
+     */
+    class RowSelection
+    {
+    public:
+        template <class IntVec>
+        RowSelection(const IntVec& rows, const int num_source_rows)
+            : rows_(rows.size()),
+              start_(num_source_rows + 1, 0),
+              ordered_(true),
+              in_place_(int(rows.size()) == num_source_rows)
+        {
+            const int m = rows.size();
+            int last = -1;
+            for (int i = 0; i < m; ++i) {
+                const int r = rows[i];
+                assert(r < num_source_rows);
+                rows_[i] = r;
+                if (r >= 0) {
+                    ++start_[r + 1];
+                    ordered_ = ordered_ && r > last;
+                    last = r;
+                    in_place_ = in_place_ && r == i;
+                }
+            }
+            for (int r = 0; r < num_source_rows; ++r) {
+                start_[r + 1] += start_[r];
+            }
+            targets_.resize(start_[num_source_rows]);
+            std::vector<int> pos(start_.begin(), start_.end() - 1);
+            for (int i = 0; i < m; ++i) {
+                if (rows_[i] >= 0) {
+                    targets_[pos[rows_[i]]++] = i;
+                }
+            }
+        }
+
+        /// Number of selected rows.
+        int size() const
+        {
+            return rows_.size();
+        }
+
+        /// Number of rows of the matrices selected from.
+        int sourceRows() const
+        {
+            return start_.size() - 1;
+        }
+
+        /// Source row of selected row i, or -1.
+        int operator[](const int i) const
+        {
+            return rows_[i];
+        }
+
+        /// Selected rows taking source row r, in increasing order.
+        const int* targetsBegin(const int r) const
+        {
+            return targets_.data() + start_[r];
+        }
+
+        const int* targetsEnd(const int r) const
+        {
+            return targets_.data() + start_[r + 1];
+        }
+
+        /// True if the selected source rows are strictly increasing,
+        /// such that selecting preserves the order of the entries in a column.
+        bool ordered() const
+        {
+            return ordered_;
+        }
+
+        /// True if each row is either kept in place or zeroed.
+        bool inPlace() const
+        {
+            return in_place_;
+        }
+
+        /// True if each source row is selected at most once.
+        bool unique() const
+        {
+            return int(targets_.size()) == 0 || ordered_ || uniqueTargets();
+        }
+
+    private:
+        std::vector<int> rows_;
+        std::vector<int> start_;
+        std::vector<int> targets_;
+        bool ordered_;
+        bool in_place_;
+
+        bool uniqueTargets() const
+        {
+            for (std::size_t r = 0; r + 1 < start_.size(); ++r) {
+                if (start_[r + 1] - start_[r] > 1) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+
+
     /**
      * AutoDiffMatrix is a wrapper class that optimizes matrix operations.
      * Internally, an AutoDiffMatrix can be either Zero, Identity, Diagonal,
@@ -43,7 +157,7 @@ namespace Opm
     class AutoDiffMatrix
     {
     public:
-        typedef std::vector<double> DiagRep;
+        typedef std::vector<double, AutoDiffArenaAllocator<double> > DiagRep;
         typedef Eigen::SparseMatrix<double> SparseRep;
 
 
@@ -266,7 +380,11 @@ namespace Opm
         {
             if( type_ == Sparse && rhs.type_ == Sparse )
             {
-                fastSparseAdd( sparse_, rhs.sparse_ );
+                addSparse( sparse_, rhs.sparse_ );
+            }
+            else if( type_ == Diagonal && rhs.type_ == Diagonal )
+            {
+                DiagonalKernels::add( diag_.data(), rhs.diag_.data(), rows_ );
             }
             else {
                 *this = *this + rhs;
@@ -296,6 +414,73 @@ namespace Opm
 
 
 
+        /**
+         * Performs (*this) += diag(d) * rhs. For Zero, Identity and Diagonal
+         * operands this is done in place without creating any temporary
+         * matrices, which makes it suitable for accumulating the Jacobian
+         * of an elementwise expression one operand at a time.
+         */
+        template <class DiagVector>
+        void addDiagonalProduct(const DiagVector& d, const AutoDiffMatrix& rhs)
+        {
+            // Evaluate into contiguous storage for the vectorized kernels.
+            Eigen::Array<double, Eigen::Dynamic, 1> dv(d.size());
+            for (int r = 0; r < dv.size(); ++r) {
+                dv[r] = d[r];
+            }
+            addDiagonalProduct(dv, rhs);
+        }
+
+        /**
+         * Performs (*this) += diag(d) * rhs, see above.
+         */
+        void addDiagonalProduct(const Eigen::Array<double, Eigen::Dynamic, 1>& d, const AutoDiffMatrix& rhs)
+        {
+            assert(rows_ == rhs.rows_);
+            assert(cols_ == rhs.cols_);
+            assert(d.size() == rows_);
+            if (rhs.type_ == Zero) {
+                return;
+            }
+            const bool rhs_is_diag = (rhs.type_ == Identity || rhs.type_ == Diagonal);
+            if (type_ == Zero && rhs_is_diag) {
+                type_ = Diagonal;
+                diag_.resize(rows_);
+                if (rhs.type_ == Identity) {
+                    for (int r = 0; r < rows_; ++r) {
+                        diag_[r] = d[r];
+                    }
+                } else {
+                    DiagonalKernels::product(diag_.data(), d.data(), rhs.diag_.data(), rows_);
+                }
+                return;
+            }
+            if ((type_ == Identity || type_ == Diagonal) && rhs_is_diag) {
+                if (type_ == Identity) {
+                    type_ = Diagonal;
+                    diag_.assign(rows_, 1.0);
+                }
+                if (rhs.type_ == Identity) {
+                    DiagonalKernels::add(diag_.data(), d.data(), rows_);
+                } else {
+                    DiagonalKernels::addProduct(diag_.data(), d.data(), rhs.diag_.data(), rows_);
+                }
+                return;
+            }
+            // At least one operand is sparse, use the general operators.
+            DiagRep dcopy(rows_);
+            for (int r = 0; r < rows_; ++r) {
+                dcopy[r] = d[r];
+            }
+            const AutoDiffMatrix dmat(Diagonal, rows_, rows_, std::move(dcopy));
+            *this += dmat * rhs;
+        }
+
+
+
+
+
+
         /**
          * Multiplies an AutoDiffMatrix with a scalar. Optimizes internally
          * by exploiting that e.g., an identity matrix multiplied by a scalar x
@@ -316,9 +501,7 @@ namespace Opm
             case Diagonal:
                 {
                     AutoDiffMatrix retval(*this);
-                    for (double& elem : retval.diag_) {
-                        elem *= rhs;
-                    }
+                    DiagonalKernels::scale(retval.diag_.data(), rhs, rows_);
                     return retval;
                 }
             case Sparse:
@@ -407,6 +590,130 @@ namespace Opm
 
 
 
+        /**
+         * Returns the matrix whose row i is row rows[i] of this matrix, or
+         * a zero row if rows[i] is negative. This is the product S * (*this)
+         * with a selection matrix S having at most one unit entry per row,
+         * computed by copying rows instead of forming a sparse product.
+         * Selecting a subset of the rows of a diagonal matrix in place
+         * (that is, rows[i] is either i or negative) yields a diagonal matrix.
+         */
+        template <class IntVec>
+        AutoDiffMatrix selectRows(const IntVec& rows) const
+        {
+            return selectRows(RowSelection(rows, rows_));
+        }
+
+
+
+        /**
+         * As selectRows(const IntVec&), with a precomputed selection
+         * that may be reused for several matrices.
+         */
+        AutoDiffMatrix selectRows(const RowSelection& sel) const
+        {
+            assert(sel.sourceRows() == rows_);
+            const int m = sel.size();
+            switch (type_) {
+            case Zero:
+                return AutoDiffMatrix(m, cols_);
+            case Identity:
+            case Diagonal:
+                {
+                    if (sel.inPlace()) {
+                        DiagRep d(m, 0.0);
+                        for (int i = 0; i < m; ++i) {
+                            if (sel[i] >= 0) {
+                                d[i] = (type_ == Identity) ? 1.0 : diag_[i];
+                            }
+                        }
+                        return AutoDiffMatrix(Diagonal, m, m, std::move(d));
+                    }
+                    // Column c holds the rows selecting source row c. Built
+                    // from the selected rows only, visiting them in
+                    // increasing order so that each column is sorted.
+                    SparseRep s(m, cols_);
+                    int* outer = s.outerIndexPtr();
+                    for (int i = 0; i < m; ++i) {
+                        if (sel[i] >= 0) {
+                            ++outer[sel[i] + 1];
+                        }
+                    }
+                    for (int c = 0; c < cols_; ++c) {
+                        outer[c + 1] += outer[c];
+                    }
+                    s.resizeNonZeros(outer[cols_]);
+                    int* inner = s.innerIndexPtr();
+                    double* values = s.valuePtr();
+                    for (int i = 0; i < m; ++i) {
+                        const int c = sel[i];
+                        if (c >= 0) {
+                            // outer[c] is used as the insertion cursor of column c.
+                            inner[outer[c]] = i;
+                            values[outer[c]] = (type_ == Identity) ? 1.0 : diag_[c];
+                            ++outer[c];
+                        }
+                    }
+                    // Shift the cursors back to the column starts.
+                    for (int c = cols_; c > 0; --c) {
+                        outer[c] = outer[c - 1];
+                    }
+                    outer[0] = 0;
+                    return AutoDiffMatrix(Sparse, m, cols_, DiagRep(), std::move(s));
+                }
+            case Sparse:
+                {
+                    // Each entry (r, c) is copied to (i, c) for all rows i selecting r.
+                    // With column major storage, the entries of the selected
+                    // rows can only be found by visiting all nonzeros.
+                    SparseRep s(m, cols_);
+                    int* outer = s.outerIndexPtr();
+                    outer[0] = 0;
+                    for (int c = 0; c < cols_; ++c) {
+                        int count = 0;
+                        for (SparseRep::InnerIterator it(sparse_, c); it; ++it) {
+                            count += sel.targetsEnd(it.index()) - sel.targetsBegin(it.index());
+                        }
+                        outer[c + 1] = outer[c] + count;
+                    }
+                    s.resizeNonZeros(outer[cols_]);
+                    int* inner = s.innerIndexPtr();
+                    double* values = s.valuePtr();
+                    for (int c = 0; c < cols_; ++c) {
+                        int k = outer[c];
+                        for (SparseRep::InnerIterator it(sparse_, c); it; ++it) {
+                            for (const int* t = sel.targetsBegin(it.index()); t != sel.targetsEnd(it.index()); ++t) {
+                                inner[k] = *t;
+                                values[k] = it.value();
+                                ++k;
+                            }
+                        }
+                        if (!sel.ordered()) {
+                            // Insertion sort, the columns are short.
+                            for (int j = outer[c] + 1; j < outer[c + 1]; ++j) {
+                                const int row = inner[j];
+                                const double value = values[j];
+                                int l = j;
+                                for (; l > outer[c] && inner[l - 1] > row; --l) {
+                                    inner[l] = inner[l - 1];
+                                    values[l] = values[l - 1];
+                                }
+                                inner[l] = row;
+                                values[l] = value;
+                            }
+                        }
+                    }
+                    return AutoDiffMatrix(Sparse, m, cols_, DiagRep(), std::move(s));
+                }
+            default:
+                OPM_THROW(std::logic_error, "Invalid AutoDiffMatrix type encountered: " << type_);
+            }
+        }
+
+
+
+
+
         // Add identity to identity
         static AutoDiffMatrix addII(const AutoDiffMatrix& lhs, const AutoDiffMatrix& rhs)
         {
@@ -427,9 +734,7 @@ namespace Opm
             assert(lhs.type_ == Diagonal);
             assert(rhs.type_ == Identity);
             AutoDiffMatrix retval = lhs;
-            for (int r = 0; r < lhs.rows_; ++r) {
-                retval.diag_[r] += 1.0;
-            }
+            DiagonalKernels::addScalar(retval.diag_.data(), 1.0, lhs.rows_);
             return retval;
         }
 
@@ -439,9 +744,7 @@ namespace Opm
             assert(lhs.type_ == Diagonal);
             assert(rhs.type_ == Diagonal);
             AutoDiffMatrix retval = lhs;
-            for (int r = 0; r < lhs.rows_; ++r) {
-                retval.diag_[r] += rhs.diag_[r];
-            }
+            DiagonalKernels::add(retval.diag_.data(), rhs.diag_.data(), lhs.rows_);
             return retval;
         }
 
@@ -472,10 +775,31 @@ namespace Opm
             assert(lhs.type_ == Sparse);
             assert(rhs.type_ == Sparse);
             AutoDiffMatrix retval = lhs;
-            retval.sparse_ += rhs.sparse_;
+            addSparse(retval.sparse_, rhs.sparse_);
             return retval;
         }
 
+        // Add sparse to sparse in place. If the patterns differ, the
+        // sparsity pattern cache is used when enabled, otherwise large
+        // sums are merged by the threaded fastSparseSum().
+        static void addSparse(SparseRep& lhs, const SparseRep& rhs)
+        {
+            if (lhs.isCompressed() && rhs.isCompressed()
+                && !equalSparsityPattern(lhs, rhs)) {
+                if (SparsityPatternCache::enabled()) {
+                    SparsityPatternCache::sum(lhs, rhs, lhs);
+                } else if (FastSparseThreading::useThreads(lhs.nonZeros() + rhs.nonZeros())) {
+                    SparseRep sum;
+                    fastSparseSum(lhs, rhs, sum);
+                    lhs.swap(sum);
+                } else {
+                    lhs += rhs;
+                }
+            } else {
+                fastSparseAdd(lhs, rhs);
+            }
+        }
+
 
 
 
@@ -485,9 +809,7 @@ namespace Opm
             assert(lhs.type_ == Diagonal);
             assert(rhs.type_ == Diagonal);
             AutoDiffMatrix retval = lhs;
-            for (int r = 0; r < lhs.rows_; ++r) {
-                retval.diag_[r] *= rhs.diag_[r];
-            }
+            DiagonalKernels::multiply(retval.diag_.data(), rhs.diag_.data(), lhs.rows_);
             return retval;
         }
 
@@ -526,7 +848,12 @@ namespace Opm
             retval.type_ = Sparse;
             retval.rows_ = lhs.rows_;
             retval.cols_ = rhs.cols_;
-            fastSparseProduct(lhs.sparse_, rhs.sparse_, retval.sparse_);
+            if (SparsityPatternCache::enabled()
+                && lhs.sparse_.isCompressed() && rhs.sparse_.isCompressed()) {
+                SparsityPatternCache::product(lhs.sparse_, rhs.sparse_, retval.sparse_);
+            } else {
+                fastSparseProduct(lhs.sparse_, rhs.sparse_, retval.sparse_);
+            }
             return retval;
         }
 
@@ -667,8 +994,8 @@ namespace Opm
             : type_(type),
               rows_(rows_arg),
               cols_(cols_arg),
-              diag_(diag),
-              sparse_(sparse)
+              diag_(std::move(diag)),
+              sparse_(std::move(sparse))
         {
         }
 
@@ -45,6 +45,8 @@ namespace Opm {
     {
     public:
         typedef BlackoilModelBase<Grid, StandardWells, BlackoilModel<Grid> > Base;
+        friend Base;
+        typedef typename Base::ADB ADB;
 
         /// Construct the model. It will retain references to the
         /// arguments of this functions, and they are expected to
@@ -77,6 +79,25 @@ namespace Opm {
                    eclState, schedule, summary_config, has_disgas, has_vapoil, terminal_output)
         {
         }
+
+    protected:
+        /// Viscosity and reciprocal formation volume factor of a phase,
+        /// evaluated in a single pass over the cells. This model does not
+        /// override fluidViscosity() or fluidReciprocFVF(), so the result
+        /// is the same as that of the base class.
+        BlackoilPropsAdFromDeck::PhasePvt
+        fluidViscosityAndReciprocFVF(const int               phase,
+                                     const ADB&              p    ,
+                                     const ADB&              temp ,
+                                     const ADB&              rs   ,
+                                     const ADB&              rv   ,
+                                     const std::vector<PhasePresence>& cond) const
+        {
+            return fluid_.phasePvt(phase, p, temp, (phase == Gas) ? rv : rs, cond, cells_);
+        }
+
+        using Base::fluid_;
+        using Base::cells_;
     };
 
 
@@ -35,6 +35,7 @@
 #include <opm/autodiff/VFPProdPropertiesLegacy.hpp>
 #include <opm/autodiff/VFPProperties.hpp>
 #include <opm/autodiff/RateConverterLegacy.hpp>
+#include <opm/autodiff/StencilOps.hpp>
 #include <opm/autodiff/IterationReport.hpp>
 #include <opm/autodiff/DefaultBlackoilSolutionState.hpp>
 #include <opm/parser/eclipse/EclipseState/Grid/NNC.hpp>
@@ -184,7 +185,8 @@ namespace Opm {
         /// updates if necessary.
         /// \param[in] iteration              should be 0 for the first call of a new timestep
         /// \param[in] timer                  simulation timer
-        /// \param[in] nonlinear_solver       nonlinear solver used (for oscillation/relaxation control)
+        /// \param[in] nonlinear_solver       nonlinear solver used (for oscillation/relaxation control, line search
+        ///                                   and linear tolerance)
         /// \param[in, out] reservoir_state   reservoir state variables
         /// \param[in, out] well_state        well state variables
         template <class NonlinearSolverType>
@@ -212,6 +214,23 @@ namespace Opm {
                  WellState& well_state,
                  const bool initial_assembly);
 
+        /// Evaluate the residual of the nonlinear system at a trial state,
+        /// without computing any Jacobians. The primary variables are
+        /// created as constants, so all property, flux and well
+        /// computations only operate on values.
+        /// The accumulation terms of the start of the time step must be
+        /// available from a previous call to assemble() with
+        /// initial_assembly = true. Well controls are not updated and the
+        /// well equations are not solved; the well state is copied and
+        /// not modified. Note that this overwrites the current residual,
+        /// so assemble() must be called before the next linear solve.
+        /// \param[in] reservoir_state   trial reservoir state variables
+        /// \param[in] well_state        trial well state variables
+        /// \return the residual norms, as given by computeResidualNorms()
+        std::vector<double>
+        evaluateResidual(const ReservoirState& reservoir_state,
+                         const WellState& well_state);
+
         /// \brief Compute the residual norms of the mass balance for each phase,
         /// the well flux, and the well equation.
         /// \return a vector that contains for each phase the norm of the mass balance
@@ -333,11 +352,14 @@ namespace Opm {
         const std::vector<int>          canph_;
         const std::vector<int>          cells_;  // All grid cells
         HelperOps                       ops_;
+        StencilOps                      stencil_;
         const bool has_disgas_;
         const bool has_vapoil_;
 
         ModelParameters                 param_;
         bool use_threshold_pressure_;
+        // If true, variableState() creates the primary variables as constants.
+        bool residual_only_;
         V threshold_pressures_by_connection_;
 
         mutable SimulatorData sd_;
@@ -417,6 +439,14 @@ namespace Opm {
         computeAccum(const SolutionState& state,
                      const int            aix  );
 
+        /// Accumulation terms from the reciprocal formation volume
+        /// factors already stored in sd_.rq[phase].b. Called through
+        /// asImpl() by computeAccum() and assembleMassBalanceEq(), so
+        /// implementations adding accumulation terms should override it.
+        void
+        computeAccumFromReciprocFVF(const SolutionState& state,
+                                    const int            aix  );
+
         void
         assembleMassBalanceEq(const SolutionState& state);
 
@@ -479,6 +509,19 @@ namespace Opm {
                          const ADB&              rv   ,
                          const std::vector<PhasePresence>& cond) const;
 
+        /// Viscosity and reciprocal formation volume factor of a phase.
+        /// By default calls fluidViscosity() and fluidReciprocFVF()
+        /// through asImpl(), so that their overrides are respected.
+        /// Implementations without such overrides may evaluate both in
+        /// one pass, see BlackoilModel.
+        BlackoilPropsAdFromDeck::PhasePvt
+        fluidViscosityAndReciprocFVF(const int               phase,
+                                     const ADB&              p    ,
+                                     const ADB&              temp ,
+                                     const ADB&              rs   ,
+                                     const ADB&              rv   ,
+                                     const std::vector<PhasePresence>& cond) const;
+
         ADB
         fluidDensity(const int  phase,
                      const ADB& b,
@@ -511,6 +554,22 @@ namespace Opm {
         ADB
         transMult(const ADB& p) const;
 
+        /// Apply ops_.div, matrix-free if requested by the parameters.
+        ADB
+        applyDiv(const ADB& flux) const;
+
+        /// Apply ops_.ngrad, matrix-free if requested by the parameters.
+        ADB
+        applyNgrad(const ADB& x) const;
+
+        /// Apply ops_.ngrad, matrix-free if requested by the parameters.
+        V
+        applyNgrad(const V& x) const;
+
+        /// Apply ops_.caver, matrix-free if requested by the parameters.
+        ADB
+        applyCaver(const ADB& x) const;
+
         const std::vector<PhasePresence>
         phaseCondition() const {return phaseCondition_;}
 
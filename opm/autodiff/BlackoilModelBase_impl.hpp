@@ -28,9 +28,12 @@
 #include <opm/autodiff/BlackoilDetails.hpp>
 #include <opm/autodiff/BlackoilLegacyDetails.hpp>
 
+#include <opm/autodiff/AutoDiffArena.hpp>
 #include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/autodiff/AutoDiffBlockExpr.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
 #include <opm/autodiff/GridHelpers.hpp>
+#include <opm/autodiff/SparsityPatternCache.hpp>
 #include <opm/autodiff/WellHelpers.hpp>
 #include <opm/autodiff/BlackoilPropsAdFromDeck.hpp>
 #include <opm/autodiff/GeoProps.hpp>
@@ -123,10 +126,12 @@ typedef Eigen::Array<double,
         , canph_ (detail::active2Canonical(fluid.phaseUsage()))
         , cells_ (detail::buildAllCells(Opm::AutoDiffGrid::numCells(grid)))
         , ops_   (grid, geo.nnc())
+        , stencil_(ops_)
         , has_disgas_(has_disgas)
         , has_vapoil_(has_vapoil)
         , param_( param )
         , use_threshold_pressure_(false)
+        , residual_only_(false)
         , sd_    (fluid.numPhases())
         , phaseCondition_(AutoDiffGrid::numCells(grid))
         , well_model_ (well_model)
@@ -137,7 +142,8 @@ typedef Eigen::Array<double,
                         ADB::null(),
                         ADB::null(),
                         { 1.1169, 1.0031, 0.0031 }, // the default magic numbers
-                        false } )
+                        false,
+                        0.0 } )
         , terminal_output_ (terminal_output)
         , material_name_(0)
         , current_relaxation_(1.0)
@@ -191,6 +197,10 @@ typedef Eigen::Array<double,
             wellModel().setWellsActive( localWellsActive() );
             global_nc_    =  Opm::AutoDiffGrid::numCells(grid_);
         }
+
+        SparsityPatternCache::setEnabled(param_.use_sparsity_pattern_cache_);
+        SparsityPatternCache::setCapacity(param_.sparsity_pattern_cache_size_);
+        FastSparseThreading::setThreshold(std::max(0, param_.sparse_kernel_thread_threshold_));
     }
 
 
@@ -229,6 +239,7 @@ typedef Eigen::Array<double,
         if (active_[Gas]) {
             updatePrimalVariableFromState(reservoir_state);
         }
+        linsolver_.prepareStep();
     }
 
 
@@ -258,14 +269,35 @@ typedef Eigen::Array<double,
             current_relaxation_ = 1.0;
             dx_old_ = V::Zero(sizeNonLinear());
         }
+        // The AD arena is only used while assembling, so that its chunks
+        // are recycled once per iteration.
+        AutoDiffArena::beginLinearization();
+        AutoDiffArena::setEnabled(param_.use_autodiff_arena_);
+        SparsityPatternCache::resetStatistics();
         try {
             report += asImpl().assemble(reservoir_state, well_state, iteration == 0);
             report.assemble_time += perfTimer.stop();
         }
         catch (...) {
+            AutoDiffArena::setEnabled(false);
             report.assemble_time += perfTimer.stop();
             throw;
         }
+        AutoDiffArena::setEnabled(false);
+        if (param_.use_autodiff_arena_ && terminalOutputEnabled()) {
+            const AutoDiffArena::Statistics stats = AutoDiffArena::statistics();
+            std::ostringstream ss;
+            ss << "Assembly used " << stats.allocations << " AD allocations, "
+               << stats.bytes << " bytes (" << stats.reserved << " bytes held by the AD arena).";
+            OpmLog::debug(ss.str());
+        }
+        if (param_.use_sparsity_pattern_cache_ && terminalOutputEnabled()) {
+            const SparsityPatternCache::Statistics stats = SparsityPatternCache::statistics();
+            std::ostringstream ss;
+            ss << "Assembly had " << stats.hits << " sparsity pattern cache hits, "
+               << stats.misses << " misses.";
+            OpmLog::debug(ss.str());
+        }
 
         report.total_linearizations = 1;
         perfTimer.reset();
@@ -283,6 +315,16 @@ typedef Eigen::Array<double,
             // enable single precision for solvers when dt is smaller then maximal time step for single precision
             residual_.singlePrecision = ( dt < param_.maxSinglePrecisionTimeStep_ );
 
+            // With inexact Newton, solve only as accurately as the
+            // nonlinear convergence warrants.
+            residual_.linearSolverReduction = 0.0;
+            if (nonlinear_solver.useInexactNewton()) {
+                residual_.linearSolverReduction = nonlinear_solver.linearTolerance(residual_norms_history_);
+                if (terminalOutputEnabled()) {
+                    OpmLog::debug(" Inexact Newton: linear tolerance " + std::to_string(residual_.linearSolverReduction));
+                }
+            }
+
             // Compute the nonlinear update.
             V dx;
             try {
@@ -316,6 +358,106 @@ typedef Eigen::Array<double,
                 nonlinear_solver.stabilizeNonlinearUpdate(dx, dx_old_, current_relaxation_);
             }
 
+            if (nonlinear_solver.useLineSearch()) {
+                // Backtracking line search along dx. The merit of a step
+                // length is the largest mass balance residual norm relative
+                // to the norm at the current state, evaluated without
+                // Jacobians at the updated (and chopped) trial state.
+                const std::vector<double> norms0 = residual_norms_history_.back();
+                const int num_mb = residual_.material_balance_eq.size();
+
+                // The trial evaluations overwrite the phase conditions,
+                // the residual and the residual quantities, which belong to
+                // the current iterate. The residual and the residual
+                // quantities are swapped out rather than copied; the trials
+                // only need the accumulation at the start of the time step,
+                // without derivatives. The rest of the simulator data is
+                // recomputed by the final updateState().
+                const V isRs = isRs_;
+                const V isRv = isRv_;
+                const V isSg = isSg_;
+                const std::vector<PhasePresence> phase_condition = phaseCondition_;
+                std::vector<ReservoirResidualQuant> rq(sd_.rq.size());
+                for (std::size_t phase = 0; phase < rq.size(); ++phase) {
+                    rq[phase].accum[0] = ADB::constant(sd_.rq[phase].accum[0].value());
+                }
+                std::swap(rq, sd_.rq);
+                LinearisedBlackoilResidual residual = {
+                    std::vector<ADB>(num_mb, ADB::null()),
+                    ADB::null(),
+                    ADB::null(),
+                    residual_.matbalscale,
+                    residual_.singlePrecision,
+                    residual_.linearSolverReduction
+                };
+                std::swap(residual, residual_);
+                auto restore = [&]() {
+                    isRs_ = isRs;
+                    isRv_ = isRv;
+                    isSg_ = isSg;
+                    phaseCondition_ = phase_condition;
+                    std::swap(rq, sd_.rq);
+                    std::swap(residual, residual_);
+                };
+
+                bool all_trials_failed = true;
+                auto merit = [&](const double alpha) {
+                    ReservoirState trial_state = reservoir_state;
+                    WellState trial_well_state = well_state;
+                    std::vector<double> norms;
+                    try {
+                        asImpl().updateState(alpha * dx, trial_state, trial_well_state);
+                        norms = asImpl().evaluateResidual(trial_state, trial_well_state);
+                    }
+                    catch (const std::runtime_error&) {
+                        // Failures which lead to a time step cut in
+                        // AdaptiveTimeStepping, including NumericalIssue,
+                        // reject the trial step.
+                        return std::numeric_limits<double>::infinity();
+                    }
+                    all_trials_failed = false;
+                    double m = 0.0;
+                    for (int idx = 0; idx < num_mb; ++idx) {
+                        if (norms0[idx] > 0.0) {
+                            m = std::max(m, norms[idx] / norms0[idx]);
+                        }
+                    }
+                    return m;
+                };
+                double alpha = 1.0;
+                try {
+                    alpha = nonlinear_solver.lineSearch(merit);
+                }
+                catch (...) {
+                    restore();
+                    throw;
+                }
+                restore();
+                if (alpha == 0.0) {
+                    if (all_trials_failed) {
+                        // No trial state could be evaluated, so the full
+                        // update would fail as well. Let the caller cut
+                        // the time step.
+                        const std::string msg = "Line search: the residual could not be evaluated for any step length";
+                        if (terminalOutputEnabled()) {
+                            OpmLog::problem(msg);
+                        }
+                        OPM_THROW_NOLOG(Opm::NumericalIssue, msg);
+                    }
+                    // No step length reduces the residual sufficiently.
+                    // Fall back to the full Newton update.
+                    if (terminalOutputEnabled()) {
+                        OpmLog::warning("Line search: no sufficient decrease, using the full update");
+                    }
+                }
+                else if (alpha < 1.0) {
+                    dx *= alpha;
+                    if (terminalOutputEnabled()) {
+                        OpmLog::debug(" Line search: update scaled by " + std::to_string(alpha));
+                    }
+                }
+            }
+
             // Apply the update, applying model-dependent
             // limitations and chopping of the update.
             asImpl().updateState(dx, reservoir_state, well_state);
@@ -517,7 +659,15 @@ typedef Eigen::Array<double,
                   const WellState&     xw) const
     {
         std::vector<V> vars0 = asImpl().variableStateInitials(x, xw);
-        std::vector<ADB> vars = ADB::variables(vars0);
+        std::vector<ADB> vars;
+        if (residual_only_) {
+            vars.reserve(vars0.size());
+            for (V& v : vars0) {
+                vars.push_back(ADB::constant(std::move(v)));
+            }
+        } else {
+            vars = ADB::variables(vars0);
+        }
         return asImpl().variableStateExtractVars(x, asImpl().variableStateIndices(), vars);
     }
 
@@ -714,22 +864,45 @@ typedef Eigen::Array<double,
     {
         const Opm::PhaseUsage& pu = fluid_.phaseUsage();
 
-        const ADB&              press = state.pressure;
         const ADB&              temp  = state.temperature;
-        const std::vector<ADB>& sat   = state.saturation;
         const ADB&              rs    = state.rs;
         const ADB&              rv    = state.rv;
 
         const std::vector<PhasePresence> cond = phaseCondition();
 
+        const int maxnp = Opm::BlackoilPhases::MaxNumPhases;
+        for (int phase = 0; phase < maxnp; ++phase) {
+            if (active_[ phase ]) {
+                const int pos = pu.phase_pos[ phase ];
+                sd_.rq[pos].b = asImpl().fluidReciprocFVF(phase, state.canonical_phase_pressures[phase], temp, rs, rv, cond);
+            }
+        }
+
+        asImpl().computeAccumFromReciprocFVF(state, aix);
+    }
+
+
+
+
+
+    template <class Grid, class WellModel, class Implementation>
+    void
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    computeAccumFromReciprocFVF(const SolutionState& state,
+                                const int            aix  )
+    {
+        const Opm::PhaseUsage& pu = fluid_.phaseUsage();
+
+        const ADB&              press = state.pressure;
+        const std::vector<ADB>& sat   = state.saturation;
+
         const ADB pv_mult = poroMult(press);
 
         const int maxnp = Opm::BlackoilPhases::MaxNumPhases;
         for (int phase = 0; phase < maxnp; ++phase) {
             if (active_[ phase ]) {
                 const int pos = pu.phase_pos[ phase ];
-                sd_.rq[pos].b = asImpl().fluidReciprocFVF(phase, state.canonical_phase_pressures[phase], temp, rs, rv, cond);
-                sd_.rq[pos].accum[aix] = pv_mult * sd_.rq[pos].b * sat[pos];
+                sd_.rq[pos].accum[aix] = lazy(pv_mult) * sd_.rq[pos].b * sat[pos];
                 // OPM_AD_DUMP(sd_.rq[pos].b);
                 // OPM_AD_DUMP(sd_.rq[pos].accum[aix]);
             }
@@ -744,8 +917,8 @@ typedef Eigen::Array<double,
             // when both dissolved gas and vaporized oil are present.
             const ADB accum_gas_copy =sd_.rq[pg].accum[aix];
 
-            sd_.rq[pg].accum[aix] += state.rs * sd_.rq[po].accum[aix];
-            sd_.rq[po].accum[aix] += state.rv * accum_gas_copy;
+            sd_.rq[pg].accum[aix] = lazy(sd_.rq[pg].accum[aix]) + state.rs * sd_.rq[po].accum[aix];
+            sd_.rq[po].accum[aix] = lazy(sd_.rq[po].accum[aix]) + state.rv * accum_gas_copy;
             // OPM_AD_DUMP(sd_.rq[pg].accum[aix]);
         }
     }
@@ -842,18 +1015,78 @@ typedef Eigen::Array<double,
 
 
 
+
+    template <class Grid, class WellModel, class Implementation>
+    std::vector<double>
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    evaluateResidual(const ReservoirState& reservoir_state,
+                     const WellState& well_state)
+    {
+        WellState trial_well_state = well_state;
+
+        // Create the primary variables without derivatives. Models
+        // overriding variableState() may not honour residual_only_,
+        // so make sure the state is constant anyway. The flag is reset
+        // also if variableState() throws.
+        struct ResidualOnlyScope
+        {
+            explicit ResidualOnlyScope(bool& flag) : flag_(flag) { flag_ = true; }
+            ~ResidualOnlyScope() { flag_ = false; }
+            bool& flag_;
+        };
+        SolutionState state = [&]() {
+            const ResidualOnlyScope scope(residual_only_);
+            return asImpl().variableState(reservoir_state, trial_well_state);
+        }();
+        asImpl().makeConstantState(state);
+
+        // -------- Mass balance equations --------
+        asImpl().assembleMassBalanceEq(state);
+
+        // -------- Well equations ----------
+        if (wellsActive()) {
+            std::vector<ADB> mob_perfcells;
+            std::vector<ADB> b_perfcells;
+            asImpl().wellModel().extractWellPerfProperties(state, sd_.rq, mob_perfcells, b_perfcells);
+            V aliveWells;
+            std::vector<ADB> cq_s;
+            asImpl().wellModel().computeWellFlux(state, mob_perfcells, b_perfcells, aliveWells, cq_s);
+            asImpl().wellModel().updatePerfPhaseRatesAndPressures(cq_s, state, trial_well_state);
+            asImpl().wellModel().addWellFluxEq(cq_s, state, residual_);
+            asImpl().addWellContributionToMassBalanceEq(cq_s, state, trial_well_state);
+            asImpl().wellModel().addWellControlEq(state, trial_well_state, aliveWells, residual_);
+        }
+
+        return asImpl().computeResidualNorms();
+    }
+
+
+
+
     template <class Grid, class WellModel, class Implementation>
     void
     BlackoilModelBase<Grid, WellModel, Implementation>::
     assembleMassBalanceEq(const SolutionState& state)
     {
-        // Compute b_p and the accumulation term b_p*s_p for each phase,
+        // Compute mu_p and b_p for each phase. Implementations may
+        // evaluate both in a single pass over the cells.
+#pragma omp parallel for schedule(static)
+        for (int phaseIdx = 0; phaseIdx < fluid_.numPhases(); ++phaseIdx) {
+            const std::vector<PhasePresence>& cond = phaseCondition();
+            BlackoilPropsAdFromDeck::PhasePvt pvt =
+                asImpl().fluidViscosityAndReciprocFVF(canph_[phaseIdx], state.canonical_phase_pressures[canph_[phaseIdx]],
+                                                      state.temperature, state.rs, state.rv, cond);
+            sd_.rq[phaseIdx].mu = std::move(pvt.mu);
+            sd_.rq[phaseIdx].b = std::move(pvt.b);
+        }
+
+        // Compute the accumulation term b_p*s_p for each phase,
         // except gas. For gas, we compute b_g*s_g + Rs*b_o*s_o.
         // These quantities are stored in sd_.rq[phase].accum[1].
         // The corresponding accumulation terms from the start of
         // the timestep (b^0_p*s^0_p etc.) were already computed
         // on the initial call to assemble() and stored in sd_.rq[phase].accum[0].
-        asImpl().computeAccum(state, 1);
+        asImpl().computeAccumFromReciprocFVF(state, 1);
 
         // Set up the common parts of the mass balance equations
         // for each active phase.
@@ -871,14 +1104,12 @@ typedef Eigen::Array<double,
         }
 #pragma omp parallel for schedule(static)
         for (int phaseIdx = 0; phaseIdx < fluid_.numPhases(); ++phaseIdx) {
-            const std::vector<PhasePresence>& cond = phaseCondition();
-            sd_.rq[phaseIdx].mu = asImpl().fluidViscosity(canph_[phaseIdx], state.canonical_phase_pressures[canph_[phaseIdx]], state.temperature, state.rs, state.rv, cond);
             sd_.rq[phaseIdx].rho = asImpl().fluidDensity(canph_[phaseIdx], sd_.rq[phaseIdx].b, state.rs, state.rv);
             asImpl().computeMassFlux(phaseIdx, trans_all, sd_.rq[phaseIdx].kr, sd_.rq[phaseIdx].mu, sd_.rq[phaseIdx].rho, state.canonical_phase_pressures[canph_[phaseIdx]], state);
 
             residual_.material_balance_eq[ phaseIdx ] =
                 pvdt_ * (sd_.rq[phaseIdx].accum[1] - sd_.rq[phaseIdx].accum[0])
-                + ops_.div*sd_.rq[phaseIdx].mflux;
+                + applyDiv(sd_.rq[phaseIdx].mflux);
         }
 
         // -------- Extra (optional) rs and rv contributions to the mass balance equations --------
@@ -898,8 +1129,8 @@ typedef Eigen::Array<double,
                                                 sd_.rq[pg].dh.value());
             const ADB rv_face = upwindGas.select(state.rv);
 
-            residual_.material_balance_eq[ pg ] += ops_.div * (rs_face * sd_.rq[po].mflux);
-            residual_.material_balance_eq[ po ] += ops_.div * (rv_face * sd_.rq[pg].mflux);
+            residual_.material_balance_eq[ pg ] += applyDiv(rs_face * sd_.rq[po].mflux);
+            residual_.material_balance_eq[ po ] += applyDiv(rv_face * sd_.rq[pg].mflux);
 
             // OPM_AD_DUMP(residual_.material_balance_eq[ Gas ]);
 
@@ -965,12 +1196,11 @@ typedef Eigen::Array<double,
         }
 
         // Add well contributions to mass balance equations
-        const int nc = Opm::AutoDiffGrid::numCells(grid_);
         const int np = asImpl().numPhases();
         const V& efficiency_factors = wellModel().wellPerfEfficiencyFactors();
         for (int phase = 0; phase < np; ++phase) {
             residual_.material_balance_eq[phase] -= superset(efficiency_factors * cq_s[phase],
-                                                             wellModel().wellOps().well_cells, nc);
+                                                             wellModel().wellOps().well_cells_plan);
         }
     }
 
@@ -1497,8 +1727,8 @@ typedef Eigen::Array<double,
         sd_.rq[ actph ].mob = tr_mult * kr / mu;
 
         // Compute head differentials. Gravity potential is done using the face average as in eclipse and MRST.
-        const ADB rhoavg = ops_.caver * rho;
-        sd_.rq[ actph ].dh = ops_.ngrad * phasePressure - geo_.gravity()[2] * (rhoavg * (ops_.ngrad * geo_.z().matrix()));
+        const ADB rhoavg = applyCaver(rho);
+        sd_.rq[ actph ].dh = applyNgrad(phasePressure) - geo_.gravity()[2] * (rhoavg * applyNgrad(geo_.z()));
         if (use_threshold_pressure_) {
             applyThresholdPressures(sd_.rq[ actph ].dh);
         }
@@ -2006,6 +2236,24 @@ typedef Eigen::Array<double,
 
 
 
+    template <class Grid, class WellModel, class Implementation>
+    BlackoilPropsAdFromDeck::PhasePvt
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    fluidViscosityAndReciprocFVF(const int               phase,
+                                 const ADB&              p    ,
+                                 const ADB&              temp ,
+                                 const ADB&              rs   ,
+                                 const ADB&              rv   ,
+                                 const std::vector<PhasePresence>& cond) const
+    {
+        return { asImpl().fluidViscosity(phase, p, temp, rs, rv, cond),
+                 asImpl().fluidReciprocFVF(phase, p, temp, rs, rv, cond) };
+    }
+
+
+
+
+
     template <class Grid, class WellModel, class Implementation>
     ADB
     BlackoilModelBase<Grid, WellModel, Implementation>::
@@ -2095,10 +2343,13 @@ typedef Eigen::Array<double,
         if (rock_comp_props_ && rock_comp_props_->isActive()) {
             V pm(n);
             V dpm(n);
+            // Evaluate in chunks, so that tabulated multipliers are
+            // computed in vectorizable batches.
+            const int chunk = 1024;
 #pragma omp parallel for schedule(static)
-            for (int i = 0; i < n; ++i) {
-                pm[i] = rock_comp_props_->poroMult(p.value()[i]);
-                dpm[i] = rock_comp_props_->poroMultDeriv(p.value()[i]);
+            for (int start = 0; start < n; start += chunk) {
+                const int size = std::min(chunk, n - start);
+                rock_comp_props_->poroMult(size, p.value().data() + start, pm.data() + start, dpm.data() + start);
             }
             ADB::M dpm_diag(dpm.matrix().asDiagonal());
             const int num_blocks = p.numBlocks();
@@ -2117,6 +2368,66 @@ typedef Eigen::Array<double,
 
 
 
+    template <class Grid, class WellModel, class Implementation>
+    ADB
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    applyDiv(const ADB& flux) const
+    {
+        if (param_.use_matrix_free_stencils_) {
+            return stencil_.div(flux);
+        }
+        return ops_.div * flux;
+    }
+
+
+
+
+
+    template <class Grid, class WellModel, class Implementation>
+    ADB
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    applyNgrad(const ADB& x) const
+    {
+        if (param_.use_matrix_free_stencils_) {
+            return stencil_.ngrad(x);
+        }
+        return ops_.ngrad * x;
+    }
+
+
+
+
+
+    template <class Grid, class WellModel, class Implementation>
+    V
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    applyNgrad(const V& x) const
+    {
+        if (param_.use_matrix_free_stencils_) {
+            return stencil_.ngrad(x);
+        }
+        return (ops_.ngrad * x.matrix()).array();
+    }
+
+
+
+
+
+    template <class Grid, class WellModel, class Implementation>
+    ADB
+    BlackoilModelBase<Grid, WellModel, Implementation>::
+    applyCaver(const ADB& x) const
+    {
+        if (param_.use_matrix_free_stencils_) {
+            return stencil_.caver(x);
+        }
+        return ops_.caver * x;
+    }
+
+
+
+
+
     template <class Grid, class WellModel, class Implementation>
     ADB
     BlackoilModelBase<Grid, WellModel, Implementation>::
@@ -2126,10 +2437,12 @@ typedef Eigen::Array<double,
         if (rock_comp_props_ && rock_comp_props_->isActive()) {
             V tm(n);
             V dtm(n);
+            // Evaluate in chunks, as in poroMult().
+            const int chunk = 1024;
 #pragma omp parallel for schedule(static)
-            for (int i = 0; i < n; ++i) {
-                tm[i] = rock_comp_props_->transMult(p.value()[i]);
-                dtm[i] = rock_comp_props_->transMultDeriv(p.value()[i]);
+            for (int start = 0; start < n; start += chunk) {
+                const int size = std::min(chunk, n - start);
+                rock_comp_props_->transMult(size, p.value().data() + start, tm.data() + start, dtm.data() + start);
             }
             ADB::M dtm_diag(dtm.matrix().asDiagonal());
             const int num_blocks = p.numBlocks();
@@ -2600,7 +2913,7 @@ typedef Eigen::Array<double,
 
             for (int phase = 0; phase < np; ++phase) {
                 if (active_[phase]) {
-                    const std::vector<int>& well_cells = asImpl().wellModel().wellOps().well_cells;
+                    const SubsetPlan& well_cells = asImpl().wellModel().wellOps().well_cells_plan;
                     const ADB mu = asImpl().fluidViscosity(canph_[phase], state.canonical_phase_pressures[canph_[phase]],
                                                        temp, rs, rv, cond);
                     mob[phase] = tr_mult * kr[canph_[phase]] / mu;
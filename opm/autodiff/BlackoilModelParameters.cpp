@@ -20,6 +20,9 @@
 #include <opm/autodiff/BlackoilModelParameters.hpp>
 #include <opm/common/utility/parameters/ParameterGroup.hpp>
 #include <opm/parser/eclipse/Units/Units.hpp>
+#include <opm/common/ErrorMacros.hpp>
+
+#include <stdexcept>
 
 namespace Opm
 {
@@ -68,6 +71,17 @@ namespace Opm
         deck_file_name_ = param.template get<std::string>("deck_filename");
         matrix_add_well_contributions_ = param.getDefault("matrix_add_well_contributions", matrix_add_well_contributions_);
         preconditioner_add_well_contributions_ = param.getDefault("preconditioner_add_well_contributions", preconditioner_add_well_contributions_);
+        use_autodiff_arena_ = param.getDefault("use_autodiff_arena", use_autodiff_arena_);
+        use_sparsity_pattern_cache_ = param.getDefault("use_sparsity_pattern_cache", use_sparsity_pattern_cache_);
+        const int sparsity_pattern_cache_size = param.getDefault("sparsity_pattern_cache_size", int(sparsity_pattern_cache_size_));
+        if (sparsity_pattern_cache_size < 1) {
+            OPM_THROW(std::invalid_argument, "sparsity_pattern_cache_size must be at least 1, got "
+                      << sparsity_pattern_cache_size);
+        }
+        sparsity_pattern_cache_size_ = sparsity_pattern_cache_size;
+        use_matrix_free_stencils_ = param.getDefault("use_matrix_free_stencils", use_matrix_free_stencils_);
+        sparse_kernel_thread_threshold_ = param.getDefault("sparse_kernel_thread_threshold", sparse_kernel_thread_threshold_);
+        reorder_threads_ = param.getDefault("reorder_threads", reorder_threads_);
     }
 
 
@@ -99,6 +113,12 @@ namespace Opm
         use_multisegment_well_ = false;
         matrix_add_well_contributions_ = false;
         preconditioner_add_well_contributions_ = false;
+        use_autodiff_arena_ = false;
+        use_sparsity_pattern_cache_ = false;
+        sparsity_pattern_cache_size_ = 32;
+        use_matrix_free_stencils_ = false;
+        sparse_kernel_thread_threshold_ = 20000;
+        reorder_threads_ = false;
     }
 
 
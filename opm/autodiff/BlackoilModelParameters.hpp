@@ -20,6 +20,7 @@
 #ifndef OPM_BLACKOILMODELPARAMETERS_HEADER_INCLUDED
 #define OPM_BLACKOILMODELPARAMETERS_HEADER_INCLUDED
 
+#include <cstddef>
 #include <string>
 
 namespace Opm
@@ -99,6 +100,30 @@ namespace Opm
         // Whether to add influences of wells between cells to the preconditioner matrix only
         bool preconditioner_add_well_contributions_;
 
+        /// Whether to serve the temporaries of the automatic differentiation from
+        /// a per-thread arena that is recycled between linearizations.
+        bool use_autodiff_arena_;
+
+        /// Whether to cache the sparsity patterns of sparse Jacobian products
+        /// and sums, and only recompute their values when the pattern recurs.
+        bool use_sparsity_pattern_cache_;
+
+        /// Maximum number of sparsity patterns cached per thread, at least 1.
+        std::size_t sparsity_pattern_cache_size_;
+
+        /// Whether to apply the two point flux operators (div, ngrad, caver)
+        /// as loops over the connections instead of as sparse matrices.
+        bool use_matrix_free_stencils_;
+
+        /// Minimum number of stored nonzeros in the operands of a sparse
+        /// Jacobian product, sum or diagonal scaling for it to be computed
+        /// with multiple OpenMP threads.
+        int sparse_kernel_thread_threshold_;
+
+        /// Whether the reordering transport solver solves mutually independent
+        /// components with multiple OpenMP threads.
+        bool reorder_threads_;
+
         /// Construct from user parameters or defaults.
         explicit BlackoilModelParameters( const ParameterGroup& param );
 
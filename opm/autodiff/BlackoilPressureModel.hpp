@@ -119,7 +119,8 @@ namespace Opm {
                 ADB::function(fe.value(), { fe.derivative()[0], fe.derivative()[3], fe.derivative()[4] }),
                 ADB::function(we.value(), { we.derivative()[0], we.derivative()[3], we.derivative()[4] }),
                 residual_.matbalscale,
-                residual_.singlePrecision
+                residual_.singlePrecision,
+                residual_.linearSolverReduction
             };
             assert(pressure_res.sizeNonLinear() == n1 + n2);
             V dx_pressure = linsolver_.computeNewtonIncrement(pressure_res);
@@ -37,6 +37,10 @@
 #include <opm/parser/eclipse/EclipseState/EclipseState.hpp>
 
 #include <opm/common/ErrorMacros.hpp>
+#include <opm/common/OpmLog/OpmLog.hpp>
+
+#include <algorithm>
+#include <sstream>
 
 namespace Opm
 {
@@ -45,6 +49,33 @@ namespace Opm
     typedef BlackoilPropsAdFromDeck::V V;
     typedef Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Block;
 
+    namespace {
+        // Abscissae of the samples of a tabulated function.
+        template <class TabulatedFunction>
+        std::vector<double> knots(const TabulatedFunction& f)
+        {
+            std::vector<double> x(f.numSamples());
+            for (std::size_t i = 0; i < x.size(); ++i) {
+                x[i] = f.xAt(i);
+            }
+            return x;
+        }
+
+        void warnIfInaccurate(const UniformGridTable& table,
+                              const char* curve,
+                              const int region,
+                              const double tolerance)
+        {
+            if (table.maxError() > tolerance) {
+                std::ostringstream msg;
+                msg << "Uniform table of " << curve << " in PVT region " << region + 1
+                    << " has relative error " << table.maxError() << " with "
+                    << table.numIntervals() << " intervals, above the tolerance " << tolerance << ".";
+                OpmLog::warning(msg.str());
+            }
+        }
+    } // anonymous namespace
+
     /// Constructor wrapping an opm-core black oil interface.
     BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const Opm::Deck& deck,
                                                      const Opm::EclipseState& eclState,
@@ -132,6 +163,8 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
     vap1_             = props.vap1_;
     vap2_             = props.vap2_;
     vap_satmax_guard_ = props.vap_satmax_guard_;
+    rsSatTables_      = props.rsSatTables_;
+    rvSatTables_      = props.rvSatTables_;
     // For data that is dependant on the subgrid we simply allocate space
     // and initialize with obviously bogus numbers.
     cellPvtRegionIdx_.resize(number_of_cells, std::numeric_limits<int>::min());
@@ -179,6 +212,18 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
         satprops_.reset(ptr);
         ptr->init(deck, materialLawManager_);
 
+        // Saturation regions, used to group the cells when evaluating
+        // relative permeabilities and capillary pressures.
+        {
+            const auto& cartSatRegion = eclState.get3DProperties().getIntGridProperty("SATNUM").getData();
+            std::vector<int> satRegion(number_of_cells);
+            for (int cellIdx = 0; cellIdx < number_of_cells; ++cellIdx) {
+                const int cartCellIdx = global_cell ? global_cell[cellIdx] : cellIdx;
+                satRegion[cellIdx] = std::max(0, cartSatRegion[cartCellIdx] - 1);
+            }
+            ptr->setCellRegions(std::move(satRegion));
+        }
+
         if (phase_usage_.num_phases != satprops_->numPhases()) {
             OPM_THROW(std::runtime_error, "BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck() - "
                       "Inconsistent number of phases in pvt data (" << phase_usage_.num_phases
@@ -623,6 +668,126 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
 
 
 
+    // ------ Viscosity and formation volume factor together ------
+
+    namespace
+    {
+        /// Function f(p, r) with Jacobian df/dp * p' + df/dr * r', where
+        /// the r term is left out if r is null.
+        ADB pvtFunction(V&& f, const V& dfdp, const ADB& p, const V& dfdr, const ADB* r)
+        {
+            ADB::M dfdp_diag(dfdp.matrix().asDiagonal());
+            ADB::M dfdr_diag(dfdr.matrix().asDiagonal());
+            const int num_blocks = p.numBlocks();
+            std::vector<ADB::M> jacs(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                fastSparseProduct(dfdp_diag, p.derivative()[block], jacs[block]);
+                if (r) {
+                    ADB::M temp;
+                    fastSparseProduct(dfdr_diag, r->derivative()[block], temp);
+                    jacs[block] += temp;
+                }
+            }
+            return ADB::function(std::move(f), std::move(jacs));
+        }
+    } // anonymous namespace
+
+    /// Viscosity and reciprocal formation volume factor of a phase.
+    /// \param[in]  phase  Canonical phase index (Water, Oil or Gas).
+    /// \param[in]  p      Array of n phase pressure values.
+    /// \param[in]  T      Array of n temperature values.
+    /// \param[in]  r      Array of n gas solution factor values for oil, or
+    ///                    vapor oil/gas ratios for gas. Not used for water.
+    /// \param[in]  cond   Array of n objects, each specifying which phases are present with non-zero saturation in a cell.
+    /// \param[in]  cells  Array of n cell indices to be associated with the pressure values.
+    /// \return            Viscosity and reciprocal formation volume factor values.
+    BlackoilPropsAdFromDeck::PhasePvt
+    BlackoilPropsAdFromDeck::phasePvt(const int phase,
+                                      const ADB& p,
+                                      const ADB& T,
+                                      const ADB& r,
+                                      const std::vector<PhasePresence>& cond,
+                                      const Cells& cells) const
+    {
+        if (phase < 0 || phase >= BlackoilPhases::MaxNumPhases) {
+            OPM_THROW(std::runtime_error, "Unknown phase index " << phase);
+        }
+        if (!phase_usage_.phase_used[phase]) {
+            OPM_THROW(std::runtime_error, "Cannot call phasePvt(): phase " << phase << " not active.");
+        }
+        const int n = cells.size();
+        assert(p.size() == n);
+
+        // As in muOil() and bOil(), oil only depends on rs if gas is active.
+        const bool use_r = (phase == Gas) || (phase == Oil && phase_usage_.phase_used[Gas]);
+
+        V mu(n);
+        V dmudp(n);
+        V dmudr(n);
+        V b(n);
+        V dbdp(n);
+        V dbdr(n);
+
+        typedef Opm::DenseAd::Evaluation<double, /*size=*/2> Eval;
+
+        Eval pEval = 0.0;
+        Eval TEval = 0.0;
+        Eval rEval = 0.0;
+        Eval muEval;
+        Eval bEval;
+
+        pEval.setDerivative(0, 1.0);
+        rEval.setDerivative(1, 1.0);
+
+        for (int i = 0; i < n; ++i) {
+            const unsigned pvtRegionIdx = cellPvtRegionIdx_[cells[i]];
+            pEval.setValue(p.value()[i]);
+            TEval.setValue(T.value()[i]);
+
+            switch (phase) {
+            case Water:
+                muEval = FluidSystem::waterPvt().viscosity(pvtRegionIdx, TEval, pEval);
+                bEval = FluidSystem::waterPvt().inverseFormationVolumeFactor(pvtRegionIdx, TEval, pEval);
+                break;
+            case Oil:
+                if (cond[i].hasFreeGas()) {
+                    muEval = FluidSystem::oilPvt().saturatedViscosity(pvtRegionIdx, TEval, pEval);
+                    bEval = FluidSystem::oilPvt().saturatedInverseFormationVolumeFactor(pvtRegionIdx, TEval, pEval);
+                }
+                else {
+                    rEval.setValue((use_r && r.size() > 0) ? r.value()[i] : 0.0);
+                    muEval = FluidSystem::oilPvt().viscosity(pvtRegionIdx, TEval, pEval, rEval);
+                    bEval = FluidSystem::oilPvt().inverseFormationVolumeFactor(pvtRegionIdx, TEval, pEval, rEval);
+                }
+                break;
+            case Gas:
+                if (cond[i].hasFreeOil()) {
+                    muEval = FluidSystem::gasPvt().saturatedViscosity(pvtRegionIdx, TEval, pEval);
+                    bEval = FluidSystem::gasPvt().saturatedInverseFormationVolumeFactor(pvtRegionIdx, TEval, pEval);
+                }
+                else {
+                    rEval.setValue(r.value()[i]);
+                    muEval = FluidSystem::gasPvt().viscosity(pvtRegionIdx, TEval, pEval, rEval);
+                    bEval = FluidSystem::gasPvt().inverseFormationVolumeFactor(pvtRegionIdx, TEval, pEval, rEval);
+                }
+                break;
+            }
+
+            mu[i] = muEval.value();
+            dmudp[i] = muEval.derivative(0);
+            dmudr[i] = muEval.derivative(1);
+            b[i] = bEval.value();
+            dbdp[i] = bEval.derivative(0);
+            dbdr[i] = bEval.derivative(1);
+        }
+
+        const ADB* rr = use_r ? &r : nullptr;
+        return PhasePvt{ pvtFunction(std::move(mu), dmudp, p, dmudr, rr),
+                         pvtFunction(std::move(b), dbdp, p, dbdr, rr) };
+    }
+
+
+
     // ------ Rs bubble point curve ------
 
     /// Bubble point curve for Rs as function of oil pressure.
@@ -649,6 +814,11 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
 
         for (int i = 0; i < n; ++i) {
             unsigned pvtRegionIdx = cellPvtRegionIdx_[cells[i]];
+            if (!rsSatTables_.empty() && rsSatTables_[pvtRegionIdx].contains(po.value()[i])) {
+                rbub[i] = rsSatTables_[pvtRegionIdx](po.value()[i]);
+                drbubdp[i] = rsSatTables_[pvtRegionIdx].derivative(po.value()[i]);
+                continue;
+            }
             pEval.setValue(po.value()[i]);
 
             const Eval& RsEval = FluidSystem::oilPvt().saturatedGasDissolutionFactor(pvtRegionIdx, TEval, pEval);
@@ -706,6 +876,11 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
 
         for (int i = 0; i < n; ++i) {
             unsigned pvtRegionIdx = cellPvtRegionIdx_[cells[i]];
+            if (!rvSatTables_.empty() && rvSatTables_[pvtRegionIdx].contains(pg.value()[i])) {
+                rv[i] = rvSatTables_[pvtRegionIdx](pg.value()[i]);
+                drvdp[i] = rvSatTables_[pvtRegionIdx].derivative(pg.value()[i]);
+                continue;
+            }
             pEval.setValue(pg.value()[i]);
 
             const Eval& RvEval = FluidSystem::gasPvt().saturatedOilVaporizationFactor(pvtRegionIdx, TEval, pEval);
@@ -737,6 +912,56 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
         return rv;
     }
 
+    /// Resample the saturated Rs and Rv curves on uniform pressure grids.
+    /// \param[in]  pmin           Lower end of the tabulated pressure range.
+    /// \param[in]  pmax           Upper end of the tabulated pressure range.
+    /// \param[in]  tolerance      Relative interpolation error tolerance.
+    /// \param[in]  max_intervals  Maximum number of intervals of each table.
+    void BlackoilPropsAdFromDeck::tabulateSaturationCurves(const double pmin,
+                                                           const double pmax,
+                                                           const double tolerance,
+                                                           const int max_intervals)
+    {
+        int num_regions = 0;
+        for (const int region : cellPvtRegionIdx_) {
+            num_regions = std::max(num_regions, region + 1);
+        }
+        const double T = 293.15; // As in rsSat() and rvSat().
+
+        // The curves are piecewise linear between the pressures of the
+        // PVTO and PVTG tables, and their largest interpolation errors are
+        // at these knots rather than at the interval midpoints.
+        const auto& oilPvt = FluidSystem::oilPvt();
+        const auto& gasPvt = FluidSystem::gasPvt();
+        const bool liveOil = oilPvt.approach() == OilPvtApproach::LiveOilPvt;
+        const bool wetGas = gasPvt.approach() == GasPvtApproach::WetGasPvt;
+
+        rsSatTables_.clear();
+        rvSatTables_.clear();
+        for (int region = 0; region < num_regions; ++region) {
+            if (phase_usage_.phase_used[Oil]) {
+                auto rs = [region, T](const double p) {
+                    return FluidSystem::oilPvt().saturatedGasDissolutionFactor(region, T, p);
+                };
+                const std::vector<double> rsKnots = liveOil
+                    ? knots(oilPvt.getRealPvt<OilPvtApproach::LiveOilPvt>().saturatedGasDissolutionFactorTable()[region])
+                    : std::vector<double>();
+                rsSatTables_.push_back(UniformGridTable::fromFunction(rs, pmin, pmax, tolerance, 16, max_intervals, rsKnots));
+                warnIfInaccurate(rsSatTables_.back(), "saturated Rs", region, tolerance);
+            }
+            if (phase_usage_.phase_used[Gas]) {
+                auto rv = [region, T](const double p) {
+                    return FluidSystem::gasPvt().saturatedOilVaporizationFactor(region, T, p);
+                };
+                const std::vector<double> rvKnots = wetGas
+                    ? knots(gasPvt.getRealPvt<GasPvtApproach::WetGasPvt>().saturatedOilVaporizationFactorTable()[region])
+                    : std::vector<double>();
+                rvSatTables_.push_back(UniformGridTable::fromFunction(rv, pmin, pmax, tolerance, 16, max_intervals, rvKnots));
+                warnIfInaccurate(rvSatTables_.back(), "saturated Rv", region, tolerance);
+            }
+        }
+    }
+
     // ------ Relative permeability ------
 
     /// Relative permeabilities for all phases.
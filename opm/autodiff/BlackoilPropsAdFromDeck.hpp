@@ -27,6 +27,7 @@
 
 #include <opm/core/props/satfunc/SaturationPropsFromDeck.hpp>
 #include <opm/core/props/rock/RockFromDeck.hpp>
+#include <opm/core/utility/UniformGridTable.hpp>
 
 #include <opm/material/fluidsystems/BlackOilFluidSystem.hpp>
 #include <opm/material/densead/Math.hpp>
@@ -275,6 +276,34 @@ namespace Opm
                  const std::vector<PhasePresence>& cond,
                  const Cells& cells) const;
 
+        // ------ Viscosity and formation volume factor together ------
+
+        /// Viscosity and reciprocal formation volume factor of a phase.
+        struct PhasePvt
+        {
+            ADB mu;
+            ADB b;
+        };
+
+        /// Viscosity and reciprocal formation volume factor of a phase,
+        /// giving the same results as the muXxx() and bXxx() methods but
+        /// computed in a single pass over the cells, sharing the region
+        /// lookup and the evaluation points between the two properties.
+        /// \param[in]  phase  Canonical phase index (Water, Oil or Gas).
+        /// \param[in]  p      Array of n phase pressure values.
+        /// \param[in]  T      Array of n temperature values.
+        /// \param[in]  r      Array of n gas solution factor values for oil, or
+        ///                    vapor oil/gas ratios for gas. Not used for water.
+        /// \param[in]  cond   Array of n objects, each specifying which phases are present with non-zero saturation in a cell.
+        /// \param[in]  cells  Array of n cell indices to be associated with the pressure values.
+        /// \return            Viscosity and reciprocal formation volume factor values.
+        PhasePvt phasePvt(const int phase,
+                          const ADB& p,
+                          const ADB& T,
+                          const ADB& r,
+                          const std::vector<PhasePresence>& cond,
+                          const Cells& cells) const;
+
         // ------ Rs bubble point curve ------
 
         /// Bubble point curve for Rs as function of oil pressure.
@@ -327,6 +356,20 @@ namespace Opm
                   const ADB& so,
                   const Cells& cells) const;
 
+        /// Resample the saturated Rs and Rv curves of each PVT region on
+        /// uniform pressure grids over [pmin, pmax], so that rsSat() and
+        /// rvSat() need no table search for pressures in this range.
+        /// The number of intervals is doubled until the relative
+        /// interpolation error, measured at the interval midpoints and at
+        /// the pressures of the PVT tables, is below tolerance, or
+        /// max_intervals is reached, in which case a warning with the
+        /// achieved error is logged. Pressures outside the range use the
+        /// PVT tables.
+        void tabulateSaturationCurves(const double pmin,
+                                      const double pmax,
+                                      const double tolerance,
+                                      const int max_intervals = 1 << 16);
+
         // ------ Relative permeability ------
 
         /// Relative permeabilities for all phases.
@@ -498,6 +541,11 @@ namespace Opm
         double vap2_;
         std::vector<double> satOilMax_;
         double vap_satmax_guard_;  //Threshold value to promote stability
+
+        // Uniform tables of the saturated Rs and Rv curves for each PVT
+        // region, empty unless tabulateSaturationCurves() was called.
+        std::vector<UniformGridTable> rsSatTables_;
+        std::vector<UniformGridTable> rvSatTables_;
     };
 } // namespace Opm
 
@@ -27,10 +27,17 @@
 #include <opm/autodiff/multiPhaseUpwind.hpp>
 #include <opm/grid/UnstructuredGrid.h>
 #include <opm/core/transport/reorder/reordersequence.h>
+#include <opm/core/transport/reorder/ReorderSequenceCache.hpp>
 #include <opm/core/simulator/BlackoilState.hpp>
 
 #include <opm/autodiff/BlackoilTransportModel.hpp>
 
+#include <exception>
+
+#if HAVE_OPENMP
+#include <omp.h>
+#endif
+
 namespace Opm {
 
 
@@ -246,6 +253,7 @@ namespace Opm {
             , state_{ ReservoirState(0, 0, 0), WellState(), V(), V() }
             , tr_model_(param, grid, fluid, geo, rock_comp_props, std_wells, linsolver,
                         eclState, schedule, summary_config, has_disgas, has_vapoil, terminal_output)
+            , threads_(param.reorder_threads_)
         {
             // Set up the common parts of the mass balance equations
             // for each active phase.
@@ -442,8 +450,9 @@ namespace Opm {
         V total_wellflux_cell_;
         V oil_wellflux_cell_;
         V gas_wellflux_cell_;
-        std::vector<int> sequence_;
-        std::vector<int> components_;
+        std::unique_ptr<ReorderSequenceCache> ordering_;
+        std::vector<int> levels_;
+        std::vector<int> level_components_;
         V trans_all_;
         V gdz_;
         DataBlock rhos_;
@@ -451,9 +460,21 @@ namespace Opm {
         std::array<double, 2> max_abs_dx_;
         std::array<int, 2> max_abs_dx_cell_;
 
+        // Largest absolute update of each unknown, and its cell.
+        struct MaxChange
+        {
+            std::array<double, 2> dx;
+            std::array<int, 2> cell;
+        };
+        // One entry per thread, merged after solving all components.
+        std::vector<MaxChange> thread_max_change_;
+
         // TODO: remove this, for debug only.
         BlackoilTransportModel<Grid, WellModel> tr_model_;
 
+        // Solve the components of a level with multiple threads.
+        bool threads_;
+
 
         // ============  Member functions  ============
 
@@ -585,19 +606,32 @@ namespace Opm {
             static_assert(std::is_same<Grid, UnstructuredGrid>::value,
                           "compute_sequence() is written in C and therefore requires an UnstructuredGrid, "
                           "it must be rewritten to use other grid classes such as CpGrid");
-            using namespace Opm::AutoDiffGrid;
-            const int num_cells = numCells(grid_);
-            sequence_.resize(num_cells);
-            components_.resize(num_cells + 1); // max possible size
-            int num_components = -1;
-
+            if (!ordering_) {
+                ordering_.reset(new ReorderSequenceCache(grid_));
+            }
 
+            // The ordering only changes where the flux changes direction,
+            // it is often unchanged between nonlinear iterations.
             using namespace Opm::AutoDiffGrid;
             const int num_faces = numFaces(grid_);
             V flux_on_all_faces = superset(total_flux_, ops_.internal_faces, num_faces);
-            compute_sequence(&grid_, flux_on_all_faces.data(), sequence_.data(), components_.data(), &num_components);
-            OpmLog::debug(std::string("Number of components: ") + std::to_string(num_components));
-            components_.resize(num_components + 1); // resize to fit actually used part
+            const auto update = ordering_->update(flux_on_all_faces.data());
+            if (update == ReorderSequenceCache::Unchanged) {
+                OpmLog::debug("Reusing cell ordering.");
+                return;
+            }
+            const int num_components = ordering_->numComponents();
+            OpmLog::debug(std::string(update == ReorderSequenceCache::Full ? "Computed" : "Updated")
+                          + " cell ordering, number of components: " + std::to_string(num_components));
+
+            // Group mutually independent components into levels.
+            levels_.resize(num_components + 1);
+            level_components_.resize(num_components);
+            int num_levels = -1;
+            compute_component_levels(&grid_, ordering_->sequence().data(), ordering_->components().data(),
+                                     num_components, levels_.data(), level_components_.data(), &num_levels);
+            OpmLog::debug(std::string("Number of component levels: ") + std::to_string(num_levels));
+            levels_.resize(num_levels + 1);
         }
 
 
@@ -610,15 +644,61 @@ namespace Opm {
             max_abs_dx_[1] = 0.0;
             max_abs_dx_cell_[0] = -1;
             max_abs_dx_cell_[1] = -1;
+            int num_threads = 1;
+#if HAVE_OPENMP
+            if (threads_) {
+                num_threads = omp_get_max_threads();
+            }
+#endif // HAVE_OPENMP
+            const MaxChange zero_change = { {{ 0.0, 0.0 }}, {{ -1, -1 }} };
+            thread_max_change_.assign(num_threads, zero_change);
+
+            // Solve the equations, level by level. Components within a
+            // level are not adjacent, so they can be solved concurrently
+            // with the same result as in sequential order, if enabled by
+            // the reorder_threads parameter.
+            const std::vector<int>& sequence = ordering_->sequence();
+            const std::vector<int>& components = ordering_->components();
+            const int num_levels = levels_.size() - 1;
+            for (int level = 0; level < num_levels; ++level) {
+                const int level_begin = levels_[level];
+                const int level_end = levels_[level + 1];
+                // Exceptions must not escape the parallel region, the first
+                // one caught is rethrown after the level has been processed.
+                std::exception_ptr error;
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16) if(threads_)
+#endif // HAVE_OPENMP
+                for (int ix = level_begin; ix < level_end; ++ix) {
+                    try {
+                        const int comp = level_components_[ix];
+                        const int comp_size = components[comp + 1] - components[comp];
+                        if (comp_size == 1) {
+                            solveSingleCell(sequence[components[comp]]);
+                        } else {
+                            solveMultiCell(comp_size, &sequence[components[comp]]);
+                        }
+                    } catch (...) {
+#if HAVE_OPENMP
+#pragma omp critical(BlackoilReorderingTransportModel_error)
+#endif // HAVE_OPENMP
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
 
-            // Solve the equations.
-            const int num_components = components_.size() - 1;
-            for (int comp = 0; comp < num_components; ++comp) {
-                const int comp_size = components_[comp + 1] - components_[comp];
-                if (comp_size == 1) {
-                    solveSingleCell(sequence_[components_[comp]]);
-                } else {
-                    solveMultiCell(comp_size, &sequence_[components_[comp]]);
+            // Merge the max changes of the threads.
+            for (const MaxChange& change : thread_max_change_) {
+                for (int j = 0; j < 2; ++j) {
+                    if (change.dx[j] > max_abs_dx_[j]) {
+                        max_abs_dx_[j] = change.dx[j];
+                        max_abs_dx_cell_[j] = change.cell[j];
+                    }
                 }
             }
 
@@ -681,6 +761,9 @@ namespace Opm {
                 os << "Failed to converge in cell " << cell << ", residual = " << res
                    << ", cell values { s = ( " << cstate_[cell].s[Water] << ", " << cstate_[cell].s[Oil] << ", " << cstate_[cell].s[Gas]
                    << " ), rs = " << cstate_[cell].rs << ", rv = " << cstate_[cell].rv << " }";
+#if HAVE_OPENMP
+#pragma omp critical(BlackoilReorderingTransportModel_log)
+#endif // HAVE_OPENMP
                 OpmLog::debug(os.str());
             }
         }
@@ -860,14 +943,18 @@ namespace Opm {
         void updateState(const int cell,
                          const Vec2& dx)
         {
-            if (std::fabs(dx[0]) > max_abs_dx_[0]) {
-                max_abs_dx_cell_[0] = cell;
-            }
-            if (std::fabs(dx[1]) > max_abs_dx_[1]) {
-                max_abs_dx_cell_[1] = cell;
+            // Track the max change of the calling thread.
+            int thread = 0;
+#if HAVE_OPENMP
+            thread = omp_get_thread_num();
+#endif // HAVE_OPENMP
+            MaxChange& change = thread_max_change_[thread];
+            for (int j = 0; j < 2; ++j) {
+                if (std::fabs(dx[j]) > change.dx[j]) {
+                    change.dx[j] = std::fabs(dx[j]);
+                    change.cell[j] = cell;
+                }
             }
-            max_abs_dx_[0] = std::max(max_abs_dx_[0], std::fabs(dx[0]));
-            max_abs_dx_[1] = std::max(max_abs_dx_[1], std::fabs(dx[1]));
 
             // Get saturation updates.
             const double dsw = dx[0];
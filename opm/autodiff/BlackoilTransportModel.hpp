@@ -189,7 +189,8 @@ namespace Opm {
                 ADB::null(),
                 ADB::null(),
                 residual_.matbalscale,
-                residual_.singlePrecision
+                residual_.singlePrecision,
+                residual_.linearSolverReduction
             };
             assert(transport_res.sizeNonLinear() == 2*n_transport);
             V dx_transport = linsolver_.computeNewtonIncrement(transport_res);
@@ -457,8 +458,8 @@ namespace Opm {
                 const int gaspos = pu.phase_pos[Gas];
                 const ADB cq_s_prod_oil = cq_s_prod[oilpos];
                 const ADB cq_s_prod_gas = cq_s_prod[gaspos];
-                cq_s_prod[gaspos] += subset(state.rs, Base::well_model_.wellOps().well_cells) * cq_s_prod_oil;
-                cq_s_prod[oilpos] += subset(state.rv, Base::well_model_.wellOps().well_cells) * cq_s_prod_gas;
+                cq_s_prod[gaspos] += subset(state.rs, Base::well_model_.wellOps().well_cells_plan) * cq_s_prod_oil;
+                cq_s_prod[oilpos] += subset(state.rv, Base::well_model_.wellOps().well_cells_plan) * cq_s_prod_gas;
             }
 
             // Compute well perforation surface volume fluxes.
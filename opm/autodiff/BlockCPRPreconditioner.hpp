@@ -0,0 +1,305 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_BLOCKCPRPRECONDITIONER_HEADER_INCLUDED
+#define OPM_BLOCKCPRPRECONDITIONER_HEADER_INCLUDED
+
+#include <opm/autodiff/CPRPreconditioner.hpp>
+#include <opm/autodiff/ParallelOverlappingILU0.hpp>
+#include <opm/autodiff/fastSparseOperations.hpp>
+#include <opm/common/ErrorMacros.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+
+#include <dune/common/fmatrix.hh>
+#include <dune/common/fvector.hh>
+#include <dune/common/version.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/preconditioner.hh>
+#include <dune/istl/preconditioners.hh>
+#include <dune/istl/solvercategory.hh>
+#include <dune/istl/solvers.hh>
+#include <dune/istl/paamg/amg.hh>
+
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Sequential two-stage CPR (constrained pressure residual)
+    /// preconditioner for block-interleaved systems.
+    ///
+    /// The equations of each block row are combined with per-row pressure
+    /// weights into a scalar pressure equation. The pressure matrix, with
+    /// the same sparsity pattern as the block matrix, is extracted in a
+    /// single pass over the block rows, without converting the system to
+    /// a scalar matrix first. Each application solves the pressure system
+    /// approximately, and then applies the fine scale smoother (e.g.
+    /// ILU(n) of the full system) to the remaining defect.
+    ///
+    /// The pressure solve is controlled by the same CPRParameter as the
+    /// elliptic solve of CPRPreconditioner: BiCGStab or CG
+    /// (cpr_use_bicgstab) to the tolerance cpr_solver_tol, with at most
+    /// cpr_max_ell_iter iterations, preconditioned by AMG (cpr_use_amg)
+    /// or ILU0, both with relaxation cpr_relax and MILU variant
+    /// cpr_ilu_milu. The AMG is created by
+    /// ISTLUtility::createAMGPreconditionerPointer, and thereby coarsened
+    /// as for the other CPR and AMG preconditioners.
+    ///
+    /// The weights are chosen by the caller: quasiImpesWeights() computes
+    /// them from the diagonal blocks of the full system. True-IMPES
+    /// weights are obtained by passing the diagonal blocks of the
+    /// accumulation terms alone to impesWeights().
+    ///
+    /// \tparam Matrix         block matrix type, a Dune::BCRSMatrix
+    /// \tparam Vector         block vector type, a Dune::BlockVector
+    /// \tparam pressureIndex  index of the pressure unknown within a block
+    template <class Matrix, class Vector, int pressureIndex = 0>
+    class BlockCPRPreconditioner : public Dune::Preconditioner<Vector, Vector>
+    {
+    public:
+        typedef typename Matrix::field_type Scalar;
+        typedef typename Matrix::block_type MatrixBlock;
+        typedef typename Vector::block_type VectorBlock;
+        enum { np = VectorBlock::dimension };
+        typedef std::vector<VectorBlock> Weights;
+
+        typedef Dune::BCRSMatrix< Dune::FieldMatrix<Scalar, 1, 1> > PressureMatrix;
+        typedef Dune::BlockVector< Dune::FieldVector<Scalar, 1> > PressureVector;
+        typedef Dune::MatrixAdapter<PressureMatrix, PressureVector, PressureVector> PressureOperator;
+        typedef Dune::Preconditioner<PressureVector, PressureVector> PressurePreconditioner;
+        typedef typename ISTLUtility::CPRSelector<PressureMatrix, PressureVector, PressureVector,
+                                                  Dune::Amg::SequentialInformation>::AMG PressureAMG;
+        typedef ParallelOverlappingILU0<PressureMatrix, PressureVector, PressureVector> PressureILU;
+        typedef Dune::Preconditioner<Vector, Vector> FineSmoother;
+
+        typedef Vector domain_type;
+        typedef Vector range_type;
+        typedef typename Vector::field_type field_type;
+
+#if ! DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        enum {
+            //! \brief The category the preconditioner is part of.
+            category = Dune::SolverCategory::sequential
+        };
+#endif
+
+        /// Extract the pressure system and set up its preconditioner.
+        /// \param[in] A         block matrix, must outlive the preconditioner
+        /// \param[in] weights   pressure weights, one block per block row
+        /// \param[in] smoother  fine scale preconditioner for A
+        /// \param[in] param     parameters of the pressure solve
+        BlockCPRPreconditioner(const Matrix& A,
+                               Weights weights,
+                               std::unique_ptr<FineSmoother> smoother,
+                               const CPRParameter& param = CPRParameter())
+            : param_(param),
+              A_(A),
+              weights_(std::move(weights)),
+              smoother_(std::move(smoother)),
+              Ap_(createPressureMatrix(A)),
+              xp_(A.N()),
+              bp_(A.N()),
+              r_(A.N()),
+              dx_(A.M())
+        {
+            if (weights_.size() != A_.N()) {
+                OPM_THROW(std::logic_error, "BlockCPRPreconditioner: need one weight block per block row.");
+            }
+            extractPressureMatrix();
+            op_.reset(new PressureOperator(*Ap_));
+
+            if (param_.cpr_use_amg_) {
+                std::unique_ptr<PressureAMG> amg;
+                ISTLUtility::template createAMGPreconditionerPointer<0>(*op_, param_.cpr_relax_,
+                                                                        param_.cpr_ilu_milu_, info_, amg);
+                pressurePrecond_ = std::move(amg);
+            } else {
+                pressurePrecond_.reset(new PressureILU(*Ap_, 0, param_.cpr_relax_, param_.cpr_ilu_milu_,
+                                                       param_.cpr_ilu_redblack_, param_.cpr_ilu_reorder_sphere_));
+            }
+        }
+
+#if DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        Dune::SolverCategory::Category category() const override
+        {
+            return Dune::SolverCategory::sequential;
+        }
+#endif
+
+        void pre(Vector& x, Vector& b) override
+        {
+            smoother_->pre(x, b);
+        }
+
+        void apply(Vector& v, const Vector& d) override
+        {
+            // Pressure stage.
+            restrictDefect(d, bp_);
+            xp_ = 0.0;
+            solvePressure();
+            v = 0.0;
+            const int n = v.size();
+            for (int i = 0; i < n; ++i) {
+                v[i][pressureIndex] = xp_[i][0];
+            }
+
+            // Fine scale stage on the remaining defect.
+            r_ = d;
+            A_.mmv(v, r_);
+            dx_ = 0.0;
+            smoother_->apply(dx_, r_);
+            v += dx_;
+        }
+
+        void post(Vector& x) override
+        {
+            smoother_->post(x);
+        }
+
+        /// The extracted pressure matrix.
+        const PressureMatrix& pressureMatrix() const
+        {
+            return *Ap_;
+        }
+
+        /// Pressure weights for each block row, w_i solving D_i^T w_i = e_p,
+        /// where D_i are the given diagonal blocks and p the pressure index.
+        /// The pressure equation of row i then depends on its own pressure,
+        /// but not on its other unknowns, through D_i. Each weight block is
+        /// scaled to unit maximum norm.
+        static Weights impesWeights(const std::vector<MatrixBlock>& diagonal)
+        {
+            const int n = diagonal.size();
+            Weights weights(n);
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(n * np * np))
+#endif
+            for (int i = 0; i < n; ++i) {
+                Dune::FieldMatrix<Scalar, np, np> transposed;
+                for (int r = 0; r < np; ++r) {
+                    for (int c = 0; c < np; ++c) {
+                        transposed[r][c] = diagonal[i][c][r];
+                    }
+                }
+                VectorBlock unit(0.0);
+                unit[pressureIndex] = 1.0;
+                VectorBlock& w = weights[i];
+                transposed.solve(w, unit);
+                w /= w.infinity_norm();
+            }
+            return weights;
+        }
+
+        /// Quasi-IMPES weights, computed from the diagonal blocks of A.
+        static Weights quasiImpesWeights(const Matrix& A)
+        {
+            std::vector<MatrixBlock> diagonal(A.N());
+            for (auto row = A.begin(); row != A.end(); ++row) {
+                diagonal[row.index()] = (*row)[row.index()];
+            }
+            return impesWeights(diagonal);
+        }
+
+    private:
+        CPRParameter param_;
+        const Matrix& A_;
+        Weights weights_;
+        std::unique_ptr<FineSmoother> smoother_;
+        std::unique_ptr<PressureMatrix> Ap_;
+        std::unique_ptr<PressureOperator> op_;
+        Dune::Amg::SequentialInformation info_;
+        std::unique_ptr<PressurePreconditioner> pressurePrecond_;
+        PressureVector xp_;
+        PressureVector bp_;
+        Vector r_;
+        Vector dx_;
+
+        static std::unique_ptr<PressureMatrix> createPressureMatrix(const Matrix& A)
+        {
+            std::unique_ptr<PressureMatrix> Ap(new PressureMatrix(A.N(), A.M(), A.nonzeroes(), PressureMatrix::row_wise));
+            for (auto row = Ap->createbegin(); row != Ap->createend(); ++row) {
+                const auto& arow = A[row.index()];
+                for (auto col = arow.begin(); col != arow.end(); ++col) {
+                    row.insert(col.index());
+                }
+            }
+            return Ap;
+        }
+
+        // Weighted sum of the equations of each block row, restricted to
+        // the pressure columns. The pattern of Ap_ equals that of A_.
+        void extractPressureMatrix()
+        {
+            const int n = A_.N();
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(A_.nonzeroes()))
+#endif
+            for (int i = 0; i < n; ++i) {
+                const VectorBlock& w = weights_[i];
+                const auto& arow = A_[i];
+                auto& prow = (*Ap_)[i];
+                auto pcol = prow.begin();
+                for (auto acol = arow.begin(); acol != arow.end(); ++acol, ++pcol) {
+                    const MatrixBlock& block = *acol;
+                    Scalar value = 0.0;
+                    for (int e = 0; e < np; ++e) {
+                        value += w[e] * block[e][pressureIndex];
+                    }
+                    *pcol = value;
+                }
+            }
+        }
+
+        // Approximate solve of Ap_ xp_ = bp_, as the elliptic solve of
+        // CPRPreconditioner. Overwrites bp_.
+        void solvePressure()
+        {
+            const double tolerance = param_.cpr_solver_tol_;
+            const int maxit = param_.cpr_max_ell_iter_;
+            const int verbosity = param_.cpr_solver_verbose_ ? 1 : 0;
+            Dune::InverseOperatorResult result;
+            if (param_.cpr_use_bicgstab_) {
+                Dune::BiCGSTABSolver<PressureVector> linsolve(*op_, *pressurePrecond_, tolerance, maxit, verbosity);
+                linsolve.apply(xp_, bp_, result);
+            } else {
+                Dune::CGSolver<PressureVector> linsolve(*op_, *pressurePrecond_, tolerance, maxit, verbosity);
+                linsolve.apply(xp_, bp_, result);
+            }
+        }
+
+        void restrictDefect(const Vector& d, PressureVector& bp) const
+        {
+            const int n = d.size();
+            for (int i = 0; i < n; ++i) {
+                bp[i][0] = weights_[i] * d[i];
+            }
+        }
+    };
+
+} // namespace Opm
+
+#endif // OPM_BLOCKCPRPRECONDITIONER_HEADER_INCLUDED
@@ -0,0 +1,421 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_BLOCKSPARSEJACOBIAN_HEADER_INCLUDED
+#define OPM_BLOCKSPARSEJACOBIAN_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/common/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Block compressed row (BSR) storage of a square system of np
+    /// equations in np unknowns, all of the same size n.
+    ///
+    /// All derivatives of the np equations for one cell with respect to
+    /// the np unknowns of another cell are stored together as a dense,
+    /// row-major np x np block. This is the layout used by the
+    /// interleaved ISTL solvers, and the class therefore allows the
+    /// Jacobian to be handed to ISTL by copying contiguous blocks instead
+    /// of scattering each (equation, variable) Jacobian separately.
+    ///
+    /// The model assembly produces one AutoDiffMatrix per (equation,
+    /// variable) pair. Once the block pattern is known, fillMatrix()
+    /// writes the derivatives from those straight into the blocks of the
+    /// ISTL matrix, so the values are not stored here as well. The own
+    /// values are only formed when the pattern is (re)built, or on
+    /// request through refill(), e.g. to capture the system.
+    ///
+    /// The interleaved vector layout used by mv() is x[cell*np + var].
+    template <int np>
+    class BlockSparseJacobian
+    {
+    public:
+        typedef AutoDiffBlock<double> ADB;
+        enum { BlockSize = np * np };
+
+        /// Construct an empty matrix.
+        BlockSparseJacobian()
+            : n_(0)
+        {
+        }
+
+        /// Construct from the first np Jacobian blocks of np equations.
+        /// \param[in] eqs                    equations, eqs.size() == np
+        /// \param[in] full_sparsity_pattern  if false, the block pattern is
+        ///                                   taken from the pressure (first
+        ///                                   variable) derivatives only, as in
+        ///                                   the original interleaved solver.
+        BlockSparseJacobian(const std::vector<ADB>& eqs,
+                            const bool full_sparsity_pattern)
+            : n_(0)
+        {
+            assign(eqs, full_sparsity_pattern);
+        }
+
+        /// Rebuild the pattern and values from the given equations.
+        void assign(const std::vector<ADB>& eqs, const bool full_sparsity_pattern)
+        {
+            assert(int(eqs.size()) == np);
+            n_ = eqs[0].size();
+            const int num_pattern_vars = full_sparsity_pattern ? np : 1;
+            std::vector<const AutoDiffMatrix::SparseRep*> pattern_mats;
+            pattern_mats.reserve(np * num_pattern_vars);
+            for (int eq = 0; eq < np; ++eq) {
+                for (int var = 0; var < num_pattern_vars; ++var) {
+                    pattern_mats.push_back(&eqs[eq].derivative()[var].getSparse());
+                }
+            }
+            buildPattern(pattern_mats);
+
+            values_.assign(colIndex_.size() * BlockSize, 0.0);
+            if (!addJacobians(eqs, ValueWriter(values_))) {
+                OPM_THROW(std::logic_error, "BlockSparseJacobian: a derivative is outside the block"
+                          " sparsity pattern, the full sparsity pattern is required.");
+            }
+        }
+
+        /// Refill the values from the given equations, keeping the
+        /// current block pattern. This succeeds if all nonzero derivatives
+        /// are within the pattern, which may then contain blocks that are
+        /// zero for these equations. Otherwise the values are undefined,
+        /// and assign() must be called to rebuild the pattern.
+        /// \return true if the pattern could be reused.
+        bool refill(const std::vector<ADB>& eqs)
+        {
+            assert(int(eqs.size()) == np);
+            if (rowStart_.empty() || eqs[0].size() != n_) {
+                return false;
+            }
+            std::fill(values_.begin(), values_.end(), 0.0);
+            return addJacobians(eqs, ValueWriter(values_));
+        }
+
+        /// Write the derivatives of the given equations, with equation eq
+        /// multiplied by scale[eq], directly into the blocks of A, which
+        /// must have the pattern of this matrix, e.g. from a previous call
+        /// to copyTo(). The own values of this matrix are not changed.
+        /// \return true if all nonzero derivatives are within the pattern,
+        ///         otherwise the values of A are undefined and assign()
+        ///         must be called to rebuild the pattern.
+        template <class BCRSMatrix>
+        bool fillMatrix(const std::vector<ADB>& eqs,
+                        const std::vector<double>& scale,
+                        BCRSMatrix& A) const
+        {
+            assert(int(eqs.size()) == np && int(scale.size()) >= np);
+            if (rowStart_.empty() || eqs[0].size() != n_
+                || int(A.N()) != n_ || int(A.nonzeroes()) != nonZeroBlocks()) {
+                return false;
+            }
+            // Address of each block of A, in the order of colIndex_.
+            typedef typename BCRSMatrix::block_type MatrixBlock;
+            std::vector<MatrixBlock*> blocks(nonZeroBlocks());
+            for (int ri = 0; ri < n_; ++ri) {
+                int k = rowStart_[ri];
+                auto& row = A[ri];
+                for (auto col = row.begin(), colend = row.end(); col != colend; ++col, ++k) {
+                    assert(int(col.index()) == colIndex_[k]);
+                    blocks[k] = &(*col);
+                    *blocks[k] = 0.0;
+                }
+            }
+            return addJacobians(eqs, [&blocks, &scale](const int k, const int eq, const int var, const double value) {
+                    (*blocks[k])[eq][var] = scale[eq] * value;
+                });
+        }
+
+        /// Number of block rows (and block columns).
+        int size() const
+        {
+            return n_;
+        }
+
+        /// Number of stored blocks.
+        int nonZeroBlocks() const
+        {
+            return colIndex_.size();
+        }
+
+        /// Start of each block row in colIndex(), size() + 1 elements.
+        const std::vector<int>& rowStart() const
+        {
+            return rowStart_;
+        }
+
+        /// Block column index of each stored block.
+        const std::vector<int>& colIndex() const
+        {
+            return colIndex_;
+        }
+
+        /// Pointer to the np*np row-major values of stored block k.
+        double* block(const int k)
+        {
+            return values_.data() + k * BlockSize;
+        }
+
+        /// Pointer to the np*np row-major values of stored block k.
+        const double* block(const int k) const
+        {
+            return values_.data() + k * BlockSize;
+        }
+
+        /// Index of the stored block (row, col), or -1 if not present.
+        int find(const int row, const int col) const
+        {
+            const auto b = colIndex_.begin() + rowStart_[row];
+            const auto e = colIndex_.begin() + rowStart_[row + 1];
+            const auto it = std::lower_bound(b, e, col);
+            return (it != e && *it == col) ? int(it - colIndex_.begin()) : -1;
+        }
+
+        /// Multiply all derivatives of equation eq by factor.
+        void scaleEquation(const int eq, const double factor)
+        {
+            assert(eq >= 0 && eq < np);
+            const int nnzb = nonZeroBlocks();
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(nnzb))
+#endif
+            for (int k = 0; k < nnzb; ++k) {
+                double* row = block(k) + eq * np;
+                for (int var = 0; var < np; ++var) {
+                    row[var] *= factor;
+                }
+            }
+        }
+
+        /// Compute y = A x for interleaved vectors x and y.
+        template <class Vector>
+        void mv(const Vector& x, Vector& y) const
+        {
+            assert(int(x.size()) == n_ * np);
+            y.resize(n_ * np);
+            for (int row = 0; row < n_; ++row) {
+                double acc[np] = { 0.0 };
+                for (int k = rowStart_[row]; k < rowStart_[row + 1]; ++k) {
+                    const double* blk = block(k);
+                    const int xoff = colIndex_[k] * np;
+                    for (int eq = 0; eq < np; ++eq) {
+                        for (int var = 0; var < np; ++var) {
+                            acc[eq] += blk[eq * np + var] * x[xoff + var];
+                        }
+                    }
+                }
+                for (int eq = 0; eq < np; ++eq) {
+                    y[row * np + eq] = acc[eq];
+                }
+            }
+        }
+
+        /// Create a Dune::BCRSMatrix with np x np blocks and the same
+        /// pattern and values as this matrix.
+        template <class BCRSMatrix>
+        void copyTo(BCRSMatrix& A) const
+        {
+            A.setSize(n_, n_, nonZeroBlocks());
+            A.setBuildMode(BCRSMatrix::row_wise);
+            const typename BCRSMatrix::CreateIterator endrow = A.createend();
+            for (typename BCRSMatrix::CreateIterator row = A.createbegin(); row != endrow; ++row) {
+                const int ri = row.index();
+                for (int k = rowStart_[ri]; k < rowStart_[ri + 1]; ++k) {
+                    row.insert(colIndex_[k]);
+                }
+            }
+            copyValuesTo(A);
+        }
+
+        /// Copy the values to a Dune::BCRSMatrix that already has the
+        /// pattern of this matrix, e.g. from a previous call to copyTo().
+        template <class BCRSMatrix>
+        void copyValuesTo(BCRSMatrix& A) const
+        {
+            assert(int(A.N()) == n_ && int(A.nonzeroes()) == nonZeroBlocks());
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(nonZeroBlocks()))
+#endif
+            for (int ri = 0; ri < n_; ++ri) {
+                int k = rowStart_[ri];
+                auto& row = A[ri];
+                for (auto col = row.begin(), colend = row.end(); col != colend; ++col, ++k) {
+                    assert(int(col.index()) == colIndex_[k]);
+                    const double* blk = block(k);
+                    for (int eq = 0; eq < np; ++eq) {
+                        for (int var = 0; var < np; ++var) {
+                            (*col)[eq][var] = blk[eq * np + var];
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        int n_;
+        std::vector<int> rowStart_;
+        std::vector<int> colIndex_;
+        std::vector<double> values_;
+
+        // Writes a derivative into the own block values.
+        struct ValueWriter
+        {
+            explicit ValueWriter(std::vector<double>& values)
+                : values_(values.data())
+            {
+            }
+
+            void operator()(const int k, const int eq, const int var, const double value) const
+            {
+                values_[k * BlockSize + eq * np + var] = value;
+            }
+
+            double* values_;
+        };
+
+        // Form the union of the patterns of the given (column major) matrices.
+        void buildPattern(const std::vector<const AutoDiffMatrix::SparseRep*>& mats)
+        {
+            // Count (with duplicates) the entries in each row.
+            std::vector<int> count(n_ + 1, 0);
+            for (const auto* m : mats) {
+                assert(m->rows() == n_ && m->cols() == n_);
+                const int* ja = m->innerIndexPtr();
+                const int nnz = m->outerIndexPtr()[n_];
+                for (int i = 0; i < nnz; ++i) {
+                    ++count[ja[i] + 1];
+                }
+            }
+            std::partial_sum(count.begin(), count.end(), count.begin());
+
+            // Bucket the column indices by row. Looping over columns in
+            // the outer loop makes each bucket sorted.
+            std::vector<int> cols(count[n_]);
+            std::vector<int> pos(count.begin(), count.end() - 1);
+            for (int col = 0; col < n_; ++col) {
+                for (const auto* m : mats) {
+                    const int* ia = m->outerIndexPtr();
+                    const int* ja = m->innerIndexPtr();
+                    for (int i = ia[col]; i < ia[col + 1]; ++i) {
+                        cols[pos[ja[i]]++] = col;
+                    }
+                }
+            }
+
+            // Remove duplicates.
+            rowStart_.resize(n_ + 1);
+            colIndex_.clear();
+            colIndex_.reserve(cols.size());
+            rowStart_[0] = 0;
+            for (int row = 0; row < n_; ++row) {
+                int last = -1;
+                for (int i = count[row]; i < count[row + 1]; ++i) {
+                    if (cols[i] != last) {
+                        colIndex_.push_back(cols[i]);
+                        last = cols[i];
+                    }
+                }
+                rowStart_[row + 1] = colIndex_.size();
+            }
+        }
+
+        // Insert the derivatives of all equations with respect to all
+        // variables, through write(block, eq, var, value). Threads work on
+        // disjoint ranges of block columns, so they never write to the
+        // same block.
+        // Returns false if a nonzero derivative is outside the pattern.
+        template <class Writer>
+        bool addJacobians(const std::vector<ADB>& eqs, const Writer& write) const
+        {
+            // Convert to sparse form before the threaded loop, getSparse()
+            // may need to create the representation.
+            std::vector<const AutoDiffMatrix::SparseRep*> mats(BlockSize, nullptr);
+            int nnz = 0;
+            for (int eq = 0; eq < np; ++eq) {
+                for (int var = 0; var < np; ++var) {
+                    const AutoDiffMatrix& jac = eqs[eq].derivative()[var];
+                    if (jac.nonZeros() != 0) {
+                        mats[eq * np + var] = &jac.getSparse();
+                        nnz += jac.nonZeros();
+                    }
+                }
+            }
+
+            bool in_pattern = true;
+#if HAVE_OPENMP
+#pragma omp parallel reduction(&&:in_pattern) if(FastSparseThreading::useThreads(nnz))
+#else
+            static_cast<void>(nnz);
+#endif
+            {
+                // Within a column major matrix the column indices of the
+                // entries in a given row increase, and each thread visits
+                // its columns in increasing order, so a cursor per row
+                // finds each block position in amortized constant time.
+                // Only the first visit of a row by a thread searches.
+                std::vector<int> cursor(n_, -1);
+#if HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif
+                for (int col = 0; col < n_; ++col) {
+                    for (int ev = 0; ev < BlockSize; ++ev) {
+                        const AutoDiffMatrix::SparseRep* s = mats[ev];
+                        if (s == nullptr) {
+                            continue;
+                        }
+                        const int* ia = s->outerIndexPtr();
+                        const int* ja = s->innerIndexPtr();
+                        const double* sa = s->valuePtr();
+                        for (int i = ia[col]; i < ia[col + 1]; ++i) {
+                            const int row = ja[i];
+                            const int end = rowStart_[row + 1];
+                            int k = cursor[row];
+                            if (k < 0) {
+                                k = std::lower_bound(colIndex_.begin() + rowStart_[row],
+                                                     colIndex_.begin() + end, col) - colIndex_.begin();
+                            } else {
+                                while (k < end && colIndex_[k] < col) {
+                                    ++k;
+                                }
+                            }
+                            cursor[row] = k;
+                            if (k == end || colIndex_[k] != col) {
+                                if (sa[i] != 0.0) {
+                                    in_pattern = false;
+                                }
+                                continue;
+                            }
+                            write(k, ev / np, ev % np, sa[i]);
+                        }
+                    }
+                }
+            }
+            return in_pattern;
+        }
+    };
+
+} // namespace Opm
+
+#endif // OPM_BLOCKSPARSEJACOBIAN_HEADER_INCLUDED
@@ -0,0 +1,192 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_DIAGONALKERNELS_HEADER_INCLUDED
+#define OPM_DIAGONALKERNELS_HEADER_INCLUDED
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Opm
+{
+
+    /// Vectorized elementwise kernels for the diagonal Jacobians of
+    /// AutoDiffMatrix.
+    ///
+    /// The instruction set is selected at build time from the target
+    /// flags of the compiler (AVX-512, AVX or SSE2, in that order of
+    /// preference), with a scalar fallback. Only AVX instructions are used
+    /// for 256 bit vectors, also when AVX2 is available. The arrays may
+    /// alias each other as long as they are identical, i.e. y == x is
+    /// allowed.
+    ///
+    /// Products and sums are rounded separately (no fused multiply-add),
+    /// so the results do not depend on the instruction set used.
+    namespace DiagonalKernels
+    {
+
+        namespace detail
+        {
+#if defined(__AVX512F__)
+            struct Pack
+            {
+                typedef __m512d Type;
+                enum { width = 8 };
+                static Type load(const double* p) { return _mm512_loadu_pd(p); }
+                static void store(double* p, const Type x) { _mm512_storeu_pd(p, x); }
+                static Type broadcast(const double a) { return _mm512_set1_pd(a); }
+                static Type add(const Type a, const Type b) { return _mm512_add_pd(a, b); }
+                static Type mul(const Type a, const Type b) { return _mm512_mul_pd(a, b); }
+            };
+#elif defined(__AVX__)
+            struct Pack
+            {
+                typedef __m256d Type;
+                enum { width = 4 };
+                static Type load(const double* p) { return _mm256_loadu_pd(p); }
+                static void store(double* p, const Type x) { _mm256_storeu_pd(p, x); }
+                static Type broadcast(const double a) { return _mm256_set1_pd(a); }
+                static Type add(const Type a, const Type b) { return _mm256_add_pd(a, b); }
+                static Type mul(const Type a, const Type b) { return _mm256_mul_pd(a, b); }
+            };
+#elif defined(__SSE2__)
+            struct Pack
+            {
+                typedef __m128d Type;
+                enum { width = 2 };
+                static Type load(const double* p) { return _mm_loadu_pd(p); }
+                static void store(double* p, const Type x) { _mm_storeu_pd(p, x); }
+                static Type broadcast(const double a) { return _mm_set1_pd(a); }
+                static Type add(const Type a, const Type b) { return _mm_add_pd(a, b); }
+                static Type mul(const Type a, const Type b) { return _mm_mul_pd(a, b); }
+            };
+#else
+            struct Pack
+            {
+                typedef double Type;
+                enum { width = 1 };
+                static Type load(const double* p) { return *p; }
+                static void store(double* p, const Type x) { *p = x; }
+                static Type broadcast(const double a) { return a; }
+                static Type add(const Type a, const Type b) { return a + b; }
+                static Type mul(const Type a, const Type b) { return a * b; }
+            };
+#endif
+        } // namespace detail
+
+        /// Name of the instruction set used by the kernels.
+        inline const char* instructionSet()
+        {
+#if defined(__AVX512F__)
+            return "AVX-512";
+#elif defined(__AVX__)
+            return "AVX";
+#elif defined(__SSE2__)
+            return "SSE2";
+#else
+            return "scalar";
+#endif
+        }
+
+        /// y[i] += x[i]
+        inline void add(double* y, const double* x, const int n)
+        {
+            typedef detail::Pack P;
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::add(P::load(y + i), P::load(x + i)));
+            }
+            for (; i < n; ++i) {
+                y[i] += x[i];
+            }
+        }
+
+        /// y[i] += a
+        inline void addScalar(double* y, const double a, const int n)
+        {
+            typedef detail::Pack P;
+            const P::Type av = P::broadcast(a);
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::add(P::load(y + i), av));
+            }
+            for (; i < n; ++i) {
+                y[i] += a;
+            }
+        }
+
+        /// y[i] *= x[i]
+        inline void multiply(double* y, const double* x, const int n)
+        {
+            typedef detail::Pack P;
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::mul(P::load(y + i), P::load(x + i)));
+            }
+            for (; i < n; ++i) {
+                y[i] *= x[i];
+            }
+        }
+
+        /// y[i] *= a
+        inline void scale(double* y, const double a, const int n)
+        {
+            typedef detail::Pack P;
+            const P::Type av = P::broadcast(a);
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::mul(P::load(y + i), av));
+            }
+            for (; i < n; ++i) {
+                y[i] *= a;
+            }
+        }
+
+        /// y[i] = a[i] * x[i]
+        inline void product(double* y, const double* a, const double* x, const int n)
+        {
+            typedef detail::Pack P;
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::mul(P::load(a + i), P::load(x + i)));
+            }
+            for (; i < n; ++i) {
+                y[i] = a[i] * x[i];
+            }
+        }
+
+        /// y[i] += a[i] * x[i]
+        inline void addProduct(double* y, const double* a, const double* x, const int n)
+        {
+            typedef detail::Pack P;
+            int i = 0;
+            for (; i + P::width <= n; i += P::width) {
+                P::store(y + i, P::add(P::load(y + i), P::mul(P::load(a + i), P::load(x + i))));
+            }
+            for (; i < n; ++i) {
+                y[i] += a[i] * x[i];
+            }
+        }
+
+    } // namespace DiagonalKernels
+
+} // namespace Opm
+
+#endif // OPM_DIAGONALKERNELS_HEADER_INCLUDED
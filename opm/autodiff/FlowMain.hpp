@@ -567,6 +567,16 @@ namespace Opm
             // Rock compressibility.
             rock_comp_.reset(new RockCompressibility(*eclipse_state_, output_cout_));
 
+            // Optionally replace table searches in the rock and saturated
+            // Rs/Rv curves by uniform tables.
+            if (param_.getDefault("tabulate_properties", false)) {
+                const double tolerance = param_.getDefault("tabulation_tolerance", 1e-6);
+                const double pmin = param_.getDefault("tabulation_min_pressure", 1.0) * unit::barsa;
+                const double pmax = param_.getDefault("tabulation_max_pressure", 1000.0) * unit::barsa;
+                rock_comp_->tabulate(tolerance);
+                fluidprops_->tabulateSaturationCurves(pmin, pmax, tolerance);
+            }
+
             // Gravity.
             assert(UgGridHelpers::dimensions(grid) == 3);
             gravity_.fill(0.0);
@@ -803,6 +813,7 @@ namespace Opm
         void setupLinearSolver()
         {
             const std::string cprSolver = "cpr";
+            const std::string cprBlockSolver = "cpr_block";
             const std::string interleavedSolver = "interleaved";
             const std::string directSolver = "direct";
             std::string flowDefaultSolver = interleavedSolver;
@@ -817,6 +828,21 @@ namespace Opm
 
             if (solver_approach == cprSolver) {
                 fis_solver_.reset(new NewtonIterationBlackoilCPR(param_, parallel_information_));
+            } else if (solver_approach == cprBlockSolver) {
+                if (parallel_information_.empty() && NewtonIterationBlackoilInterleaved::supportsBlockCPR()) {
+                    // CPR on the block-interleaved system, without
+                    // forming a scalar system (BlockCPRPreconditioner).
+                    if (!param_.has("use_cpr")) {
+                        param_.insertParameter("use_cpr", "true");
+                    }
+                    fis_solver_.reset(new NewtonIterationBlackoilInterleaved(param_, parallel_information_));
+                } else {
+                    // The block CPR is sequential, and needs the Dune AMG.
+                    if (output_cout_) {
+                        OpmLog::warning("The block CPR solver is not available in this run, using the CPR solver.");
+                    }
+                    fis_solver_.reset(new NewtonIterationBlackoilCPR(param_, parallel_information_));
+                }
             } else if (solver_approach == interleavedSolver) {
                 fis_solver_.reset(new NewtonIterationBlackoilInterleaved(param_, parallel_information_));
             } else if (solver_approach == directSolver) {
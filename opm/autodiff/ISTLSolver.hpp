@@ -21,14 +21,18 @@
 #define OPM_ISTLSOLVER_HEADER_INCLUDED
 
 #include <opm/autodiff/BlackoilAmg.hpp>
+#include <opm/autodiff/BlockCPRPreconditioner.hpp>
 #include <opm/autodiff/CPRPreconditioner.hpp>
 #include <opm/autodiff/NewtonIterationBlackoilInterleaved.hpp>
 #include <opm/autodiff/NewtonIterationUtilities.hpp>
 #include <opm/autodiff/ParallelRestrictedAdditiveSchwarz.hpp>
 #include <opm/autodiff/ParallelOverlappingILU0.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/KrylovRecycling.hpp>
 #include <opm/autodiff/MatrixBlock.hpp>
 #include <opm/autodiff/MPIUtilities.hpp>
+#include <opm/autodiff/MixedPrecisionPreconditioner.hpp>
+#include <opm/autodiff/PreconditionerReuse.hpp>
 
 #include <opm/common/Exceptions.hpp>
 #include <opm/core/linalg/ParallelIstlInformation.hpp>
@@ -43,6 +47,9 @@
 
 #include <opm/common/utility/platform_dependent/reenable_warnings.h>
 
+#include <memory>
+#include <type_traits>
+
 namespace Opm
 {
     /// This class solves the fully implicit black-oil system by
@@ -70,12 +77,30 @@ namespace Opm
         /// \param[in] param   parameters controlling the behaviour of the linear solvers
         /// \param[in] parallelInformation In the case of a parallel run
         ///                                with dune-istl the information about the parallelization.
+        /// \param[in] reuse_param  parameters controlling the reuse of preconditioners between solves
+        /// \param[in] mixed_precision  if true, store and apply the preconditioner in single
+        ///                             precision in sequential double precision solves
+        /// \param[in] recycle_param  parameters controlling the recycling of previous
+        ///                           solutions in sequential solves
+        /// \param[in] cpr_param  parameters of the block CPR preconditioner (use_cpr)
         ISTLSolver(const NewtonIterationBlackoilInterleavedParameters& param,
-                   const boost::any& parallelInformation_arg=boost::any())
+                   const boost::any& parallelInformation_arg=boost::any(),
+                   const PreconditionerReuseParameters& reuse_param=PreconditionerReuseParameters(),
+                   const bool mixed_precision=false,
+                   const KrylovRecyclingParameters& recycle_param=KrylovRecyclingParameters(),
+                   const CPRParameter& cpr_param=CPRParameter())
         : iterations_( 0 ),
           parallelInformation_(parallelInformation_arg),
           isIORank_(isIORank(parallelInformation_arg)),
-          parameters_( param )
+          parameters_( param ),
+          linearSolverReduction_( param.linear_solver_reduction_ ),
+          mixedPrecision_( mixed_precision ),
+          reusePolicy_( reuse_param ),
+          reuseMatrix_( nullptr ),
+          recycling_( recycle_param ),
+          cprParameters_( cpr_param ),
+          deflate_( false ),
+          reductionScale_( 1.0 )
         {
         }
 
@@ -88,7 +113,15 @@ namespace Opm
         : iterations_( 0 ),
           parallelInformation_(parallelInformation_arg),
           isIORank_(isIORank(parallelInformation_arg)),
-          parameters_( param )
+          parameters_( param ),
+          linearSolverReduction_( parameters_.linear_solver_reduction_ ),
+          mixedPrecision_( param.getDefault("linear_solver_mixed_precision", false) ),
+          reusePolicy_( PreconditionerReuseParameters( param ) ),
+          reuseMatrix_( nullptr ),
+          recycling_( KrylovRecyclingParameters( param ) ),
+          cprParameters_( param ),
+          deflate_( false ),
+          reductionScale_( 1.0 )
         {
         }
 
@@ -111,6 +144,21 @@ namespace Opm
         /// \copydoc NewtonIterationBlackoilInterface::parallelInformation
         const boost::any& parallelInformation() const { return parallelInformation_; }
 
+        /// Set up the preconditioner in the next solve even if it could be
+        /// reused, e.g. because the matrix has been recreated.
+        void invalidatePreconditioner() const { reusePolicy_.invalidate(); }
+
+        /// Forget the recycled solutions of earlier solves, at the start of
+        /// a time step.
+        void prepareStep() const { recycling_.clear(); }
+
+        /// Set the relative residual reduction of the following solves. If
+        /// not positive, the configured linear_solver_reduction is used.
+        void setLinearSolverReduction(const double reduction) const
+        {
+            linearSolverReduction_ = reduction > 0.0 ? reduction : parameters_.linear_solver_reduction_;
+        }
+
     public:
         /// \brief construct the CPR preconditioner and the solver.
         /// \tparam P The type of the parallel information.
@@ -156,20 +204,29 @@ namespace Opm
                 const MILU_VARIANT ilu_milu  = parameters_.ilu_milu_;
                 if (  parameters_.use_cpr_ )
                 {
-                    // We should never end up here as this code is
-                    // only part of flow_legacy  and if use_cpr_ is
-                    // true for flow_legacy then solver_approach=cpr
-                    // was specified and NewtonIterationBlackoilCPR
-                    // is used as a solve and not ISTLSolver.
-                    OPM_THROW(std::logic_error,
-                              "This code path should bever be exectuded for parameters_.use_cpr_="
-                              <<parameters_.use_cpr_<<" in flow_legacy.");
+                    // Selected by solver_approach=cpr_block in sequential
+                    // runs. The CPR preconditioner works on the
+                    // block-interleaved matrix directly, while
+                    // NewtonIterationBlackoilCPR (solver_approach=cpr)
+                    // forms a scalar system.
+                    auto cpr = constructBlockCPRPrecond( linearOperator, parallelInformation_arg );
+                    if ( ! cpr ) {
+                        OPM_THROW(std::logic_error,
+                                  "The block CPR preconditioner is only available in sequential runs.");
+                    }
+                    solve(linearOperator, x, istlb, *sp, *cpr, result);
                 }
                 else
                 {
                     typedef typename CPRSelectorType::AMG AMG;
                     std::unique_ptr< AMG > amg;
 
+                    auto mixed = constructMixedPrecond( linearOperator.getmat(), parallelInformation_arg );
+                    if ( mixed ) {
+                        solve(linearOperator, x, istlb, *sp, *mixed, result);
+                        return;
+                    }
+
                     // Construct preconditioner.
                     constructAMGPrecond( linearOperator, parallelInformation_arg, amg, opA, relax, ilu_milu );
 
@@ -180,6 +237,12 @@ namespace Opm
             else
 #endif
             {
+                auto mixed = constructMixedPrecond( linearOperator.getmat(), parallelInformation_arg );
+                if ( mixed ) {
+                    solve(linearOperator, x, istlb, *sp, *mixed, result);
+                    return;
+                }
+
                 // Construct preconditioner.
                 auto precond = constructPrecond(linearOperator, parallelInformation_arg);
 
@@ -188,6 +251,90 @@ namespace Opm
             }
         }
 
+        typedef Dune::Preconditioner< Vector, Vector > PreconditionerBase;
+        typedef Dune::BCRSMatrix< Dune::MatrixBlock< float,
+                                                     Matrix::block_type::rows,
+                                                     Matrix::block_type::cols > > FloatMatrix;
+        typedef MixedPrecisionPreconditioner< FloatMatrix, Vector > MixedPreconditioner;
+
+        /// \brief Construct an ILU0 or AMG preconditioner stored in single
+        /// precision, if requested. Returns null if not requested or if the
+        /// solve is already in single precision.
+        std::unique_ptr< PreconditionerBase >
+        constructMixedPrecond(const Matrix& A, const Dune::Amg::SequentialInformation&) const
+        {
+            typedef typename MixedPreconditioner::InnerPreconditioner Inner;
+            typedef typename MixedPreconditioner::OperatorF FloatOperator;
+            typedef typename MixedPreconditioner::VectorF FloatVector;
+
+            std::unique_ptr< PreconditionerBase > precond;
+            if ( ! mixedPrecision_ || ! std::is_same< Scalar, double >::value ) {
+                return precond;
+            }
+            const double relax   = parameters_.ilu_relaxation_;
+            const MILU_VARIANT ilu_milu  = parameters_.ilu_milu_;
+#if FLOW_SUPPORT_AMG
+            if ( parameters_.linear_solver_use_amg_ )
+            {
+                typedef typename ISTLUtility::CPRSelector< FloatMatrix, FloatVector, FloatVector,
+                                                           Dune::Amg::SequentialInformation >::AMG FloatAMG;
+                auto createAMG = [&]( FloatOperator& opF ) {
+                    std::unique_ptr< FloatAMG > amg;
+                    ISTLUtility::template createAMGPreconditionerPointer<pressureIndex>( opF, relax, ilu_milu, seqInfo_, amg );
+                    return std::unique_ptr< Inner >( std::move( amg ) );
+                };
+                precond.reset( new MixedPreconditioner( A, createAMG ) );
+                return precond;
+            }
+#endif
+            const int ilu_fillin = parameters_.ilu_fillin_level_;
+            const bool ilu_redblack = parameters_.ilu_redblack_;
+            const bool ilu_reorder_spheres = parameters_.ilu_reorder_sphere_;
+            auto createILU = [&]( FloatOperator& opF ) {
+                typedef ParallelOverlappingILU0< FloatMatrix, FloatVector, FloatVector > FloatILU;
+                return std::unique_ptr< Inner >( new FloatILU( opF.getmat(), ilu_fillin, relax, ilu_milu,
+                                                               ilu_redblack, ilu_reorder_spheres ) );
+            };
+            precond.reset( new MixedPreconditioner( A, createILU ) );
+            return precond;
+        }
+
+        /// \brief Mixed precision preconditioners are only supported in sequential runs.
+        template <class Comm>
+        std::unique_ptr< PreconditionerBase >
+        constructMixedPrecond(const Matrix&, const Comm&) const
+        {
+            return std::unique_ptr< PreconditionerBase >();
+        }
+
+
+        typedef BlockCPRPreconditioner< Matrix, Vector, pressureIndex > BlockCPR;
+
+        /// \brief Construct the CPR preconditioner for the block matrix, with
+        /// quasi-IMPES pressure weights and ILU(n) as fine scale smoother,
+        /// both controlled by the cpr_* parameters as in CPRPreconditioner.
+        template <class Operator>
+        std::unique_ptr< PreconditionerBase >
+        constructBlockCPRPrecond(Operator& opA, const Dune::Amg::SequentialInformation&) const
+        {
+            const Matrix& A = opA.getmat();
+            std::unique_ptr< PreconditionerBase > smoother( new SeqPreconditioner( A, cprParameters_.cpr_ilu_n_,
+                                                                                   cprParameters_.cpr_relax_,
+                                                                                   cprParameters_.cpr_ilu_milu_,
+                                                                                   cprParameters_.cpr_ilu_redblack_,
+                                                                                   cprParameters_.cpr_ilu_reorder_sphere_ ) );
+            return std::unique_ptr< PreconditionerBase >( new BlockCPR( A, BlockCPR::quasiImpesWeights( A ),
+                                                                        std::move( smoother ), cprParameters_ ) );
+        }
+
+        /// \brief The block CPR preconditioner is only supported in sequential runs.
+        template <class Operator, class Comm>
+        std::unique_ptr< PreconditionerBase >
+        constructBlockCPRPrecond(Operator&, const Comm&) const
+        {
+            return std::unique_ptr< PreconditionerBase >();
+        }
+
 
 	// 3x3 matrix block inversion was unstable at least 2.3 until and including
 	// 2.5.0. There may still be some issue with the 4x4 matrix block inversion
@@ -236,6 +383,65 @@ namespace Opm
 #endif
 
 
+        typedef Dune::MatrixAdapter< Matrix, Vector, Vector > SeqOperator;
+#if FLOW_SUPPORT_AMG
+        typedef typename ISTLUtility::CPRSelector< Matrix, Vector, Vector, Dune::Amg::SequentialInformation >::AMG SeqAMG;
+#endif
+
+        // Set up the operator and preconditioner kept between solves.
+        void setupReusedPreconditioner(Matrix& A) const
+        {
+            reuseMatrix_ = &A;
+#if FLOW_SUPPORT_AMG
+            reuseAmg_.reset();
+#endif
+            reusePrecond_.reset();
+            reuseOperator_.reset( new SeqOperator( A ) );
+            reusePrecond_ = constructMixedPrecond( A, seqInfo_ );
+            if ( ! reusePrecond_ )
+            {
+#if FLOW_SUPPORT_AMG
+                if ( parameters_.linear_solver_use_amg_ )
+                {
+                    std::unique_ptr< SeqOperator > opA;
+                    constructAMGPrecond( *reuseOperator_, seqInfo_, reuseAmg_, opA,
+                                         parameters_.ilu_relaxation_, parameters_.ilu_milu_ );
+                }
+                else
+#endif
+                {
+                    reusePrecond_ = constructPrecond( *reuseOperator_, seqInfo_ );
+                }
+            }
+            reusePolicy_.setupDone();
+        }
+
+        // Update the numerical values of a reused preconditioner where
+        // this is cheap. The AMG keeps its coarsening and smoothers and
+        // recomputes the coarse level matrices. ILU factors and mixed
+        // precision preconditioners, including their single precision
+        // copy of the matrix, keep the values of the setup matrix.
+        void updateReusedPreconditioner() const
+        {
+#if FLOW_SUPPORT_AMG
+            if ( reuseAmg_ ) {
+                reuseAmg_->recalculateHierarchy();
+            }
+#endif
+        }
+
+        void solveWithReusedPreconditioner(Vector& x, Vector& b, Dune::InverseOperatorResult& result) const
+        {
+            Dune::SeqScalarProduct< Vector > sp;
+#if FLOW_SUPPORT_AMG
+            if ( reuseAmg_ ) {
+                solve( *reuseOperator_, x, b, sp, *reuseAmg_, result );
+                return;
+            }
+#endif
+            solve( *reuseOperator_, x, b, sp, *reusePrecond_, result );
+        }
+
         template <class MatrixOperator, class POrComm, class AMG >
         void
         constructAMGPrecond(MatrixOperator& opA, const POrComm& comm, std::unique_ptr< AMG >& amg, std::unique_ptr< MatrixOperator >&, const double relax,
@@ -254,9 +460,17 @@ namespace Opm
             // GMRes solver
             int verbosity = ( isIORank_ ) ? parameters_.linear_solver_verbosity_ : 0;
 
+            // Remove the recycled subspace from the defects seen by the
+            // preconditioner, if requested.
+            Dune::Preconditioner< Vector, Vector >* prec = &precond;
+            RecycledSubspacePreconditioner< Matrix, Vector > deflated( precond, recycling_ );
+            if ( deflate_ ) {
+                prec = &deflated;
+            }
+
             if ( parameters_.newton_use_gmres_ ) {
-                Dune::RestartedGMResSolver<Vector> linsolve(opA, sp, precond,
-                          parameters_.linear_solver_reduction_,
+                Dune::RestartedGMResSolver<Vector> linsolve(opA, sp, *prec,
+                          linearSolverReduction_ * reductionScale_,
                           parameters_.linear_solver_restart_,
                           parameters_.linear_solver_maxiter_,
                           verbosity);
@@ -264,8 +478,8 @@ namespace Opm
                 linsolve.apply(x, istlb, result);
             }
             else { // BiCGstab solver
-                Dune::BiCGSTABSolver<Vector> linsolve(opA, sp, precond,
-                          parameters_.linear_solver_reduction_,
+                Dune::BiCGSTABSolver<Vector> linsolve(opA, sp, *prec,
+                          linearSolverReduction_ * reductionScale_,
                           parameters_.linear_solver_maxiter_,
                           verbosity);
                 // Solve system.
@@ -282,6 +496,7 @@ namespace Opm
         /// \param[in] b   right hand side b
         void solve(Matrix& A, Vector& x, Vector& b ) const
         {
+            reductionScale_ = 1.0;
             // Parallel version is deactivated until we figure out how to do it properly.
 #if HAVE_MPI
             if (parallelInformation_.type() == typeid(ParallelISTLInformation))
@@ -299,12 +514,76 @@ namespace Opm
             else
 #endif
             {
-                // Construct operator, scalar product and vectors needed.
-                Dune::MatrixAdapter< Matrix, Vector, Vector> opA( A );
-                solve( opA, x, b );
+                deflate_ = false;
+                if ( recycling_.enabled() )
+                {
+                    // Start from the best approximation in the span of
+                    // the previous solutions. While the preconditioner
+                    // is reused, A is treated as unchanged, and its
+                    // products with those solutions are not recomputed.
+                    const bool reusing = reusePolicy_.enabled() && ! parameters_.use_cpr_
+                        && &A == reuseMatrix_ && ! reusePolicy_.needsSetup();
+                    recycling_.setup( A, ! reusing );
+                    // The reduction of the Krylov solvers is relative to
+                    // the initial defect, the requested one to b.
+                    reductionScale_ = 1.0 / recycling_.initialGuess( A, b, x );
+                    deflate_ = recycling_.deflation() && recycling_.size() > 0;
+                }
+
+                if ( reusePolicy_.enabled() && ! parameters_.use_cpr_ )
+                {
+                    solveReusingPreconditioner( A, x, b );
+                }
+                else
+                {
+                    // Construct operator, scalar product and vectors needed.
+                    Dune::MatrixAdapter< Matrix, Vector, Vector> opA( A );
+                    solve( opA, x, b );
+                }
+                deflate_ = false;
+                reductionScale_ = 1.0;
+                recycling_.addSolution( x );
             }
         }
 
+        /// Sequential solve of Ax = b that keeps the operator and the
+        /// preconditioner between calls, and sets up the preconditioner
+        /// again only when the reuse policy requires it. The matrix A
+        /// must stay alive between calls and only change its values,
+        /// otherwise invalidatePreconditioner() must be called.
+        /// If a solve with a reused preconditioner fails, it is repeated
+        /// with a new one.
+        void solveReusingPreconditioner(Matrix& A, Vector& x, Vector& b) const
+        {
+            if ( &A != reuseMatrix_ ) {
+                reusePolicy_.invalidate();
+            }
+            if ( reusePolicy_.needsSetup() ) {
+                setupReusedPreconditioner( A );
+            }
+            else {
+                updateReusedPreconditioner();
+            }
+
+            const bool reused = reusePolicy_.reused();
+            std::unique_ptr< Vector > x0, b0;
+            if ( reused ) {
+                x0.reset( new Vector( x ) );
+                b0.reset( new Vector( b ) );
+            }
+
+            Dune::InverseOperatorResult result;
+            solveWithReusedPreconditioner( x, b, result );
+            if ( ! result.converged && reused ) {
+                setupReusedPreconditioner( A );
+                x = *x0;
+                b = *b0;
+                solveWithReusedPreconditioner( x, b, result );
+            }
+            reusePolicy_.solveDone( result.iterations );
+            checkConvergence( result );
+        }
+
         /// Solve the linear system Ax = b, with A being the
         /// combined derivative matrix of the residual and b
         /// being the residual itself.
@@ -372,6 +651,26 @@ namespace Opm
         bool isIORank_;
 
         NewtonIterationBlackoilInterleavedParameters parameters_;
+        mutable double linearSolverReduction_;
+        bool mixedPrecision_;
+
+        // Operator and preconditioner kept between sequential solves.
+        mutable PreconditionerReusePolicy reusePolicy_;
+        mutable const Matrix* reuseMatrix_;
+        mutable Dune::Amg::SequentialInformation seqInfo_;
+        mutable std::unique_ptr< SeqOperator > reuseOperator_;
+        mutable std::unique_ptr< PreconditionerBase > reusePrecond_;
+#if FLOW_SUPPORT_AMG
+        mutable std::unique_ptr< SeqAMG > reuseAmg_;
+#endif
+
+        // Solutions recycled between sequential solves.
+        mutable KrylovRecycling< Matrix, Vector > recycling_;
+        CPRParameter cprParameters_;
+        mutable bool deflate_;
+        // Factor applied to the reduction, for initial guesses that
+        // already reduce the defect.
+        mutable double reductionScale_;
     }; // end ISTLSolver
 
 } // namespace Opm
@@ -0,0 +1,303 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_KRYLOVRECYCLING_HEADER_INCLUDED
+#define OPM_KRYLOVRECYCLING_HEADER_INCLUDED
+
+#include <opm/common/utility/parameters/ParameterGroup.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+
+#include <dune/common/version.hh>
+#include <dune/istl/preconditioner.hh>
+#include <dune/istl/solvercategory.hh>
+
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <cmath>
+#include <deque>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Parameters controlling the recycling of solutions between linear
+    /// solves.
+    struct KrylovRecyclingParameters
+    {
+        /// Number of previous solutions kept. Zero disables recycling.
+        int subspace_size_;
+        /// If true, the recycled subspace is also deflated in every
+        /// preconditioner application, not only used for the initial guess.
+        bool deflation_;
+
+        /// Construct with recycling disabled.
+        KrylovRecyclingParameters()
+        {
+            reset();
+        }
+
+        /// Construct from user parameters or defaults.
+        explicit KrylovRecyclingParameters(const ParameterGroup& param)
+        {
+            reset();
+            subspace_size_ = param.getDefault("linear_solver_recycle_size", subspace_size_);
+            deflation_ = param.getDefault("linear_solver_recycle_deflation", deflation_);
+        }
+
+        /// Set default values.
+        void reset()
+        {
+            subspace_size_ = 0;
+            deflation_ = true;
+        }
+    };
+
+
+
+    /// Recycled subspace of previous solutions for a sequence of slowly
+    /// varying linear systems, e.g. those of the Newton iterations of a
+    /// time step.
+    ///
+    /// Before a solve, setup() computes C = A U for the kept solutions U
+    /// and orthonormalises C, transforming U accordingly, so that
+    /// U C^T r minimises the residual r - A U y over the subspace. This
+    /// gives the initial guess U C^T b, an extrapolation of the previous
+    /// solutions. The products A U are kept, so that while the matrix is
+    /// unchanged only the products of new solutions are computed. With
+    /// deflation, the same projection is applied to the defect in each
+    /// preconditioner application (see RecycledSubspacePreconditioner),
+    /// similar to the use of the recycled space in GCRO-DR, so that the
+    /// Krylov method works on the complement of the subspace.
+    ///
+    /// The solutions of one time step are poor approximations to those of
+    /// the next, so clear() should be called at the start of each step.
+    ///
+    /// \tparam Matrix  matrix type, a Dune::BCRSMatrix
+    /// \tparam Vector  vector type, a Dune::BlockVector
+    template <class Matrix, class Vector>
+    class KrylovRecycling
+    {
+    public:
+        explicit KrylovRecycling(const KrylovRecyclingParameters& param
+                                 = KrylovRecyclingParameters())
+            : param_(param)
+        {
+        }
+
+        /// True if solutions are recycled at all.
+        bool enabled() const
+        {
+            return param_.subspace_size_ > 0;
+        }
+
+        /// True if the subspace should be deflated in the preconditioner.
+        bool deflation() const
+        {
+            return param_.deflation_;
+        }
+
+        /// Dimension of the subspace prepared by the last setup().
+        int size() const
+        {
+            return U_.size();
+        }
+
+        /// Prepare the subspace for solves with A.
+        /// \param[in] A               matrix of the next solves
+        /// \param[in] matrix_changed  if false, A is taken to be the matrix
+        ///                            of the previous setup, e.g. while its
+        ///                            preconditioner is reused, and the
+        ///                            products with A are not recomputed
+        void setup(const Matrix& A, const bool matrix_changed = true)
+        {
+            U_.clear();
+            C_.clear();
+            if (matrix_changed) {
+                products_.clear();
+            }
+            for (std::size_t k = 0; k < solutions_.size(); ++k) {
+                const Vector& s = solutions_[k];
+                if (s.size() != A.N()) {
+                    // The system has changed size, forget all solutions.
+                    clear();
+                    return;
+                }
+                if (k == products_.size()) {
+                    products_.emplace_back(A.N());
+                    A.mv(s, products_.back());
+                }
+                Vector u = s;
+                Vector c = products_[k];
+                // Modified Gram-Schmidt on C, applying the same
+                // combinations to U.
+                const double norm0 = c.two_norm();
+                for (std::size_t j = 0; j < C_.size(); ++j) {
+                    const double h = C_[j].dot(c);
+                    c.axpy(-h, C_[j]);
+                    u.axpy(-h, U_[j]);
+                }
+                const double norm = c.two_norm();
+                if (!(norm > 1e-10 * norm0)) {
+                    // Numerically in the span of the others.
+                    continue;
+                }
+                c /= norm;
+                u /= norm;
+                C_.push_back(c);
+                U_.push_back(u);
+            }
+        }
+
+        /// Replace x by the minimal residual approximation of A x = b
+        /// within the subspace, or by zero if that is not better.
+        /// \return  |b - A x| / |b|, the reduction already achieved
+        double initialGuess(const Matrix& A, const Vector& b, Vector& x) const
+        {
+            x = 0.0;
+            const double bnorm = b.two_norm();
+            if (C_.empty() || !(bnorm > 0.0)) {
+                return 1.0;
+            }
+            for (std::size_t j = 0; j < C_.size(); ++j) {
+                x.axpy(C_[j].dot(b), U_[j]);
+            }
+            // Computed explicitly, since the products may be those of
+            // an earlier matrix.
+            Vector r = b;
+            A.mmv(x, r);
+            const double reduction = r.two_norm() / bnorm;
+            if (!(reduction < 1.0)) {
+                x = 0.0;
+                return 1.0;
+            }
+            return reduction;
+        }
+
+        /// Project the defect d onto the subspace: v += U C^T d, d -= C C^T d.
+        void project(Vector& v, Vector& d) const
+        {
+            for (std::size_t j = 0; j < C_.size(); ++j) {
+                const double y = C_[j].dot(d);
+                v.axpy(y, U_[j]);
+                d.axpy(-y, C_[j]);
+            }
+        }
+
+        /// Keep the solution of a finished solve, replacing the oldest one
+        /// when the subspace is full.
+        void addSolution(const Vector& x)
+        {
+            if (!enabled()) {
+                return;
+            }
+            if (int(solutions_.size()) >= param_.subspace_size_) {
+                solutions_.pop_front();
+                if (!products_.empty()) {
+                    products_.pop_front();
+                }
+            }
+            solutions_.push_back(x);
+        }
+
+        /// Forget all kept solutions, e.g. at the start of a time step.
+        void clear()
+        {
+            solutions_.clear();
+            products_.clear();
+            U_.clear();
+            C_.clear();
+        }
+
+    private:
+        KrylovRecyclingParameters param_;
+        std::deque<Vector> solutions_;
+        std::deque<Vector> products_;   // A s for the first solutions s
+        std::vector<Vector> U_;
+        std::vector<Vector> C_;
+    };
+
+
+
+    /// Sequential preconditioner that removes the recycled subspace from
+    /// the defect before applying the inner preconditioner,
+    ///     v = U C^T d + M^{-1} (d - C C^T d),
+    /// using that C = A U.
+    template <class Matrix, class Vector>
+    class RecycledSubspacePreconditioner : public Dune::Preconditioner<Vector, Vector>
+    {
+    public:
+        typedef Vector domain_type;
+        typedef Vector range_type;
+        typedef typename Vector::field_type field_type;
+
+#if ! DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        enum {
+            //! \brief The category the preconditioner is part of.
+            category = Dune::SolverCategory::sequential
+        };
+#endif
+
+        RecycledSubspacePreconditioner(Dune::Preconditioner<Vector, Vector>& inner,
+                                       const KrylovRecycling<Matrix, Vector>& recycling)
+            : inner_(inner),
+              recycling_(recycling)
+        {
+        }
+
+#if DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        Dune::SolverCategory::Category category() const override
+        {
+            return Dune::SolverCategory::sequential;
+        }
+#endif
+
+        void pre(Vector& x, Vector& b) override
+        {
+            inner_.pre(x, b);
+        }
+
+        void apply(Vector& v, const Vector& d) override
+        {
+            d_ = d;
+            if (u_.size() != v.size()) {
+                u_.resize(v.size());
+            }
+            u_ = 0.0;
+            recycling_.project(u_, d_);
+            v = 0.0;
+            inner_.apply(v, d_);
+            v += u_;
+        }
+
+        void post(Vector& x) override
+        {
+            inner_.post(x);
+        }
+
+    private:
+        Dune::Preconditioner<Vector, Vector>& inner_;
+        const KrylovRecycling<Matrix, Vector>& recycling_;
+        Vector d_;
+        Vector u_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_KRYLOVRECYCLING_HEADER_INCLUDED
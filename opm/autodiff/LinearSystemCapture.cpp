@@ -0,0 +1,251 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/LinearSystemCapture.hpp>
+#include <opm/common/ErrorMacros.hpp>
+#include <opm/core/linalg/ParallelIstlInformation.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace Opm
+{
+
+    namespace
+    {
+        const char captureTag[8] = { 'O', 'P', 'M', 'L', 'I', 'N', 'S', 'Y' };
+        const std::int32_t captureVersion = 1;
+
+        template <class T>
+        void writeArray(std::ostream& os, const std::vector<T>& v)
+        {
+            os.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+        }
+
+        void writeInt(std::ostream& os, const std::int32_t i)
+        {
+            os.write(reinterpret_cast<const char*>(&i), sizeof(i));
+        }
+
+        template <class T>
+        void readArray(std::istream& is, std::vector<T>& v, const std::size_t size)
+        {
+            v.resize(size);
+            is.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+        }
+
+        std::int32_t readInt(std::istream& is)
+        {
+            std::int32_t i = 0;
+            is.read(reinterpret_cast<char*>(&i), sizeof(i));
+            return i;
+        }
+    } // anonymous namespace
+
+
+
+    CapturedLinearSystem captureLinearSystem(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A,
+                                             const AutoDiffBlock<double>::V& rhs,
+                                             const bool wells_eliminated)
+    {
+        typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Sp;
+        CapturedLinearSystem sys;
+        sys.block_size = 1;
+        sys.wells_eliminated = wells_eliminated;
+        const int n = A.rows();
+        sys.row_start.reserve(n + 1);
+        sys.col_index.reserve(A.nonZeros());
+        sys.values.reserve(A.nonZeros());
+        sys.row_start.push_back(0);
+        for (int row = 0; row < n; ++row) {
+            for (Sp::InnerIterator it(A, row); it; ++it) {
+                sys.col_index.push_back(it.col());
+                sys.values.push_back(it.value());
+            }
+            sys.row_start.push_back(sys.col_index.size());
+        }
+        sys.rhs.assign(rhs.data(), rhs.data() + rhs.size());
+        return sys;
+    }
+
+
+
+    void writeLinearSystem(const std::string& filename, const CapturedLinearSystem& sys)
+    {
+        std::ofstream os(filename.c_str(), std::ios::binary);
+        if (!os) {
+            OPM_THROW(std::runtime_error, "Could not open " << filename << " for writing.");
+        }
+        const int bs = sys.block_size;
+        const int n = sys.size();
+        const int nnzb = sys.col_index.size();
+        if (int(sys.values.size()) != nnzb * bs * bs || int(sys.rhs.size()) != n * bs) {
+            OPM_THROW(std::logic_error, "writeLinearSystem: inconsistent system sizes.");
+        }
+        os.write(captureTag, sizeof(captureTag));
+        writeInt(os, captureVersion);
+        writeInt(os, bs);
+        writeInt(os, sys.wells_eliminated ? 1 : 0);
+        writeInt(os, sys.solve_index);
+        writeInt(os, n);
+        writeInt(os, nnzb);
+        writeArray(os, sys.row_start);
+        writeArray(os, sys.col_index);
+        writeArray(os, sys.values);
+        writeArray(os, sys.rhs);
+        if (!os) {
+            OPM_THROW(std::runtime_error, "Failed writing linear system to " << filename);
+        }
+    }
+
+
+
+    CapturedLinearSystem readLinearSystem(const std::string& filename)
+    {
+        std::ifstream is(filename.c_str(), std::ios::binary);
+        if (!is) {
+            OPM_THROW(std::runtime_error, "Could not open " << filename << " for reading.");
+        }
+        char tag[sizeof(captureTag)];
+        is.read(tag, sizeof(tag));
+        if (!is || std::memcmp(tag, captureTag, sizeof(tag)) != 0) {
+            OPM_THROW(std::runtime_error, filename << " is not a captured linear system.");
+        }
+        const int version = readInt(is);
+        if (version != captureVersion) {
+            OPM_THROW(std::runtime_error, filename << " has unsupported version " << version);
+        }
+        CapturedLinearSystem sys;
+        sys.block_size = readInt(is);
+        sys.wells_eliminated = readInt(is) != 0;
+        sys.solve_index = readInt(is);
+        const int n = readInt(is);
+        const int nnzb = readInt(is);
+        const int bs = sys.block_size;
+        if (!is || bs < 1 || n < 0 || nnzb < 0) {
+            OPM_THROW(std::runtime_error, filename << " has an invalid header.");
+        }
+        readArray(is, sys.row_start, n + 1);
+        readArray(is, sys.col_index, nnzb);
+        readArray(is, sys.values, std::size_t(nnzb) * bs * bs);
+        readArray(is, sys.rhs, std::size_t(n) * bs);
+        if (!is) {
+            OPM_THROW(std::runtime_error, filename << " is truncated.");
+        }
+        if (sys.row_start[0] != 0 || sys.row_start[n] != nnzb) {
+            OPM_THROW(std::runtime_error, filename << " has invalid row starts.");
+        }
+        for (int row = 0; row < n; ++row) {
+            if (sys.row_start[row + 1] < sys.row_start[row]) {
+                OPM_THROW(std::runtime_error, filename << " has decreasing row starts at row " << row);
+            }
+        }
+        for (int k = 0; k < nnzb; ++k) {
+            if (sys.col_index[k] < 0 || sys.col_index[k] >= n) {
+                OPM_THROW(std::runtime_error, filename << " has column index " << sys.col_index[k]
+                          << " out of range for " << n << " rows.");
+            }
+        }
+        return sys;
+    }
+
+
+
+    LinearSystemCaptureParameters::LinearSystemCaptureParameters(const ParameterGroup& param)
+    {
+        reset();
+        prefix_ = param.getDefault("linear_system_capture_prefix", prefix_);
+        first_ = param.getDefault("linear_system_capture_first", first_);
+        stride_ = param.getDefault("linear_system_capture_stride", stride_);
+        count_ = param.getDefault("linear_system_capture_count", count_);
+        if (stride_ < 1) {
+            OPM_THROW(std::runtime_error, "linear_system_capture_stride must be positive.");
+        }
+    }
+
+
+
+    LinearSystemCapture::LinearSystemCapture(const LinearSystemCaptureParameters& param,
+                                             const int rank)
+        : param_(param),
+          rank_(rank),
+          solves_(0),
+          captured_(0)
+    {
+    }
+
+
+
+    int LinearSystemCapture::processRank(const boost::any& parallelInformation)
+    {
+#if HAVE_MPI
+        if (parallelInformation.type() == typeid(ParallelISTLInformation)) {
+            const ParallelISTLInformation& info =
+                boost::any_cast<const ParallelISTLInformation&>(parallelInformation);
+            return info.communicator().rank();
+        }
+#else
+        static_cast<void>(parallelInformation);
+#endif
+        return -1;
+    }
+
+
+
+    bool LinearSystemCapture::selectNextSolve()
+    {
+        const int solve = solves_++;
+        if (!enabled() || solve < param_.first_) {
+            return false;
+        }
+        if (param_.count_ >= 0 && captured_ >= param_.count_) {
+            return false;
+        }
+        return (solve - param_.first_) % param_.stride_ == 0;
+    }
+
+
+
+    void LinearSystemCapture::write(CapturedLinearSystem sys)
+    {
+        sys.solve_index = solves_ - 1;
+        writeLinearSystem(filename(sys.solve_index), sys);
+        ++captured_;
+    }
+
+
+
+    std::string LinearSystemCapture::filename(const int solve_index) const
+    {
+        std::ostringstream name;
+        name << param_.prefix_ << '_';
+        if (rank_ >= 0) {
+            name << "rank" << rank_ << '_';
+        }
+        name << std::setw(5) << std::setfill('0') << solve_index << ".linsys";
+        return name.str();
+    }
+
+} // namespace Opm
@@ -0,0 +1,187 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_LINEARSYSTEMCAPTURE_HEADER_INCLUDED
+#define OPM_LINEARSYSTEMCAPTURE_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/autodiff/BlockSparseJacobian.hpp>
+#include <opm/common/utility/parameters/ParameterGroup.hpp>
+
+#include <Eigen/Sparse>
+
+#include <boost/any.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Opm
+{
+
+    /// A linear system as passed to a linear solver, in block compressed
+    /// row form with dense row-major blocks of size block_size x block_size.
+    /// Scalar systems have block_size 1.
+    struct CapturedLinearSystem
+    {
+        int block_size = 1;
+        /// True if well unknowns were eliminated to form the system.
+        bool wells_eliminated = false;
+        /// Index of the linear solve the system was captured from.
+        int solve_index = 0;
+        std::vector<int> row_start;     // Number of block rows + 1 elements.
+        std::vector<int> col_index;     // Block column of each stored block.
+        std::vector<double> values;     // block_size^2 values per stored block.
+        std::vector<double> rhs;        // Interleaved, block_size values per block row.
+
+        /// Number of block rows.
+        int size() const
+        {
+            return row_start.empty() ? 0 : int(row_start.size()) - 1;
+        }
+    };
+
+    /// Capture an interleaved block system.
+    /// \param[in] jacobian          matrix
+    /// \param[in] rhs               interleaved right hand side, np * jacobian.size() values
+    /// \param[in] wells_eliminated  true if the well unknowns were eliminated
+    template <int np, class Scalar>
+    CapturedLinearSystem captureLinearSystem(const BlockSparseJacobian<np>& jacobian,
+                                             const Scalar* rhs,
+                                             const bool wells_eliminated)
+    {
+        CapturedLinearSystem sys;
+        sys.block_size = np;
+        sys.wells_eliminated = wells_eliminated;
+        if (jacobian.size() == 0) {
+            // An empty system has no blocks to copy.
+            sys.row_start.assign(1, 0);
+            return sys;
+        }
+        sys.row_start = jacobian.rowStart();
+        sys.col_index = jacobian.colIndex();
+        const int nnzb = jacobian.nonZeroBlocks();
+        if (nnzb > 0) {
+            const double* values = jacobian.block(0);
+            sys.values.assign(values, values + nnzb * np * np);
+        }
+        sys.rhs.assign(rhs, rhs + np * jacobian.size());
+        return sys;
+    }
+
+    /// Capture a scalar system.
+    /// \param[in] A                 matrix
+    /// \param[in] rhs               right hand side
+    /// \param[in] wells_eliminated  true if the well unknowns were eliminated
+    CapturedLinearSystem captureLinearSystem(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A,
+                                             const AutoDiffBlock<double>::V& rhs,
+                                             const bool wells_eliminated);
+
+    /// Write a captured system in binary form.
+    ///
+    /// The file holds, in native byte order, the 8 character tag
+    /// "OPMLINSY", followed by the 32 bit integers version, block size,
+    /// wells eliminated (0 or 1), solve index, number of block rows n and
+    /// number of stored blocks nnzb, then the row starts (n + 1 integers),
+    /// the block column indices (nnzb integers), the block values
+    /// (nnzb * block size^2 doubles) and the right hand side
+    /// (n * block size doubles).
+    void writeLinearSystem(const std::string& filename, const CapturedLinearSystem& sys);
+
+    /// Read a system written by writeLinearSystem(). Throws if the file
+    /// is not a captured system, or if its row starts are not monotone
+    /// or its column indices out of range.
+    CapturedLinearSystem readLinearSystem(const std::string& filename);
+
+
+
+    /// Parameters selecting the linear solves whose systems are captured.
+    struct LinearSystemCaptureParameters
+    {
+        /// File name prefix of the captured systems. Capture is disabled
+        /// if empty.
+        std::string prefix_;
+        /// Index of the first captured solve, counted from zero.
+        int first_;
+        /// Number of solves between captured ones.
+        int stride_;
+        /// Maximum number of captured systems, negative for no limit.
+        int count_;
+
+        /// Construct with capture disabled.
+        LinearSystemCaptureParameters()
+        {
+            reset();
+        }
+
+        /// Construct from user parameters or defaults.
+        explicit LinearSystemCaptureParameters(const ParameterGroup& param);
+
+        /// Set default values.
+        void reset()
+        {
+            prefix_ = "";
+            first_ = 0;
+            stride_ = 1;
+            count_ = 1;
+        }
+    };
+
+    /// Writes the linear systems of selected solves, normally of
+    /// successive Newton iterations, to files named
+    /// <prefix>_<solve index>.linsys. In parallel runs each process
+    /// writes its local system to <prefix>_rank<rank>_<solve index>.linsys.
+    class LinearSystemCapture
+    {
+    public:
+        /// \param[in] param  selection of the captured solves
+        /// \param[in] rank   rank of this process in parallel runs, negative
+        ///                   in sequential runs
+        explicit LinearSystemCapture(const LinearSystemCaptureParameters& param = LinearSystemCaptureParameters(),
+                                     const int rank = -1);
+
+        /// Rank of this process for the given parallel information, or -1
+        /// for sequential runs.
+        static int processRank(const boost::any& parallelInformation);
+
+        /// True if any system may be captured.
+        bool enabled() const
+        {
+            return !param_.prefix_.empty();
+        }
+
+        /// Count a linear solve. Returns true if its system should be
+        /// captured with write().
+        bool selectNextSolve();
+
+        /// Write the system of the last selected solve.
+        void write(CapturedLinearSystem sys);
+
+        /// File name used for the given solve.
+        std::string filename(const int solve_index) const;
+
+    private:
+        LinearSystemCaptureParameters param_;
+        int rank_;
+        int solves_;
+        int captured_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_LINEARSYSTEMCAPTURE_HEADER_INCLUDED
@@ -67,6 +67,11 @@ namespace Opm
 
         bool singlePrecision ;
 
+        /// Relative residual reduction required of the linear solver for
+        /// this system. If not positive, the solver uses its configured
+        /// linear_solver_reduction.
+        double linearSolverReduction;
+
         /// The size of the non-linear system.
         int sizeNonLinear() const;
     };
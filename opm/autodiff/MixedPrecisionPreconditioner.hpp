@@ -0,0 +1,165 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_MIXEDPRECISIONPRECONDITIONER_HEADER_INCLUDED
+#define OPM_MIXEDPRECISIONPRECONDITIONER_HEADER_INCLUDED
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+
+#include <dune/common/version.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/preconditioner.hh>
+#include <dune/istl/solvercategory.hh>
+
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <memory>
+
+namespace Opm
+{
+
+    /// Sequential preconditioner for double precision vectors that is
+    /// set up and applied in single precision.
+    ///
+    /// The matrix is copied to single precision, and the inner
+    /// preconditioner (e.g. ILU0 or AMG) is set up for the copy. Each
+    /// application converts the defect to single precision, applies the
+    /// inner preconditioner, and converts the update back. The Krylov
+    /// iteration, and thereby the accuracy of the solution, stays in
+    /// double precision, while the memory traffic of the preconditioner
+    /// is halved.
+    ///
+    /// \tparam MatrixF  single precision matrix type, a Dune::BCRSMatrix
+    /// \tparam X        double precision vector type, a Dune::BlockVector
+    template <class MatrixF, class X>
+    class MixedPrecisionPreconditioner : public Dune::Preconditioner<X, X>
+    {
+    public:
+        typedef typename MatrixF::field_type FloatType;
+        typedef Dune::BlockVector< Dune::FieldVector<FloatType, X::block_type::dimension> > VectorF;
+        typedef Dune::MatrixAdapter<MatrixF, VectorF, VectorF> OperatorF;
+        typedef Dune::Preconditioner<VectorF, VectorF> InnerPreconditioner;
+
+        typedef X domain_type;
+        typedef X range_type;
+        typedef typename X::field_type field_type;
+
+#if ! DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        enum {
+            //! \brief The category the preconditioner is part of.
+            category = Dune::SolverCategory::sequential
+        };
+#endif
+
+        /// Copy the matrix to single precision and set up the inner
+        /// preconditioner.
+        /// \param[in] A            double precision matrix
+        /// \param[in] createInner  callable creating the inner preconditioner
+        ///                         from an OperatorF, returning a
+        ///                         std::unique_ptr<InnerPreconditioner>
+        template <class Matrix, class Factory>
+        MixedPrecisionPreconditioner(const Matrix& A, Factory createInner)
+            : A_(copyMatrix(A)),
+              op_(new OperatorF(*A_)),
+              inner_(createInner(*op_)),
+              v_(A.M()),
+              d_(A.N())
+        {
+        }
+
+#if DUNE_VERSION_NEWER(DUNE_ISTL, 2, 6)
+        Dune::SolverCategory::Category category() const override
+        {
+            return Dune::SolverCategory::sequential;
+        }
+#endif
+
+        void pre(X& x, X& b) override
+        {
+            // The inner preconditioner may need to see a right hand side,
+            // e.g. to set up the vectors of the AMG levels.
+            copyVector(x, v_);
+            copyVector(b, d_);
+            inner_->pre(v_, d_);
+        }
+
+        void apply(X& v, const X& d) override
+        {
+            copyVector(d, d_);
+            v_ = 0.0;
+            inner_->apply(v_, d_);
+            copyVector(v_, v);
+        }
+
+        void post(X& x) override
+        {
+            static_cast<void>(x);
+            inner_->post(v_);
+        }
+
+    private:
+        std::unique_ptr<MatrixF> A_;
+        std::unique_ptr<OperatorF> op_;
+        std::unique_ptr<InnerPreconditioner> inner_;
+        VectorF v_;
+        VectorF d_;
+
+        template <class Matrix>
+        static std::unique_ptr<MatrixF> copyMatrix(const Matrix& A)
+        {
+            std::unique_ptr<MatrixF> B(new MatrixF(A.N(), A.M(), A.nonzeroes(), MatrixF::row_wise));
+            for (auto row = B->createbegin(); row != B->createend(); ++row) {
+                const auto& arow = A[row.index()];
+                for (auto col = arow.begin(); col != arow.end(); ++col) {
+                    row.insert(col.index());
+                }
+            }
+            for (auto row = A.begin(); row != A.end(); ++row) {
+                auto& brow = (*B)[row.index()];
+                auto bcol = brow.begin();
+                for (auto col = row->begin(); col != row->end(); ++col, ++bcol) {
+                    const auto& ablock = *col;
+                    auto& bblock = *bcol;
+                    for (int i = 0; i < int(ablock.N()); ++i) {
+                        for (int j = 0; j < int(ablock.M()); ++j) {
+                            bblock[i][j] = ablock[i][j];
+                        }
+                    }
+                }
+            }
+            return B;
+        }
+
+        template <class From, class To>
+        static void copyVector(const From& from, To& to)
+        {
+            const int n = from.size();
+            for (int i = 0; i < n; ++i) {
+                for (int c = 0; c < int(from[i].size()); ++c) {
+                    to[i][c] = from[i][c];
+                }
+            }
+        }
+    };
+
+} // namespace Opm
+
+#endif // OPM_MIXEDPRECISIONPRECONDITIONER_HEADER_INCLUDED
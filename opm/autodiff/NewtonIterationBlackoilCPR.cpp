@@ -26,6 +26,7 @@
 
 #include <opm/autodiff/NewtonIterationBlackoilCPR.hpp>
 #include <opm/autodiff/NewtonIterationUtilities.hpp>
+#include <opm/autodiff/WellSchurComplement.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
 #include <opm/parser/eclipse/Units/Units.hpp>
 #include <opm/common/Exceptions.hpp>
@@ -63,7 +64,10 @@ namespace Opm
         linear_solver_maxiter_( param.getDefault("linear_solver_maxiter", 50 ) ),
         linear_solver_restart_( param.getDefault("linear_solver_restart", 40 ) ),
         linear_solver_verbosity_( param.getDefault("linear_solver_verbosity", 0 )),
-        linear_solver_ignoreconvergencefailure_(param.getDefault("linear_solver_ignoreconvergencefailure", false))
+        linear_solver_ignoreconvergencefailure_(param.getDefault("linear_solver_ignoreconvergencefailure", false)),
+        current_reduction_( linear_solver_reduction_ ),
+        reusePolicy_( PreconditionerReuseParameters( param ) ),
+        capture_( LinearSystemCaptureParameters( param ), LinearSystemCapture::processRank( parallelInformation_arg ) )
     {
     }
 
@@ -79,6 +83,9 @@ namespace Opm
     NewtonIterationBlackoilCPR::SolutionVector
     NewtonIterationBlackoilCPR::computeNewtonIncrement(const LinearisedBlackoilResidual& residual) const
     {
+        current_reduction_ = residual.linearSolverReduction > 0.0 ? residual.linearSolverReduction
+                                                                  : linear_solver_reduction_;
+
         // Build the vector of equations.
         const int np = residual.material_balance_eq.size();
         std::vector<ADB> eqs;
@@ -89,18 +96,16 @@ namespace Opm
 
         // check if wells are present
         const bool hasWells = residual.well_flux_eq.size() > 0 ;
-        std::vector<ADB> elim_eqs;
+        std::unique_ptr<WellSchurComplement> well_elimination;
         if( hasWells )
         {
             eqs.push_back(residual.well_flux_eq);
             eqs.push_back(residual.well_eq);
 
-            // Eliminate the well-related unknowns, and corresponding equations.
-            elim_eqs.reserve(2);
-            elim_eqs.push_back(eqs[np]);
-            eqs = eliminateVariable(eqs, np); // Eliminate well flux unknowns.
-            elim_eqs.push_back(eqs[np]);
-            eqs = eliminateVariable(eqs, np); // Eliminate well bhp unknowns.
+            // Eliminate the well-related unknowns, and corresponding equations,
+            // by a Schur complement formed well by well.
+            well_elimination.reset(new WellSchurComplement(eqs, np));
+            eqs = well_elimination->reducedEquations();
             assert(int(eqs.size()) == np);
         }
 
@@ -121,20 +126,25 @@ namespace Opm
         A.topRows(nc) *= pscale;
         b.topRows(nc) *= pscale;
 
+        if (capture_.selectNextSolve()) {
+            capture_.write(captureLinearSystem(A, b, hasWells));
+        }
+
         // Solve reduced system.
         SolutionVector dx(SolutionVector::Zero(b.size()));
 
-        // Create ISTL matrix.
-        DuneMatrix istlA( A );
+        // Create ISTL matrix. The matrices are shared, as a reused
+        // preconditioner keeps the ones it was set up with.
+        std::shared_ptr<DuneMatrix> istlA = std::make_shared<DuneMatrix>( A );
 
         // Create ISTL matrix for elliptic part.
-        DuneMatrix istlAe( A.topLeftCorner(nc, nc) );
+        std::shared_ptr<DuneMatrix> istlAe = std::make_shared<DuneMatrix>( A.topLeftCorner(nc, nc) );
 
         // Right hand side.
-        Vector istlb(istlA.N());
+        Vector istlb(istlA->N());
         std::copy_n(b.data(), istlb.size(), istlb.begin());
         // System solution
-        Vector x(istlA.M());
+        Vector x(istlA->M());
         x = 0.0;
 
         Dune::InverseOperatorResult result;
@@ -148,20 +158,23 @@ namespace Opm
             Comm istlAeComm(info.communicator());
             info.copyValuesTo(istlAeComm.indexSet(), istlAeComm.remoteIndices());
             info.copyValuesTo(istlComm.indexSet(), istlComm.remoteIndices(),
-                              istlAe.N(), istlA.N()/istlAe.N());
+                              istlAe->N(), istlA->N()/istlAe->N());
             // Construct operator, scalar product and vectors needed.
             typedef Dune::OverlappingSchwarzOperator<Mat,Vector,Vector,Comm> Operator;
-            Operator opA(istlA, istlComm);
-            constructPreconditionerAndSolve<Dune::SolverCategory::overlapping>(opA, istlAe, x, istlb, istlComm, istlAeComm, result);
+            Operator opA(*istlA, istlComm);
+            constructPreconditionerAndSolve<Dune::SolverCategory::overlapping>(opA, *istlAe, x, istlb, istlComm, istlAeComm, result);
         }
         else
 #endif
         {
             // Construct operator, scalar product and vectors needed.
-            typedef Dune::MatrixAdapter<Mat,Vector,Vector> Operator;
-            Operator opA(istlA);
-            Dune::Amg::SequentialInformation info;
-            constructPreconditionerAndSolve(opA, istlAe, x, istlb, info, info, result);
+            SeqOperator opA(*istlA);
+            if (reusePolicy_.enabled()) {
+                solveReusingPreconditioner(opA, istlA, istlAe, x, istlb, result);
+            } else {
+                Dune::Amg::SequentialInformation info;
+                constructPreconditionerAndSolve(opA, *istlAe, x, istlb, info, info, result);
+            }
         }
 
         // store number of iterations
@@ -177,9 +190,7 @@ namespace Opm
 
         if ( hasWells ) {
             // Compute full solution using the eliminated equations.
-            // Recovery in inverse order of elimination.
-            dx = recoverVariable(elim_eqs[1], dx, np);
-            dx = recoverVariable(elim_eqs[0], dx, np);
+            dx = well_elimination->recover(dx);
         }
         return dx;
     }
@@ -188,6 +199,59 @@ namespace Opm
 
 
 
+    void
+    NewtonIterationBlackoilCPR::solveReusingPreconditioner(SeqOperator& opA,
+                                                           const std::shared_ptr<DuneMatrix>& istlA,
+                                                           const std::shared_ptr<DuneMatrix>& istlAe,
+                                                           Vector& x, Vector& istlb,
+                                                           Dune::InverseOperatorResult& result) const
+    {
+        if (reuseA_ && (reuseA_->N() != istlA->N() || reuseAe_->N() != istlAe->N())) {
+            reusePolicy_.invalidate();
+        }
+        if (reusePolicy_.needsSetup()) {
+            setupReusedPreconditioner(istlA, istlAe);
+        }
+
+        const bool reused = reusePolicy_.reused();
+        Vector x0;
+        Vector b0;
+        if (reused) {
+            x0 = x;
+            b0 = istlb;
+        }
+
+        Dune::SeqScalarProduct<Vector> sp;
+        solve(opA, sp, *reusePrecond_, x, istlb, result);
+        if (!result.converged && reused) {
+            // The reused preconditioner may be too far off, try a new one.
+            setupReusedPreconditioner(istlA, istlAe);
+            x = x0;
+            istlb = b0;
+            solve(opA, sp, *reusePrecond_, x, istlb, result);
+        }
+        reusePolicy_.solveDone(result.iterations);
+    }
+
+
+
+
+
+    void
+    NewtonIterationBlackoilCPR::setupReusedPreconditioner(const std::shared_ptr<DuneMatrix>& istlA,
+                                                          const std::shared_ptr<DuneMatrix>& istlAe) const
+    {
+        reusePrecond_.reset();
+        reuseA_ = istlA;
+        reuseAe_ = istlAe;
+        reusePrecond_.reset(new SeqPreconditioner(cpr_param_, *reuseA_, *reuseAe_, reuseInfo_, reuseInfo_));
+        reusePolicy_.setupDone();
+    }
+
+
+
+
+
     const boost::any& NewtonIterationBlackoilCPR::parallelInformation() const
     {
         return parallelInformation_;
@@ -27,6 +27,8 @@
 #include <opm/autodiff/DuneMatrix.hpp>
 #include <opm/autodiff/NewtonIterationBlackoilInterface.hpp>
 #include <opm/autodiff/CPRPreconditioner.hpp>
+#include <opm/autodiff/LinearSystemCapture.hpp>
+#include <opm/autodiff/PreconditionerReuse.hpp>
 #include <opm/common/utility/parameters/ParameterGroup.hpp>
 #include <opm/core/linalg/LinearSolverInterface.hpp>
 #include <dune/istl/scalarproducts.hh>
@@ -61,6 +63,12 @@ namespace Opm
         ///                        cpr_ilu_n        (default 0) use ILU(n) for preconditioning of the linear system
         ///                        cpr_use_amg      (default false) if true, use AMG preconditioner for elliptic part
         ///                        cpr_use_bicgstab (default true)  if true, use BiCGStab (else use CG) for elliptic part
+        ///                        preconditioner_reuse_max (default 0) number of solves that may reuse
+        ///                                         the preconditioner of an earlier solve (sequential runs).
+        ///                                         The reused preconditioner is not updated, it keeps
+        ///                                         the ILU and AMG of the matrices it was set up with
+        ///                        preconditioner_reuse_iteration_growth (default 2.0) set up a new
+        ///                                         preconditioner when the linear iterations grow by this factor
         /// \param[in] parallelInformation In the case of a parallel run
         ///                               with dune-istl the information about the parallelization.
         NewtonIterationBlackoilCPR(const ParameterGroup& param,
@@ -80,6 +88,8 @@ namespace Opm
         virtual const boost::any& parallelInformation() const;
 
     private:
+        typedef Dune::MatrixAdapter<Mat,Vector,Vector> SeqOperator;
+        typedef Opm::CPRPreconditioner<Mat,Vector,Vector,Dune::Amg::SequentialInformation> SeqPreconditioner;
 
         /// \brief construct the CPR preconditioner and the solver.
         /// \tparam P The type of the parallel information.
@@ -109,24 +119,45 @@ namespace Opm
             parallelInformation_arg.copyOwnerToAll(istlb, istlb);
             Preconditioner precond(cpr_param_, opA.getmat(), istlAe, parallelInformation_arg,
                                    parallelInformationAe);
+            solve(opA, *sp, precond, x, istlb, result);
+        }
 
+        /// \brief Solve with the given operator, scalar product and preconditioner.
+        template <class O, class SP, class Precond>
+        void solve(O& opA, SP& sp, Precond& precond, Vector& x, Vector& istlb,
+                   Dune::InverseOperatorResult& result) const
+        {
             // TODO: Revise when linear solvers interface opm-core is done
             // Construct linear solver.
             // GMRes solver
             if ( newton_use_gmres_ ) {
-                Dune::RestartedGMResSolver<Vector> linsolve(opA, *sp, precond,
-                          linear_solver_reduction_, linear_solver_restart_, linear_solver_maxiter_, linear_solver_verbosity_);
+                Dune::RestartedGMResSolver<Vector> linsolve(opA, sp, precond,
+                          current_reduction_, linear_solver_restart_, linear_solver_maxiter_, linear_solver_verbosity_);
                 // Solve system.
                 linsolve.apply(x, istlb, result);
             }
             else { // BiCGstab solver
-                Dune::BiCGSTABSolver<Vector> linsolve(opA, *sp, precond,
-                          linear_solver_reduction_, linear_solver_maxiter_, linear_solver_verbosity_);
+                Dune::BiCGSTABSolver<Vector> linsolve(opA, sp, precond,
+                          current_reduction_, linear_solver_maxiter_, linear_solver_verbosity_);
                 // Solve system.
                 linsolve.apply(x, istlb, result);
             }
         }
 
+        /// \brief Sequential solve that reuses the CPR preconditioner of an
+        /// earlier solve when the reuse policy permits. A reused
+        /// preconditioner keeps the matrices it was set up with, and is
+        /// not updated with the values of the current matrix.
+        void solveReusingPreconditioner(SeqOperator& opA,
+                                        const std::shared_ptr<DuneMatrix>& istlA,
+                                        const std::shared_ptr<DuneMatrix>& istlAe,
+                                        Vector& x, Vector& istlb,
+                                        Dune::InverseOperatorResult& result) const;
+
+        /// \brief Set up the CPR preconditioner kept between solves.
+        void setupReusedPreconditioner(const std::shared_ptr<DuneMatrix>& istlA,
+                                       const std::shared_ptr<DuneMatrix>& istlAe) const;
+
         CPRParameter cpr_param_;
 
         mutable int iterations_;
@@ -138,6 +169,19 @@ namespace Opm
         const int    linear_solver_restart_;
         const int    linear_solver_verbosity_;
         const bool   linear_solver_ignoreconvergencefailure_;
+        // Reduction of the current solve, linear_solver_reduction_
+        // unless the residual requests another one.
+        mutable double current_reduction_;
+
+        // Preconditioner kept between sequential solves, and the
+        // matrices it was set up with.
+        mutable PreconditionerReusePolicy reusePolicy_;
+        mutable Dune::Amg::SequentialInformation reuseInfo_;
+        mutable std::shared_ptr<DuneMatrix> reuseA_;
+        mutable std::shared_ptr<DuneMatrix> reuseAe_;
+        mutable std::unique_ptr<SeqPreconditioner> reusePrecond_;
+
+        mutable LinearSystemCapture capture_;
     };
 
 } // namespace Opm
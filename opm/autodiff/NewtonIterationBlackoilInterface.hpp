@@ -49,6 +49,10 @@ namespace Opm
 
         /// \brief Get the information about the parallelization of the grid.
         virtual const boost::any& parallelInformation() const = 0;
+
+        /// Called at the start of each time step. Solvers that keep data
+        /// from earlier solves, such as recycled solutions, reset it here.
+        virtual void prepareStep() const {}
     };
 
 } // namespace Opm
@@ -29,9 +29,11 @@
 #include <opm/autodiff/CPRPreconditioner.hpp>
 #include <opm/autodiff/NewtonIterationBlackoilInterleaved.hpp>
 #include <opm/autodiff/NewtonIterationUtilities.hpp>
+#include <opm/autodiff/WellSchurComplement.hpp>
 #include <opm/autodiff/ParallelRestrictedAdditiveSchwarz.hpp>
 #include <opm/autodiff/ParallelOverlappingILU0.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/BlockSparseJacobian.hpp>
 #include <opm/autodiff/DuneMatrix.hpp>
 #include <opm/common/Exceptions.hpp>
 #include <opm/core/linalg/ParallelIstlInformation.hpp>
@@ -50,20 +52,6 @@
 namespace Opm
 {
 
-    namespace detail {
-        /**
-         * Simple binary operator that always returns 0.1
-         * It is used to get the sparsity pattern for our
-         * interleaved system, and is marginally faster than using
-         * operator+=.
-         */
-        template<typename Scalar> struct PointOneOp {
-            EIGEN_EMPTY_STRUCT_CTOR(PointOneOp)
-            Scalar operator()(const Scalar&, const Scalar&) const { return 0.1; }
-        };
-    }
-
-
     /// This class solves the fully implicit black-oil system by
     /// solving the reduced system (after eliminating well variables)
     /// as a block-structured matrix (one block for all cell variables) for a fixed
@@ -87,10 +75,21 @@ namespace Opm
         /// \param[in] param   parameters controlling the behaviour of the linear solvers
         /// \param[in] parallelInformation In the case of a parallel run
          ///                               with dune-istl the information about the parallelization.
+        /// \param[in] reuse_param  parameters controlling the reuse of preconditioners
+        /// \param[in] mixed_precision  if true, store the preconditioner in single precision
+        /// \param[in] recycle_param  parameters controlling the recycling of previous solutions
+        /// \param[in] cpr_param  parameters of the block CPR preconditioner
+        /// \param[in] capture  if non-null, used to write the systems of selected solves
         NewtonIterationBlackoilInterleavedImpl(const NewtonIterationBlackoilInterleavedParameters& param,
-                                               const boost::any& parallelInformation_arg=boost::any())
-        : istlSolver_( param, parallelInformation_arg ),
-          parameters_( param )
+                                               const boost::any& parallelInformation_arg=boost::any(),
+                                               const PreconditionerReuseParameters& reuse_param=PreconditionerReuseParameters(),
+                                               const bool mixed_precision=false,
+                                               const KrylovRecyclingParameters& recycle_param=KrylovRecyclingParameters(),
+                                               const CPRParameter& cpr_param=CPRParameter(),
+                                               LinearSystemCapture* capture=nullptr)
+        : istlSolver_( param, parallelInformation_arg, reuse_param, mixed_precision, recycle_param, cpr_param ),
+          parameters_( param ),
+          capture_( capture )
         {
         }
 
@@ -106,93 +105,8 @@ namespace Opm
         /// \copydoc NewtonIterationBlackoilInterface::parallelInformation
         const boost::any& parallelInformation() const { return istlSolver_.parallelInformation(); }
 
-    public:
-        void formInterleavedSystem(const std::vector<LinearisedBlackoilResidual::ADB>& eqs,
-                                   Mat& istlA) const
-        {
-            assert( np == int(eqs.size()) );
-            // Find sparsity structure as union of basic block sparsity structures,
-            // corresponding to the jacobians with respect to pressure.
-            // Use our custom PointOneOp to get to the union structure.
-            // As default we only iterate over the pressure derivatives.
-            Eigen::SparseMatrix<double, Eigen::ColMajor> col_major = eqs[0].derivative()[0].getSparse();
-            detail::PointOneOp<double> point_one;
-            for (int phase = 1; phase < np; ++phase) {
-                const AutoDiffMatrix::SparseRep& mat = eqs[phase].derivative()[0].getSparse();
-                col_major = col_major.binaryExpr(mat, point_one);
-            }
-            // For some cases (for instance involving Solvent flow) the reasoning for only adding
-            // the pressure derivatives fails. As getting the sparsity pattern is non-trivial, in terms
-            // of work, the full sparsity pattern is only added when required.
-            if (parameters_.require_full_sparsity_pattern_) {
-                for (int p1 = 0; p1 < np; ++p1) {
-                    for (int p2 = 1; p2 < np; ++p2) { // pressure is already added
-                        const AutoDiffMatrix::SparseRep& mat = eqs[p1].derivative()[p2].getSparse();
-                        col_major = col_major.binaryExpr(mat, point_one);
-                    }
-                }
-            }
-
-            // Automatically convert the column major structure to a row-major structure
-            Eigen::SparseMatrix<double, Eigen::RowMajor> row_major = col_major;
-
-            const int size = row_major.rows();
-            assert(size == row_major.cols());
-
-            {
-                // Create ISTL matrix with interleaved rows and columns (block structured).
-                istlA.setSize(row_major.rows(), row_major.cols(), row_major.nonZeros());
-                istlA.setBuildMode(Mat::row_wise);
-                const int* ia = row_major.outerIndexPtr();
-                const int* ja = row_major.innerIndexPtr();
-                const typename Mat::CreateIterator endrow = istlA.createend();
-                for (typename Mat::CreateIterator row = istlA.createbegin(); row != endrow; ++row) {
-                    const int ri = row.index();
-                    for (int i = ia[ri]; i < ia[ri + 1]; ++i) {
-                        row.insert(ja[i]);
-                    }
-                }
-            }
-
-            /*
-            // not neeeded since MatrixBlock initially zeros all elements during construction
-            // Set all blocks to zero.
-            for (auto row = istlA.begin(), rowend = istlA.end(); row != rowend; ++row ) {
-                for (auto col = row->begin(), colend = row->end(); col != colend; ++col ) {
-                    *col = 0.0;
-                }
-            }
-            */
-
-            /**
-             * Go through all jacobians, and insert in correct spot
-             *
-             * The straight forward way to do this would be to run through each
-             * element in the output matrix, and set all block entries by gathering
-             * from all "input matrices" (derivatives).
-             *
-             * A faster alternative is to instead run through each "input matrix" and
-             * insert its elements in the correct spot in the output matrix.
-             *
-             */
-            for (int p1 = 0; p1 < np; ++p1) {
-                for (int p2 = 0; p2 < np; ++p2) {
-                    // Note that that since these are CSC and not CSR matrices,
-                    // ja contains row numbers instead of column numbers.
-                    const AutoDiffMatrix::SparseRep& s = eqs[p1].derivative()[p2].getSparse();
-                    const int* ia = s.outerIndexPtr();
-                    const int* ja = s.innerIndexPtr();
-                    const double* sa = s.valuePtr();
-                    for (int col = 0; col < size; ++col) {
-                        for (int elem_ix = ia[col]; elem_ix < ia[col + 1]; ++elem_ix) {
-                            const int row = ja[elem_ix];
-                            istlA[row][col][p1][p2] = sa[elem_ix];
-                        }
-                    }
-                }
-            }
-        }
-
+        /// \copydoc NewtonIterationBlackoilInterface::prepareStep
+        void prepareStep() const { istlSolver_.prepareStep(); }
 
         /// Solve the linear system Ax = b, with A being the
         /// combined derivative matrix of the residual and b
@@ -202,7 +116,6 @@ namespace Opm
         SolutionVector computeNewtonIncrement(const LinearisedBlackoilResidual& residual) const
         {
             typedef LinearisedBlackoilResidual::ADB  ADB;
-            typedef ADB::V   V;
 
             // Build the vector of equations.
             //const int np = residual.material_balance_eq.size();
@@ -215,78 +128,77 @@ namespace Opm
 
             // check if wells are present
             const bool hasWells = residual.well_flux_eq.size() > 0 ;
-            std::vector<ADB> elim_eqs;
+            std::unique_ptr<WellSchurComplement> well_elimination;
             if( hasWells )
             {
                 eqs.push_back(residual.well_flux_eq);
                 eqs.push_back(residual.well_eq);
 
-                // Eliminate the well-related unknowns, and corresponding equations.
-                elim_eqs.reserve(2);
-                elim_eqs.push_back(eqs[np]);
-                eqs = eliminateVariable(eqs, np); // Eliminate well flux unknowns.
-                elim_eqs.push_back(eqs[np]);
-                eqs = eliminateVariable(eqs, np); // Eliminate well bhp unknowns.
+                // Eliminate the well-related unknowns, and corresponding equations,
+                // by a Schur complement formed well by well.
+                well_elimination.reset(new WellSchurComplement(eqs, np));
+                eqs = well_elimination->reducedEquations();
                 assert(int(eqs.size()) == np);
             }
 
-            // Scale material balance equations.
-            for (int phase = 0; phase < np; ++phase) {
-                eqs[phase] = eqs[phase] * residual.matbalscale[phase];
-            }
-
-            // calculating the size for b
-            int size_b = 0;
-            for (int elem = 0; elem < np; ++elem) {
-                const int loc_size = eqs[elem].size();
-                size_b += loc_size;
+            // ISTL matrix with interleaved rows and columns (block
+            // structured), with one np x np block per cell connection. The
+            // block pattern and the ISTL matrix are kept between calls, and
+            // the scaled jacobians are written straight into the ISTL
+            // blocks. Only if the pattern has changed (for instance when
+            // wells are opened) is it rebuilt, through the block compressed
+            // form of the jacobians.
+            const bool same_pattern = istlA_ && jacobian_.fillMatrix(eqs, residual.matbalscale, *istlA_);
+            if (!same_pattern) {
+                jacobian_.assign(eqs, parameters_.require_full_sparsity_pattern_);
+                for (int phase = 0; phase < np; ++phase) {
+                    jacobian_.scaleEquation(phase, residual.matbalscale[phase]);
+                }
+                istlA_.reset(new Mat());
+                jacobian_.copyTo(*istlA_);
+                istlSolver_.invalidatePreconditioner();
             }
+            const int size = istlA_->N();
 
-            V b(size_b);
-
-            int pos = 0;
+            // Right hand side, written directly into the ISTL vector
+            // through a view of its storage as an np x size array.
+            istlb_.resize(size);
+            typedef Eigen::Array<Scalar, np, Eigen::Dynamic> InterleavedArray;
+            Eigen::Map<InterleavedArray> b(size > 0 ? &istlb_[0][0] : nullptr, np, size);
             for (int elem = 0; elem < np; ++elem) {
-                const int loc_size = eqs[elem].size();
-                b.segment(pos, loc_size) = eqs[elem].value();
-                pos += loc_size;
+                assert(eqs[elem].size() == size);
+                b.row(elem) = (eqs[elem].value() * residual.matbalscale[elem]).template cast<Scalar>().transpose();
             }
-            assert(pos == size_b);
-
-            // Create ISTL matrix with interleaved rows and columns (block structured).
-            Mat istlA;
-            formInterleavedSystem(eqs, istlA);
-
-            // Solve reduced system.
-            SolutionVector dx(SolutionVector::Zero(b.size()));
 
-            // Right hand side.
-            const int size = istlA.N();
-            Vector istlb(size);
-            for (int i = 0; i < size; ++i) {
-                for( int p = 0, idx = i; p<np; ++p, idx += size ) {
-                    istlb[i][p] = b(idx);
+            if (capture_ && capture_->selectNextSolve()) {
+                if (same_pattern) {
+                    // The block values are only formed for the capture.
+                    jacobian_.refill(eqs);
+                    for (int phase = 0; phase < np; ++phase) {
+                        jacobian_.scaleEquation(phase, residual.matbalscale[phase]);
+                    }
                 }
+                capture_->write(captureLinearSystem(jacobian_, size > 0 ? &istlb_[0][0] : static_cast<const Scalar*>(nullptr), hasWells));
             }
 
             // System solution
-            Vector x(istlA.M());
-            x = 0.0;
+            x_.resize(istlA_->M());
+            x_ = 0.0;
 
             // solve linear system using ISTL methods
-            istlSolver_.solve( istlA, x, istlb );
+            istlSolver_.setLinearSolverReduction( residual.linearSolverReduction );
+            istlSolver_.solve( *istlA_, x_, istlb_ );
 
             // Copy solver output to dx.
-            for (int i = 0; i < size; ++i) {
-                for( int p=0, idx = i; p<np; ++p, idx += size ) {
-                    dx(idx) = x[i][p];
-                }
+            SolutionVector dx(np * size);
+            const Eigen::Map<const InterleavedArray> x(size > 0 ? &x_[0][0] : nullptr, np, size);
+            for (int elem = 0; elem < np; ++elem) {
+                dx.segment(elem * size, size) = x.row(elem).transpose().template cast<double>();
             }
 
             if ( hasWells ) {
                 // Compute full solution using the eliminated equations.
-                // Recovery in inverse order of elimination.
-                dx = recoverVariable(elim_eqs[1], dx, np);
-                dx = recoverVariable(elim_eqs[0], dx, np);
+                dx = well_elimination->recover(dx);
             }
             return dx;
         }
@@ -294,6 +206,13 @@ namespace Opm
     protected:
         ISTLSolverType istlSolver_;
         NewtonIterationBlackoilInterleavedParameters parameters_;
+        LinearSystemCapture* capture_;
+
+        // Linear system storage kept between calls.
+        mutable BlockSparseJacobian<np> jacobian_;
+        mutable std::unique_ptr<Mat> istlA_;
+        mutable Vector istlb_;
+        mutable Vector x_;
     }; // end NewtonIterationBlackoilInterleavedImpl
 
 
@@ -304,6 +223,11 @@ namespace Opm
       : newtonIncrementDoublePrecision_(),
         newtonIncrementSinglePrecision_(),
         parameters_( param ),
+        reuseParameters_( param ),
+        mixedPrecision_( param.getDefault("linear_solver_mixed_precision", false) ),
+        recycleParameters_( param ),
+        cprParameters_( param ),
+        capture_( LinearSystemCaptureParameters( param ), LinearSystemCapture::processRank( parallelInformation_arg ) ),
         parallelInformation_(parallelInformation_arg),
         iterations_( 0 )
     {
@@ -318,6 +242,11 @@ namespace Opm
             static const NewtonIterationBlackoilInterface&
             get( NewtonIncVector& newtonIncrements,
                  const NewtonIterationBlackoilInterleavedParameters& param,
+                 const PreconditionerReuseParameters& reuseParam,
+                 const bool mixedPrecision,
+                 const KrylovRecyclingParameters& recycleParam,
+                 const CPRParameter& cprParam,
+                 LinearSystemCapture& capture,
                  const boost::any& parallelInformation,
                  const int np )
             {
@@ -326,12 +255,12 @@ namespace Opm
                     assert( np < int(newtonIncrements.size()) );
                     // create NewtonIncrement with fixed np
                     if( ! newtonIncrements[ NP ] )
-                        newtonIncrements[ NP ].reset( new NewtonIterationBlackoilInterleavedImpl< NP, Scalar >( param, parallelInformation ) );
+                        newtonIncrements[ NP ].reset( new NewtonIterationBlackoilInterleavedImpl< NP, Scalar >( param, parallelInformation, reuseParam, mixedPrecision, recycleParam, cprParam, &capture ) );
                     return *(newtonIncrements[ NP ]);
                 }
                 else
                 {
-                    return NewtonIncrement< NP-1, Scalar >::get(newtonIncrements, param, parallelInformation, np );
+                    return NewtonIncrement< NP-1, Scalar >::get(newtonIncrements, param, reuseParam, mixedPrecision, recycleParam, cprParam, capture, parallelInformation, np );
                 }
             }
         };
@@ -343,6 +272,11 @@ namespace Opm
             static const NewtonIterationBlackoilInterface&
             get( NewtonIncVector&,
                  const NewtonIterationBlackoilInterleavedParameters&,
+                 const PreconditionerReuseParameters&,
+                 const bool,
+                 const KrylovRecyclingParameters&,
+                 const CPRParameter&,
+                 LinearSystemCapture&,
                  const boost::any&,
                  const int np )
             {
@@ -355,7 +289,8 @@ namespace Opm
 
 
         std::pair<NewtonIterationBlackoilInterleaved::SolutionVector, Dune::InverseOperatorResult>
-        computePressureIncrement(const LinearisedBlackoilResidual& residual)
+        computePressureIncrement(const LinearisedBlackoilResidual& residual,
+                                 LinearSystemCapture& capture)
         {
             typedef LinearisedBlackoilResidual::ADB ADB;
 
@@ -371,16 +306,13 @@ namespace Opm
 
             // Check if wells are present.
             const bool hasWells = residual.well_flux_eq.size() > 0 ;
-            std::vector<ADB> elim_eqs;
+            std::unique_ptr<WellSchurComplement> well_elimination;
             if (hasWells) {
                 // Eliminate the well-related unknowns, and corresponding equations.
                 eqs.push_back(residual.well_flux_eq);
                 eqs.push_back(residual.well_eq);
-                elim_eqs.reserve(2);
-                elim_eqs.push_back(eqs[np]);
-                eqs = eliminateVariable(eqs, np); // Eliminate well flux unknowns.
-                elim_eqs.push_back(eqs[np]);
-                eqs = eliminateVariable(eqs, np); // Eliminate well bhp unknowns.
+                well_elimination.reset(new WellSchurComplement(eqs, np));
+                eqs = well_elimination->reducedEquations();
                 assert(int(eqs.size()) == np);
             }
 
@@ -397,6 +329,10 @@ namespace Opm
             b = 0.0;
             std::copy_n(eqs[0].value().data(), size, b.begin());
 
+            if (capture.selectNextSolve()) {
+                capture.write(captureLinearSystem(eigenA, eqs[0].value(), hasWells));
+            }
+
             // Solve with AMG solver.
             typedef Dune::BCRSMatrix<Dune::FieldMatrix<double, 1, 1> > Mat;
             typedef Dune::MatrixAdapter<Mat, Vector1, Vector1> Operator;
@@ -429,7 +365,7 @@ namespace Opm
 
             const int verbosity = 0;
             const int maxit = 30;
-            const double tolerance = 1e-5;
+            const double tolerance = residual.linearSolverReduction > 0.0 ? residual.linearSolverReduction : 1e-5;
 
             // Construct linear solver.
             Dune::BiCGSTABSolver<Vector1> linsolve(sOpA, precond, tolerance, maxit, verbosity);
@@ -453,9 +389,7 @@ namespace Opm
 
             if (hasWells) {
                 // Compute full solution using the eliminated equations.
-                // Recovery in inverse order of elimination.
-                dx = recoverVariable(elim_eqs[1], dx, np);
-                dx = recoverVariable(elim_eqs[0], dx, np);
+                dx = well_elimination->recover(dx);
             }
             return std::make_pair(dx, result);
         }
@@ -470,14 +404,14 @@ namespace Opm
         // get np and call appropriate template method
         const int np = residual.material_balance_eq.size();
         if (np == 1) {
-            auto result = detail::computePressureIncrement(residual);
+            auto result = detail::computePressureIncrement(residual, capture_);
             iterations_ = result.second.iterations;
             return result.first;
         }
 
         const NewtonIterationBlackoilInterface& newtonIncrement = residual.singlePrecision ?
-            detail::NewtonIncrement< maxNumberEquations_, float  > :: get( newtonIncrementSinglePrecision_, parameters_, parallelInformation_, np ) :
-            detail::NewtonIncrement< maxNumberEquations_, double > :: get( newtonIncrementDoublePrecision_, parameters_, parallelInformation_, np );
+            detail::NewtonIncrement< maxNumberEquations_, float  > :: get( newtonIncrementSinglePrecision_, parameters_, reuseParameters_, mixedPrecision_, recycleParameters_, cprParameters_, capture_, parallelInformation_, np ) :
+            detail::NewtonIncrement< maxNumberEquations_, double > :: get( newtonIncrementDoublePrecision_, parameters_, reuseParameters_, mixedPrecision_, recycleParameters_, cprParameters_, capture_, parallelInformation_, np );
 
         // compute newton increment
         SolutionVector dx = newtonIncrement.computeNewtonIncrement( residual );
@@ -491,6 +425,29 @@ namespace Opm
         return parallelInformation_;
     }
 
+    void NewtonIterationBlackoilInterleaved::prepareStep() const
+    {
+        for (const auto& newtonIncrement : newtonIncrementDoublePrecision_) {
+            if (newtonIncrement) {
+                newtonIncrement->prepareStep();
+            }
+        }
+        for (const auto& newtonIncrement : newtonIncrementSinglePrecision_) {
+            if (newtonIncrement) {
+                newtonIncrement->prepareStep();
+            }
+        }
+    }
+
+    bool NewtonIterationBlackoilInterleaved::supportsBlockCPR()
+    {
+#if FLOW_SUPPORT_AMG
+        return true;
+#else
+        return false;
+#endif
+    }
+
 
 
 } // namespace Opm
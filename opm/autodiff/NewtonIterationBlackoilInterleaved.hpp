@@ -30,6 +30,9 @@
 #include <opm/common/utility/parameters/ParameterGroup.hpp>
 #include <opm/autodiff/ParallelOverlappingILU0.hpp>
 #include <opm/autodiff/FlowLinearSolverParameters.hpp>
+#include <opm/autodiff/KrylovRecycling.hpp>
+#include <opm/autodiff/LinearSystemCapture.hpp>
+#include <opm/autodiff/PreconditionerReuse.hpp>
 
 #include <ewoms/common/parametersystem.hh>
 
@@ -68,6 +71,15 @@ namespace Opm
         /// \copydoc NewtonIterationBlackoilInterface::parallelInformation
         virtual const boost::any& parallelInformation() const;
 
+        /// \copydoc NewtonIterationBlackoilInterface::prepareStep
+        virtual void prepareStep() const;
+
+        /// True if this build supports the block CPR preconditioner
+        /// (parameter use_cpr, set by solver_approach=cpr_block, and
+        /// controlled by the cpr_* parameters), which needs the Dune
+        /// AMG. The AMG is not available in builds with UMFPACK.
+        static bool supportsBlockCPR();
+
     private:
         // max number of equations supported, increase if necessary
         static const int maxNumberEquations_ = 6 ;
@@ -75,6 +87,11 @@ namespace Opm
         mutable std::array< std::unique_ptr< NewtonIterationBlackoilInterface >, maxNumberEquations_+1 > newtonIncrementDoublePrecision_;
         mutable std::array< std::unique_ptr< NewtonIterationBlackoilInterface >, maxNumberEquations_+1 > newtonIncrementSinglePrecision_;
         NewtonIterationBlackoilInterleavedParameters parameters_;
+        PreconditionerReuseParameters reuseParameters_;
+        bool mixedPrecision_;
+        KrylovRecyclingParameters recycleParameters_;
+        CPRParameter cprParameters_;
+        mutable LinearSystemCapture capture_;
         boost::any parallelInformation_;
         mutable int iterations_;
     };
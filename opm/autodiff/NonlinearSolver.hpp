@@ -49,6 +49,15 @@ namespace Opm {
             double         relax_rel_tol_;
             int            max_iter_; // max nonlinear iterations
             int            min_iter_; // min nonlinear iterations
+            bool           use_line_search_;        // backtracking line search on the updates
+            int            line_search_max_cuts_;   // max number of step length reductions
+            double         line_search_cut_factor_; // step length reduction factor
+            double         line_search_armijo_;     // sufficient decrease parameter
+            bool           use_inexact_newton_;     // linear tolerance from the residual history
+            double         inexact_newton_eta_max_; // largest linear tolerance
+            double         inexact_newton_eta_min_; // smallest linear tolerance
+            double         inexact_newton_gamma_;   // Eisenstat-Walker gamma
+            double         inexact_newton_alpha_;   // Eisenstat-Walker exponent
 
             explicit SolverParameters( const ParameterGroup& param );
             SolverParameters();
@@ -174,6 +183,38 @@ namespace Opm {
         /// The minimum number of nonlinear iterations allowed.
         int minIter() const              { return param_.min_iter_; }
 
+        /// Whether nonlinear updates should be subject to a line search.
+        bool useLineSearch() const       { return param_.use_line_search_; }
+
+        /// Backtracking line search along a nonlinear update.
+        /// Starting from the full update, the step length is reduced by
+        /// the cut factor until the Armijo condition
+        ///     merit(alpha) <= (1 - c*alpha) * merit(0)
+        /// is satisfied. If that does not happen within the maximum number
+        /// of cuts, no step is accepted, and the caller must decide how to
+        /// proceed.
+        /// \param[in] merit   callable returning the merit (typically a
+        ///                    residual norm) after an update scaled by alpha,
+        ///                    relative to the merit of the current state
+        /// \return            accepted step length alpha in (0, 1], or 0
+        ///                    if no step length was accepted
+        template <class MeritFunction>
+        double lineSearch(const MeritFunction& merit) const;
+
+        /// Whether the linear tolerance should follow the nonlinear convergence.
+        bool useInexactNewton() const    { return param_.use_inexact_newton_; }
+
+        /// Relative linear tolerance for the next Newton update, chosen by
+        /// the Eisenstat-Walker rule (choice 2)
+        ///     eta_k = gamma * (|F_k| / |F_k-1|)^alpha,
+        /// where |F| is the Euclidean norm of the phase residual norms.
+        /// To avoid a sudden drop, eta_k is at least gamma * eta_k-1^alpha
+        /// when that exceeds 0.1. The tolerance is kept within
+        /// [eta_min, eta_max], and is eta_max for the first iteration.
+        /// \param[in] residual_history  residual norms of each iteration so
+        ///                              far, including the current one
+        double linearTolerance(const std::vector<std::vector<double>>& residual_history) const;
+
         /// Set parameters to override those given at construction time.
         void setParameters(const SolverParameters& param) { param_ = param; }
 
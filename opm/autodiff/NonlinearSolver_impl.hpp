@@ -27,6 +27,9 @@
 #include <opm/common/Exceptions.hpp>
 #include <opm/common/ErrorMacros.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace Opm
 {
     template <class PhysicalModel>
@@ -186,6 +189,15 @@ namespace Opm
         relax_rel_tol_   = 0.2;
         max_iter_        = 10;
         min_iter_        = 1;
+        use_line_search_        = false;
+        line_search_max_cuts_   = 4;
+        line_search_cut_factor_ = 0.5;
+        line_search_armijo_     = 1.0e-4;
+        use_inexact_newton_     = false;
+        inexact_newton_eta_max_ = 0.5;
+        inexact_newton_eta_min_ = 1.0e-4;
+        inexact_newton_gamma_   = 0.9;
+        inexact_newton_alpha_   = 2.0;
     }
 
     template <class PhysicalModel>
@@ -207,6 +219,23 @@ namespace Opm
         relax_max_   = param.getDefault("relax_max", relax_max_);
         max_iter_    = param.getDefault("max_iter", max_iter_);
         min_iter_    = param.getDefault("min_iter", min_iter_);
+        use_line_search_        = param.getDefault("use_line_search", use_line_search_);
+        line_search_max_cuts_   = param.getDefault("line_search_max_cuts", line_search_max_cuts_);
+        line_search_cut_factor_ = param.getDefault("line_search_cut_factor", line_search_cut_factor_);
+        line_search_armijo_     = param.getDefault("line_search_armijo", line_search_armijo_);
+        if (line_search_cut_factor_ <= 0.0 || line_search_cut_factor_ >= 1.0) {
+            OPM_THROW(std::runtime_error, "line_search_cut_factor must be in (0, 1), got " << line_search_cut_factor_);
+        }
+        use_inexact_newton_     = param.getDefault("use_inexact_newton", use_inexact_newton_);
+        inexact_newton_eta_max_ = param.getDefault("inexact_newton_eta_max", inexact_newton_eta_max_);
+        inexact_newton_eta_min_ = param.getDefault("inexact_newton_eta_min", inexact_newton_eta_min_);
+        inexact_newton_gamma_   = param.getDefault("inexact_newton_gamma", inexact_newton_gamma_);
+        inexact_newton_alpha_   = param.getDefault("inexact_newton_alpha", inexact_newton_alpha_);
+        if (inexact_newton_eta_min_ <= 0.0 || inexact_newton_eta_min_ > inexact_newton_eta_max_
+            || inexact_newton_eta_max_ >= 1.0) {
+            OPM_THROW(std::runtime_error, "Need 0 < inexact_newton_eta_min <= inexact_newton_eta_max < 1, got "
+                      << inexact_newton_eta_min_ << " and " << inexact_newton_eta_max_);
+        }
 
         std::string relaxation_type = param.getDefault("relax_type", std::string("dampen"));
         if (relaxation_type == "dampen") {
@@ -255,6 +284,38 @@ namespace Opm
     }
 
 
+    template <class PhysicalModel>
+    double
+    NonlinearSolver<PhysicalModel>::linearTolerance(const std::vector<std::vector<double>>& residual_history) const
+    {
+        // The tolerance only depends on the history, so it is recomputed
+        // from the first iteration instead of being stored.
+        const int num_phases = model_->numPhases();
+        auto norm = [num_phases](const std::vector<double>& F) {
+            double sum = 0.0;
+            for (int p = 0; p < num_phases; ++p) {
+                sum += F[p] * F[p];
+            }
+            return std::sqrt(sum);
+        };
+
+        const double gamma = param_.inexact_newton_gamma_;
+        const double alpha = param_.inexact_newton_alpha_;
+        double eta = param_.inexact_newton_eta_max_;
+        for (std::size_t it = 1; it < residual_history.size(); ++it) {
+            const double norm_old = norm(residual_history[it - 1]);
+            const double ratio = norm_old > 0.0 ? norm(residual_history[it]) / norm_old : 0.0;
+            double eta_new = gamma * std::pow(ratio, alpha);
+            const double safeguard = gamma * std::pow(eta, alpha);
+            if (safeguard > 0.1) {
+                eta_new = std::max(eta_new, safeguard);
+            }
+            eta = std::min(std::max(eta_new, param_.inexact_newton_eta_min_), param_.inexact_newton_eta_max_);
+        }
+        return eta;
+    }
+
+
     template <class PhysicalModel>
     template <class BVector>
     void
@@ -295,6 +356,22 @@ namespace Opm
 
         return;
     }
+
+    template <class PhysicalModel>
+    template <class MeritFunction>
+    double
+    NonlinearSolver<PhysicalModel>::lineSearch(const MeritFunction& merit) const
+    {
+        double alpha = 1.0;
+        for (int cut = 0; cut <= param_.line_search_max_cuts_; ++cut) {
+            const double m = merit(alpha);
+            if (m <= 1.0 - param_.line_search_armijo_ * alpha) {
+                return alpha;
+            }
+            alpha *= param_.line_search_cut_factor_;
+        }
+        return 0.0;
+    }
 } // namespace Opm
 
 
@@ -0,0 +1,156 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_PRECONDITIONERREUSE_HEADER_INCLUDED
+#define OPM_PRECONDITIONERREUSE_HEADER_INCLUDED
+
+#include <opm/common/utility/parameters/ParameterGroup.hpp>
+
+#include <algorithm>
+
+namespace Opm
+{
+
+    /// Parameters controlling the reuse of a preconditioner between
+    /// linear solves.
+    ///
+    /// A reused preconditioner is stale: it approximates the matrix it was
+    /// set up for, not the current one. Only the coarse level matrices of
+    /// a double precision AMG in ISTLSolver are recomputed from the current
+    /// matrix; its aggregates and smoothers are kept. ILU0 factors, the
+    /// single precision copy of the matrix and its preconditioner (mixed
+    /// precision), and the whole CPR preconditioner of
+    /// NewtonIterationBlackoilCPR keep the values of the setup matrix.
+    /// Reuse therefore trades convergence for setup time, and is off by
+    /// default.
+    struct PreconditionerReuseParameters
+    {
+        /// Maximum number of solves that reuse a preconditioner after the
+        /// one it was set up for. Zero (the default) sets up the
+        /// preconditioner for every solve.
+        int max_reuse_;
+        /// The preconditioner is set up again when a solve needs more than
+        /// this factor times the linear iterations of the first solve with
+        /// the current preconditioner.
+        double iteration_growth_;
+
+        /// Construct with reuse disabled.
+        PreconditionerReuseParameters()
+        {
+            reset();
+        }
+
+        /// Construct from user parameters or defaults.
+        explicit PreconditionerReuseParameters(const ParameterGroup& param)
+        {
+            reset();
+            max_reuse_ = param.getDefault("preconditioner_reuse_max", max_reuse_);
+            iteration_growth_ = param.getDefault("preconditioner_reuse_iteration_growth", iteration_growth_);
+        }
+
+        /// Set default values.
+        void reset()
+        {
+            max_reuse_ = 0;
+            iteration_growth_ = 2.0;
+        }
+    };
+
+
+
+    /// Bookkeeping for reusing a preconditioner between linear solves.
+    ///
+    /// A linear solver asks needsSetup() before each solve, calls
+    /// setupDone() when it has set up the preconditioner, and reports the
+    /// number of linear iterations of each solve with solveDone().
+    class PreconditionerReusePolicy
+    {
+    public:
+        explicit PreconditionerReusePolicy(const PreconditionerReuseParameters& param = PreconditionerReuseParameters())
+            : param_(param),
+              valid_(false),
+              uses_(0),
+              first_iterations_(0),
+              last_iterations_(0)
+        {
+        }
+
+        /// True if preconditioners may be reused at all.
+        bool enabled() const
+        {
+            return param_.max_reuse_ > 0;
+        }
+
+        /// True if the preconditioner must be set up before the next solve.
+        bool needsSetup() const
+        {
+            if (!valid_ || !enabled()) {
+                return true;
+            }
+            if (uses_ > param_.max_reuse_) {
+                return true;
+            }
+            return uses_ > 1
+                && last_iterations_ > param_.iteration_growth_ * std::max(first_iterations_, 1);
+        }
+
+        /// True if the current preconditioner has been used in an earlier
+        /// solve, i.e. was not set up for the next one.
+        bool reused() const
+        {
+            return valid_ && uses_ > 0;
+        }
+
+        /// Record that the preconditioner was set up.
+        void setupDone()
+        {
+            valid_ = true;
+            uses_ = 0;
+            first_iterations_ = 0;
+            last_iterations_ = 0;
+        }
+
+        /// Record a solve with the current preconditioner.
+        void solveDone(const int iterations)
+        {
+            if (uses_ == 0) {
+                first_iterations_ = iterations;
+            }
+            last_iterations_ = iterations;
+            ++uses_;
+        }
+
+        /// Require a new setup before the next solve, e.g. because the
+        /// matrix pattern has changed.
+        void invalidate()
+        {
+            valid_ = false;
+        }
+
+    private:
+        PreconditionerReuseParameters param_;
+        bool valid_;
+        int uses_;
+        int first_iterations_;
+        int last_iterations_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_PRECONDITIONERREUSE_HEADER_INCLUDED
@@ -326,7 +326,8 @@ namespace Opm
                                                                    props,
                                                                    use_segregation_split_ ? gravity : NULL,
                                                                    param.getDefault("nl_tolerance", 1e-9),
-                                                                   param.getDefault("nl_maxiter", 30)));
+                                                                   param.getDefault("nl_maxiter", 30),
+                                                                   param.getDefault("reorder_threads", false)));
 
         } else if (transport_solver_type_ == "ad") {
             if (rock_comp_props && rock_comp_props->isActive()) {
@@ -0,0 +1,444 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_SPARSITYPATTERNCACHE_HEADER_INCLUDED
+#define OPM_SPARSITYPATTERNCACHE_HEADER_INCLUDED
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <Eigen/Sparse>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <opm/autodiff/AutoDiffArena.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Cache of the symbolic phase of sparse matrix products and sums.
+    ///
+    /// The sparsity patterns of the grid operators (grad, div, caver,
+    /// upwind selection) are the same in every Newton iteration and time
+    /// step, and so are the patterns of most products and sums formed
+    /// with them. When enabled, the result pattern of a product or sum is
+    /// stored together with the patterns of its operands, and subsequent
+    /// operations with identical operand patterns only redo the numerical
+    /// phase into the known output structure.
+    ///
+    /// Patterns are looked up through a structural signature of the
+    /// operands (dimensions, number of nonzeros and a fixed number of
+    /// sampled indices), which costs O(1) per operand. A candidate is
+    /// verified by comparing the index arrays before use, since e.g.
+    /// upwind selection matrices keep their dimensions and number of
+    /// nonzeros when the flow changes direction; that comparison is a
+    /// single contiguous pass with early exit. Neither storage addresses
+    /// nor object identity are used, as both are reused for different
+    /// patterns once temporaries are freed. The cache is kept per
+    /// thread, with a bounded number of entries replaced in least
+    /// recently used order. The lookup counters are kept per thread as
+    /// well, so that counting does not contend on shared cache lines, and
+    /// summed when queried.
+    ///
+    /// Note that the cached patterns are structural: entries of the result
+    /// which are numerically zero are stored explicitly, in contrast to
+    /// fastSparseProduct() which drops them.
+    class SparsityPatternCache
+    {
+    public:
+        typedef Eigen::SparseMatrix<double> Sparse;
+
+        /// Lookup counters.
+        struct Statistics
+        {
+            std::size_t hits;
+            std::size_t misses;
+        };
+
+        /// Select whether the cache should be used.
+        static void setEnabled(const bool enabled)
+        {
+            state().enabled = enabled;
+        }
+
+        /// Whether the cache should be used.
+        static bool enabled()
+        {
+            return state().enabled;
+        }
+
+        /// Maximum number of cached patterns per thread.
+        static void setCapacity(const std::size_t capacity)
+        {
+            state().capacity = std::max(std::size_t(1), capacity);
+        }
+
+        /// Reset the lookup counters.
+        static void resetStatistics()
+        {
+            GlobalState& gs = state();
+            std::lock_guard<std::mutex> lock(gs.mutex);
+            gs.totals(gs.base_hits, gs.base_misses);
+        }
+
+        /// Lookup counters since the last call to resetStatistics().
+        static Statistics statistics()
+        {
+            GlobalState& gs = state();
+            std::lock_guard<std::mutex> lock(gs.mutex);
+            Statistics s;
+            gs.totals(s.hits, s.misses);
+            s.hits -= gs.base_hits;
+            s.misses -= gs.base_misses;
+            return s;
+        }
+
+        /// Compute res = lhs * rhs, reusing a cached result pattern if possible.
+        static void product(const Sparse& lhs, const Sparse& rhs, Sparse& res)
+        {
+            assert(lhs.cols() == rhs.rows());
+            assert(lhs.isCompressed() && rhs.isCompressed());
+            const Entry& entry = lookup(Product, lhs, rhs);
+            entry.result.shape(res);
+
+            const int cols = rhs.cols();
+            const int* ri = res.outerIndexPtr();
+            const int* rj = res.innerIndexPtr();
+            double* rv = res.valuePtr();
+            std::vector<int, AutoDiffArenaAllocator<int> > pos(lhs.rows());
+            for (int j = 0; j < cols; ++j) {
+                for (int k = ri[j]; k < ri[j + 1]; ++k) {
+                    pos[rj[k]] = k;
+                }
+                for (Sparse::InnerIterator rhsIt(rhs, j); rhsIt; ++rhsIt) {
+                    const double y = rhsIt.value();
+                    for (Sparse::InnerIterator lhsIt(lhs, rhsIt.index()); lhsIt; ++lhsIt) {
+                        rv[pos[lhsIt.index()]] += lhsIt.value() * y;
+                    }
+                }
+            }
+        }
+
+        /// Compute res = lhs + rhs, reusing a cached result pattern if possible.
+        static void sum(const Sparse& lhs, const Sparse& rhs, Sparse& res)
+        {
+            assert(lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols());
+            assert(lhs.isCompressed() && rhs.isCompressed());
+            const Entry& entry = lookup(Sum, lhs, rhs);
+            // Copy the operands so that res may alias one of them.
+            Sparse result;
+            entry.result.shape(result);
+
+            const int cols = lhs.cols();
+            const int* ri = result.outerIndexPtr();
+            const int* rj = result.innerIndexPtr();
+            double* rv = result.valuePtr();
+            for (int j = 0; j < cols; ++j) {
+                int k = ri[j];
+                for (Sparse::InnerIterator it(lhs, j); it; ++it) {
+                    while (rj[k] != it.index()) {
+                        ++k;
+                    }
+                    rv[k] += it.value();
+                }
+                k = ri[j];
+                for (Sparse::InnerIterator it(rhs, j); it; ++it) {
+                    while (rj[k] != it.index()) {
+                        ++k;
+                    }
+                    rv[k] += it.value();
+                }
+            }
+            res.swap(result);
+        }
+
+        /// Drop all patterns cached by the calling thread.
+        static void clear()
+        {
+            threadCache().entries.clear();
+        }
+
+    private:
+        enum Operation { Product, Sum };
+
+        struct Pattern
+        {
+            int rows;
+            int cols;
+            std::vector<int> outer;
+            std::vector<int> inner;
+
+            Pattern()
+                : rows(0), cols(0)
+            {
+            }
+
+            explicit Pattern(const Sparse& m)
+                : rows(m.rows()),
+                  cols(m.cols()),
+                  outer(m.outerIndexPtr(), m.outerIndexPtr() + m.outerSize() + 1),
+                  inner(m.innerIndexPtr(), m.innerIndexPtr() + m.nonZeros())
+            {
+            }
+
+            // The caller must have checked the dimensions and the number
+            // of nonzeros, through the signature.
+            bool matches(const Sparse& m) const
+            {
+                return std::equal(outer.begin(), outer.end(), m.outerIndexPtr())
+                    && std::equal(inner.begin(), inner.end(), m.innerIndexPtr());
+            }
+
+            // Set m to this pattern with all values zero.
+            void shape(Sparse& m) const
+            {
+                m.resize(rows, cols);
+                m.resizeNonZeros(inner.size());
+                std::copy(outer.begin(), outer.end(), m.outerIndexPtr());
+                std::copy(inner.begin(), inner.end(), m.innerIndexPtr());
+                std::fill(m.valuePtr(), m.valuePtr() + inner.size(), 0.0);
+            }
+        };
+
+        struct Signature
+        {
+            int rows;
+            int cols;
+            int nnz;
+            std::uint64_t samples;
+
+            bool operator==(const Signature& other) const
+            {
+                return rows == other.rows && cols == other.cols
+                    && nnz == other.nnz && samples == other.samples;
+            }
+        };
+
+        struct Entry
+        {
+            Operation op;
+            Signature lhs_signature;
+            Signature rhs_signature;
+            Pattern lhs;
+            Pattern rhs;
+            Pattern result;
+            std::uint64_t last_use;
+        };
+
+        struct ThreadCache
+        {
+            ThreadCache()
+                : clock(0), hits(0), misses(0)
+            {
+                GlobalState& gs = state();
+                std::lock_guard<std::mutex> lock(gs.mutex);
+                gs.caches.push_back(this);
+            }
+
+            ~ThreadCache()
+            {
+                GlobalState& gs = state();
+                std::lock_guard<std::mutex> lock(gs.mutex);
+                gs.retired_hits += hits;
+                gs.retired_misses += misses;
+                gs.caches.erase(std::find(gs.caches.begin(), gs.caches.end(), this));
+            }
+
+            // Only the owning thread writes the counters, so a relaxed
+            // load and store is enough, and cheaper than fetch_add().
+            static void increment(std::atomic<std::size_t>& counter)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_relaxed);
+            }
+
+            std::vector<Entry> entries;
+            std::uint64_t clock;
+            std::atomic<std::size_t> hits;
+            std::atomic<std::size_t> misses;
+        };
+
+        // The counters of all threads only ever grow; statistics() reports
+        // their sum relative to the sum at the last resetStatistics().
+        struct GlobalState
+        {
+            GlobalState()
+                : enabled(false), capacity(32),
+                  retired_hits(0), retired_misses(0),
+                  base_hits(0), base_misses(0)
+            {
+            }
+
+            // Sum of the counters of all threads, also those that have
+            // exited. The mutex must be held.
+            void totals(std::size_t& total_hits, std::size_t& total_misses) const
+            {
+                total_hits = retired_hits;
+                total_misses = retired_misses;
+                for (const ThreadCache* cache : caches) {
+                    total_hits += cache->hits.load(std::memory_order_relaxed);
+                    total_misses += cache->misses.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::atomic<bool> enabled;
+            std::atomic<std::size_t> capacity;
+            std::mutex mutex;
+            std::vector<const ThreadCache*> caches;
+            std::size_t retired_hits;
+            std::size_t retired_misses;
+            std::size_t base_hits;
+            std::size_t base_misses;
+        };
+
+        static GlobalState& state()
+        {
+            static GlobalState gs;
+            return gs;
+        }
+
+        static ThreadCache& threadCache()
+        {
+            static thread_local ThreadCache cache;
+            return cache;
+        }
+
+        static Signature signature(const Sparse& m)
+        {
+            enum { NumSamples = 16 };
+            Signature sig;
+            sig.rows = m.rows();
+            sig.cols = m.cols();
+            sig.nnz = m.nonZeros();
+            // FNV-1a over evenly spaced entries of the index arrays.
+            std::uint64_t h = 14695981039346656037ull;
+            auto mix = [&h](const std::uint64_t x) {
+                h ^= x;
+                h *= 1099511628211ull;
+            };
+            const int* outer = m.outerIndexPtr();
+            const int no = m.outerSize() + 1;
+            for (int s = 0; s < NumSamples; ++s) {
+                mix(outer[std::int64_t(s) * (no - 1) / (NumSamples - 1)]);
+            }
+            const int* inner = m.innerIndexPtr();
+            if (sig.nnz > 0) {
+                for (int s = 0; s < NumSamples; ++s) {
+                    mix(inner[std::int64_t(s) * (sig.nnz - 1) / (NumSamples - 1)]);
+                }
+            }
+            sig.samples = h;
+            return sig;
+        }
+
+        static const Entry& lookup(const Operation op, const Sparse& lhs, const Sparse& rhs)
+        {
+            ThreadCache& cache = threadCache();
+            const Signature lhs_signature = signature(lhs);
+            const Signature rhs_signature = signature(rhs);
+            ++cache.clock;
+            for (Entry& e : cache.entries) {
+                if (e.op == op && e.lhs_signature == lhs_signature && e.rhs_signature == rhs_signature
+                    && e.lhs.matches(lhs) && e.rhs.matches(rhs)) {
+                    e.last_use = cache.clock;
+                    ThreadCache::increment(cache.hits);
+                    return e;
+                }
+            }
+            ThreadCache::increment(cache.misses);
+
+            Entry entry;
+            entry.op = op;
+            entry.lhs_signature = lhs_signature;
+            entry.rhs_signature = rhs_signature;
+            entry.lhs = Pattern(lhs);
+            entry.rhs = Pattern(rhs);
+            entry.result = (op == Product) ? productPattern(lhs, rhs) : sumPattern(lhs, rhs);
+            entry.last_use = cache.clock;
+
+            if (cache.entries.size() < state().capacity) {
+                cache.entries.push_back(std::move(entry));
+                return cache.entries.back();
+            }
+            auto lru = std::min_element(cache.entries.begin(), cache.entries.end(),
+                                        [](const Entry& a, const Entry& b) { return a.last_use < b.last_use; });
+            *lru = std::move(entry);
+            return *lru;
+        }
+
+        // Structural pattern of lhs * rhs.
+        static Pattern productPattern(const Sparse& lhs, const Sparse& rhs)
+        {
+            Pattern p;
+            p.rows = lhs.rows();
+            p.cols = rhs.cols();
+            p.outer.resize(p.cols + 1);
+            p.inner.reserve(lhs.nonZeros() + rhs.nonZeros());
+            std::vector<bool> mask(p.rows, false);
+            p.outer[0] = 0;
+            for (int j = 0; j < p.cols; ++j) {
+                const std::size_t start = p.inner.size();
+                for (Sparse::InnerIterator rhsIt(rhs, j); rhsIt; ++rhsIt) {
+                    for (Sparse::InnerIterator lhsIt(lhs, rhsIt.index()); lhsIt; ++lhsIt) {
+                        const int i = lhsIt.index();
+                        if (!mask[i]) {
+                            mask[i] = true;
+                            p.inner.push_back(i);
+                        }
+                    }
+                }
+                std::sort(p.inner.begin() + start, p.inner.end());
+                for (std::size_t k = start; k < p.inner.size(); ++k) {
+                    mask[p.inner[k]] = false;
+                }
+                p.outer[j + 1] = p.inner.size();
+            }
+            return p;
+        }
+
+        // Structural pattern of lhs + rhs.
+        static Pattern sumPattern(const Sparse& lhs, const Sparse& rhs)
+        {
+            Pattern p;
+            p.rows = lhs.rows();
+            p.cols = lhs.cols();
+            p.outer.resize(p.cols + 1);
+            p.inner.reserve(lhs.nonZeros() + rhs.nonZeros());
+            p.outer[0] = 0;
+            const int* li = lhs.innerIndexPtr();
+            const int* ri = rhs.innerIndexPtr();
+            for (int j = 0; j < p.cols; ++j) {
+                std::set_union(li + lhs.outerIndexPtr()[j], li + lhs.outerIndexPtr()[j + 1],
+                               ri + rhs.outerIndexPtr()[j], ri + rhs.outerIndexPtr()[j + 1],
+                               std::back_inserter(p.inner));
+                p.outer[j + 1] = p.inner.size();
+            }
+            return p;
+        }
+    };
+
+} // namespace Opm
+
+#endif // OPM_SPARSITYPATTERNCACHE_HEADER_INCLUDED
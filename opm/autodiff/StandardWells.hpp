@@ -55,6 +55,7 @@ namespace Opm {
                 Eigen::SparseMatrix<double> w2p;              // well -> perf (scatter)
                 Eigen::SparseMatrix<double> p2w;              // perf -> well (gather)
                 std::vector<int> well_cells;                  // the set of perforated cells
+                SubsetPlan well_cells_plan;                   // subset()/superset() plan for well_cells, set by init()
             };
 
             // ---------      Types      ---------
@@ -209,7 +210,7 @@ namespace Opm {
         protected:
             bool wells_active_;
             const Wells*   wells_;
-            const WellOps  wops_;
+            WellOps  wops_;
             // It will probably need to be updated during running time.
             WellCollection* well_collection_;
 
@@ -105,6 +105,7 @@ namespace Opm
         phase_condition_ = pc_arg;
         vfp_properties_ = vfp_properties_arg;
         gravity_ = gravity_arg;
+        wops_.well_cells_plan = SubsetPlan(wops_.well_cells, depth_arg.size());
         perf_cell_depth_ = subset(depth_arg, wellOps().well_cells);;
 
         calculateEfficiencyFactors();
@@ -247,7 +248,7 @@ namespace Opm
         const std::vector<int>& well_cells = wellOps().well_cells;
 
         // Use cell values for the temperature as the wells don't knows its temperature yet.
-        const ADB perf_temp = subset(state.temperature, well_cells);
+        const ADB perf_temp = subset(state.temperature, wellOps().well_cells_plan);
 
         // Compute b, rsmax, rvmax values for perforations.
         // Evaluate the properties using average well block pressures
@@ -267,12 +268,12 @@ namespace Opm
         assert((*active_)[Oil]);
         const Vector perf_so =  subset(state.saturation[pu.phase_pos[Oil]].value(), well_cells);
         if (pu.phase_used[BlackoilPhases::Liquid]) {
-            const ADB perf_rs = (state.rs.size() > 0) ? subset(state.rs, well_cells) : ADB::null();
+            const ADB perf_rs = (state.rs.size() > 0) ? subset(state.rs, wellOps().well_cells_plan) : ADB::null();
             const Vector bo = fluid_->bOil(avg_press_ad, perf_temp, perf_rs, perf_cond, well_cells).value();
             b.col(pu.phase_pos[BlackoilPhases::Liquid]) = bo;
         }
         if (pu.phase_used[BlackoilPhases::Vapour]) {
-            const ADB perf_rv = (state.rv.size() > 0) ? subset(state.rv, well_cells) : ADB::null();
+            const ADB perf_rv = (state.rv.size() > 0) ? subset(state.rv, wellOps().well_cells_plan) : ADB::null();
             const Vector bg = fluid_->bGas(avg_press_ad, perf_temp, perf_rv, perf_cond, well_cells).value();
             b.col(pu.phase_pos[BlackoilPhases::Vapour]) = bg;
         }
@@ -382,8 +383,8 @@ namespace Opm
             mob_perfcells.resize(num_phases, ADB::null());
             b_perfcells.resize(num_phases, ADB::null());
             for (int phase = 0; phase < num_phases; ++phase) {
-                mob_perfcells[phase] = subset(rq[phase].mob, well_cells);
-                b_perfcells[phase] = subset(rq[phase].b, well_cells);
+                mob_perfcells[phase] = subset(rq[phase].mob, wellOps().well_cells_plan);
+                b_perfcells[phase] = subset(rq[phase].b, wellOps().well_cells_plan);
             }
         }
     }
@@ -413,7 +414,7 @@ namespace Opm
         // pressure diffs computed already (once per step, not changing per iteration)
         const Vector& cdp = wellPerforationPressureDiffs();
         // Extract needed quantities for the perforation cells
-        const ADB& p_perfcells = subset(state.pressure, well_cells);
+        const ADB& p_perfcells = subset(state.pressure, wellOps().well_cells_plan);
 
         // Perforation pressure
         const ADB perfpressure = (wellOps().w2p * state.bhp) + cdp;
@@ -468,8 +469,8 @@ namespace Opm
             const int gaspos = pu.phase_pos[Gas];
             const ADB cq_psOil = cq_ps[oilpos];
             const ADB cq_psGas = cq_ps[gaspos];
-            const ADB& rv_perfcells = subset(state.rv, well_cells);
-            const ADB& rs_perfcells = subset(state.rs, well_cells);
+            const ADB& rv_perfcells = subset(state.rv, wellOps().well_cells_plan);
+            const ADB& rs_perfcells = subset(state.rs, wellOps().well_cells_plan);
             cq_ps[gaspos] += rs_perfcells * cq_psOil;
             cq_ps[oilpos] += rv_perfcells * cq_psGas;
         }
@@ -527,8 +528,8 @@ namespace Opm
 
         if ((*active_)[Oil] && (*active_)[Gas]) {
             // Incorporate RS/RV factors if both oil and gas active
-            const ADB& rv_perfcells = subset(state.rv, well_cells);
-            const ADB& rs_perfcells = subset(state.rs, well_cells);
+            const ADB& rv_perfcells = subset(state.rv, wellOps().well_cells_plan);
+            const ADB& rs_perfcells = subset(state.rs, wellOps().well_cells_plan);
             const ADB d = Vector::Constant(nperf,1.0) - rv_perfcells * rs_perfcells;
 
             const int oilpos = pu.phase_pos[Oil];
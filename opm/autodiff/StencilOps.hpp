@@ -0,0 +1,318 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_STENCILOPS_HEADER_INCLUDED
+#define OPM_STENCILOPS_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/autodiff/AutoDiffHelpers.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Matrix-free versions of the two point operators of HelperOps.
+    ///
+    /// The operators ngrad, grad, caver and div of HelperOps are sparse
+    /// matrices with (at most) two nonzeros per connection. This class
+    /// applies the same operators directly as gather and scatter loops
+    /// over the connections (internal faces and non-neighbouring
+    /// connections), both to values and to the Jacobians of AD
+    /// quantities, without going through a generic sparse matrix product.
+    ///
+    /// The results are identical to those obtained with the HelperOps
+    /// matrices, except that the Jacobians may contain explicitly stored
+    /// zeros where contributions cancel.
+    class StencilOps
+    {
+    public:
+        typedef AutoDiffBlock<double> ADB;
+        typedef ADB::V V;
+        typedef ADB::M M;
+
+        /// Construct from the connection structure of ops.
+        explicit StencilOps(const HelperOps& ops)
+            : num_cells_(ops.ngrad.cols()),
+              num_connections_(ops.connection_cells.rows()),
+              conn_(2 * num_connections_)
+        {
+            for (int f = 0; f < num_connections_; ++f) {
+                assert(ops.connection_cells(f, 0) != ops.connection_cells(f, 1));
+                conn_[2*f]     = ops.connection_cells(f, 0);
+                conn_[2*f + 1] = ops.connection_cells(f, 1);
+            }
+
+            // Connections of each cell, in increasing order. This is the
+            // column structure of ngrad.
+            cell_start_.assign(num_cells_ + 1, 0);
+            for (int k = 0; k < 2 * num_connections_; ++k) {
+                ++cell_start_[conn_[k] + 1];
+            }
+            for (int c = 0; c < num_cells_; ++c) {
+                cell_start_[c + 1] += cell_start_[c];
+            }
+            cell_conn_.resize(2 * num_connections_);
+            cell_is_first_.resize(2 * num_connections_);
+            std::vector<int> pos(cell_start_.begin(), cell_start_.end() - 1);
+            for (int f = 0; f < num_connections_; ++f) {
+                for (int side = 0; side < 2; ++side) {
+                    const int k = pos[conn_[2*f + side]]++;
+                    cell_conn_[k] = f;
+                    cell_is_first_[k] = (side == 0);
+                }
+            }
+        }
+
+        /// Number of cells.
+        int numCells() const
+        {
+            return num_cells_;
+        }
+
+        /// Number of connections (internal faces and NNCs).
+        int numConnections() const
+        {
+            return num_connections_;
+        }
+
+        /// For each connection the difference first - second of its cells' values.
+        V ngrad(const V& x) const
+        {
+            return faceOp(1.0, -1.0, x);
+        }
+
+        /// For each connection the difference second - first of its cells' values.
+        V grad(const V& x) const
+        {
+            return faceOp(-1.0, 1.0, x);
+        }
+
+        /// For each connection the average of its cells' values.
+        V caver(const V& x) const
+        {
+            return faceOp(0.5, 0.5, x);
+        }
+
+        /// For each cell the sum of its connections' (signed) values.
+        V div(const V& flux) const
+        {
+            assert(flux.size() == num_connections_);
+            V y(num_cells_);
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+            for (int c = 0; c < num_cells_; ++c) {
+                double sum = 0.0;
+                for (int k = cell_start_[c]; k < cell_start_[c + 1]; ++k) {
+                    const double v = flux[cell_conn_[k]];
+                    sum += cell_is_first_[k] ? v : -v;
+                }
+                y[c] = sum;
+            }
+            return y;
+        }
+
+        /// For each connection the difference first - second of its cells' values.
+        ADB ngrad(const ADB& x) const
+        {
+            return faceOp(1.0, -1.0, x);
+        }
+
+        /// For each connection the difference second - first of its cells' values.
+        ADB grad(const ADB& x) const
+        {
+            return faceOp(-1.0, 1.0, x);
+        }
+
+        /// For each connection the average of its cells' values.
+        ADB caver(const ADB& x) const
+        {
+            return faceOp(0.5, 0.5, x);
+        }
+
+        /// For each cell the sum of its connections' (signed) values.
+        ADB div(const ADB& flux) const
+        {
+            V val = div(flux.value());
+            std::vector<M> jac;
+            jac.reserve(flux.numBlocks());
+            for (const M& fj : flux.derivative()) {
+                jac.push_back(divJacobian(fj));
+            }
+            return ADB::function(std::move(val), std::move(jac));
+        }
+
+    private:
+        int num_cells_;
+        int num_connections_;
+        // Cells of each connection, interleaved (first, second).
+        std::vector<int> conn_;
+        // Connections of each cell, as compressed rows.
+        std::vector<int> cell_start_;
+        std::vector<int> cell_conn_;
+        std::vector<char> cell_is_first_;
+
+        // y[f] = a0 * x[first cell of f] + a1 * x[second cell of f]
+        V faceOp(const double a0, const double a1, const V& x) const
+        {
+            assert(x.size() == num_cells_);
+            V y(num_connections_);
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+            for (int f = 0; f < num_connections_; ++f) {
+                y[f] = a0 * x[conn_[2*f]] + a1 * x[conn_[2*f + 1]];
+            }
+            return y;
+        }
+
+        ADB faceOp(const double a0, const double a1, const ADB& x) const
+        {
+            V val = faceOp(a0, a1, x.value());
+            std::vector<M> jac;
+            jac.reserve(x.numBlocks());
+            for (const M& xj : x.derivative()) {
+                jac.push_back(faceJacobian(a0, a1, xj));
+            }
+            return ADB::function(std::move(val), std::move(jac));
+        }
+
+        // Row f of the result is a0 * (row first(f) of jac) + a1 * (row second(f) of jac).
+        M faceJacobian(const double a0, const double a1, const M& jac) const
+        {
+            assert(jac.rows() == num_cells_);
+            if (jac.nonZeros() == 0) {
+                return M(num_connections_, jac.cols());
+            }
+            const M::SparseRep& s = jac.getSparse();
+            Assembler assembler(num_connections_, s.cols(), 2 * s.nonZeros());
+            for (int col = 0; col < s.cols(); ++col) {
+                for (M::SparseRep::InnerIterator it(s, col); it; ++it) {
+                    const int c = it.index();
+                    const double v = it.value();
+                    for (int k = cell_start_[c]; k < cell_start_[c + 1]; ++k) {
+                        assembler.add(cell_conn_[k], (cell_is_first_[k] ? a0 : a1) * v);
+                    }
+                }
+                assembler.finishColumn();
+            }
+            return M(assembler.matrix());
+        }
+
+        // Row c of the result is the signed sum of the rows of jac
+        // corresponding to the connections of cell c.
+        M divJacobian(const M& jac) const
+        {
+            assert(jac.rows() == num_connections_);
+            if (jac.nonZeros() == 0) {
+                return M(num_cells_, jac.cols());
+            }
+            const M::SparseRep& s = jac.getSparse();
+            Assembler assembler(num_cells_, s.cols(), 2 * s.nonZeros());
+            for (int col = 0; col < s.cols(); ++col) {
+                for (M::SparseRep::InnerIterator it(s, col); it; ++it) {
+                    const int f = it.index();
+                    assembler.add(conn_[2*f], it.value());
+                    assembler.add(conn_[2*f + 1], -it.value());
+                }
+                assembler.finishColumn();
+            }
+            return M(assembler.matrix());
+        }
+
+        // Column by column construction of a compressed column matrix,
+        // accumulating repeated entries within a column.
+        class Assembler
+        {
+        public:
+            Assembler(const int rows, const int cols, const int nnz_estimate)
+                : rows_(rows),
+                  cols_(cols),
+                  slot_(rows, -1),
+                  col_begin_(0)
+            {
+                outer_.reserve(cols + 1);
+                outer_.push_back(0);
+                inner_.reserve(nnz_estimate);
+                values_.reserve(nnz_estimate);
+            }
+
+            void add(const int row, const double value)
+            {
+                int& slot = slot_[row];
+                if (slot < 0) {
+                    slot = inner_.size();
+                    inner_.push_back(row);
+                    values_.push_back(value);
+                } else {
+                    values_[slot] += value;
+                }
+            }
+
+            void finishColumn()
+            {
+                const int end = inner_.size();
+                if (!std::is_sorted(inner_.begin() + col_begin_, inner_.end())) {
+                    std::vector<std::pair<int, double> > entries;
+                    entries.reserve(end - col_begin_);
+                    for (int k = col_begin_; k < end; ++k) {
+                        entries.emplace_back(inner_[k], values_[k]);
+                    }
+                    std::sort(entries.begin(), entries.end());
+                    for (int k = col_begin_; k < end; ++k) {
+                        inner_[k] = entries[k - col_begin_].first;
+                        values_[k] = entries[k - col_begin_].second;
+                    }
+                }
+                for (int k = col_begin_; k < end; ++k) {
+                    slot_[inner_[k]] = -1;
+                }
+                outer_.push_back(end);
+                col_begin_ = end;
+            }
+
+            M::SparseRep matrix() const
+            {
+                assert(int(outer_.size()) == cols_ + 1);
+                M::SparseRep m(rows_, cols_);
+                m.resizeNonZeros(inner_.size());
+                std::copy(outer_.begin(), outer_.end(), m.outerIndexPtr());
+                std::copy(inner_.begin(), inner_.end(), m.innerIndexPtr());
+                std::copy(values_.begin(), values_.end(), m.valuePtr());
+                return m;
+            }
+
+        private:
+            int rows_;
+            int cols_;
+            std::vector<int> slot_;
+            int col_begin_;
+            std::vector<int> outer_;
+            std::vector<int> inner_;
+            std::vector<double> values_;
+        };
+    };
+
+} // namespace Opm
+
+#endif // OPM_STENCILOPS_HEADER_INCLUDED
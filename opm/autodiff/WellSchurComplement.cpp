@@ -0,0 +1,332 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/WellSchurComplement.hpp>
+#include <opm/autodiff/NewtonIterationUtilities.hpp>
+#include <opm/common/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace Opm
+{
+
+    namespace
+    {
+        int findRoot(std::vector<int>& parent, int i)
+        {
+            while (parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+    } // anonymous namespace
+
+
+
+    WellSchurComplement::WellSchurComplement(const std::vector<ADB>& eqs, const int n)
+        : n_(n),
+          fallback_(false)
+    {
+        const int num_eq = eqs.size();
+        const int num_vars = eqs[0].derivative().size();
+        if (num_eq != num_vars) {
+            OPM_THROW(std::logic_error, "WellSchurComplement requires the same number of variables and equations.");
+        }
+        if (n >= num_eq) {
+            OPM_THROW(std::logic_error, "WellSchurComplement: no well equations to eliminate.");
+        }
+
+        res_start_.resize(n + 1, 0);
+        for (int v = 0; v < n; ++v) {
+            res_start_[v + 1] = res_start_[v] + eqs[v].size();
+        }
+        well_start_.resize(num_eq - n + 1, 0);
+        for (int i = 0; i < num_eq - n; ++i) {
+            well_start_[i + 1] = well_start_[i] + eqs[n + i].size();
+        }
+        const int num_well = well_start_.back();
+
+        // Find the independent diagonal blocks of D as the connected
+        // components of its graph.
+        std::vector<int> parent(num_well);
+        std::iota(parent.begin(), parent.end(), 0);
+        for (int i = 0; i < num_eq - n; ++i) {
+            for (int j = 0; j < num_eq - n; ++j) {
+                const AutoDiffMatrix& Dij = eqs[n + i].derivative()[n + j];
+                if (Dij.nonZeros() == 0) {
+                    continue;
+                }
+                const AutoDiffMatrix::SparseRep& s = Dij.getSparse();
+                for (int col = 0; col < s.outerSize(); ++col) {
+                    for (AutoDiffMatrix::SparseRep::InnerIterator it(s, col); it; ++it) {
+                        const int a = findRoot(parent, well_start_[i] + it.row());
+                        const int b = findRoot(parent, well_start_[j] + col);
+                        if (a != b) {
+                            parent[std::max(a, b)] = std::min(a, b);
+                        }
+                    }
+                }
+            }
+        }
+        std::vector<int> component(num_well);
+        std::vector<int> component_size;
+        for (int g = 0; g < num_well; ++g) {
+            const int root = findRoot(parent, g);
+            if (root == g) {
+                component[g] = component_size.size();
+                component_size.push_back(0);
+            } else {
+                // Roots have the smallest index of their component.
+                component[g] = component[root];
+            }
+            ++component_size[component[g]];
+        }
+
+        const int largest = component_size.empty() ? 0
+            : *std::max_element(component_size.begin(), component_size.end());
+        if (largest > maxDenseBlockSize()) {
+            eliminateSequentially(eqs);
+        } else {
+            eliminateByBlocks(eqs, component, component_size.size());
+        }
+    }
+
+
+
+    void WellSchurComplement::eliminateSequentially(const std::vector<ADB>& eqs)
+    {
+        fallback_ = true;
+        reduced_ = eqs;
+        while (int(reduced_.size()) > n_) {
+            eliminated_.push_back(reduced_[n_]);
+            reduced_ = eliminateVariable(reduced_, n_);
+        }
+    }
+
+
+
+    void WellSchurComplement::eliminateByBlocks(const std::vector<ADB>& eqs,
+                                                const std::vector<int>& component,
+                                                const int num_components)
+    {
+        typedef Eigen::Triplet<double> Tri;
+        typedef Eigen::SparseMatrix<double> ColSparse;
+        const int num_eq = eqs.size();
+        const int num_res = res_start_.back();
+        const int num_well = well_start_.back();
+
+        // Gather D, B (column major) and C (row major) with global
+        // reservoir and well indices, and the well equation values.
+        std::vector<Tri> d_entries;
+        std::vector<Tri> b_entries;
+        std::vector<Tri> c_entries;
+        w_.resize(num_well);
+        for (int eq = 0; eq < num_eq; ++eq) {
+            const bool well_eq = eq >= n_;
+            const int row_start = well_eq ? well_start_[eq - n_] : res_start_[eq];
+            if (well_eq) {
+                w_.segment(row_start, eqs[eq].size()) = eqs[eq].value();
+            }
+            for (int var = 0; var < num_eq; ++var) {
+                const bool well_var = var >= n_;
+                if (!well_eq && !well_var) {
+                    continue;
+                }
+                const AutoDiffMatrix& J = eqs[eq].derivative()[var];
+                if (J.nonZeros() == 0) {
+                    continue;
+                }
+                std::vector<Tri>& entries = well_eq ? (well_var ? d_entries : c_entries) : b_entries;
+                const int col_start = well_var ? well_start_[var - n_] : res_start_[var];
+                const AutoDiffMatrix::SparseRep& s = J.getSparse();
+                for (int col = 0; col < s.outerSize(); ++col) {
+                    for (AutoDiffMatrix::SparseRep::InnerIterator it(s, col); it; ++it) {
+                        entries.emplace_back(row_start + it.row(), col_start + col, it.value());
+                    }
+                }
+            }
+        }
+        ColSparse B(num_res, num_well);
+        B.setFromTriplets(b_entries.begin(), b_entries.end());
+        C_.resize(num_well, num_res);
+        C_.setFromTriplets(c_entries.begin(), c_entries.end());
+
+        // Factorise each diagonal block of D.
+        blocks_.resize(num_components);
+        std::vector<int> local(num_well);
+        for (int g = 0; g < num_well; ++g) {
+            Block& block = blocks_[component[g]];
+            local[g] = block.index.size();
+            block.index.push_back(g);
+        }
+        std::vector<Eigen::MatrixXd> Dk(num_components);
+        for (int k = 0; k < num_components; ++k) {
+            const int sz = blocks_[k].index.size();
+            Dk[k].setZero(sz, sz);
+        }
+        for (const Tri& t : d_entries) {
+            Dk[component[t.row()]](local[t.row()], local[t.col()]) += t.value();
+        }
+        for (int k = 0; k < num_components; ++k) {
+            blocks_[k].lu.compute(Dk[k]);
+        }
+
+        // Form B_k inv(D_k) C_k for each block on the cells it couples to,
+        // and the corresponding update B_k inv(D_k) w_k of the right hand side.
+        V rhs_update = V::Zero(num_res);
+        std::vector<Tri> s_entries;
+        std::vector<int> row_mark(num_res, -1);
+        std::vector<int> col_mark(num_res, -1);
+        std::vector<int> rows;
+        std::vector<int> cols;
+        for (int k = 0; k < num_components; ++k) {
+            const Block& block = blocks_[k];
+            const int sz = block.index.size();
+            rows.clear();
+            cols.clear();
+            for (const int g : block.index) {
+                for (ColSparse::InnerIterator it(B, g); it; ++it) {
+                    if (row_mark[it.row()] != k) {
+                        row_mark[it.row()] = k;
+                        rows.push_back(it.row());
+                    }
+                }
+                for (RowSparse::InnerIterator it(C_, g); it; ++it) {
+                    if (col_mark[it.col()] != k) {
+                        col_mark[it.col()] = k;
+                        cols.push_back(it.col());
+                    }
+                }
+            }
+            if (rows.empty()) {
+                continue;
+            }
+            // Local positions, reusing the marks.
+            for (int a = 0; a < int(rows.size()); ++a) {
+                row_mark[rows[a]] = -2 - a;
+            }
+            for (int b = 0; b < int(cols.size()); ++b) {
+                col_mark[cols[b]] = -2 - b;
+            }
+
+            Eigen::MatrixXd Bk = Eigen::MatrixXd::Zero(rows.size(), sz);
+            Eigen::MatrixXd Ck = Eigen::MatrixXd::Zero(sz, cols.size());
+            Eigen::VectorXd wk(sz);
+            for (int j = 0; j < sz; ++j) {
+                const int g = block.index[j];
+                for (ColSparse::InnerIterator it(B, g); it; ++it) {
+                    Bk(-2 - row_mark[it.row()], j) = it.value();
+                }
+                for (RowSparse::InnerIterator it(C_, g); it; ++it) {
+                    Ck(j, -2 - col_mark[it.col()]) = it.value();
+                }
+                wk(j) = w_(g);
+            }
+            for (const int r : rows) {
+                row_mark[r] = k;
+            }
+            for (const int c : cols) {
+                col_mark[c] = k;
+            }
+
+            const Eigen::VectorXd Bk_Dk_wk = Bk * block.lu.solve(wk);
+            for (int a = 0; a < int(rows.size()); ++a) {
+                rhs_update(rows[a]) += Bk_Dk_wk(a);
+            }
+            if (cols.empty()) {
+                continue;
+            }
+            const Eigen::MatrixXd Sk = Bk * block.lu.solve(Ck);
+            for (int b = 0; b < int(cols.size()); ++b) {
+                for (int a = 0; a < int(rows.size()); ++a) {
+                    if (Sk(a, b) != 0.0) {
+                        s_entries.emplace_back(rows[a], cols[b], Sk(a, b));
+                    }
+                }
+            }
+        }
+
+        // Split the Schur complement term by reservoir equation and unknown.
+        std::vector<std::vector<Tri>> s_blocks(n_ * n_);
+        for (const Tri& t : s_entries) {
+            const int eq = std::upper_bound(res_start_.begin(), res_start_.end(), t.row()) - res_start_.begin() - 1;
+            const int var = std::upper_bound(res_start_.begin(), res_start_.end(), t.col()) - res_start_.begin() - 1;
+            s_blocks[eq * n_ + var].emplace_back(t.row() - res_start_[eq], t.col() - res_start_[var], t.value());
+        }
+
+        // Create the reduced equations.
+        reduced_.clear();
+        reduced_.reserve(n_);
+        for (int eq = 0; eq < n_; ++eq) {
+            const int size_eq = eqs[eq].size();
+            V val = eqs[eq].value() - rhs_update.segment(res_start_[eq], size_eq);
+            std::vector<AutoDiffMatrix> jacs(eqs[eq].derivative().begin(),
+                                             eqs[eq].derivative().begin() + n_);
+            for (int var = 0; var < n_; ++var) {
+                const std::vector<Tri>& entries = s_blocks[eq * n_ + var];
+                if (entries.empty()) {
+                    continue;
+                }
+                ColSparse S(size_eq, res_start_[var + 1] - res_start_[var]);
+                S.setFromTriplets(entries.begin(), entries.end());
+                jacs[var] -= AutoDiffMatrix(S);
+            }
+            reduced_.push_back(ADB::function(std::move(val), std::move(jacs)));
+        }
+    }
+
+
+
+    WellSchurComplement::V
+    WellSchurComplement::recover(const V& partial_solution) const
+    {
+        if (fallback_) {
+            // Recovery in inverse order of elimination.
+            V sol = partial_solution;
+            for (int i = eliminated_.size() - 1; i >= 0; --i) {
+                sol = recoverVariable(eliminated_[i], sol, n_);
+            }
+            return sol;
+        }
+
+        // The well unknowns are y = inv(D) (w - C x).
+        const int num_res = res_start_.back();
+        assert(partial_solution.size() == num_res);
+        const Eigen::VectorXd rhs = w_.matrix() - C_ * partial_solution.matrix();
+        V sol(num_res + well_start_.back());
+        sol.head(num_res) = partial_solution;
+        for (const Block& block : blocks_) {
+            const int sz = block.index.size();
+            Eigen::VectorXd rk(sz);
+            for (int j = 0; j < sz; ++j) {
+                rk(j) = rhs(block.index[j]);
+            }
+            const Eigen::VectorXd yk = block.lu.solve(rk);
+            for (int j = 0; j < sz; ++j) {
+                sol(num_res + block.index[j]) = yk(j);
+            }
+        }
+        return sol;
+    }
+
+} // namespace Opm
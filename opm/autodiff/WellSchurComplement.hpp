@@ -0,0 +1,116 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_WELLSCHURCOMPLEMENT_HEADER_INCLUDED
+#define OPM_WELLSCHURCOMPLEMENT_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffBlock.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace Opm
+{
+
+    /// Elimination of the well unknowns from a linearised system by a
+    /// structured Schur complement.
+    ///
+    /// The system is split into reservoir equations and unknowns (the
+    /// first n of each) and well equations and unknowns (the remaining
+    /// ones, e.g. well fluxes and bottom hole pressures),
+    ///
+    ///     ( A B ) (x)   (r)
+    ///     ( C D ) (y) = (w),
+    ///
+    /// and reduced to (A - B inv(D) C) x = r - B inv(D) w. The well block D
+    /// is split into its independent diagonal blocks (normally one per
+    /// well), each of which is factorised as a small dense matrix. The
+    /// Schur complement is then formed one block at a time from the
+    /// perforated cells of the well, instead of by sparse products over
+    /// the whole system as in eliminateVariable().
+    ///
+    /// If a diagonal block of D is larger than maxDenseBlockSize() (e.g.
+    /// when wells are coupled through group controls), the elimination
+    /// falls back to eliminateVariable() and recoverVariable().
+    class WellSchurComplement
+    {
+    public:
+        typedef AutoDiffBlock<double> ADB;
+        typedef ADB::V V;
+
+        /// Eliminate the unknowns n, ..., eqs.size() - 1 from the equations.
+        /// \param[in] eqs  equations, with as many Jacobian blocks as equations,
+        ///                 and each unknown of the same size as its equation
+        /// \param[in] n    number of reservoir equations (and unknowns)
+        WellSchurComplement(const std::vector<ADB>& eqs, const int n);
+
+        /// The first n equations with the well unknowns eliminated.
+        const std::vector<ADB>& reducedEquations() const
+        {
+            return reduced_;
+        }
+
+        /// Recover the solution of the full system.
+        /// \param[in] partial_solution  solution of the reduced system
+        /// \return                      solution of the full system, reservoir
+        ///                              unknowns followed by well unknowns
+        V recover(const V& partial_solution) const;
+
+        /// Number of independent diagonal blocks of the well matrix D.
+        int numBlocks() const
+        {
+            return blocks_.size();
+        }
+
+        /// Largest diagonal block of D that is factorised densely.
+        static int maxDenseBlockSize()
+        {
+            return 256;
+        }
+
+    private:
+        typedef Eigen::SparseMatrix<double, Eigen::RowMajor> RowSparse;
+
+        // One independent diagonal block of D.
+        struct Block
+        {
+            std::vector<int> index;              // Well unknowns/equations (global well index).
+            Eigen::PartialPivLU<Eigen::MatrixXd> lu;
+        };
+
+        int n_;
+        std::vector<int> res_start_;    // Start of each reservoir unknown, n + 1 elements.
+        std::vector<int> well_start_;   // Start of each well unknown, counted from the first.
+        std::vector<Block> blocks_;
+        RowSparse C_;                   // Derivatives of the well equations wrt. the reservoir unknowns.
+        V w_;                           // Well equation values.
+        bool fallback_;
+        std::vector<ADB> eliminated_;   // Equations eliminated in the fallback.
+        std::vector<ADB> reduced_;
+
+        void eliminateByBlocks(const std::vector<ADB>& eqs,
+                               const std::vector<int>& component,
+                               const int num_components);
+        void eliminateSequentially(const std::vector<ADB>& eqs);
+    };
+
+} // namespace Opm
+
+#endif // OPM_WELLSCHURCOMPLEMENT_HEADER_INCLUDED
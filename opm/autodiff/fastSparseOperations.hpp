@@ -22,8 +22,48 @@
 
 #include <Eigen/Core>
 
+#include <opm/autodiff/AutoDiffArena.hpp>
+
+#if HAVE_OPENMP
+#include <omp.h>
+#endif
+
 namespace Opm {
 
+// Controls when the kernels below use multiple OpenMP threads. Work is
+// measured in stored nonzeros of the operands; below the threshold, or
+// inside an already parallel region, the serial kernels are used.
+class FastSparseThreading
+{
+public:
+  static void setThreshold(const std::size_t threshold)
+  {
+    thresholdRef() = threshold;
+  }
+
+  static std::size_t threshold()
+  {
+    return thresholdRef();
+  }
+
+  static bool useThreads(const std::size_t work)
+  {
+#if HAVE_OPENMP
+    return work >= thresholdRef() && omp_get_max_threads() > 1 && !omp_in_parallel();
+#else
+    static_cast<void>(work);
+    return false;
+#endif
+  }
+
+private:
+  static std::size_t& thresholdRef()
+  {
+    static std::size_t threshold = 20000;
+    return threshold;
+  }
+};
+
 template < unsigned int depth >
 struct QuickSort
 {
@@ -75,9 +115,10 @@ void fastSparseProduct(const Lhs& lhs, const Rhs& rhs, ResultType& res)
   Index cols = rhs.outerSize();
   eigen_assert(lhs.outerSize() == rhs.innerSize());
 
-  std::vector<bool> mask(rows,false);
-  Eigen::Matrix<Scalar,Eigen::Dynamic,1> values(rows);
-  Eigen::Matrix<Index, Eigen::Dynamic,1> indices(rows);
+  // scratch arrays are drawn from the AD arena (if enabled)
+  std::vector<bool, AutoDiffArenaAllocator<bool> > mask(rows,false);
+  std::vector<Scalar, AutoDiffArenaAllocator<Scalar> > values(rows);
+  std::vector<Index, AutoDiffArenaAllocator<Index> > indices(rows);
 
   // estimate the number of non zero entries
   // given a rhs column containing Y non zeros, we assume that the respective Y columns
@@ -141,8 +182,117 @@ void fastSparseProduct(const Lhs& lhs, const Rhs& rhs, ResultType& res)
 
 
 
+// Column partitioned, multithreaded version of fastSparseProduct for
+// column major matrices. Each thread computes a range of result columns
+// into its own buffer, merging the contributions to a column by sorting
+// them, so no scratch arrays of the full row dimension are needed per
+// thread. The buffers are concatenated into the result afterwards.
+inline void fastSparseProductThreaded(const Eigen::SparseMatrix<double>& lhs,
+                                      const Eigen::SparseMatrix<double>& rhs,
+                                      Eigen::SparseMatrix<double>& res)
+{
+  typedef Eigen::SparseMatrix<double>::InnerIterator It;
+  const int rows = lhs.rows();
+  const int cols = rhs.cols();
+  eigen_assert(lhs.cols() == rhs.rows());
+
+  int num_chunks = std::min(cols, 1);
+#if HAVE_OPENMP
+  num_chunks = std::min(cols, 4 * omp_get_max_threads());
+#endif
+  std::vector<std::vector<int> > chunk_inner(num_chunks);
+  std::vector<std::vector<double> > chunk_values(num_chunks);
+  std::vector<int> outer(cols + 1, 0);
+
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int chunk = 0; chunk < num_chunks; ++chunk)
+  {
+    const int begin = static_cast<long long>(cols) * chunk / num_chunks;
+    const int end = static_cast<long long>(cols) * (chunk + 1) / num_chunks;
+    std::vector<int>& inner = chunk_inner[chunk];
+    std::vector<double>& values = chunk_values[chunk];
+    std::vector<std::pair<int, double> > column;
+    for (int j = begin; j < end; ++j)
+    {
+      column.clear();
+      for (It rhsIt(rhs, j); rhsIt; ++rhsIt)
+      {
+        const double y = rhsIt.value();
+        for (It lhsIt(lhs, rhsIt.index()); lhsIt; ++lhsIt)
+        {
+          const double val = lhsIt.value() * y;
+          if (val != 0.0)
+          {
+            column.emplace_back(lhsIt.index(), val);
+          }
+        }
+      }
+      // stable, so that contributions are summed in the same order as
+      // in the serial kernel
+      std::stable_sort(column.begin(), column.end(),
+                [](const std::pair<int, double>& a, const std::pair<int, double>& b) { return a.first < b.first; });
+      const std::size_t start = inner.size();
+      for (std::size_t k = 0; k < column.size(); ++k)
+      {
+        if (inner.size() > start && inner.back() == column[k].first)
+        {
+          values.back() += column[k].second;
+        }
+        else
+        {
+          inner.push_back(column[k].first);
+          values.push_back(column[k].second);
+        }
+      }
+      outer[j + 1] = inner.size() - start;
+    }
+  }
+
+  for (int j = 0; j < cols; ++j)
+  {
+    outer[j + 1] += outer[j];
+  }
+  res.resize(rows, cols);
+  res.resizeNonZeros(outer[cols]);
+  std::copy(outer.begin(), outer.end(), res.outerIndexPtr());
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int chunk = 0; chunk < num_chunks; ++chunk)
+  {
+    const int begin = static_cast<long long>(cols) * chunk / num_chunks;
+    std::copy(chunk_inner[chunk].begin(), chunk_inner[chunk].end(), res.innerIndexPtr() + outer[begin]);
+    std::copy(chunk_values[chunk].begin(), chunk_values[chunk].end(), res.valuePtr() + outer[begin]);
+  }
+}
+
+
+
+// Sparse products of column major matrices use the threaded kernel for
+// large operands.
+inline void fastSparseProduct(const Eigen::SparseMatrix<double>& lhs,
+                              const Eigen::SparseMatrix<double>& rhs,
+                              Eigen::SparseMatrix<double>& res)
+{
+  typedef Eigen::SparseMatrix<double> Sp;
+  if (lhs.nonZeros() > 0 && rhs.nonZeros() > 0
+      && FastSparseThreading::useThreads(lhs.nonZeros() + rhs.nonZeros()))
+  {
+    fastSparseProductThreaded(lhs, rhs, res);
+  }
+  else
+  {
+    fastSparseProduct<Sp, Sp, Sp>(lhs, rhs, res);
+  }
+}
+
+
+
 
-inline void fastDiagSparseProduct(const std::vector<double>& lhs,
+template <class DiagVector>
+inline void fastDiagSparseProduct(const DiagVector& lhs,
                                   const Eigen::SparseMatrix<double>& rhs,
                                   Eigen::SparseMatrix<double>& res)
 {
@@ -150,6 +300,9 @@ inline void fastDiagSparseProduct(const std::vector<double>& lhs,
 
     // Multiply rows by diagonal lhs.
     int n = res.cols();
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(res.nonZeros()))
+#endif
     for (int col = 0; col < n; ++col) {
         typedef Eigen::SparseMatrix<double>::InnerIterator It;
         for (It it(res, col); it; ++it) {
@@ -161,14 +314,18 @@ inline void fastDiagSparseProduct(const std::vector<double>& lhs,
 
 
 
+template <class DiagVector>
 inline void fastSparseDiagProduct(const Eigen::SparseMatrix<double>& lhs,
-                                  const std::vector<double>& rhs,
+                                  const DiagVector& rhs,
                                   Eigen::SparseMatrix<double>& res)
 {
     res = lhs;
 
     // Multiply columns by diagonal rhs.
     int n = res.cols();
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(res.nonZeros()))
+#endif
     for (int col = 0; col < n; ++col) {
         typedef Eigen::SparseMatrix<double>::InnerIterator It;
         for (It it(res, col); it; ++it) {
@@ -238,6 +395,9 @@ fastSparseAdd(Lhs& lhs, const Rhs& rhs)
         const Scalar* rhsV = rhs.valuePtr();
         Scalar* lhsV = lhs.valuePtr();
 
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(nnz))
+#endif
         for(Index i=0; i<nnz; ++i )
         {
             lhsV[ i ] += rhsV[ i ];
@@ -267,6 +427,9 @@ fastSparseSubstract(Lhs& lhs, const Rhs& rhs)
         const Scalar* rhsV = rhs.valuePtr();
         Scalar* lhsV = lhs.valuePtr();
 
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(FastSparseThreading::useThreads(nnz))
+#endif
         for(Index i=0; i<nnz; ++i )
         {
             lhsV[ i ] -= rhsV[ i ];
@@ -279,6 +442,90 @@ fastSparseSubstract(Lhs& lhs, const Rhs& rhs)
     }
 }
 
+// res = lhs + rhs for column major matrices of (possibly) different
+// sparsity patterns, merging the columns in parallel. res may not alias
+// lhs or rhs.
+inline void
+fastSparseSum(const Eigen::SparseMatrix<double>& lhs,
+              const Eigen::SparseMatrix<double>& rhs,
+              Eigen::SparseMatrix<double>& res)
+{
+    typedef Eigen::SparseMatrix<double>::InnerIterator It;
+    eigen_assert(lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols());
+    const int cols = lhs.cols();
+    const bool threaded = FastSparseThreading::useThreads(lhs.nonZeros() + rhs.nonZeros());
+    static_cast<void>(threaded);
+
+    // Count the merged entries of each column.
+    std::vector<int> outer(cols + 1, 0);
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(threaded)
+#endif
+    for (int j = 0; j < cols; ++j)
+    {
+        int count = 0;
+        It l(lhs, j);
+        It r(rhs, j);
+        while (l || r)
+        {
+            if (l && (!r || l.index() <= r.index()))
+            {
+                if (r && l.index() == r.index())
+                {
+                    ++r;
+                }
+                ++l;
+            }
+            else
+            {
+                ++r;
+            }
+            ++count;
+        }
+        outer[j + 1] = count;
+    }
+    for (int j = 0; j < cols; ++j)
+    {
+        outer[j + 1] += outer[j];
+    }
+
+    res.resize(lhs.rows(), cols);
+    res.resizeNonZeros(outer[cols]);
+    std::copy(outer.begin(), outer.end(), res.outerIndexPtr());
+    int* inner = res.innerIndexPtr();
+    double* values = res.valuePtr();
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(static) if(threaded)
+#endif
+    for (int j = 0; j < cols; ++j)
+    {
+        int k = outer[j];
+        It l(lhs, j);
+        It r(rhs, j);
+        while (l || r)
+        {
+            if (l && (!r || l.index() <= r.index()))
+            {
+                inner[k] = l.index();
+                values[k] = l.value();
+                if (r && l.index() == r.index())
+                {
+                    values[k] += r.value();
+                    ++r;
+                }
+                ++l;
+            }
+            else
+            {
+                inner[k] = r.index();
+                values[k] = r.value();
+                ++r;
+            }
+            ++k;
+        }
+    }
+}
+
 } // end namespace Opm
 
 #endif // OPM_FASTSPARSEPRODUCT_HEADER_INCLUDED
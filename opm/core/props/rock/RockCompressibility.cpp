@@ -29,10 +29,27 @@
 #include <opm/parser/eclipse/EclipseState/Tables/TableManager.hpp>
 
 #include <iostream>
+#include <sstream>
 
 namespace Opm
 {
 
+    namespace
+    {
+        void warnIfInaccurate(const UniformGridTable& table,
+                              const char* curve,
+                              const double tolerance)
+        {
+            if (table.maxError() > tolerance) {
+                std::ostringstream msg;
+                msg << "Uniform table of ROCKTAB " << curve
+                    << " has relative error " << table.maxError() << " with "
+                    << table.numIntervals() << " intervals, above the tolerance " << tolerance << ".";
+                OpmLog::warning(msg.str());
+            }
+        }
+    } // anonymous namespace
+
     RockCompressibility::RockCompressibility(const ParameterGroup& param)
         : pref_(0.0),
           rock_comp_(0.0)
@@ -89,6 +106,8 @@ namespace Opm
             // Approximating with a quadratic curve.
             const double cpnorm = rock_comp_*(pressure - pref_);
             return (1.0 + cpnorm + 0.5*cpnorm*cpnorm);
+        } else if (poromult_table_.contains(pressure)) {
+            return poromult_table_(pressure);
         } else {
             return Opm::linearInterpolation(p_, poromult_, pressure);
         }
@@ -101,6 +120,8 @@ namespace Opm
             // we must use its derivative.
             const double cpnorm = rock_comp_*(pressure - pref_);
             return rock_comp_ + cpnorm*rock_comp_;
+        } else if (poromult_table_.contains(pressure)) {
+            return poromult_table_.derivative(pressure);
         } else {
             return Opm::linearInterpolationDerivative(p_, poromult_, pressure);
         }
@@ -110,6 +131,8 @@ namespace Opm
     {
         if (p_.empty()) {
             return 1.0;
+        } else if (transmult_table_.contains(pressure)) {
+            return transmult_table_(pressure);
         } else {
             return Opm::linearInterpolation(p_, transmult_, pressure);
         }
@@ -119,6 +142,8 @@ namespace Opm
     {
         if (p_.empty()) {
             return 0.0;
+        } else if (transmult_table_.contains(pressure)) {
+            return transmult_table_.derivative(pressure);
         } else {
             return Opm::linearInterpolationDerivative(p_, transmult_, pressure);
         }
@@ -138,5 +163,67 @@ namespace Opm
         }
     }
 
+    void RockCompressibility::poroMult(const int n,
+                                       const double* pressure,
+                                       double* mult,
+                                       double* deriv) const
+    {
+        if (poromult_table_.empty()) {
+            for (int i = 0; i < n; ++i) {
+                mult[i] = poroMult(pressure[i]);
+                deriv[i] = poroMultDeriv(pressure[i]);
+            }
+            return;
+        }
+        poromult_table_.evaluate(n, pressure, mult, deriv);
+        // Keep the extrapolation of the original table.
+        for (int i = 0; i < n; ++i) {
+            if (!poromult_table_.contains(pressure[i])) {
+                mult[i] = Opm::linearInterpolation(p_, poromult_, pressure[i]);
+                deriv[i] = Opm::linearInterpolationDerivative(p_, poromult_, pressure[i]);
+            }
+        }
+    }
+
+    void RockCompressibility::transMult(const int n,
+                                        const double* pressure,
+                                        double* mult,
+                                        double* deriv) const
+    {
+        if (transmult_table_.empty()) {
+            for (int i = 0; i < n; ++i) {
+                mult[i] = transMult(pressure[i]);
+                deriv[i] = transMultDeriv(pressure[i]);
+            }
+            return;
+        }
+        transmult_table_.evaluate(n, pressure, mult, deriv);
+        // Keep the extrapolation of the original table.
+        for (int i = 0; i < n; ++i) {
+            if (!transmult_table_.contains(pressure[i])) {
+                mult[i] = Opm::linearInterpolation(p_, transmult_, pressure[i]);
+                deriv[i] = Opm::linearInterpolationDerivative(p_, transmult_, pressure[i]);
+            }
+        }
+    }
+
+    void RockCompressibility::tabulate(const double tolerance,
+                                       const int max_intervals)
+    {
+        if (p_.size() < 2) {
+            return;
+        }
+        const double pmin = p_.front();
+        const double pmax = p_.back();
+        auto poromult = [this](const double p) { return Opm::linearInterpolation(p_, poromult_, p); };
+        auto transmult = [this](const double p) { return Opm::linearInterpolation(p_, transmult_, p); };
+        poromult_table_ = UniformGridTable::fromFunction(poromult, pmin, pmax, tolerance,
+                                                         p_.size() - 1, max_intervals, p_);
+        transmult_table_ = UniformGridTable::fromFunction(transmult, pmin, pmax, tolerance,
+                                                          p_.size() - 1, max_intervals, p_);
+        warnIfInaccurate(poromult_table_, "pore volume multipliers", tolerance);
+        warnIfInaccurate(transmult_table_, "transmissibility multipliers", tolerance);
+    }
+
 } // namespace Opm
 
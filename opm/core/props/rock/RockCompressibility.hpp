@@ -20,6 +20,7 @@
 #ifndef OPM_ROCKCOMPRESSIBILITY_HEADER_INCLUDED
 #define OPM_ROCKCOMPRESSIBILITY_HEADER_INCLUDED
 
+#include <opm/core/utility/UniformGridTable.hpp>
 #include <opm/parser/eclipse/EclipseState/EclipseState.hpp>
 
 #include <vector>
@@ -61,12 +62,36 @@ namespace Opm
         /// Rock compressibility = (d poro / d p)*(1 / poro).
         double rockComp(double pressure) const;
 
+        /// Porosity multipliers and their derivatives for n pressures.
+        void poroMult(const int n,
+                      const double* pressure,
+                      double* mult,
+                      double* deriv) const;
+
+        /// Transmissibility multipliers and their derivatives for n pressures.
+        void transMult(const int n,
+                       const double* pressure,
+                       double* mult,
+                       double* deriv) const;
+
+        /// Resample the ROCKTAB multipliers on uniform pressure grids, so
+        /// that evaluation within the table range needs no interval
+        /// search. The number of intervals is doubled until the relative
+        /// interpolation error, checked at the midpoints and at the ROCKTAB
+        /// pressures, is below tolerance, or max_intervals is reached, in
+        /// which case a warning with the achieved error is logged. Has no
+        /// effect with ROCK, which is evaluated directly.
+        void tabulate(const double tolerance,
+                      const int max_intervals = 1 << 16);
+
     private:
         std::vector<double> p_;
         std::vector<double> poromult_;
         std::vector<double> transmult_;
         double pref_;
         double rock_comp_;
+        UniformGridTable poromult_table_;
+        UniformGridTable transmult_table_;
     };
 
 } // namespace Opm
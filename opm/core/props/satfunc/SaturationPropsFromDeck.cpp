@@ -28,14 +28,38 @@
 #include <opm/core/simulator/ExplicitArraysFluidState.hpp>
 #include <opm/core/simulator/ExplicitArraysSatDerivativesFluidState.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <utility>
+
+#if HAVE_OPENMP
+#include <omp.h>
+#endif
 
 namespace Opm
 {
 
     typedef SaturationPropsFromDeck::MaterialLawManager::MaterialLaw MaterialLaw;
 
+    namespace
+    {
+        // Fewer cells are evaluated by the calling thread alone.
+        const int minCellsForThreads = 1000;
+
+        // True if n cells should be evaluated by multiple threads. Calls
+        // from within a parallel region are always serial.
+        bool useThreads(const int n)
+        {
+#if HAVE_OPENMP
+            return n >= minCellsForThreads && omp_get_max_threads() > 1 && !omp_in_parallel();
+#else
+            static_cast<void>(n);
+            return false;
+#endif
+        }
+    } // anonymous namespace
+
     // ----------- Methods of SaturationPropsFromDeck ---------
 
 
@@ -52,12 +76,55 @@ namespace Opm
         materialLawManager_ = materialLawManager;
     }
 
+    /// Set the saturation region of each cell.
+    void SaturationPropsFromDeck::setCellRegions(std::vector<int> cellRegion)
+    {
+        cellRegion_ = std::move(cellRegion);
+        regionOrder_.clear();
+        const int numRegions = cellRegion_.empty() ? 0
+            : *std::max_element(cellRegion_.begin(), cellRegion_.end()) + 1;
+        if (numRegions < 2) {
+            return;
+        }
+        // Counting sort of the cells by region, stable within each region.
+        const int numCells = cellRegion_.size();
+        std::vector<int> start(numRegions + 1, 0);
+        for (int c = 0; c < numCells; ++c) {
+            ++start[cellRegion_[c] + 1];
+        }
+        for (int r = 0; r < numRegions; ++r) {
+            start[r + 1] += start[r];
+        }
+        regionOrder_.resize(numCells);
+        for (int c = 0; c < numCells; ++c) {
+            regionOrder_[start[cellRegion_[c]]++] = c;
+        }
+    }
+
     /// \return   P, the number of phases.
     int SaturationPropsFromDeck::numPhases() const
     {
         return phaseUsage_.num_phases;
     }
 
+    /// Order in which the n data points are evaluated, null if they
+    /// are evaluated in the given order.
+    const int* SaturationPropsFromDeck::evaluationOrder(const int n,
+                                                        const int* cells) const
+    {
+        if (regionOrder_.empty() || n != int(regionOrder_.size())) {
+            return nullptr;
+        }
+        // The cached grouping applies when all cells are evaluated in
+        // their natural order, as for the whole grid.
+        for (int i = 0; i < n; ++i) {
+            if (cells[i] != i) {
+                return nullptr;
+            }
+        }
+        return regionOrder_.data();
+    }
+
 
 
 
@@ -80,38 +147,57 @@ namespace Opm
         assert(cells != 0);
 
         const int np = numPhases();
+        const int* order = evaluationOrder(n, cells);
         if (dkrds) {
-            ExplicitArraysSatDerivativesFluidState fluidState(phaseUsage_);
-            fluidState.setSaturationArray(s);
-
-            typedef ExplicitArraysSatDerivativesFluidState::Evaluation Evaluation;
-            Evaluation relativePerms[BlackoilPhases::MaxNumPhases];
-            for (int i = 0; i < n; ++i) {
-                fluidState.setIndex(i);
-                const auto& params = materialLawManager_->materialLawParams(cells[i]);
-                MaterialLaw::relativePermeabilities(relativePerms, params, fluidState);
-
-                // copy the values calculated using opm-material to the target arrays
-                for (int krPhaseIdx = 0; krPhaseIdx < np; ++krPhaseIdx) {
-                    kr[np*i + krPhaseIdx] = relativePerms[krPhaseIdx].value();
-
-                    for (int satPhaseIdx = 0; satPhaseIdx < np; ++satPhaseIdx)
-                        dkrds[np*np*i + satPhaseIdx*np + krPhaseIdx] = relativePerms[krPhaseIdx].derivative(satPhaseIdx);
+#if HAVE_OPENMP
+#pragma omp parallel if(useThreads(n))
+#endif // HAVE_OPENMP
+            {
+                ExplicitArraysSatDerivativesFluidState fluidState(phaseUsage_);
+                fluidState.setSaturationArray(s);
+
+                typedef ExplicitArraysSatDerivativesFluidState::Evaluation Evaluation;
+                Evaluation relativePerms[BlackoilPhases::MaxNumPhases];
+#if HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif // HAVE_OPENMP
+                for (int k = 0; k < n; ++k) {
+                    const int i = order ? order[k] : k;
+                    fluidState.setIndex(i);
+                    const auto& params = materialLawManager_->materialLawParams(cells[i]);
+                    MaterialLaw::relativePermeabilities(relativePerms, params, fluidState);
+
+                    // copy the values calculated using opm-material to the target arrays
+                    for (int krPhaseIdx = 0; krPhaseIdx < np; ++krPhaseIdx) {
+                        kr[np*i + krPhaseIdx] = relativePerms[krPhaseIdx].value();
+
+                        for (int satPhaseIdx = 0; satPhaseIdx < np; ++satPhaseIdx)
+                            dkrds[np*np*i + satPhaseIdx*np + krPhaseIdx] = relativePerms[krPhaseIdx].derivative(satPhaseIdx);
+                    }
                 }
             }
         } else {
-            ExplicitArraysFluidState fluidState(phaseUsage_);
-            fluidState.setSaturationArray(s);
-
-            double relativePerms[BlackoilPhases::MaxNumPhases] = { 0 };
-            for (int i = 0; i < n; ++i) {
-                fluidState.setIndex(i);
-                const auto& params = materialLawManager_->materialLawParams(cells[i]);
-                MaterialLaw::relativePermeabilities(relativePerms, params, fluidState);
-
-                // copy the values calculated using opm-material to the target arrays
-                for (int krPhaseIdx = 0; krPhaseIdx < np; ++krPhaseIdx) {
-                    kr[np*i + krPhaseIdx] = relativePerms[krPhaseIdx];
+#if HAVE_OPENMP
+#pragma omp parallel if(useThreads(n))
+#endif // HAVE_OPENMP
+            {
+                ExplicitArraysFluidState fluidState(phaseUsage_);
+                fluidState.setSaturationArray(s);
+
+                double relativePerms[BlackoilPhases::MaxNumPhases] = { 0 };
+#if HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif // HAVE_OPENMP
+                for (int k = 0; k < n; ++k) {
+                    const int i = order ? order[k] : k;
+                    fluidState.setIndex(i);
+                    const auto& params = materialLawManager_->materialLawParams(cells[i]);
+                    MaterialLaw::relativePermeabilities(relativePerms, params, fluidState);
+
+                    // copy the values calculated using opm-material to the target arrays
+                    for (int krPhaseIdx = 0; krPhaseIdx < np; ++krPhaseIdx) {
+                        kr[np*i + krPhaseIdx] = relativePerms[krPhaseIdx];
+                    }
                 }
             }
         }
@@ -140,64 +226,83 @@ namespace Opm
         assert(phaseUsage_.phase_used[BlackoilPhases::Liquid]);
 
         const int np = numPhases();
+        const int* order = evaluationOrder(n, cells);
 
         if (dpcds) {
-            ExplicitArraysSatDerivativesFluidState fluidState(phaseUsage_);
-            typedef ExplicitArraysSatDerivativesFluidState::Evaluation Evaluation;
-            fluidState.setSaturationArray(s);
-
-            Evaluation capillaryPressures[BlackoilPhases::MaxNumPhases];
-            for (int i = 0; i < n; ++i) {
-                fluidState.setIndex(i);
-                const auto& params = materialLawManager_->materialLawParams(cells[i]);
-                MaterialLaw::capillaryPressures(capillaryPressures, params, fluidState);
-
-                // copy the values calculated using opm-material to the target arrays
-                for (int canonicalPhaseIdx = 0; canonicalPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalPhaseIdx) {
-                    // skip unused phases
-                    if ( ! phaseUsage_.phase_used[canonicalPhaseIdx]) {
-                        continue;
-                    }
-                    const int pcPhaseIdx = phaseUsage_.phase_pos[canonicalPhaseIdx];
-
-                    const double sign = (canonicalPhaseIdx == BlackoilPhases::Aqua)? -1.0 : 1.0;
-                    // in opm-material the wetting phase is the reference phase
-                    // for two-phase problems i.e water for oil-water system,
-                    // but for flow it is always oil. Add oil (liquid) capillary pressure value
-                    // to shift the reference phase to oil
-                    pc[np*i + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid].value() + sign * capillaryPressures[canonicalPhaseIdx].value();
-                    for (int canonicalSatPhaseIdx = 0; canonicalSatPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalSatPhaseIdx) {
-                        if ( ! phaseUsage_.phase_used[canonicalSatPhaseIdx])
+#if HAVE_OPENMP
+#pragma omp parallel if(useThreads(n))
+#endif // HAVE_OPENMP
+            {
+                ExplicitArraysSatDerivativesFluidState fluidState(phaseUsage_);
+                typedef ExplicitArraysSatDerivativesFluidState::Evaluation Evaluation;
+                fluidState.setSaturationArray(s);
+
+                Evaluation capillaryPressures[BlackoilPhases::MaxNumPhases];
+#if HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif // HAVE_OPENMP
+                for (int k = 0; k < n; ++k) {
+                    const int i = order ? order[k] : k;
+                    fluidState.setIndex(i);
+                    const auto& params = materialLawManager_->materialLawParams(cells[i]);
+                    MaterialLaw::capillaryPressures(capillaryPressures, params, fluidState);
+
+                    // copy the values calculated using opm-material to the target arrays
+                    for (int canonicalPhaseIdx = 0; canonicalPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalPhaseIdx) {
+                        // skip unused phases
+                        if ( ! phaseUsage_.phase_used[canonicalPhaseIdx]) {
                             continue;
-
-                        const int satPhaseIdx = phaseUsage_.phase_pos[canonicalSatPhaseIdx];
-                        dpcds[np*np*i + satPhaseIdx*np + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid].derivative(canonicalSatPhaseIdx) + sign * capillaryPressures[canonicalPhaseIdx].derivative(canonicalSatPhaseIdx);
+                        }
+                        const int pcPhaseIdx = phaseUsage_.phase_pos[canonicalPhaseIdx];
+
+                        const double sign = (canonicalPhaseIdx == BlackoilPhases::Aqua)? -1.0 : 1.0;
+                        // in opm-material the wetting phase is the reference phase
+                        // for two-phase problems i.e water for oil-water system,
+                        // but for flow it is always oil. Add oil (liquid) capillary pressure value
+                        // to shift the reference phase to oil
+                        pc[np*i + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid].value() + sign * capillaryPressures[canonicalPhaseIdx].value();
+                        for (int canonicalSatPhaseIdx = 0; canonicalSatPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalSatPhaseIdx) {
+                            if ( ! phaseUsage_.phase_used[canonicalSatPhaseIdx])
+                                continue;
+
+                            const int satPhaseIdx = phaseUsage_.phase_pos[canonicalSatPhaseIdx];
+                            dpcds[np*np*i + satPhaseIdx*np + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid].derivative(canonicalSatPhaseIdx) + sign * capillaryPressures[canonicalPhaseIdx].derivative(canonicalSatPhaseIdx);
+                        }
                     }
                 }
             }
         } else {
-            ExplicitArraysFluidState fluidState(phaseUsage_);
-            fluidState.setSaturationArray(s);
+#if HAVE_OPENMP
+#pragma omp parallel if(useThreads(n))
+#endif // HAVE_OPENMP
+            {
+                ExplicitArraysFluidState fluidState(phaseUsage_);
+                fluidState.setSaturationArray(s);
+
+                double capillaryPressures[BlackoilPhases::MaxNumPhases] = { 0 };
+#if HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif // HAVE_OPENMP
+                for (int k = 0; k < n; ++k) {
+                    const int i = order ? order[k] : k;
+                    fluidState.setIndex(i);
+                    const auto& params = materialLawManager_->materialLawParams(cells[i]);
+                    MaterialLaw::capillaryPressures(capillaryPressures, params, fluidState);
+
+                    // copy the values calculated using opm-material to the target arrays
+                    for (int canonicalPhaseIdx = 0; canonicalPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalPhaseIdx) {
+                        // skip unused phases
+                        if ( ! phaseUsage_.phase_used[canonicalPhaseIdx])
+                            continue;
 
-            double capillaryPressures[BlackoilPhases::MaxNumPhases] = { 0 };
-            for (int i = 0; i < n; ++i) {
-                fluidState.setIndex(i);
-                const auto& params = materialLawManager_->materialLawParams(cells[i]);
-                MaterialLaw::capillaryPressures(capillaryPressures, params, fluidState);
-
-                // copy the values calculated using opm-material to the target arrays
-                for (int canonicalPhaseIdx = 0; canonicalPhaseIdx < BlackoilPhases::MaxNumPhases; ++canonicalPhaseIdx) {
-                    // skip unused phases
-                    if ( ! phaseUsage_.phase_used[canonicalPhaseIdx])
-                        continue;
-
-                    const int pcPhaseIdx = phaseUsage_.phase_pos[canonicalPhaseIdx];
-                    double sign = (canonicalPhaseIdx == BlackoilPhases::Aqua)? -1.0 : 1.0;
-                    // in opm-material the wetting phase is the reference phase
-                    // for two-phase problems i.e water for oil-water system,
-                    // but for flow it is always oil. Add oil (liquid) capillary pressure value
-                    // to shift the reference phase to oil
-                    pc[np*i + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid] + sign * capillaryPressures[canonicalPhaseIdx];
+                        const int pcPhaseIdx = phaseUsage_.phase_pos[canonicalPhaseIdx];
+                        double sign = (canonicalPhaseIdx == BlackoilPhases::Aqua)? -1.0 : 1.0;
+                        // in opm-material the wetting phase is the reference phase
+                        // for two-phase problems i.e water for oil-water system,
+                        // but for flow it is always oil. Add oil (liquid) capillary pressure value
+                        // to shift the reference phase to oil
+                        pc[np*i + pcPhaseIdx] = capillaryPressures[BlackoilPhases::Liquid] + sign * capillaryPressures[canonicalPhaseIdx];
+                    }
                 }
             }
         }
@@ -72,6 +72,16 @@ namespace Opm
             init(Opm::phaseUsageFromDeck(deck), materialLawManager);
         }
 
+        /// Set the saturation region (SATNUM, counted from zero) of each
+        /// cell. The cells are grouped by region here, once, and
+        /// relperm() and capPress() calls for all cells in natural order
+        /// visit them region by region, so that consecutive evaluations
+        /// use the same tables. Other calls use the given order.
+        /// Small batches, and calls from within a parallel region, are
+        /// evaluated by the calling thread alone.
+        /// \param[in]  cellRegion  Region index of each cell
+        void setCellRegions(std::vector<int> cellRegion);
+
         /// \return   P, the number of phases.
         int numPhases() const;
 
@@ -170,8 +180,17 @@ namespace Opm
 
 
     private:
+        /// Order in which the n data points are evaluated, grouped by
+        /// saturation region and in increasing order within each region.
+        /// Null if the data points are evaluated in the given order, which
+        /// is the case unless all cells are evaluated in natural order.
+        const int* evaluationOrder(const int n,
+                                   const int* cells) const;
+
         std::shared_ptr<MaterialLawManager> materialLawManager_;
         PhaseUsage phaseUsage_;
+        std::vector<int> cellRegion_;
+        std::vector<int> regionOrder_;  // cells grouped by region, empty with one region
     };
 
 
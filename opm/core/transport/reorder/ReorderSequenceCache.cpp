@@ -0,0 +1,242 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <opm/core/transport/reorder/ReorderSequenceCache.hpp>
+#include <opm/core/transport/reorder/reordersequence.h>
+#include <opm/core/transport/reorder/tarjan.h>
+#include <opm/grid/UnstructuredGrid.h>
+
+#include <algorithm>
+#include <vector>
+
+
+namespace
+{
+    signed char faceSign(const double flux)
+    {
+        return flux > 0.0 ? 1 : (flux < 0.0 ? -1 : 0);
+    }
+}
+
+
+namespace Opm
+{
+
+    ReorderSequenceCache::ReorderSequenceCache(const UnstructuredGrid& grid)
+        : grid_(grid),
+          valid_(false),
+          face_sign_(grid.number_of_faces, 0),
+          cell_comp_(grid.number_of_cells, -1),
+          local_index_(grid.number_of_cells, -1)
+    {
+    }
+
+
+
+
+    ReorderSequenceCache::UpdateType ReorderSequenceCache::update(const double* flux)
+    {
+        if (!valid_) {
+            computeFull(flux);
+            return Full;
+        }
+
+        // Find faces with changed flux direction.
+        changed_faces_.clear();
+        const int nf = grid_.number_of_faces;
+        for (int f = 0; f < nf; ++f) {
+            if (grid_.face_cells[2*f] < 0 || grid_.face_cells[2*f + 1] < 0) {
+                continue;
+            }
+            if (faceSign(flux[f]) != face_sign_[f]) {
+                changed_faces_.push_back(f);
+            }
+        }
+        if (changed_faces_.empty()) {
+            return Unchanged;
+        }
+
+        // Find the range of components that must be reordered: those
+        // between the up- and downwind components of faces that now
+        // point backwards in the sequence, and components containing
+        // a changed face, since they may split.
+        const int ncomp = numComponents();
+        int first_comp = ncomp;
+        int last_comp = -1;
+        for (const int f : changed_faces_) {
+            const signed char sign = faceSign(flux[f]);
+            face_sign_[f] = sign;
+            const int comp0 = cell_comp_[grid_.face_cells[2*f]];
+            const int comp1 = cell_comp_[grid_.face_cells[2*f + 1]];
+            if (comp0 == comp1) {
+                first_comp = std::min(first_comp, comp0);
+                last_comp = std::max(last_comp, comp0);
+            } else if ((sign > 0 && comp0 > comp1) || (sign < 0 && comp1 > comp0)) {
+                first_comp = std::min(first_comp, std::min(comp0, comp1));
+                last_comp = std::max(last_comp, std::max(comp0, comp1));
+            }
+        }
+        if (last_comp < first_comp) {
+            // All changes are consistent with the current sequence.
+            return Incremental;
+        }
+
+        // Reordering more than half of the cells is not worth it.
+        const int window_size = components_[last_comp + 1] - components_[first_comp];
+        if (2*window_size > grid_.number_of_cells) {
+            computeFull(flux);
+            return Full;
+        }
+        reorderWindow(first_comp, last_comp);
+        return Incremental;
+    }
+
+
+
+
+    void ReorderSequenceCache::clear()
+    {
+        valid_ = false;
+    }
+
+
+
+
+    const std::vector<int>& ReorderSequenceCache::sequence() const
+    {
+        return sequence_;
+    }
+
+
+
+
+    const std::vector<int>& ReorderSequenceCache::components() const
+    {
+        return components_;
+    }
+
+
+
+
+    int ReorderSequenceCache::numComponents() const
+    {
+        return components_.size() - 1;
+    }
+
+
+
+
+    const UnstructuredGrid& ReorderSequenceCache::grid() const
+    {
+        return grid_;
+    }
+
+
+
+
+    void ReorderSequenceCache::computeFull(const double* flux)
+    {
+        const int nc = grid_.number_of_cells;
+        const int nf = grid_.number_of_faces;
+        sequence_.resize(nc);
+        components_.resize(nc + 1);
+        int ncomp;
+        compute_sequence(&grid_, flux, sequence_.data(), components_.data(), &ncomp);
+        components_.resize(ncomp + 1);
+
+        for (int f = 0; f < nf; ++f) {
+            face_sign_[f] = faceSign(flux[f]);
+        }
+        updateCellComponents(0);
+        valid_ = true;
+    }
+
+
+
+
+    void ReorderSequenceCache::reorderWindow(const int first_comp, const int last_comp)
+    {
+        const int begin = components_[first_comp];
+        const int end = components_[last_comp + 1];
+        const int nw = end - begin;
+        for (int k = 0; k < nw; ++k) {
+            local_index_[sequence_[begin + k]] = k;
+        }
+
+        // Upwind graph restricted to the window, in local numbering.
+        std::vector<int> ia(nw + 1);
+        std::vector<int> ja;
+        ja.reserve(nw);
+        ia[0] = 0;
+        for (int k = 0; k < nw; ++k) {
+            const int cell = sequence_[begin + k];
+            for (int j = grid_.cell_facepos[cell]; j < grid_.cell_facepos[cell + 1]; ++j) {
+                const int f = grid_.cell_faces[j];
+                const bool first_cell = (grid_.face_cells[2*f] == cell);
+                const int other = grid_.face_cells[2*f + (first_cell ? 1 : 0)];
+                if (other < 0 || local_index_[other] < 0) {
+                    continue;
+                }
+                const int inflow = first_cell ? -face_sign_[f] : face_sign_[f];
+                if (inflow > 0) {
+                    ja.push_back(local_index_[other]);
+                }
+            }
+            ia[k + 1] = ja.size();
+        }
+
+        std::vector<int> vert(nw);
+        std::vector<int> comp(nw + 1);
+        std::vector<int> work(3 * nw);
+        int ncomp_window;
+        tarjan(nw, ia.data(), ja.data(), vert.data(), comp.data(), &ncomp_window, work.data());
+
+        // Splice the new order of the window into the sequence.
+        const std::vector<int> cells(sequence_.begin() + begin, sequence_.begin() + end);
+        for (int k = 0; k < nw; ++k) {
+            sequence_[begin + k] = cells[vert[k]];
+            local_index_[cells[k]] = -1;
+        }
+        std::vector<int> new_components;
+        new_components.reserve(components_.size() - (last_comp - first_comp + 1) + ncomp_window);
+        new_components.insert(new_components.end(), components_.begin(), components_.begin() + first_comp);
+        for (int c = 0; c < ncomp_window; ++c) {
+            new_components.push_back(begin + comp[c]);
+        }
+        new_components.insert(new_components.end(), components_.begin() + last_comp + 1, components_.end());
+        components_.swap(new_components);
+
+        updateCellComponents(first_comp);
+    }
+
+
+
+
+    void ReorderSequenceCache::updateCellComponents(const int first_comp)
+    {
+        const int ncomp = numComponents();
+        for (int c = first_comp; c < ncomp; ++c) {
+            for (int i = components_[c]; i < components_[c + 1]; ++i) {
+                cell_comp_[sequence_[i]] = c;
+            }
+        }
+    }
+
+} // namespace Opm
@@ -0,0 +1,88 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_REORDERSEQUENCECACHE_HEADER_INCLUDED
+#define OPM_REORDERSEQUENCECACHE_HEADER_INCLUDED
+
+#include <vector>
+
+struct UnstructuredGrid;
+
+namespace Opm
+{
+
+    /// Keeps the causal cell ordering of compute_sequence() between
+    /// calls, and updates it only as far as the flux field requires.
+    ///
+    /// The ordering only depends on the direction of the flux over
+    /// each interior face. If no face has changed direction, the
+    /// cached sequence is reused as is. If some faces have changed
+    /// direction, only the components between the up- and downwind
+    /// cells of faces that now contradict the ordering are reordered,
+    /// using Tarjan's algorithm on that part of the graph. The full
+    /// ordering is recomputed if that part is large.
+    class ReorderSequenceCache
+    {
+    public:
+        /// How the last call to update() obtained the ordering.
+        enum UpdateType { Unchanged, Incremental, Full };
+
+        /// Construct with no ordering computed.
+        explicit ReorderSequenceCache(const UnstructuredGrid& grid);
+
+        /// Bring the ordering up to date with a flux field.
+        /// \param[in] flux  Darcy flux, one value per face, positive
+        ///                  from face_cells[2*f] to face_cells[2*f + 1].
+        /// \return          how the ordering was obtained.
+        UpdateType update(const double* flux);
+
+        /// Forget the cached ordering, the next update() recomputes it.
+        void clear();
+
+        /// Causal cell permutation, see compute_sequence().
+        const std::vector<int>& sequence() const;
+
+        /// Start of each strongly connected component in sequence(),
+        /// and one-past-the-end. Size numComponents() + 1.
+        const std::vector<int>& components() const;
+
+        /// Number of strongly connected components.
+        int numComponents() const;
+
+        /// Grid of the ordering.
+        const UnstructuredGrid& grid() const;
+
+    private:
+        void computeFull(const double* flux);
+        void reorderWindow(const int first_comp, const int last_comp);
+        void updateCellComponents(const int first_comp);
+
+        const UnstructuredGrid& grid_;
+        bool valid_;
+        std::vector<signed char> face_sign_;
+        std::vector<int> sequence_;
+        std::vector<int> components_;
+        std::vector<int> cell_comp_;
+        std::vector<int> changed_faces_;
+        std::vector<int> local_index_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_REORDERSEQUENCECACHE_HEADER_INCLUDED
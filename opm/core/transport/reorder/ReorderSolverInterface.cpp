@@ -23,6 +23,7 @@
 #include <opm/grid/UnstructuredGrid.h>
 #include <opm/grid/utility/StopWatch.hpp>
 
+#include <exception>
 #include <vector>
 #include <cassert>
 #include <iostream>
@@ -30,48 +31,108 @@
 
 void Opm::ReorderSolverInterface::reorderAndTransport(const UnstructuredGrid& grid, const double* darcyflux)
 {
-    // Compute reordered sequence of single-cell problems
-    sequence_.resize(grid.number_of_cells);
-    components_.resize(grid.number_of_cells + 1);
-    int ncomponents;
+    // Compute reordered sequence of single-cell problems, or update
+    // the one from the previous call.
+    if (!ordering_ || &ordering_->grid() != &grid) {
+        ordering_.reset(new ReorderSequenceCache(grid));
+    }
     time::StopWatch clock;
     clock.start();
-    compute_sequence(&grid, darcyflux, &sequence_[0], &components_[0], &ncomponents);
+    if (ordering_->update(darcyflux) != ReorderSequenceCache::Unchanged) {
+        levels_.clear();
+    }
     clock.stop();
     std::cout << "Topological sort took: " << clock.secsSinceStart() << " seconds." << std::endl;
+    const std::vector<int>& sequence = ordering_->sequence();
+    const std::vector<int>& components = ordering_->components();
+    const int ncomponents = ordering_->numComponents();
 
-    // Make vector's size match actual used data.
-    components_.resize(ncomponents + 1);
-
-    // Invoke appropriate solve method for each interdependent component.
-    for (int comp = 0; comp < ncomponents; ++comp) {
+    if (!concurrent_components_) {
+        // Invoke appropriate solve method for each interdependent component.
+        for (int comp = 0; comp < ncomponents; ++comp) {
 #if 0
 #ifdef MATLAB_MEX_FILE
-	// \TODO replace this with general signal handling code, check if it costs performance.
-        if (interrupt_signal) {
-            mexPrintf("Reorder loop interrupted by user: %d of %d "
-                      "cells finished.\n", i, grid.number_of_cells);
-            break;
-        }
+            // \TODO replace this with general signal handling code, check if it costs performance.
+            if (interrupt_signal) {
+                mexPrintf("Reorder loop interrupted by user: %d of %d "
+                          "cells finished.\n", i, grid.number_of_cells);
+                break;
+            }
 #endif
 #endif
-	const int comp_size = components_[comp + 1] - components_[comp];
-	if (comp_size == 1) {
-	    solveSingleCell(sequence_[components_[comp]]);
-	} else {
-	    solveMultiCell(comp_size, &sequence_[components_[comp]]);
-	}
+            solveComponent(comp);
+        }
+        return;
+    }
+
+    // Group the components into levels of mutually independent
+    // components, and solve the components of each level concurrently.
+    if (levels_.empty()) {
+        levels_.resize(ncomponents + 1);
+        level_components_.resize(ncomponents);
+        int nlevels;
+        compute_component_levels(&grid, &sequence[0], &components[0], ncomponents,
+                                 &levels_[0], &level_components_[0], &nlevels);
+        levels_.resize(nlevels + 1);
+    }
+    const int nlevels = levels_.size() - 1;
+
+    for (int level = 0; level < nlevels; ++level) {
+        const int level_begin = levels_[level];
+        const int level_end = levels_[level + 1];
+        // Exceptions must not escape the parallel region, the first
+        // one caught is rethrown after the level has been processed.
+        std::exception_ptr error;
+#if HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16) if(concurrent_components_)
+#endif // HAVE_OPENMP
+        for (int ix = level_begin; ix < level_end; ++ix) {
+            try {
+                solveComponent(level_components_[ix]);
+            } catch (...) {
+#if HAVE_OPENMP
+#pragma omp critical(ReorderSolverInterface_error)
+#endif // HAVE_OPENMP
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+
+void Opm::ReorderSolverInterface::solveComponent(const int comp)
+{
+    const std::vector<int>& sequence = ordering_->sequence();
+    const std::vector<int>& components = ordering_->components();
+    const int comp_size = components[comp + 1] - components[comp];
+    if (comp_size == 1) {
+        solveSingleCell(sequence[components[comp]]);
+    } else {
+        solveMultiCell(comp_size, &sequence[components[comp]]);
     }
 }
 
 
+void Opm::ReorderSolverInterface::setConcurrentComponents(const bool concurrent)
+{
+    concurrent_components_ = concurrent;
+}
+
+
 const std::vector<int>& Opm::ReorderSolverInterface::sequence() const
 {
-    return sequence_;
+    static const std::vector<int> empty;
+    return ordering_ ? ordering_->sequence() : empty;
 }
 
 
 const std::vector<int>& Opm::ReorderSolverInterface::components() const
 {
-    return components_;
+    static const std::vector<int> empty;
+    return ordering_ ? ordering_->components() : empty;
 }
@@ -20,6 +20,9 @@
 #ifndef OPM_REORDERSOLVERINTERFACE_HEADER_INCLUDED
 #define OPM_REORDERSOLVERINTERFACE_HEADER_INCLUDED
 
+#include <opm/core/transport/reorder/ReorderSequenceCache.hpp>
+
+#include <memory>
 #include <vector>
 
 struct UnstructuredGrid;
@@ -35,9 +38,16 @@ namespace Opm
     /// class.) The reorderAndTransport() method is provided as an aid
     /// to implementing solve() in subclasses, together with the
     /// sequence() and components() methods for accessing the ordering.
+    /// The ordering is kept between calls, and only updated where the
+    /// flux directions have changed (see ReorderSequenceCache).
+    ///
+    /// If enabled by setConcurrentComponents(), independent components
+    /// are solved concurrently by OpenMP threads, one level of the
+    /// ordering (see compute_component_levels()) at a time.
     class ReorderSolverInterface
     {
     public:
+    ReorderSolverInterface() : concurrent_components_(false) {}
     virtual ~ReorderSolverInterface() {}
     private:
 	virtual void solveSingleCell(const int cell) = 0;
@@ -46,9 +56,17 @@ namespace Opm
 	void reorderAndTransport(const UnstructuredGrid& grid, const double* darcyflux);
         const std::vector<int>& sequence() const;
         const std::vector<int>& components() const;
+        /// Allow reorderAndTransport() to solve independent components
+        /// concurrently. Only valid if solveSingleCell() and
+        /// solveMultiCell() write nothing but data belonging to their
+        /// own cells, and only read data of neighbouring cells.
+        void setConcurrentComponents(const bool concurrent);
     private:
-        std::vector<int> sequence_;
-        std::vector<int> components_;
+        void solveComponent(const int comp);
+        std::unique_ptr<ReorderSequenceCache> ordering_;
+        std::vector<int> levels_;
+        std::vector<int> level_components_;
+        bool concurrent_components_;
     };
 
 
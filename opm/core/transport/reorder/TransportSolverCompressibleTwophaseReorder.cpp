@@ -45,7 +45,8 @@ namespace Opm
                                                    const UnstructuredGrid& grid,
                                                    const Opm::BlackoilPropertiesInterface& props,
                                                    const double tol,
-                                                   const int maxit)
+                                                   const int maxit,
+                                                   const bool threads)
         : grid_(grid),
           props_(props),
           tol_(tol),
@@ -76,6 +77,9 @@ namespace Opm
             allcells_[i] = i;
         }
         props.satRange(props.numCells(), &allcells_[0], &smin_[0], &smax_[0]);
+        // Single-cell solves only modify their own cell, so independent
+        // components may be solved concurrently.
+        setConcurrentComponents(threads);
     }
 
     void TransportSolverCompressibleTwophaseReorder::solve(const double* darcyflux,
@@ -104,18 +108,13 @@ namespace Opm
             OPM_THROW(std::runtime_error, "TransportModelCompressibleTwophase requires a property object without miscibility.");
         }
 
-        std::vector<int> seq(grid_.number_of_cells);
-        std::vector<int> comp(grid_.number_of_cells + 1);
-        int ncomp;
-        compute_sequence_graph(&grid_, darcyflux_,
-                               &seq[0], &comp[0], &ncomp,
-                               &ia_upw_[0], &ja_upw_[0]);
+        // Only the graphs are needed here, the ordering itself is
+        // computed (or reused) by reorderAndTransport().
+        compute_upwind_graph(&grid_, darcyflux_, &ia_upw_[0], &ja_upw_[0]);
         const int nf = grid_.number_of_faces;
         std::vector<double> neg_darcyflux(nf);
         std::transform(darcyflux, darcyflux + nf, neg_darcyflux.begin(), std::negate<double>());
-        compute_sequence_graph(&grid_, &neg_darcyflux[0],
-                               &seq[0], &comp[0], &ncomp,
-                               &ia_downw_[0], &ja_downw_[0]);
+        compute_upwind_graph(&grid_, &neg_darcyflux[0], &ia_downw_[0], &ja_downw_[0]);
         reorderAndTransport(grid_, darcyflux);
         toBothSat(saturation_, saturation);
 
@@ -300,6 +299,9 @@ namespace Opm
             OPM_THROW(std::runtime_error, "In solveMultiCell(), we did not converge after "
                   << num_iters << " iterations. Remaining update count = " << update_count);
         }
+#if HAVE_OPENMP
+#pragma omp critical(TransportSolverCompressibleTwophaseReorder_output)
+#endif // HAVE_OPENMP
         std::cout << "Solved " << num_cells << " cell multicell problem in "
                   << num_iters << " iterations." << std::endl;
 
@@ -40,10 +40,13 @@ namespace Opm
         /// \param[in] props     Rock and fluid properties.
         /// \param[in] tol       Tolerance used in the solver.
         /// \param[in] maxit     Maximum number of non-linear iterations used.
+        /// \param[in] threads   If true, independent components are solved
+        ///                      concurrently by OpenMP threads.
         TransportSolverCompressibleTwophaseReorder(const UnstructuredGrid& grid,
                                            const Opm::BlackoilPropertiesInterface& props,
                                            const double tol,
-                                           const int maxit);
+                                           const int maxit,
+                                           const bool threads = false);
 
         /// Solve for saturation at next timestep.
         /// \param[in] darcyflux         Array of signed face fluxes.
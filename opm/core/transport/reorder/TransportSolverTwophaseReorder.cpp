@@ -47,7 +47,8 @@ namespace Opm
                                                                    const Opm::IncompPropertiesInterface& props,
                                                                    const double* gravity,
                                                                    const double tol,
-                                                                   const int maxit)
+                                                                   const int maxit,
+                                                                   const bool threads)
         : grid_(grid),
           props_(props),
           tol_(tol),
@@ -78,6 +79,9 @@ namespace Opm
             cells[i] = i;
         }
         props.satRange(props.numCells(), &cells[0], &smin_[0], &smax_[0]);
+        // Single-cell solves only modify their own cell, so independent
+        // components may be solved concurrently.
+        setConcurrentComponents(threads);
         if (gravity) {
             initGravity(gravity);
             initColumns();
@@ -102,18 +106,13 @@ namespace Opm
         toWaterSat(state.saturation(), saturation_);
 
 #ifdef EXPERIMENT_GAUSS_SEIDEL
-        std::vector<int> seq(grid_.number_of_cells);
-        std::vector<int> comp(grid_.number_of_cells + 1);
-        int ncomp;
-        compute_sequence_graph(&grid_, darcyflux_,
-                               &seq[0], &comp[0], &ncomp,
-                               &ia_upw_[0], &ja_upw_[0]);
+        // Only the graphs are needed here, the ordering itself is
+        // computed (or reused) by reorderAndTransport().
+        compute_upwind_graph(&grid_, darcyflux_, &ia_upw_[0], &ja_upw_[0]);
         const int nf = grid_.number_of_faces;
         std::vector<double> neg_darcyflux(nf);
         std::transform(darcyflux_, darcyflux_ + nf, neg_darcyflux.begin(), std::negate<double>());
-        compute_sequence_graph(&grid_, &neg_darcyflux[0],
-                               &seq[0], &comp[0], &ncomp,
-                               &ia_downw_[0], &ja_downw_[0]);
+        compute_upwind_graph(&grid_, &neg_darcyflux[0], &ia_downw_[0], &ja_downw_[0]);
 #endif
         std::fill(reorder_iterations_.begin(),reorder_iterations_.end(),0);
         reorderAndTransport(grid_, darcyflux_);
@@ -414,6 +413,9 @@ namespace Opm
             OPM_THROW(std::runtime_error, "In solveMultiCell(), we did not converge after "
                   << num_iters << " iterations. Remaining update count = " << update_count);
         }
+#if HAVE_OPENMP
+#pragma omp critical(TransportSolverTwophaseReorder_output)
+#endif // HAVE_OPENMP
         std::cout << "Solved " << num_cells << " cell multicell problem in "
                   << num_iters << " iterations." << std::endl;
 
@@ -450,6 +452,9 @@ namespace Opm
             OPM_THROW(std::runtime_error, "In solveMultiCell(), we did not converge after "
                   << num_iters << " iterations. Delta s = " << max_s_change);
         }
+#if HAVE_OPENMP
+#pragma omp critical(TransportSolverTwophaseReorder_output)
+#endif // HAVE_OPENMP
         std::cout << "Solved " << num_cells << " cell multicell problem in "
                   << num_iters << " iterations." << std::endl;
 #endif // EXPERIMENT_GAUSS_SEIDEL
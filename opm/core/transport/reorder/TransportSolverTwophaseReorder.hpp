@@ -42,11 +42,14 @@ namespace Opm
         /// \param[in] gravity   Gravity vector (null for no gravity).
         /// \param[in] tol       Tolerance used in the solver.
         /// \param[in] maxit     Maximum number of non-linear iterations used.
+        /// \param[in] threads   If true, independent components are solved
+        ///                      concurrently by OpenMP threads.
         TransportSolverTwophaseReorder(const UnstructuredGrid& grid,
                                        const Opm::IncompPropertiesInterface& props,
                                        const double* gravity,
                                        const double tol,
-                                       const int maxit);
+                                       const int maxit,
+                                       const bool threads = false);
 
         // Virtual destructor.
         virtual ~TransportSolverTwophaseReorder();
@@ -177,6 +177,87 @@ compute_sequence_graph(const struct UnstructuredGrid* grid       ,
 }
 
 
+// ---------------------------------------------------------------------
+void
+compute_upwind_graph(const struct UnstructuredGrid* grid,
+                     const double*                  flux,
+                     int*                           ia  ,
+                     int*                           ja  )
+// ---------------------------------------------------------------------
+{
+    std::vector<int> work(grid->number_of_faces);
+
+    make_upwind_graph(grid->number_of_cells,
+                      grid->cell_faces,
+                      grid->cell_facepos,
+                      grid->face_cells,
+                      flux, ia, ja, & work[0]);
+}
+
+
+// ---------------------------------------------------------------------
+void
+compute_component_levels(const struct UnstructuredGrid* grid            ,
+                         const int*                     sequence        ,
+                         const int*                     components      ,
+                         int                            ncomponents     ,
+                         int*                           levels          ,
+                         int*                           level_components,
+                         int*                           nlevels         )
+// ---------------------------------------------------------------------
+{
+    const int nc = grid->number_of_cells;
+
+    /* Component of each cell. */
+    std::vector<int> cell_comp(nc);
+    for (int c = 0; c < ncomponents; ++c) {
+        for (int i = components[c]; i < components[c + 1]; ++i) {
+            cell_comp[sequence[i]] = c;
+        }
+    }
+
+    /* Level of each component.  Components are visited in causal
+       order, so the levels of all earlier neighbours are known. */
+    std::vector<int> comp_level(ncomponents, 0);
+    int max_level = -1;
+    for (int c = 0; c < ncomponents; ++c) {
+        int level = 0;
+        for (int i = components[c]; i < components[c + 1]; ++i) {
+            const int cell = sequence[i];
+            for (int j = grid->cell_facepos[cell]; j < grid->cell_facepos[cell + 1]; ++j) {
+                const int f     = grid->cell_faces[j];
+                const int other = (grid->face_cells[2*f + 0] == cell)
+                                ?  grid->face_cells[2*f + 1]
+                                :  grid->face_cells[2*f + 0];
+                if (other < 0) {
+                    continue;
+                }
+                const int other_comp = cell_comp[other];
+                if (other_comp < c) {
+                    level = std::max(level, comp_level[other_comp] + 1);
+                }
+            }
+        }
+        comp_level[c] = level;
+        max_level = std::max(max_level, level);
+    }
+    *nlevels = max_level + 1;
+
+    /* Group components by level (counting sort, stable). */
+    std::fill(levels, levels + *nlevels + 1, 0);
+    for (int c = 0; c < ncomponents; ++c) {
+        ++levels[comp_level[c] + 1];
+    }
+    for (int l = 0; l < *nlevels; ++l) {
+        levels[l + 1] += levels[l];
+    }
+    std::vector<int> pos(levels, levels + *nlevels);
+    for (int c = 0; c < ncomponents; ++c) {
+        level_components[pos[comp_level[c]]++] = c;
+    }
+}
+
+
 /* Local Variables:    */
 /* c-basic-offset:4    */
 /* End:                */
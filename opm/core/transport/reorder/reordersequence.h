@@ -138,6 +138,84 @@ compute_sequence_graph(const struct UnstructuredGrid *grid       ,
                        int                           *ia         ,
                        int                           *ja         );
 
+
+/**
+ * Compute the upwind graph of a specific Darcy flux field, without
+ * computing a causal permutation.
+ *
+ * \param[in] grid Grid structure.
+ *
+ * \param[in] flux Darcy flux field.  One scalar value for each
+ *                 interface/connection in the grid, including the
+ *                 boundary.  We assume that <CODE>flux[f]</CODE> is
+ *                 positive if the flow is from cell
+ *                 <CODE>grid->face_cells[2*f + 0]</CODE> to cell
+ *                 <CODE>grid->face_cells[2*f + 1]</CODE>.
+ *
+ * \param[out] ia  Indirection pointers into <CODE>ja</CODE>.  Array
+ *                 of size <CODE>grid->number_of_cells + 1</CODE>.
+ *
+ * \param[out] ja  Compressed-sparse representation of the upwind
+ *                 graph, as for compute_sequence_graph().
+ */
+void
+compute_upwind_graph(const struct UnstructuredGrid *grid,
+                     const double                  *flux,
+                     int                           *ia  ,
+                     int                           *ja  );
+
+/**
+ * Partition the strongly connected components of a causal cell
+ * permutation into levels (wavefronts) of mutually independent
+ * components.
+ *
+ * A component is placed in the level following the highest level of
+ * any earlier component that contains a neighbouring cell, i.e., a
+ * cell sharing an interior face with one of its cells.  Therefore, no
+ * two components in the same level are adjacent in the grid, and every
+ * component that may influence another lies in a lower level.  The
+ * components of a single level may then be solved concurrently, level
+ * by level, with exactly the same result as when processing the
+ * components sequentially.
+ *
+ * \param[in] grid Grid structure for which the permutation was
+ *                 computed.
+ *
+ * \param[in] sequence
+ *                 Causal grid cell permutation as computed by
+ *                 compute_sequence() or compute_sequence_graph().
+ *
+ * \param[in] components
+ *                 Indirection pointers describing the strongly
+ *                 connected components of <CODE>sequence</CODE>.
+ *
+ * \param[in] ncomponents
+ *                 Number of strongly connected components.
+ *
+ * \param[out] levels
+ *                 Indirection pointers that describe the levels.
+ *                 Specifically, the \f$i\f$'th level constitutes
+ *                 components <CODE>level_components[levels[i]
+ *                 ... levels[i + 1] - 1]</CODE>.  Must point to an
+ *                 array of <CODE>ncomponents + 1</CODE> elements.
+ *
+ * \param[out] level_components
+ *                 Component indices, grouped by level.  Within a
+ *                 level, the components retain their causal order.
+ *                 Array of size <CODE>ncomponents</CODE>.
+ *
+ * \param[out] nlevels
+ *                 Number of levels.  Pointer to a single integer.
+ */
+void
+compute_component_levels(const struct UnstructuredGrid *grid            ,
+                         const int                     *sequence        ,
+                         const int                     *components      ,
+                         int                            ncomponents     ,
+                         int                           *levels          ,
+                         int                           *level_components,
+                         int                           *nlevels         );
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -0,0 +1,188 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_UNIFORMGRIDTABLE_HEADER_INCLUDED
+#define OPM_UNIFORMGRIDTABLE_HEADER_INCLUDED
+
+#include <opm/common/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Piecewise linear function sampled on a uniform grid.
+    ///
+    /// Evaluation finds the interval by index arithmetic instead of an
+    /// interval search, and the batched evaluate() has no data dependent
+    /// branches, so that it vectorizes across cells. Outside the sampled
+    /// range the end intervals are extrapolated linearly. Callers that
+    /// need the extrapolation of the original function should check
+    /// contains() first.
+    class UniformGridTable
+    {
+    public:
+        /// Construct an empty table.
+        UniformGridTable()
+            : xmin_(0.0),
+              xmax_(0.0),
+              inv_dx_(0.0),
+              error_(0.0)
+        {
+        }
+
+        /// Construct from samples y[i] = f(xmin + i*(xmax - xmin)/(y.size() - 1)).
+        UniformGridTable(const double xmin,
+                         const double xmax,
+                         std::vector<double> y)
+            : xmin_(xmin),
+              xmax_(xmax),
+              y_(std::move(y)),
+              error_(0.0)
+        {
+            if (!(xmax_ > xmin_) || y_.size() < 2) {
+                OPM_THROW(std::logic_error, "UniformGridTable needs xmax > xmin and at least two samples.");
+            }
+            inv_dx_ = numIntervals() / (xmax_ - xmin_);
+        }
+
+        /// Sample f uniformly on [xmin, xmax], doubling the number of
+        /// intervals from min_intervals until linear interpolation
+        /// deviates from f by at most tolerance * max |f| at the interval
+        /// midpoints and at the given extra check points (e.g. the knots
+        /// of a piecewise linear f), or until max_intervals is reached.
+        /// The achieved relative error is available from maxError().
+        template <class Function>
+        static UniformGridTable fromFunction(const Function& f,
+                                             const double xmin,
+                                             const double xmax,
+                                             const double tolerance,
+                                             const int min_intervals = 16,
+                                             const int max_intervals = 1 << 16,
+                                             const std::vector<double>& check_points = std::vector<double>())
+        {
+            int n = std::max(min_intervals, 1);
+            for (;;) {
+                std::vector<double> y(n + 1);
+                for (int i = 0; i <= n; ++i) {
+                    y[i] = f(xmin + i * (xmax - xmin) / n);
+                }
+                UniformGridTable table(xmin, xmax, std::move(y));
+
+                double scale = 0.0;
+                for (const double yi : table.y_) {
+                    scale = std::max(scale, std::fabs(yi));
+                }
+                double err = 0.0;
+                for (int i = 0; i < n; ++i) {
+                    const double x = xmin + (i + 0.5) * (xmax - xmin) / n;
+                    err = std::max(err, std::fabs(f(x) - table(x)));
+                }
+                for (const double x : check_points) {
+                    if (table.contains(x)) {
+                        err = std::max(err, std::fabs(f(x) - table(x)));
+                    }
+                }
+                table.error_ = (scale > 0.0) ? err / scale : err;
+
+                if (table.error_ <= tolerance || 2 * n > max_intervals) {
+                    return table;
+                }
+                n *= 2;
+            }
+        }
+
+        /// True if no samples are stored.
+        bool empty() const
+        {
+            return y_.empty();
+        }
+
+        /// Number of intervals.
+        int numIntervals() const
+        {
+            return int(y_.size()) - 1;
+        }
+
+        /// Relative error measured by fromFunction(), zero otherwise.
+        double maxError() const
+        {
+            return error_;
+        }
+
+        /// True if x is within the sampled range.
+        bool contains(const double x) const
+        {
+            return !empty() && x >= xmin_ && x <= xmax_;
+        }
+
+        /// Function value.
+        double operator()(const double x) const
+        {
+            const double s = (x - xmin_) * inv_dx_;
+            const int i = interval(s);
+            return y_[i] + (s - i) * (y_[i + 1] - y_[i]);
+        }
+
+        /// Derivative, constant within each interval.
+        double derivative(const double x) const
+        {
+            const int i = interval((x - xmin_) * inv_dx_);
+            return (y_[i + 1] - y_[i]) * inv_dx_;
+        }
+
+        /// Function values and derivatives at n points.
+        void evaluate(const int n,
+                      const double* x,
+                      double* y,
+                      double* dydx) const
+        {
+            const double* yt = y_.data();
+            for (int k = 0; k < n; ++k) {
+                const double s = (x[k] - xmin_) * inv_dx_;
+                const int i = interval(s);
+                const double slope = yt[i + 1] - yt[i];
+                y[k] = yt[i] + (s - i) * slope;
+                dydx[k] = slope * inv_dx_;
+            }
+        }
+
+    private:
+        // Interval containing the scaled coordinate s, clamped to the end
+        // intervals.
+        int interval(const double s) const
+        {
+            const double last = numIntervals() - 1;
+            return static_cast<int>(std::min(std::max(s, 0.0), last));
+        }
+
+        double xmin_;
+        double xmax_;
+        double inv_dx_;
+        std::vector<double> y_;
+        double error_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_UNIFORMGRIDTABLE_HEADER_INCLUDED
@@ -250,7 +250,8 @@ namespace Opm
                    gravity, wells_manager.c_wells() /*, src, bcs*/),
           tsolver_(grid, props,
                    param.getDefault("nl_tolerance", 1e-9),
-                   param.getDefault("nl_maxiter", 30))
+                   param.getDefault("nl_maxiter", 30),
+                   param.getDefault("reorder_threads", false))
     {
         // For output.
         output_ = param.getDefault("output", true);
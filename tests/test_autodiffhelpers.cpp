@@ -22,6 +22,8 @@
 #define BOOST_TEST_MODULE AutoDiffHelpersTest
 
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/StencilOps.hpp>
+#include <opm/grid/GridManager.hpp>
 
 #include <boost/test/unit_test.hpp>
 
@@ -224,3 +226,168 @@ BOOST_AUTO_TEST_CASE(subsetEmptyTest)
     }
 }
 
+
+BOOST_AUTO_TEST_CASE(stencilOpsTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    const GridManager gm(3, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const HelperOps ops(grid);
+    const StencilOps stencil(ops);
+    const int nc = grid.number_of_cells;
+    BOOST_REQUIRE_EQUAL(stencil.numCells(), nc);
+    BOOST_REQUIRE_EQUAL(stencil.numConnections(), ops.internal_faces.size());
+
+    V p(nc);
+    V s(nc);
+    for (int c = 0; c < nc; ++c) {
+        p[c] = 1.0 + c*c;
+        s[c] = 0.1*c;
+    }
+    const std::vector<ADB> vars = ADB::variables({ p, s });
+    const ADB x = vars[0] * vars[1] + vars[0];
+
+    const ADB ngrad_ref = ops.ngrad * x;
+    const ADB grad_ref = ops.grad * x;
+    const ADB caver_ref = ops.caver * x;
+    const ADB ngrad = stencil.ngrad(x);
+    const ADB grad = stencil.grad(x);
+    const ADB caver = stencil.caver(x);
+    const ADB flux = caver * ngrad;
+    const ADB div_ref = ops.div * flux;
+    const ADB div = stencil.div(flux);
+
+    const std::vector<std::pair<ADB, ADB> > pairs = {
+        { ngrad_ref, ngrad }, { grad_ref, grad }, { caver_ref, caver }, { div_ref, div }
+    };
+    for (const auto& pr : pairs) {
+        BOOST_CHECK_SMALL((pr.first.value() - pr.second.value()).abs().maxCoeff(), 1e-14);
+        BOOST_REQUIRE_EQUAL(pr.first.numBlocks(), pr.second.numBlocks());
+        for (int block = 0; block < pr.first.numBlocks(); ++block) {
+            const Eigen::MatrixXd ref(pr.first.derivative()[block].getSparse());
+            const Eigen::MatrixXd mf(pr.second.derivative()[block].getSparse());
+            BOOST_CHECK_SMALL((ref - mf).cwiseAbs().maxCoeff(), 1e-14);
+        }
+    }
+
+    const V z = V::LinSpaced(nc, 0.0, 1.0);
+    const V ngradz_ref = (ops.ngrad * z.matrix()).array();
+    BOOST_CHECK_SMALL((stencil.ngrad(z) - ngradz_ref).abs().maxCoeff(), 1e-14);
+}
+
+BOOST_AUTO_TEST_CASE(selectorTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    V p(5);
+    p << 5.0, 3.0, 4.0, 1.0, 2.0;
+    const std::vector<ADB> vars = ADB::variables({ p, V(0.1 * p) });
+    const ADB x1 = vars[0] * vars[1];
+    const ADB x2 = ADB::constant(V::Constant(5, 7.0));
+
+    const Selector<double> sel(p - 3.0);
+    const ADB x = sel.select(x1, x2);
+    const std::vector<int> left = { 0, 1, 2 };
+    const std::vector<int> right = { 3, 4 };
+    const ADB ref = superset(subset(x1, left), left, 5) + superset(subset(x2, right), right, 5);
+
+    BOOST_CHECK_SMALL((x.value() - ref.value()).abs().maxCoeff(), 1e-14);
+    BOOST_REQUIRE_EQUAL(x.numBlocks(), ref.numBlocks());
+    for (int block = 0; block < x.numBlocks(); ++block) {
+        const Eigen::MatrixXd jac(x.derivative()[block].getSparse());
+        const Eigen::MatrixXd jac_ref(ref.derivative()[block].getSparse());
+        BOOST_CHECK_SMALL((jac - jac_ref).cwiseAbs().maxCoeff(), 1e-14);
+    }
+
+    const V v = sel.select(p, V(2.0 * p));
+    BOOST_CHECK_EQUAL(v[0], 5.0);
+    BOOST_CHECK_EQUAL(v[3], 2.0);
+}
+
+BOOST_AUTO_TEST_CASE(upwindSelectorTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    const GridManager gm(3, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const HelperOps ops(grid);
+    const int nc = grid.number_of_cells;
+    const int nif = ops.internal_faces.size();
+
+    V p(nc);
+    for (int c = 0; c < nc; ++c) {
+        p[c] = 1.0 + c*c;
+    }
+    const std::vector<ADB> vars = ADB::variables({ p, V(0.1 * p) });
+    const ADB x = vars[0] * vars[1];
+
+    // Flow in both directions.
+    V flux(nif);
+    std::vector<int> upwind_cells(nif);
+    for (int iface = 0; iface < nif; ++iface) {
+        flux[iface] = (iface % 3 == 0) ? -1.0 : 1.0;
+        const int f = ops.internal_faces[iface];
+        upwind_cells[iface] = grid.face_cells[2*f + (flux[iface] >= 0.0 ? 0 : 1)];
+    }
+    const UpwindSelector<double> upwind(grid, ops, flux);
+
+    // The same selection applied repeatedly, and to several quantities.
+    const std::vector<ADB> xs = upwind.select(std::vector<ADB>{ x, vars[0] });
+    const std::vector<ADB> refs = { subset(x, upwind_cells), subset(vars[0], upwind_cells) };
+    for (int q = 0; q < 2; ++q) {
+        BOOST_CHECK_SMALL((xs[q].value() - refs[q].value()).abs().maxCoeff(), 1e-14);
+        BOOST_REQUIRE_EQUAL(xs[q].numBlocks(), refs[q].numBlocks());
+        for (int block = 0; block < xs[q].numBlocks(); ++block) {
+            const Eigen::MatrixXd jac(xs[q].derivative()[block].getSparse());
+            const Eigen::MatrixXd jac_ref(refs[q].derivative()[block].getSparse());
+            BOOST_CHECK_SMALL((jac - jac_ref).cwiseAbs().maxCoeff(), 1e-14);
+        }
+    }
+    BOOST_CHECK_SMALL((upwind.select(p) - subset(p, upwind_cells)).abs().maxCoeff(), 1e-14);
+}
+
+BOOST_AUTO_TEST_CASE(subsetPlanTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    const int n = 6;
+    V p = V::LinSpaced(n, 1.0, 6.0);
+    const std::vector<ADB> vars = ADB::variables({ p, V(0.5 * p) });
+    Eigen::SparseMatrix<double> grad(n - 1, n);
+    for (int i = 0; i < n - 1; ++i) {
+        grad.insert(i, i) = -1.0;
+        grad.insert(i, i + 1) = 1.0;
+    }
+    const Eigen::SparseMatrix<double> div = grad.transpose();
+    // Diagonal Jacobian in the first block, sparse in the second.
+    const ADB x = vars[0] * 2.0 + div * (grad * vars[1]);
+
+    // Unordered, and with a repeated index.
+    for (const std::vector<int>& indices : { std::vector<int>{ 1, 3, 4 },
+                                             std::vector<int>{ 4, 0, 2 },
+                                             std::vector<int>{ 2, 5, 2 } }) {
+        const SubsetPlan plan(indices, n);
+        const Eigen::SparseMatrix<double> sup = constructSupersetSparseMatrix<double>(n, indices);
+        const Eigen::SparseMatrix<double> sub = sup.transpose();
+        const ADB xs = subset(x, plan);
+        const ADB xs_ref = sub * x;
+        const ADB y = xs * xs;
+        const ADB ys = superset(y, plan);
+        const ADB ys_ref = sup * y;
+        for (const auto& pr : { std::make_pair(xs, xs_ref), std::make_pair(ys, ys_ref) }) {
+            BOOST_CHECK_SMALL((pr.first.value() - pr.second.value()).abs().maxCoeff(), 1e-14);
+            for (int block = 0; block < pr.first.numBlocks(); ++block) {
+                const Eigen::MatrixXd jac(pr.first.derivative()[block].getSparse());
+                const Eigen::MatrixXd jac_ref(pr.second.derivative()[block].getSparse());
+                BOOST_CHECK_SMALL((jac - jac_ref).cwiseAbs().maxCoeff(), 1e-14);
+            }
+        }
+        const V vs = superset(y.value(), plan);
+        BOOST_CHECK_SMALL((vs - ys_ref.value()).abs().maxCoeff(), 1e-14);
+    }
+}
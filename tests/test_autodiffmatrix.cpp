@@ -26,6 +26,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <limits>
+#include <vector>
+
 typedef Eigen::SparseMatrix<double> Sp;
 typedef Opm::AutoDiffMatrix Mat;
 using namespace Opm;
@@ -425,3 +428,162 @@ BOOST_AUTO_TEST_CASE(nonZeros)
     BOOST_CHECK_EQUAL(s.nonZeros(), 4);
 }
 
+
+
+BOOST_AUTO_TEST_CASE(SelectRows)
+{
+    Mat z = Mat(3, 3);
+
+    Mat i = Mat::createIdentity(3);
+    Sp is(Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>::Identity(3,3).sparseView());
+
+    Eigen::Array<double, Eigen::Dynamic, 1> d1(3);
+    d1 << 0.2, 1.2, 13.4;
+    Mat d = Mat(d1.matrix().asDiagonal());
+    Sp ds = spdiag(d1);
+
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> s1(3,3);
+    s1 <<
+        1.0, 0.0, 2.0,
+        0.0, 1.0, 0.0,
+        0.0, 0.0, 2.0;
+    Sp ss(s1.sparseView());
+    Mat s = Mat(ss);
+
+    // Upwind-like selection, with a repeated and a skipped row.
+    const std::vector<int> rows = { 2, 0, -1, 2 };
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> p1 = Eigen::MatrixXd::Zero(4, 3);
+    for (int r = 0; r < 4; ++r) {
+        if (rows[r] >= 0) {
+            p1(r, rows[r]) = 1.0;
+        }
+    }
+    Sp ps(p1.sparseView());
+
+    Sp x;
+    z.selectRows(rows).toSparse(x);
+    BOOST_CHECK(x == Sp(4, 3));
+    i.selectRows(rows).toSparse(x);
+    BOOST_CHECK(x == Sp(ps*is));
+    d.selectRows(rows).toSparse(x);
+    BOOST_CHECK(x == Sp(ps*ds));
+    s.selectRows(rows).toSparse(x);
+    BOOST_CHECK(x == Sp(ps*ss));
+
+    // Masking in place keeps a diagonal matrix diagonal.
+    const std::vector<int> mask = { 0, -1, 2 };
+    Eigen::Array<double, Eigen::Dynamic, 1> m1(3);
+    m1 << 0.2, 0.0, 13.4;
+    const Mat dm = d.selectRows(mask);
+    BOOST_CHECK_EQUAL(dm.nonZeros(), 3);
+    dm.toSparse(x);
+    BOOST_CHECK(Eigen::MatrixXd(x) == Eigen::MatrixXd(m1.matrix().asDiagonal()));
+    s.selectRows(mask).toSparse(x);
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> sm1 = s1;
+    sm1.row(1).setZero();
+    BOOST_CHECK(x == Sp(sm1.sparseView()));
+}
+
+
+
+BOOST_AUTO_TEST_CASE(ThreadedKernels)
+{
+    // Banded matrices with a few long range couplings.
+    const int n = 200;
+    Sp a(n, n);
+    Sp b(n, n);
+    for (int i = 0; i < n; ++i) {
+        a.insert(i, i) = 1.0 + 0.01*i;
+        b.insert(i, (7*i) % n) = 0.5 - 0.003*i;
+        if (i > 0) {
+            a.insert(i, i - 1) = -0.3;
+        }
+        if (i % 5 == 0) {
+            a.insert(i, (i + 37) % n) = 0.1*i;
+        }
+    }
+    a.makeCompressed();
+    b.makeCompressed();
+    Eigen::Array<double, Eigen::Dynamic, 1> d1(n);
+    for (int i = 0; i < n; ++i) {
+        d1[i] = 1.0 + 0.5*i;
+    }
+
+    // The kernels themselves reproduce the serial results exactly.
+    Sp serial;
+    Sp threaded;
+    fastSparseProduct<Sp, Sp, Sp>(a, b, serial);
+    fastSparseProductThreaded(a, b, threaded);
+    BOOST_CHECK(threaded == serial);
+    fastSparseSum(a, b, threaded);
+    BOOST_CHECK(threaded == Sp(a + b));
+
+    // AutoDiffMatrix operations with and without threading.
+    const Mat ma(a);
+    const Mat mb(b);
+    const Mat md(d1.matrix().asDiagonal());
+    const std::size_t threshold = FastSparseThreading::threshold();
+    std::vector<Sp> results[2];
+    for (int pass = 0; pass < 2; ++pass) {
+        FastSparseThreading::setThreshold(pass == 0 ? std::numeric_limits<std::size_t>::max() : 0);
+        Sp x;
+        (ma * mb).toSparse(x);
+        results[pass].push_back(x);
+        (ma + mb).toSparse(x);
+        results[pass].push_back(x);
+        (md * ma).toSparse(x);
+        results[pass].push_back(x);
+        (ma * md).toSparse(x);
+        results[pass].push_back(x);
+        Mat acc = ma;
+        acc += ma;
+        acc.toSparse(x);
+        results[pass].push_back(x);
+    }
+    FastSparseThreading::setThreshold(threshold);
+    for (std::size_t k = 0; k < results[0].size(); ++k) {
+        BOOST_CHECK(results[1][k] == results[0][k]);
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(DiagonalKernelsTest)
+{
+    // Odd length, to exercise the remainder loops.
+    const int n = 19;
+    std::vector<double> a(n), x(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = 0.5 + i;
+        x[i] = 2.0 - 0.25*i;
+    }
+    std::vector<double> y = x;
+    DiagonalKernels::add(y.data(), a.data(), n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], x[i] + a[i]);
+    }
+    y = x;
+    DiagonalKernels::addScalar(y.data(), 3.0, n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], x[i] + 3.0);
+    }
+    y = x;
+    DiagonalKernels::multiply(y.data(), a.data(), n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], x[i] * a[i]);
+    }
+    y = x;
+    DiagonalKernels::scale(y.data(), -1.5, n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], x[i] * -1.5);
+    }
+    DiagonalKernels::product(y.data(), a.data(), x.data(), n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], a[i] * x[i]);
+    }
+    y = x;
+    DiagonalKernels::addProduct(y.data(), a.data(), a.data(), n);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(y[i], x[i] + a[i] * a[i]);
+    }
+}
@@ -23,12 +23,17 @@
 #define BOOST_TEST_MODULE AutoDiffBlockTest
 
 #include <opm/autodiff/AutoDiffBlock.hpp>
+#include <opm/autodiff/AutoDiffBlockExpr.hpp>
+#include <opm/autodiff/AutoDiffArena.hpp>
 
 #include <boost/test/unit_test.hpp>
 
 #include <Eigen/Eigen>
 #include <Eigen/Sparse>
 
+#include <thread>
+#include <vector>
+
 using namespace Opm;
 
 namespace {
@@ -365,3 +370,145 @@ BOOST_AUTO_TEST_CASE(Pow)
 }
 
 
+
+BOOST_AUTO_TEST_CASE(LazyExpressions)
+{
+    typedef AutoDiffBlock<double> ADB;
+
+    ADB::V vx(3);
+    vx << 0.2, 1.2, 13.4;
+
+    ADB::V vy(3);
+    vy << 2.0, 3.0, 0.5;
+
+    ADB::V vc(3);
+    vc << 1.5, -0.5, 4.0;
+
+    std::vector<ADB::V> vals{ vx, vy };
+    std::vector<ADB> vars = ADB::variables(vals);
+
+    const ADB x = vars[0];
+    const ADB y = vars[1];
+
+    // Give one operand a sparse jacobian to exercise the general path.
+    Eigen::SparseMatrix<double> sm(3, 3);
+    sm.insert(0, 1) = 2.0;
+    sm.insert(2, 0) = -1.0;
+    const ADB z = ADB::M(sm) * x;
+
+    const double tolerance = 1e-14;
+
+    ADB xyz = lazy(x) * y * z;
+    checkClose(xyz, x * y * z, tolerance);
+
+    ADB sum = lazy(x) * y + x * z - 2.0 * lazy(y);
+    checkClose(sum, x * y + x * z - y * 2.0, tolerance);
+
+    ADB quot = lazy(x) / (lazy(y) + vc);
+    checkClose(quot, x / (y + vc), tolerance);
+
+    ADB scaled = vc * lazy(x) * z / y;
+    checkClose(scaled, vc * x * z / y, tolerance);
+
+    // Purely constant expression.
+    const ADB c = ADB::constant(vc);
+    ADB cc = lazy(c) * vx;
+    BOOST_CHECK(cc.derivative().empty());
+    BOOST_CHECK(cc.value().isApprox(vc * vx, tolerance));
+
+    // Assigning an expression referring to the target itself.
+    ADB w = x;
+    w = lazy(w) * w + y;
+    checkClose(w, x * x + y, tolerance);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaAllocation)
+{
+    typedef AutoDiffBlock<double> ADB;
+
+    ADB::V vx(3);
+    vx << 0.2, 1.2, 13.4;
+
+    ADB::V vy(3);
+    vy << 2.0, 3.0, 0.5;
+
+    std::vector<ADB::V> vals{ vx, vy };
+    std::vector<ADB> vars = ADB::variables(vals);
+    const ADB& x = vars[0];
+    const ADB& y = vars[1];
+
+    const ADB reference = x * y + x / y;
+
+    AutoDiffArena::setEnabled(true);
+    ADB result = ADB::null();
+    for (int iter = 0; iter < 3; ++iter) {
+        AutoDiffArena::beginLinearization();
+        result = x * y + x / y;
+        const AutoDiffArena::Statistics stats = AutoDiffArena::statistics();
+        BOOST_CHECK(stats.allocations > 0);
+        BOOST_CHECK(stats.bytes > 0);
+        BOOST_CHECK(stats.reserved > 0);
+    }
+    AutoDiffArena::setEnabled(false);
+
+    checkClose(result, reference, 1e-14);
+
+    // Memory from the arena must remain valid after disabling it.
+    result = result * x;
+    checkClose(result, reference * x, 1e-14);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaAllocatorChosenAtCreation)
+{
+    typedef std::vector<double, AutoDiffArenaAllocator<double> > Vec;
+    AutoDiffArena::setEnabled(false);
+    AutoDiffArena::beginLinearization();
+    Vec heap(100, 1.0);
+    BOOST_CHECK(!heap.get_allocator().usesArena());
+    BOOST_CHECK_EQUAL(AutoDiffArena::statistics().allocations, std::size_t(0));
+
+    AutoDiffArena::setEnabled(true);
+    Vec arena(100, 2.0);
+    const Vec copy = heap;
+    AutoDiffArena::setEnabled(false);
+    BOOST_CHECK(arena.get_allocator().usesArena());
+    BOOST_CHECK(copy.get_allocator().usesArena());
+    BOOST_CHECK_EQUAL(AutoDiffArena::statistics().allocations, std::size_t(2));
+
+    // The memory moves together with its allocator.
+    heap = std::move(arena);
+    BOOST_CHECK(heap.get_allocator().usesArena());
+    BOOST_CHECK_EQUAL(heap[99], 2.0);
+    Vec other(10, 3.0);
+    other.swap(heap);
+    BOOST_CHECK(other.get_allocator().usesArena());
+    BOOST_CHECK(!heap.get_allocator().usesArena());
+    BOOST_CHECK_EQUAL(other[99], 2.0);
+    BOOST_CHECK_EQUAL(copy[99], 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaStatisticsSumOverThreads)
+{
+    const int num_threads = 4;
+    const int num_alloc = 100;
+    AutoDiffArena::beginLinearization();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < num_alloc; ++i) {
+                AutoDiffArena::deallocate(AutoDiffArena::allocate(8));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // The counts of threads that have exited are kept.
+    const AutoDiffArena::Statistics stats = AutoDiffArena::statistics();
+    BOOST_CHECK_EQUAL(stats.allocations, std::size_t(num_threads * num_alloc));
+    BOOST_CHECK_EQUAL(stats.bytes, std::size_t(num_threads * num_alloc * 8));
+
+    AutoDiffArena::beginLinearization();
+    BOOST_CHECK_EQUAL(AutoDiffArena::statistics().allocations, std::size_t(0));
+}
@@ -0,0 +1,218 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define NVERBOSE // to suppress our messages when throwing
+
+#define BOOST_TEST_MODULE BlockCPRPreconditionerTest
+
+#include <opm/autodiff/BlockCPRPreconditioner.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <boost/test/unit_test.hpp>
+#include <dune/common/fmatrix.hh>
+#include <dune/common/fvector.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/preconditioners.hh>
+#include <dune/istl/solvers.hh>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace Opm;
+
+namespace {
+
+    typedef Dune::FieldMatrix<double, 3, 3> Block;
+    typedef Dune::BCRSMatrix<Block> Matrix;
+    typedef Dune::BlockVector< Dune::FieldVector<double, 3> > Vector;
+    typedef BlockCPRPreconditioner<Matrix, Vector, 0> BlockCPR;
+
+    // Diagonal block of cell i, with pressure in column 0. The pressure
+    // column dominates, the others couple the equations within a cell.
+    Block diagonalBlock(const int i)
+    {
+        Block d;
+        for (int r = 0; r < 3; ++r) {
+            d[r][0] = 2.0 + 0.1*r + 0.01*i;
+            for (int c = 1; c < 3; ++c) {
+                d[r][c] = (r + 1 == c ? 1.5 : 0.2) + 0.05*((i + r + c) % 3);
+            }
+        }
+        return d;
+    }
+
+    // Pressure diffusion on a line of n cells, with upwinded couplings
+    // of the other unknowns to the left neighbour.
+    Matrix blackoilLikeMatrix(const int n)
+    {
+        Matrix A(n, n, 3*n - 2, Matrix::row_wise);
+        for (auto row = A.createbegin(); row != A.createend(); ++row) {
+            const int i = row.index();
+            if (i > 0) {
+                row.insert(i - 1);
+            }
+            row.insert(i);
+            if (i < n - 1) {
+                row.insert(i + 1);
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            A[i][i] = diagonalBlock(i);
+            Block off(0.0);
+            for (int r = 0; r < 3; ++r) {
+                off[r][0] = -0.9 - 0.05*r;
+            }
+            if (i > 0) {
+                Block upwind = off;
+                upwind[1][1] = -0.3;
+                upwind[2][2] = -0.2;
+                A[i][i - 1] = upwind;
+            }
+            if (i < n - 1) {
+                A[i][i + 1] = off;
+            }
+        }
+        return A;
+    }
+
+    std::unique_ptr<BlockCPR::FineSmoother> createILU(const Matrix& A)
+    {
+        return std::unique_ptr<BlockCPR::FineSmoother>(new Dune::SeqILU0<Matrix, Vector, Vector>(A, 1.0));
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(ImpesWeightsDecoupleNonPressureUnknowns)
+{
+    const int n = 5;
+    std::vector<Block> diagonal;
+    for (int i = 0; i < n; ++i) {
+        diagonal.push_back(diagonalBlock(i));
+    }
+    const BlockCPR::Weights weights = BlockCPR::impesWeights(diagonal);
+    BOOST_REQUIRE_EQUAL(weights.size(), n);
+
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_CLOSE(weights[i].infinity_norm(), 1.0, 1.0e-12);
+        // The weighted sum of the equations depends on the pressure
+        // only, through the diagonal block.
+        for (int c = 0; c < 3; ++c) {
+            double coeff = 0.0;
+            for (int e = 0; e < 3; ++e) {
+                coeff += weights[i][e] * diagonal[i][e][c];
+            }
+            if (c == 0) {
+                BOOST_CHECK(std::fabs(coeff) > 1.0e-3);
+            } else {
+                BOOST_CHECK_SMALL(coeff, 1.0e-12);
+            }
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(QuasiImpesWeightsUseDiagonalBlocks)
+{
+    const Matrix A = blackoilLikeMatrix(4);
+    const BlockCPR::Weights weights = BlockCPR::quasiImpesWeights(A);
+    std::vector<Block> diagonal;
+    for (int i = 0; i < 4; ++i) {
+        diagonal.push_back(A[i][i]);
+    }
+    const BlockCPR::Weights truth = BlockCPR::impesWeights(diagonal);
+    for (int i = 0; i < 4; ++i) {
+        for (int e = 0; e < 3; ++e) {
+            BOOST_CHECK_CLOSE(weights[i][e], truth[i][e], 1.0e-12);
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(PressureMatrixIsWeightedSumOfEquations)
+{
+    const int n = 6;
+    const Matrix A = blackoilLikeMatrix(n);
+    const BlockCPR::Weights weights = BlockCPR::quasiImpesWeights(A);
+    const BlockCPR cpr(A, weights, createILU(A));
+    const BlockCPR::PressureMatrix& Ap = cpr.pressureMatrix();
+
+    BOOST_REQUIRE_EQUAL(Ap.N(), A.N());
+    BOOST_REQUIRE_EQUAL(Ap.nonzeroes(), A.nonzeroes());
+    for (auto row = A.begin(); row != A.end(); ++row) {
+        const int i = row.index();
+        for (auto col = row->begin(); col != row->end(); ++col) {
+            const int j = col.index();
+            BOOST_REQUIRE(Ap.exists(i, j));
+            double value = 0.0;
+            for (int e = 0; e < 3; ++e) {
+                value += weights[i][e] * (*col)[e][0];
+            }
+            BOOST_CHECK_CLOSE(Ap[i][j][0][0], value, 1.0e-12);
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(RequiresOneWeightPerRow)
+{
+    const Matrix A = blackoilLikeMatrix(3);
+    BlockCPR::Weights weights = BlockCPR::quasiImpesWeights(A);
+    weights.pop_back();
+    BOOST_CHECK_THROW(BlockCPR(A, weights, createILU(A)), std::logic_error);
+}
+
+
+BOOST_AUTO_TEST_CASE(SolvesBlockSystem)
+{
+    const int n = 40;
+    const Matrix A = blackoilLikeMatrix(n);
+    Vector b(n);
+    for (int i = 0; i < n; ++i) {
+        b[i][0] = 1.0;
+        b[i][1] = 0.1 * i;
+        b[i][2] = -0.5;
+    }
+
+    // Pressure solves preconditioned by ILU0 and by AMG.
+    for (const bool use_amg : { false, true }) {
+        CPRParameter param;
+        param.cpr_use_amg_ = use_amg;
+        BlockCPR cpr(A, BlockCPR::quasiImpesWeights(A), createILU(A), param);
+
+        Vector x(n);
+        x = 0.0;
+        Vector rhs = b;
+        Dune::MatrixAdapter<Matrix, Vector, Vector> op(A);
+        Dune::BiCGSTABSolver<Vector> solver(op, cpr, 1.0e-10, 100, 0);
+        Dune::InverseOperatorResult result;
+        solver.apply(x, rhs, result);
+        BOOST_CHECK(result.converged);
+
+        Vector r = b;
+        A.mmv(x, r);
+        BOOST_CHECK_SMALL(r.two_norm() / b.two_norm(), 1.0e-8);
+    }
+}
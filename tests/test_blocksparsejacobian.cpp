@@ -0,0 +1,189 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE BlockSparseJacobianTest
+
+#include <opm/autodiff/BlockSparseJacobian.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <boost/test/unit_test.hpp>
+#include <dune/common/fmatrix.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+using namespace Opm;
+
+namespace {
+
+    typedef AutoDiffBlock<double> ADB;
+
+    // Two equations in two variables on three cells, with a
+    // connection between cells 0 and 1 and between cells 1 and 2.
+    std::vector<ADB> twoByTwoSystem()
+    {
+        ADB::V p(3);
+        p << 1.0, 2.0, 3.0;
+        ADB::V s(3);
+        s << 0.1, 0.2, 0.3;
+        const std::vector<ADB> vars = ADB::variables({ p, s });
+
+        Eigen::SparseMatrix<double> grad(2, 3);
+        grad.insert(0, 0) = -1.0;
+        grad.insert(0, 1) = 1.0;
+        grad.insert(1, 1) = -1.0;
+        grad.insert(1, 2) = 1.0;
+        const Eigen::SparseMatrix<double> div = grad.transpose();
+
+        std::vector<ADB> eqs;
+        eqs.push_back(div * (grad * vars[0]) + vars[0] * vars[1]);
+        eqs.push_back(vars[1] * vars[1] + vars[0] * 2.0);
+        return eqs;
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(PatternAndValues)
+{
+    const std::vector<ADB> eqs = twoByTwoSystem();
+    const BlockSparseJacobian<2> jac(eqs, false);
+
+    BOOST_CHECK_EQUAL(jac.size(), 3);
+    BOOST_CHECK_EQUAL(jac.nonZeroBlocks(), 7);
+    BOOST_CHECK_EQUAL(jac.find(0, 2), -1);
+
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            const int k = jac.find(row, col);
+            for (int eq = 0; eq < 2; ++eq) {
+                for (int var = 0; var < 2; ++var) {
+                    const double expected = eqs[eq].derivative()[var].coeff(row, col);
+                    const double actual = (k < 0) ? 0.0 : jac.block(k)[eq*2 + var];
+                    BOOST_CHECK_EQUAL(actual, expected);
+                }
+            }
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(ScaleAndMultiply)
+{
+    const std::vector<ADB> eqs = twoByTwoSystem();
+    BlockSparseJacobian<2> jac(eqs, true);
+    jac.scaleEquation(1, 0.5);
+
+    Eigen::VectorXd x(6);
+    x << 1.0, -1.0, 2.0, 0.5, -3.0, 4.0;
+    Eigen::VectorXd y;
+    jac.mv(x, y);
+
+    for (int row = 0; row < 3; ++row) {
+        for (int eq = 0; eq < 2; ++eq) {
+            double expected = 0.0;
+            for (int col = 0; col < 3; ++col) {
+                for (int var = 0; var < 2; ++var) {
+                    expected += eqs[eq].derivative()[var].coeff(row, col) * x[col*2 + var];
+                }
+            }
+            if (eq == 1) {
+                expected *= 0.5;
+            }
+            BOOST_CHECK_CLOSE(y[row*2 + eq], expected, 1e-12);
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(RefillKeepsPattern)
+{
+    std::vector<ADB> eqs = twoByTwoSystem();
+    BlockSparseJacobian<2> jac;
+    BOOST_CHECK(!jac.refill(eqs));
+    jac.assign(eqs, false);
+    const std::vector<int> cols = jac.colIndex();
+
+    // New values with the same pattern.
+    for (auto& eq : eqs) {
+        eq = eq * eq;
+    }
+    BOOST_CHECK(jac.refill(eqs));
+    BOOST_CHECK(jac.colIndex() == cols);
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            const int k = jac.find(row, col);
+            for (int eq = 0; eq < 2; ++eq) {
+                for (int var = 0; var < 2; ++var) {
+                    const double expected = eqs[eq].derivative()[var].coeff(row, col);
+                    const double actual = (k < 0) ? 0.0 : jac.block(k)[eq*2 + var];
+                    BOOST_CHECK_EQUAL(actual, expected);
+                }
+            }
+        }
+    }
+
+    // A connection between cells 0 and 2 is outside the pattern.
+    Eigen::SparseMatrix<double> grad(1, 3);
+    grad.insert(0, 0) = -1.0;
+    grad.insert(0, 2) = 1.0;
+    const Eigen::SparseMatrix<double> div = grad.transpose();
+    eqs[0] = eqs[0] + div * (grad * eqs[1]);
+    BOOST_CHECK(!jac.refill(eqs));
+    jac.assign(eqs, true);
+    BOOST_CHECK(jac.find(0, 2) >= 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(FillMatrixDirectly)
+{
+    typedef Dune::BCRSMatrix< Dune::FieldMatrix<double, 2, 2> > Mat;
+    std::vector<ADB> eqs = twoByTwoSystem();
+    BlockSparseJacobian<2> jac(eqs, false);
+    Mat A;
+    BOOST_CHECK(!jac.fillMatrix(eqs, { 1.0, 1.0 }, A));
+    jac.copyTo(A);
+
+    // New values with the same pattern, written straight into A.
+    for (auto& eq : eqs) {
+        eq = eq * eq;
+    }
+    const std::vector<double> scale = { 2.0, 0.5 };
+    BOOST_CHECK(jac.fillMatrix(eqs, scale, A));
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            for (int eq = 0; eq < 2; ++eq) {
+                for (int var = 0; var < 2; ++var) {
+                    const double expected = scale[eq] * eqs[eq].derivative()[var].coeff(row, col);
+                    const double actual = A.exists(row, col) ? A[row][col][eq][var] : 0.0;
+                    BOOST_CHECK_EQUAL(actual, expected);
+                }
+            }
+        }
+    }
+
+    // A connection between cells 0 and 2 is outside the pattern.
+    Eigen::SparseMatrix<double> grad(1, 3);
+    grad.insert(0, 0) = -1.0;
+    grad.insert(0, 2) = 1.0;
+    const Eigen::SparseMatrix<double> div = grad.transpose();
+    eqs[0] = eqs[0] + div * (grad * eqs[1]);
+    BOOST_CHECK(!jac.fillMatrix(eqs, scale, A));
+}
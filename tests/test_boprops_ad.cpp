@@ -194,6 +194,104 @@ BOOST_FIXTURE_TEST_CASE(ViscosityAD, TestFixture<SetupSimple>)
     }
 }
 
+namespace {
+    bool sameDerivatives(const Opm::BlackoilPropsAdFromDeck::ADB& a,
+                         const Opm::BlackoilPropsAdFromDeck::ADB& b)
+    {
+        if (a.numBlocks() != b.numBlocks()) {
+            return false;
+        }
+        for (int block = 0; block < a.numBlocks(); ++block) {
+            Eigen::SparseMatrix<double> da;
+            Eigen::SparseMatrix<double> db;
+            a.derivative()[block].toSparse(da);
+            b.derivative()[block].toSparse(db);
+            if ((da - db).norm() != 0.0) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(PhasePvtMatchesSeparateEvaluation, TestFixture<SetupSimple>)
+{
+    const Opm::BlackoilPropsAdFromDeck::Cells cells(3, 0);
+
+    typedef Opm::BlackoilPropsAdFromDeck::V V;
+    typedef Opm::BlackoilPropsAdFromDeck::ADB ADB;
+
+    V Vp(cells.size());
+    Vp << 10*Opm::unit::barsa, 100*Opm::unit::barsa, 200*Opm::unit::barsa;
+    V Vrs(cells.size());
+    Vrs << 1.0, 10.0, 50.0;
+    const std::vector<ADB> vars = ADB::variables({ Vp, Vrs });
+    const ADB& p  = vars[0];
+    const ADB& rs = vars[1];
+    const ADB T = ADB::constant(V::Constant(cells.size(), 273.15+20));
+    const std::vector<Opm::PhasePresence> cond(cells.size());
+
+    const Opm::BlackoilPropsAdFromDeck::PhasePvt water = boprops_ad.phasePvt(Opm::Water, p, T, rs, cond, cells);
+    const ADB muWat = boprops_ad.muWat(p, T, cells);
+    const ADB bWat = boprops_ad.bWat(p, T, cells);
+    const Opm::BlackoilPropsAdFromDeck::PhasePvt oil = boprops_ad.phasePvt(Opm::Oil, p, T, rs, cond, cells);
+    const ADB muOil = boprops_ad.muOil(p, T, rs, cond, cells);
+    const ADB bOil = boprops_ad.bOil(p, T, rs, cond, cells);
+
+    for (V::Index i = 0, n = Vp.size(); i < n; ++i) {
+        BOOST_CHECK_EQUAL(water.mu.value()[i], muWat.value()[i]);
+        BOOST_CHECK_EQUAL(water.b.value()[i], bWat.value()[i]);
+        BOOST_CHECK_EQUAL(oil.mu.value()[i], muOil.value()[i]);
+        BOOST_CHECK_EQUAL(oil.b.value()[i], bOil.value()[i]);
+    }
+    BOOST_CHECK(sameDerivatives(water.mu, muWat));
+    BOOST_CHECK(sameDerivatives(water.b, bWat));
+    BOOST_CHECK(sameDerivatives(oil.mu, muOil));
+    BOOST_CHECK(sameDerivatives(oil.b, bOil));
+}
+
+BOOST_FIXTURE_TEST_CASE(PhasePvtMatchesSeparateEvaluationWithFreeGas, TestFixture<SetupSimple>)
+{
+    const Opm::BlackoilPropsAdFromDeck::Cells cells(3, 0);
+
+    typedef Opm::BlackoilPropsAdFromDeck::V V;
+    typedef Opm::BlackoilPropsAdFromDeck::ADB ADB;
+
+    V Vp(cells.size());
+    Vp << 10*Opm::unit::barsa, 100*Opm::unit::barsa, 200*Opm::unit::barsa;
+    V Vr(cells.size());
+    Vr << 1.0e-4, 1.0, 50.0;
+    const std::vector<ADB> vars = ADB::variables({ Vp, Vr });
+    const ADB& p = vars[0];
+    const ADB& r = vars[1];
+    const ADB T = ADB::constant(V::Constant(cells.size(), 273.15+20));
+
+    // Saturated cells with free gas, and an undersaturated cell.
+    std::vector<Opm::PhasePresence> cond(cells.size());
+    cond[0].setFreeOil();
+    cond[0].setFreeGas();
+    cond[1].setFreeGas();
+    cond[2].setFreeOil();
+
+    const Opm::BlackoilPropsAdFromDeck::PhasePvt oil = boprops_ad.phasePvt(Opm::Oil, p, T, r, cond, cells);
+    const ADB muOil = boprops_ad.muOil(p, T, r, cond, cells);
+    const ADB bOil = boprops_ad.bOil(p, T, r, cond, cells);
+    const Opm::BlackoilPropsAdFromDeck::PhasePvt gas = boprops_ad.phasePvt(Opm::Gas, p, T, r, cond, cells);
+    const ADB muGas = boprops_ad.muGas(p, T, r, cond, cells);
+    const ADB bGas = boprops_ad.bGas(p, T, r, cond, cells);
+
+    for (V::Index i = 0, n = Vp.size(); i < n; ++i) {
+        BOOST_CHECK_EQUAL(oil.mu.value()[i], muOil.value()[i]);
+        BOOST_CHECK_EQUAL(oil.b.value()[i], bOil.value()[i]);
+        BOOST_CHECK_EQUAL(gas.mu.value()[i], muGas.value()[i]);
+        BOOST_CHECK_EQUAL(gas.b.value()[i], bGas.value()[i]);
+    }
+    BOOST_CHECK(sameDerivatives(oil.mu, muOil));
+    BOOST_CHECK(sameDerivatives(oil.b, bOil));
+    BOOST_CHECK(sameDerivatives(gas.mu, muGas));
+    BOOST_CHECK(sameDerivatives(gas.b, bGas));
+}
+
 BOOST_FIXTURE_TEST_CASE(criticalSaturations, TestFixture<SetupSimple>)
 {
    const Opm::BlackoilPropsAdFromDeck::Cells cells(10, 0);
@@ -0,0 +1,251 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE KrylovRecyclingTest
+
+#include <opm/autodiff/KrylovRecycling.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <boost/test/unit_test.hpp>
+#include <dune/common/fmatrix.hh>
+#include <dune/common/fvector.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/preconditioners.hh>
+#include <dune/istl/solvers.hh>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <cmath>
+
+using namespace Opm;
+
+namespace {
+
+    typedef Dune::BCRSMatrix< Dune::FieldMatrix<double, 1, 1> > Matrix;
+    typedef Dune::BlockVector< Dune::FieldVector<double, 1> > Vector;
+
+    // Matrix counting its products with vectors.
+    struct CountingMatrix
+    {
+        explicit CountingMatrix(const Matrix& A)
+            : A_(A), products_(0)
+        {
+        }
+
+        std::size_t N() const
+        {
+            return A_.N();
+        }
+
+        void mv(const Vector& x, Vector& y) const
+        {
+            ++products_;
+            A_.mv(x, y);
+        }
+
+        void mmv(const Vector& x, Vector& y) const
+        {
+            ++products_;
+            A_.mmv(x, y);
+        }
+
+        const Matrix& A_;
+        mutable int products_;
+    };
+
+    // Convection-diffusion on a line of n cells.
+    Matrix convectionDiffusion(const int n)
+    {
+        Matrix A(n, n, 3*n - 2, Matrix::row_wise);
+        for (auto row = A.createbegin(); row != A.createend(); ++row) {
+            const int i = row.index();
+            if (i > 0) {
+                row.insert(i - 1);
+            }
+            row.insert(i);
+            if (i < n - 1) {
+                row.insert(i + 1);
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            A[i][i] = 2.01;
+            if (i > 0) {
+                A[i][i - 1] = -1.3;
+            }
+            if (i < n - 1) {
+                A[i][i + 1] = -0.7;
+            }
+        }
+        return A;
+    }
+
+    Vector testVector(const int n, const double shift)
+    {
+        Vector v(n);
+        for (int i = 0; i < n; ++i) {
+            v[i] = std::sin(0.3 * i + shift) + 0.1;
+        }
+        return v;
+    }
+
+    Dune::InverseOperatorResult solve(const Matrix& A, const Vector& b, Vector& x, const double reduction)
+    {
+        Dune::MatrixAdapter<Matrix, Vector, Vector> op(A);
+        Dune::SeqILU0<Matrix, Vector, Vector> ilu(A, 1.0);
+        Dune::BiCGSTABSolver<Vector> solver(op, ilu, reduction, 500, 0);
+        Vector rhs = b;
+        Dune::InverseOperatorResult result;
+        solver.apply(x, rhs, result);
+        return result;
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(DisabledByDefault)
+{
+    KrylovRecycling<Matrix, Vector> recycling;
+    BOOST_CHECK(!recycling.enabled());
+    recycling.addSolution(testVector(10, 0.0));
+    const Matrix A = convectionDiffusion(10);
+    recycling.setup(A);
+    BOOST_CHECK_EQUAL(recycling.size(), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(CachesProductsWhileMatrixUnchanged)
+{
+    const int n = 20;
+    const Matrix A = convectionDiffusion(n);
+    const CountingMatrix counting(A);
+    KrylovRecyclingParameters param;
+    param.subspace_size_ = 3;
+    KrylovRecycling<CountingMatrix, Vector> recycling(param);
+    for (int k = 0; k < 3; ++k) {
+        recycling.addSolution(testVector(n, k));
+    }
+
+    recycling.setup(counting, true);
+    BOOST_CHECK_EQUAL(counting.products_, 3);
+    BOOST_CHECK_EQUAL(recycling.size(), 3);
+    const Vector b = testVector(n, 0.5);
+    Vector x_fresh(n);
+    recycling.initialGuess(counting, b, x_fresh);
+
+    // Same matrix: no new products.
+    counting.products_ = 0;
+    recycling.setup(counting, false);
+    BOOST_CHECK_EQUAL(counting.products_, 0);
+    Vector x_cached(n);
+    recycling.initialGuess(counting, b, x_cached);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_CLOSE(x_cached[i][0], x_fresh[i][0], 1.0e-10);
+    }
+
+    // Only the product of a new solution is computed, the oldest is dropped.
+    counting.products_ = 0;
+    recycling.addSolution(testVector(n, 3.0));
+    recycling.setup(counting, false);
+    BOOST_CHECK_EQUAL(counting.products_, 1);
+    BOOST_CHECK_EQUAL(recycling.size(), 3);
+
+    // A changed matrix needs all products.
+    counting.products_ = 0;
+    recycling.setup(counting, true);
+    BOOST_CHECK_EQUAL(counting.products_, 3);
+
+    // Nothing is kept after clearing, as at the start of a time step.
+    recycling.clear();
+    counting.products_ = 0;
+    recycling.setup(counting, true);
+    BOOST_CHECK_EQUAL(counting.products_, 0);
+    BOOST_CHECK_EQUAL(recycling.size(), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(InitialGuessMinimisesResidual)
+{
+    const int n = 20;
+    const Matrix A = convectionDiffusion(n);
+    KrylovRecyclingParameters param;
+    param.subspace_size_ = 2;
+    KrylovRecycling<Matrix, Vector> recycling(param);
+    const Vector s0 = testVector(n, 0.0);
+    const Vector s1 = testVector(n, 1.0);
+    recycling.addSolution(s0);
+    recycling.addSolution(s1);
+    recycling.setup(A);
+
+    // b in the range of A on the subspace gives the exact solution.
+    Vector x_true = s0;
+    x_true.axpy(-2.0, s1);
+    Vector b(n);
+    A.mv(x_true, b);
+    Vector x(n);
+    const double reduction = recycling.initialGuess(A, b, x);
+    BOOST_CHECK_SMALL(reduction, 1.0e-10);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_CLOSE(x[i][0], x_true[i][0], 1.0e-8);
+    }
+
+    // Without any solutions the guess is zero.
+    KrylovRecycling<Matrix, Vector> empty(param);
+    empty.setup(A);
+    BOOST_CHECK_EQUAL(empty.initialGuess(A, b, x), 1.0);
+    BOOST_CHECK_EQUAL(x.two_norm(), 0.0);
+}
+
+
+BOOST_AUTO_TEST_CASE(RecycledGuessReducesIterations)
+{
+    const int n = 200;
+    const Matrix A = convectionDiffusion(n);
+    const double reduction = 1.0e-8;
+    KrylovRecyclingParameters param;
+    param.subspace_size_ = 2;
+    KrylovRecycling<Matrix, Vector> recycling(param);
+
+    const Vector b = testVector(n, 0.0);
+    Vector x(n);
+    recycling.setup(A);
+    double achieved = recycling.initialGuess(A, b, x);
+    BOOST_CHECK_EQUAL(achieved, 1.0);
+    const Dune::InverseOperatorResult first = solve(A, b, x, reduction / achieved);
+    BOOST_REQUIRE(first.converged);
+    recycling.addSolution(x);
+
+    // Repeating the system, with a slightly changed right hand side.
+    Vector b2 = b;
+    b2 *= 1.001;
+    recycling.setup(A);
+    Vector x2(n);
+    achieved = recycling.initialGuess(A, b2, x2);
+    BOOST_CHECK(achieved < 1.0e-6);
+    const Dune::InverseOperatorResult second = solve(A, b2, x2, reduction / achieved);
+    BOOST_CHECK(second.converged);
+    BOOST_CHECK(second.iterations < first.iterations);
+
+    // The solution has the requested accuracy relative to b2.
+    Vector r = b2;
+    A.mmv(x2, r);
+    BOOST_CHECK(r.two_norm() <= 10.0 * reduction * b2.two_norm());
+}
@@ -0,0 +1,203 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define NVERBOSE // to suppress our messages when throwing
+
+#define BOOST_TEST_MODULE LinearSystemCaptureTest
+
+#include <opm/autodiff/LinearSystemCapture.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+
+using namespace Opm;
+
+BOOST_AUTO_TEST_CASE(BlockSystemRoundTrip)
+{
+    typedef AutoDiffBlock<double> ADB;
+    const int n = 3;
+    ADB::V p(n);
+    p << 1.0, 2.0, 3.0;
+    ADB::V s(n);
+    s << 0.1, 0.2, 0.3;
+    const std::vector<ADB> vars = ADB::variables({ p, s });
+    std::vector<ADB> eqs;
+    eqs.push_back(vars[0] * vars[1] + vars[0]);
+    eqs.push_back(vars[1] * vars[1] - vars[0]);
+    const BlockSparseJacobian<2> jacobian(eqs, true);
+    const std::vector<float> rhs = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+
+    const CapturedLinearSystem sys = captureLinearSystem(jacobian, rhs.data(), true);
+    const std::string filename = "test_linearsystemcapture_block.linsys";
+    writeLinearSystem(filename, sys);
+    const CapturedLinearSystem read = readLinearSystem(filename);
+    std::remove(filename.c_str());
+
+    BOOST_CHECK_EQUAL(read.block_size, 2);
+    BOOST_CHECK(read.wells_eliminated);
+    BOOST_CHECK_EQUAL(read.size(), n);
+    BOOST_CHECK(read.row_start == jacobian.rowStart());
+    BOOST_CHECK(read.col_index == jacobian.colIndex());
+    BOOST_REQUIRE_EQUAL(read.values.size(), std::size_t(4 * jacobian.nonZeroBlocks()));
+    for (int k = 0; k < jacobian.nonZeroBlocks(); ++k) {
+        for (int i = 0; i < 4; ++i) {
+            BOOST_CHECK_EQUAL(read.values[4 * k + i], jacobian.block(k)[i]);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(read.rhs.size(), rhs.size());
+    for (std::size_t i = 0; i < rhs.size(); ++i) {
+        BOOST_CHECK_EQUAL(read.rhs[i], rhs[i]);
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(EmptyBlockSystem)
+{
+    const BlockSparseJacobian<2> jacobian;
+    const CapturedLinearSystem sys = captureLinearSystem(jacobian, static_cast<const double*>(nullptr), false);
+    BOOST_CHECK_EQUAL(sys.size(), 0);
+    BOOST_CHECK(sys.values.empty());
+    BOOST_CHECK(sys.rhs.empty());
+
+    const std::string filename = "test_linearsystemcapture_empty.linsys";
+    writeLinearSystem(filename, sys);
+    const CapturedLinearSystem read = readLinearSystem(filename);
+    std::remove(filename.c_str());
+    BOOST_CHECK_EQUAL(read.size(), 0);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(ScalarSystemRoundTrip)
+{
+    Eigen::SparseMatrix<double, Eigen::RowMajor> A(3, 3);
+    A.insert(0, 0) = 4.0;
+    A.insert(0, 2) = -1.0;
+    A.insert(1, 1) = 3.0;
+    A.insert(2, 0) = -1.0;
+    A.insert(2, 2) = 5.0;
+    A.makeCompressed();
+    AutoDiffBlock<double>::V b(3);
+    b << 1.0, -2.0, 0.5;
+
+    const CapturedLinearSystem sys = captureLinearSystem(A, b, false);
+    const std::string filename = "test_linearsystemcapture_scalar.linsys";
+    writeLinearSystem(filename, sys);
+    const CapturedLinearSystem read = readLinearSystem(filename);
+    std::remove(filename.c_str());
+
+    BOOST_CHECK_EQUAL(read.block_size, 1);
+    BOOST_CHECK(!read.wells_eliminated);
+    BOOST_CHECK(read.row_start == std::vector<int>({ 0, 2, 3, 5 }));
+    BOOST_CHECK(read.col_index == std::vector<int>({ 0, 2, 1, 0, 2 }));
+    BOOST_CHECK(read.values == std::vector<double>({ 4.0, -1.0, 3.0, -1.0, 5.0 }));
+    BOOST_CHECK(read.rhs == std::vector<double>({ 1.0, -2.0, 0.5 }));
+}
+
+
+
+BOOST_AUTO_TEST_CASE(SelectsSolves)
+{
+    LinearSystemCaptureParameters param;
+    BOOST_CHECK(!LinearSystemCapture(param).selectNextSolve());
+
+    param.prefix_ = "system";
+    param.first_ = 2;
+    param.stride_ = 3;
+    param.count_ = 2;
+    LinearSystemCapture capture(param);
+    std::vector<int> selected;
+    for (int solve = 0; solve < 12; ++solve) {
+        if (capture.selectNextSolve()) {
+            selected.push_back(solve);
+            capture.write(captureLinearSystem(Eigen::SparseMatrix<double, Eigen::RowMajor>(0, 0),
+                                              AutoDiffBlock<double>::V(0), false));
+            const CapturedLinearSystem read = readLinearSystem(capture.filename(solve));
+            BOOST_CHECK_EQUAL(read.solve_index, solve);
+            std::remove(capture.filename(solve).c_str());
+        }
+    }
+    BOOST_CHECK(selected == std::vector<int>({ 2, 5 }));
+    BOOST_CHECK_EQUAL(capture.filename(5), "system_00005.linsys");
+}
+
+BOOST_AUTO_TEST_CASE(RejectsOtherFiles)
+{
+    const std::string filename = "test_linearsystemcapture_other.linsys";
+    {
+        std::FILE* f = std::fopen(filename.c_str(), "w");
+        std::fputs("not a linear system", f);
+        std::fclose(f);
+    }
+    BOOST_CHECK_THROW(readLinearSystem(filename), std::runtime_error);
+    std::remove(filename.c_str());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(RankInFileName)
+{
+    LinearSystemCaptureParameters param;
+    param.prefix_ = "system";
+    BOOST_CHECK_EQUAL(LinearSystemCapture(param).filename(3), "system_00003.linsys");
+    BOOST_CHECK_EQUAL(LinearSystemCapture(param, 0).filename(3), "system_rank0_00003.linsys");
+    BOOST_CHECK_EQUAL(LinearSystemCapture(param, 12).filename(3), "system_rank12_00003.linsys");
+    BOOST_CHECK_EQUAL(LinearSystemCapture::processRank(boost::any()), -1);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(RejectsInvalidStructure)
+{
+    CapturedLinearSystem sys;
+    sys.row_start = { 0, 2, 3, 4 };
+    sys.col_index = { 0, 1, 1, 2 };
+    sys.values = { 1.0, 2.0, 3.0, 4.0 };
+    sys.rhs = { 1.0, 1.0, 1.0 };
+    const std::string filename = "test_linearsystemcapture_invalid.linsys";
+    writeLinearSystem(filename, sys);
+    BOOST_CHECK_NO_THROW(readLinearSystem(filename));
+
+    // Decreasing row starts.
+    CapturedLinearSystem bad = sys;
+    bad.row_start = { 0, 3, 2, 4 };
+    writeLinearSystem(filename, bad);
+    BOOST_CHECK_THROW(readLinearSystem(filename), std::runtime_error);
+
+    // Last row start differs from the number of blocks.
+    bad = sys;
+    bad.row_start = { 0, 2, 3, 3 };
+    writeLinearSystem(filename, bad);
+    BOOST_CHECK_THROW(readLinearSystem(filename), std::runtime_error);
+
+    // Column index out of range.
+    bad = sys;
+    bad.col_index = { 0, 1, 1, 3 };
+    writeLinearSystem(filename, bad);
+    BOOST_CHECK_THROW(readLinearSystem(filename), std::runtime_error);
+    bad.col_index = { 0, -1, 1, 2 };
+    writeLinearSystem(filename, bad);
+    BOOST_CHECK_THROW(readLinearSystem(filename), std::runtime_error);
+
+    std::remove(filename.c_str());
+}
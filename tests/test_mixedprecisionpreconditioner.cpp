@@ -0,0 +1,136 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE MixedPrecisionPreconditionerTest
+
+#include <opm/autodiff/MixedPrecisionPreconditioner.hpp>
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <boost/test/unit_test.hpp>
+#include <dune/common/fmatrix.hh>
+#include <dune/common/fvector.hh>
+#include <dune/istl/bcrsmatrix.hh>
+#include <dune/istl/bvector.hh>
+#include <dune/istl/operators.hh>
+#include <dune/istl/preconditioners.hh>
+#include <dune/istl/solvers.hh>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <cmath>
+#include <memory>
+
+using namespace Opm;
+
+namespace {
+
+    typedef Dune::FieldMatrix<double, 2, 2> Block;
+    typedef Dune::BCRSMatrix<Block> Matrix;
+    typedef Dune::BlockVector< Dune::FieldVector<double, 2> > Vector;
+    typedef Dune::BCRSMatrix< Dune::FieldMatrix<float, 2, 2> > FloatMatrix;
+    typedef MixedPrecisionPreconditioner<FloatMatrix, Vector> MixedPreconditioner;
+
+    // Two coupled equations per cell on a line of n cells: a diffusion
+    // equation with a strong diagonal coupling to a second, weakly
+    // diffusive equation, similar to a pressure and a saturation.
+    Matrix coupledLaplacian(const int n)
+    {
+        Matrix A(n, n, 3*n - 2, Matrix::row_wise);
+        for (auto row = A.createbegin(); row != A.createend(); ++row) {
+            const int i = row.index();
+            if (i > 0) {
+                row.insert(i - 1);
+            }
+            row.insert(i);
+            if (i < n - 1) {
+                row.insert(i + 1);
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            Block diag;
+            diag[0][0] = 2.0 + 1.0e-3;
+            diag[0][1] = 0.5;
+            diag[1][0] = 0.1;
+            diag[1][1] = 1.0 + 0.2;
+            A[i][i] = diag;
+            Block off;
+            off[0][0] = -1.0;
+            off[0][1] = 0.0;
+            off[1][0] = 0.0;
+            off[1][1] = -0.1;
+            if (i > 0) {
+                A[i][i - 1] = off;
+            }
+            if (i < n - 1) {
+                A[i][i + 1] = off;
+            }
+        }
+        return A;
+    }
+
+    Dune::InverseOperatorResult solve(const Matrix& A, Dune::Preconditioner<Vector, Vector>& precond,
+                                      const Vector& b, Vector& x)
+    {
+        Dune::MatrixAdapter<Matrix, Vector, Vector> op(A);
+        Dune::BiCGSTABSolver<Vector> solver(op, precond, 1.0e-10, 200, 0);
+        Vector rhs = b;
+        x = 0.0;
+        Dune::InverseOperatorResult result;
+        solver.apply(x, rhs, result);
+        return result;
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(MatchesDoublePrecisionILU)
+{
+    const int n = 50;
+    const Matrix A = coupledLaplacian(n);
+    Vector b(n);
+    for (int i = 0; i < n; ++i) {
+        b[i][0] = std::sin(0.1 * i);
+        b[i][1] = 1.0;
+    }
+
+    Dune::SeqILU0<Matrix, Vector, Vector> ilu(A, 1.0);
+    Vector x_double(n);
+    const Dune::InverseOperatorResult result_double = solve(A, ilu, b, x_double);
+
+    auto createILU = [](MixedPreconditioner::OperatorF& opF) {
+        typedef Dune::SeqILU0<FloatMatrix, MixedPreconditioner::VectorF, MixedPreconditioner::VectorF> FloatILU;
+        return std::unique_ptr<MixedPreconditioner::InnerPreconditioner>(new FloatILU(opF.getmat(), 1.0));
+    };
+    MixedPreconditioner mixed(A, createILU);
+    Vector x_mixed(n);
+    const Dune::InverseOperatorResult result_mixed = solve(A, mixed, b, x_mixed);
+
+    BOOST_CHECK(result_double.converged);
+    BOOST_CHECK(result_mixed.converged);
+    // A single precision preconditioner only changes the search
+    // directions; the solution is accurate to the double precision
+    // tolerance, and the iteration count is about the same.
+    BOOST_CHECK_LE(result_mixed.iterations, result_double.iterations + 2);
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < 2; ++c) {
+            BOOST_CHECK_CLOSE(x_mixed[i][c], x_double[i][c], 1.0e-6);
+        }
+    }
+}
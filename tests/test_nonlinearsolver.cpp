@@ -0,0 +1,192 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE NonlinearSolverTest
+
+#include <opm/autodiff/NonlinearSolver.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace Opm;
+
+namespace {
+
+    // The parts of a physical model used by the solver helpers tested here.
+    struct TwoPhaseModel
+    {
+        typedef int ReservoirState;
+        typedef int WellState;
+
+        int numPhases() const
+        {
+            return 2;
+        }
+    };
+
+    typedef NonlinearSolver<TwoPhaseModel> Solver;
+
+    std::unique_ptr<Solver> makeSolver(const Solver::SolverParameters& param)
+    {
+        return std::unique_ptr<Solver>(new Solver(param, std::unique_ptr<TwoPhaseModel>(new TwoPhaseModel)));
+    }
+
+    Solver::SolverParameters lineSearchParameters()
+    {
+        Solver::SolverParameters param;
+        param.use_line_search_ = true;
+        param.line_search_max_cuts_ = 3;
+        param.line_search_cut_factor_ = 0.5;
+        param.line_search_armijo_ = 1.0e-4;
+        return param;
+    }
+
+    Solver::SolverParameters inexactNewtonParameters()
+    {
+        Solver::SolverParameters param;
+        param.use_inexact_newton_ = true;
+        param.inexact_newton_eta_max_ = 0.5;
+        param.inexact_newton_eta_min_ = 1.0e-4;
+        param.inexact_newton_gamma_ = 0.9;
+        param.inexact_newton_alpha_ = 2.0;
+        return param;
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(LineSearchAcceptsFullStep)
+{
+    const auto solver = makeSolver(lineSearchParameters());
+    std::vector<double> trials;
+    const double alpha = solver->lineSearch([&trials](const double a) {
+            trials.push_back(a);
+            return 0.5;
+        });
+    BOOST_CHECK_EQUAL(alpha, 1.0);
+    BOOST_CHECK_EQUAL(trials.size(), 1u);
+}
+
+
+BOOST_AUTO_TEST_CASE(LineSearchBacktracks)
+{
+    const auto solver = makeSolver(lineSearchParameters());
+    std::vector<double> trials;
+    // Steps longer than 0.3 increase the residual, or fail.
+    const double alpha = solver->lineSearch([&trials](const double a) {
+            trials.push_back(a);
+            if (a > 0.6) {
+                return std::numeric_limits<double>::infinity();
+            }
+            return a > 0.3 ? 1.5 : 0.9;
+        });
+    BOOST_CHECK_EQUAL(alpha, 0.25);
+    const std::vector<double> expected = { 1.0, 0.5, 0.25 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(trials.begin(), trials.end(), expected.begin(), expected.end());
+}
+
+
+BOOST_AUTO_TEST_CASE(LineSearchArmijoCondition)
+{
+    Solver::SolverParameters param = lineSearchParameters();
+    param.line_search_armijo_ = 0.5;
+    const auto solver = makeSolver(param);
+    // A decrease to 0.6 is not sufficient for alpha = 1, which requires
+    // merit <= 0.5, but is for alpha = 0.5, which requires merit <= 0.75.
+    const double alpha = solver->lineSearch([](const double) { return 0.6; });
+    BOOST_CHECK_EQUAL(alpha, 0.5);
+}
+
+
+BOOST_AUTO_TEST_CASE(LineSearchRejectsInsufficientDecrease)
+{
+    const auto solver = makeSolver(lineSearchParameters());
+    int num_trials = 0;
+    // No step decreases the merit, so no step is accepted even though
+    // alpha = 0.25 increases it the least.
+    const double alpha = solver->lineSearch([&num_trials](const double a) {
+            ++num_trials;
+            return a == 0.25 ? 1.1 : 2.0;
+        });
+    BOOST_CHECK_EQUAL(alpha, 0.0);
+    BOOST_CHECK_EQUAL(num_trials, 4);
+
+    // The same when every trial step fails.
+    const double failed = solver->lineSearch([](const double) {
+            return std::numeric_limits<double>::infinity();
+        });
+    BOOST_CHECK_EQUAL(failed, 0.0);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(LinearToleranceFirstIteration)
+{
+    const auto solver = makeSolver(inexactNewtonParameters());
+    BOOST_CHECK_EQUAL(solver->linearTolerance({}), 0.5);
+    BOOST_CHECK_EQUAL(solver->linearTolerance({ { 3.0, 4.0 } }), 0.5);
+}
+
+
+BOOST_AUTO_TEST_CASE(LinearToleranceFollowsResidualReduction)
+{
+    Solver::SolverParameters param = inexactNewtonParameters();
+    // With eta_max = 0.3 the safeguard 0.9 * 0.3^2 = 0.081 is below 0.1,
+    // so the tolerance is gamma * ratio^alpha = 0.9 * 0.1^2.
+    param.inexact_newton_eta_max_ = 0.3;
+    const auto solver = makeSolver(param);
+    BOOST_CHECK_CLOSE(solver->linearTolerance({ { 3.0, 4.0 }, { 0.3, 0.4 } }), 0.009, 1.0e-10);
+    // Only the phase residuals count: the norms are 5 and 0.5.
+    BOOST_CHECK_CLOSE(solver->linearTolerance({ { 3.0, 4.0, 100.0 }, { 0.3, 0.4, 1.0 } }), 0.009, 1.0e-10);
+    // The next iteration reduces the residual by one half.
+    BOOST_CHECK_CLOSE(solver->linearTolerance({ { 3.0, 4.0 }, { 0.3, 0.4 }, { 0.15, 0.2 } }), 0.225, 1.0e-10);
+}
+
+
+BOOST_AUTO_TEST_CASE(LinearToleranceSafeguard)
+{
+    const auto solver = makeSolver(inexactNewtonParameters());
+    // gamma * ratio^alpha = 0.009, but the safeguard gamma * eta_max^alpha
+    // = 0.225 exceeds 0.1, and prevents the sudden drop.
+    BOOST_CHECK_CLOSE(solver->linearTolerance({ { 3.0, 4.0 }, { 0.3, 0.4 } }), 0.225, 1.0e-10);
+    // The safeguard from 0.225 is 0.9 * 0.225^2 = 0.0455625 < 0.1, so
+    // the tolerance may drop on the next iteration.
+    BOOST_CHECK_CLOSE(solver->linearTolerance({ { 3.0, 4.0 }, { 0.3, 0.4 }, { 0.03, 0.04 } }), 0.009, 1.0e-10);
+}
+
+
+BOOST_AUTO_TEST_CASE(LinearToleranceBounds)
+{
+    Solver::SolverParameters param = inexactNewtonParameters();
+    param.inexact_newton_eta_max_ = 0.3;
+    const auto solver = makeSolver(param);
+    // No reduction gives gamma = 0.9, above eta_max.
+    BOOST_CHECK_EQUAL(solver->linearTolerance({ { 3.0, 4.0 }, { 3.0, 4.0 } }), 0.3);
+    // A growing residual is also bounded by eta_max.
+    BOOST_CHECK_EQUAL(solver->linearTolerance({ { 3.0, 4.0 }, { 6.0, 8.0 } }), 0.3);
+    // A large reduction gives 0.9e-6, below eta_min.
+    BOOST_CHECK_EQUAL(solver->linearTolerance({ { 3.0, 4.0 }, { 3.0e-3, 4.0e-3 } }), 1.0e-4);
+    // A zero previous residual gives ratio zero.
+    BOOST_CHECK_EQUAL(solver->linearTolerance({ { 0.0, 0.0 }, { 0.0, 0.0 } }), 1.0e-4);
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE PreconditionerReuseTest
+
+#include <opm/autodiff/PreconditionerReuse.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace Opm;
+
+
+BOOST_AUTO_TEST_CASE(DisabledByDefault)
+{
+    PreconditionerReusePolicy policy;
+    BOOST_CHECK(!policy.enabled());
+    for (int solve = 0; solve < 3; ++solve) {
+        BOOST_CHECK(policy.needsSetup());
+        policy.setupDone();
+        BOOST_CHECK(!policy.reused());
+        policy.solveDone(10);
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(MaxReuse)
+{
+    PreconditionerReuseParameters param;
+    param.max_reuse_ = 2;
+    PreconditionerReusePolicy policy(param);
+    BOOST_CHECK(policy.needsSetup());
+    policy.setupDone();
+    policy.solveDone(10);
+    BOOST_CHECK(!policy.needsSetup());
+    BOOST_CHECK(policy.reused());
+    policy.solveDone(10);
+    BOOST_CHECK(!policy.needsSetup());
+    policy.solveDone(10);
+    BOOST_CHECK(policy.needsSetup());
+
+    policy.setupDone();
+    policy.solveDone(10);
+    BOOST_CHECK(!policy.needsSetup());
+    policy.invalidate();
+    BOOST_CHECK(policy.needsSetup());
+}
+
+
+BOOST_AUTO_TEST_CASE(IterationGrowth)
+{
+    PreconditionerReuseParameters param;
+    param.max_reuse_ = 10;
+    param.iteration_growth_ = 1.5;
+    PreconditionerReusePolicy policy(param);
+    policy.setupDone();
+    policy.solveDone(10);
+    policy.solveDone(15);
+    BOOST_CHECK(!policy.needsSetup());
+    policy.solveDone(16);
+    BOOST_CHECK(policy.needsSetup());
+}
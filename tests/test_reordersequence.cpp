@@ -0,0 +1,289 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define NVERBOSE // to suppress our messages when throwing
+
+#define BOOST_TEST_MODULE ReorderSequenceTest
+
+#include <opm/common/utility/platform_dependent/disable_warnings.h>
+#include <boost/test/unit_test.hpp>
+#include <opm/common/utility/platform_dependent/reenable_warnings.h>
+
+#include <opm/core/transport/reorder/ReorderSequenceCache.hpp>
+#include <opm/core/transport/reorder/reordersequence.h>
+#include <opm/grid/GridManager.hpp>
+#include <opm/grid/UnstructuredGrid.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace Opm;
+
+namespace
+{
+    struct Ordering
+    {
+        std::vector<int> sequence;
+        std::vector<int> components;
+        std::vector<int> levels;
+        std::vector<int> level_components;
+    };
+
+    Ordering computeOrdering(const UnstructuredGrid& grid, const std::vector<double>& flux)
+    {
+        const int nc = grid.number_of_cells;
+        Ordering o;
+        o.sequence.resize(nc);
+        o.components.resize(nc + 1);
+        int ncomp = -1;
+        compute_sequence(&grid, flux.data(), o.sequence.data(), o.components.data(), &ncomp);
+        o.components.resize(ncomp + 1);
+        o.levels.resize(ncomp + 1);
+        o.level_components.resize(ncomp);
+        int nlevels = -1;
+        compute_component_levels(&grid, o.sequence.data(), o.components.data(), ncomp,
+                                 o.levels.data(), o.level_components.data(), &nlevels);
+        o.levels.resize(nlevels + 1);
+        return o;
+    }
+
+    // Level of the component containing each cell.
+    std::vector<int> cellLevels(const UnstructuredGrid& grid, const Ordering& o)
+    {
+        std::vector<int> cell_level(grid.number_of_cells, -1);
+        const int nlevels = o.levels.size() - 1;
+        for (int level = 0; level < nlevels; ++level) {
+            for (int ix = o.levels[level]; ix < o.levels[level + 1]; ++ix) {
+                const int comp = o.level_components[ix];
+                for (int i = o.components[comp]; i < o.components[comp + 1]; ++i) {
+                    cell_level[o.sequence[i]] = level;
+                }
+            }
+        }
+        return cell_level;
+    }
+
+    // Flux through each face given by the dot product of its normal with a velocity.
+    std::vector<double> uniformFlux(const UnstructuredGrid& grid, const double vx, const double vy)
+    {
+        std::vector<double> flux(grid.number_of_faces);
+        for (int f = 0; f < grid.number_of_faces; ++f) {
+            flux[f] = vx*grid.face_normals[2*f] + vy*grid.face_normals[2*f + 1];
+        }
+        return flux;
+    }
+
+    // Smallest cell index in the component of each cell.
+    std::vector<int> componentLabels(const int num_cells,
+                                     const std::vector<int>& sequence,
+                                     const std::vector<int>& components)
+    {
+        std::vector<int> label(num_cells, -1);
+        const int ncomp = components.size() - 1;
+        for (int comp = 0; comp < ncomp; ++comp) {
+            const int first = *std::min_element(sequence.begin() + components[comp],
+                                                sequence.begin() + components[comp + 1]);
+            for (int i = components[comp]; i < components[comp + 1]; ++i) {
+                label[sequence[i]] = first;
+            }
+        }
+        return label;
+    }
+
+    // True if no interior face has flux from a later to an earlier component.
+    bool isCausal(const UnstructuredGrid& grid,
+                  const std::vector<double>& flux,
+                  const std::vector<int>& sequence,
+                  const std::vector<int>& components)
+    {
+        std::vector<int> cell_comp(grid.number_of_cells, -1);
+        const int ncomp = components.size() - 1;
+        for (int comp = 0; comp < ncomp; ++comp) {
+            for (int i = components[comp]; i < components[comp + 1]; ++i) {
+                cell_comp[sequence[i]] = comp;
+            }
+        }
+        for (int f = 0; f < grid.number_of_faces; ++f) {
+            const int c0 = grid.face_cells[2*f];
+            const int c1 = grid.face_cells[2*f + 1];
+            if (c0 < 0 || c1 < 0) {
+                continue;
+            }
+            if ((flux[f] > 0.0 && cell_comp[c0] > cell_comp[c1])
+                || (flux[f] < 0.0 && cell_comp[c1] > cell_comp[c0])) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(diagonal_flow_gives_wavefronts)
+{
+    const GridManager gm(3, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const Ordering o = computeOrdering(grid, uniformFlux(grid, 1.0, 1.0));
+
+    BOOST_CHECK_EQUAL(o.components.size(), 7);
+    BOOST_CHECK_EQUAL(o.levels.size(), 5);
+    const std::vector<int> cell_level = cellLevels(grid, o);
+    const std::vector<int> truth = { 0, 1, 2,
+                                     1, 2, 3 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cell_level.begin(), cell_level.end(), truth.begin(), truth.end());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(circulation_gives_single_level)
+{
+    const GridManager gm(2, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    // Flow in a loop 0 -> 1 -> 3 -> 2 -> 0.
+    const int next[] = { 1, 3, 0, 2 };
+    std::vector<double> flux(grid.number_of_faces, 0.0);
+    for (int f = 0; f < grid.number_of_faces; ++f) {
+        const int c0 = grid.face_cells[2*f];
+        const int c1 = grid.face_cells[2*f + 1];
+        if (c0 >= 0 && c1 >= 0) {
+            flux[f] = (next[c0] == c1) ? 1.0 : -1.0;
+        }
+    }
+    const Ordering o = computeOrdering(grid, flux);
+
+    BOOST_CHECK_EQUAL(o.components.size(), 2);
+    BOOST_CHECK_EQUAL(o.levels.size(), 2);
+    BOOST_CHECK_EQUAL(o.levels[0], 0);
+    BOOST_CHECK_EQUAL(o.levels[1], 1);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(components_in_level_are_independent)
+{
+    const GridManager gm(5, 4);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    // Some flux field with loops and zero-flux faces.
+    std::vector<double> flux(grid.number_of_faces);
+    for (int f = 0; f < grid.number_of_faces; ++f) {
+        flux[f] = double((7*f) % 5) - 2.0;
+    }
+    const Ordering o = computeOrdering(grid, flux);
+
+    // Every component appears exactly once.
+    const int ncomp = o.components.size() - 1;
+    std::vector<int> count(ncomp, 0);
+    for (const int comp : o.level_components) {
+        ++count[comp];
+    }
+    for (const int c : count) {
+        BOOST_CHECK_EQUAL(c, 1);
+    }
+
+    // Neighbouring cells are in the same component or in different
+    // levels, and upwind cells are never in a later level.
+    const std::vector<int> cell_level = cellLevels(grid, o);
+    std::vector<int> cell_comp(grid.number_of_cells);
+    for (int comp = 0; comp < ncomp; ++comp) {
+        for (int i = o.components[comp]; i < o.components[comp + 1]; ++i) {
+            cell_comp[o.sequence[i]] = comp;
+        }
+    }
+    for (int f = 0; f < grid.number_of_faces; ++f) {
+        const int c0 = grid.face_cells[2*f];
+        const int c1 = grid.face_cells[2*f + 1];
+        if (c0 < 0 || c1 < 0 || cell_comp[c0] == cell_comp[c1]) {
+            continue;
+        }
+        BOOST_CHECK(cell_level[c0] != cell_level[c1]);
+        if (flux[f] > 0.0) {
+            BOOST_CHECK(cell_level[c0] < cell_level[c1]);
+        } else if (flux[f] < 0.0) {
+            BOOST_CHECK(cell_level[c0] > cell_level[c1]);
+        }
+    }
+}
+
+
+
+
+BOOST_AUTO_TEST_CASE(cache_reuses_unchanged_ordering)
+{
+    const GridManager gm(4, 3);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    ReorderSequenceCache cache(grid);
+
+    const std::vector<double> flux = uniformFlux(grid, 1.0, 0.5);
+    BOOST_CHECK_EQUAL(cache.update(flux.data()), ReorderSequenceCache::Full);
+    const std::vector<int> sequence = cache.sequence();
+    BOOST_CHECK(isCausal(grid, flux, cache.sequence(), cache.components()));
+
+    // Same directions, different magnitudes.
+    const std::vector<double> flux2 = uniformFlux(grid, 3.0, 0.1);
+    BOOST_CHECK_EQUAL(cache.update(flux2.data()), ReorderSequenceCache::Unchanged);
+    BOOST_CHECK_EQUAL_COLLECTIONS(sequence.begin(), sequence.end(),
+                                  cache.sequence().begin(), cache.sequence().end());
+
+    // Reversed flow changes everything.
+    const std::vector<double> flux3 = uniformFlux(grid, -1.0, -0.5);
+    BOOST_CHECK_EQUAL(cache.update(flux3.data()), ReorderSequenceCache::Full);
+    BOOST_CHECK(isCausal(grid, flux3, cache.sequence(), cache.components()));
+}
+
+
+
+BOOST_AUTO_TEST_CASE(cache_updates_flipped_faces)
+{
+    const GridManager gm(8, 6);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const int nc = grid.number_of_cells;
+    ReorderSequenceCache cache(grid);
+
+    std::vector<double> flux = uniformFlux(grid, 1.0, 0.3);
+    for (int f = 0; f < grid.number_of_faces; f += 7) {
+        flux[f] = -flux[f];
+    }
+    BOOST_CHECK_EQUAL(cache.update(flux.data()), ReorderSequenceCache::Full);
+
+    // Flip a single face at a time, and compare with a full ordering.
+    for (int step = 0; step < 40; ++step) {
+        const int f = (13*step + 5) % grid.number_of_faces;
+        flux[f] = (step % 5 == 0) ? 0.0 : -flux[f] + (flux[f] == 0.0 ? 1.0 : 0.0);
+        const ReorderSequenceCache::UpdateType update = cache.update(flux.data());
+        const bool interior = grid.face_cells[2*f] >= 0 && grid.face_cells[2*f + 1] >= 0;
+        if (interior) {
+            BOOST_CHECK(update != ReorderSequenceCache::Unchanged);
+        }
+
+        std::vector<int> sequence(nc);
+        std::vector<int> components(nc + 1);
+        int ncomp = -1;
+        compute_sequence(&grid, flux.data(), sequence.data(), components.data(), &ncomp);
+        components.resize(ncomp + 1);
+
+        BOOST_CHECK_EQUAL(cache.numComponents(), ncomp);
+        BOOST_CHECK(isCausal(grid, flux, cache.sequence(), cache.components()));
+        const std::vector<int> label = componentLabels(nc, cache.sequence(), cache.components());
+        const std::vector<int> truth = componentLabels(nc, sequence, components);
+        BOOST_CHECK_EQUAL_COLLECTIONS(label.begin(), label.end(), truth.begin(), truth.end());
+    }
+}
@@ -21,16 +21,19 @@
 #include <opm/core/props/BlackoilPropertiesBasic.hpp>
 #include <opm/core/props/BlackoilPropertiesFromDeck.hpp>
 #include <opm/core/props/BlackoilPhases.hpp>
+#include <opm/core/props/satfunc/SaturationPropsFromDeck.hpp>
 
 #include <opm/parser/eclipse/Parser/Parser.hpp>
 #include <opm/parser/eclipse/Parser/ParseContext.hpp>
 #include <opm/parser/eclipse/Deck/Deck.hpp>
+#include <opm/parser/eclipse/EclipseState/EclipseState.hpp>
 
 #include <opm/core/pressure/msmfem/partition.h>
 
 #include <opm/common/utility/parameters/ParameterGroup.hpp>
 #include <opm/parser/eclipse/Units/Units.hpp>
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <limits>
@@ -662,4 +665,96 @@ BOOST_AUTO_TEST_CASE (GwsegEPS_D)
 */
 }
 
+BOOST_AUTO_TEST_CASE (SatnumRegionsGrouped)
+{
+    // Cells of two saturation regions, evaluated together in a mixed
+    // order, give the same values as evaluating each cell on its own.
+
+    Opm::ParseContext parseContext;
+    Opm::Parser parser;
+    Opm::Deck deck = parser.parseFile("satfuncRegions.DATA", parseContext);
+    Opm::EclipseState eclipseState(deck , parseContext);
+
+    const int numCells = 10;
+    std::vector<int> compressedToCartesianIdx(numCells);
+    std::iota(compressedToCartesianIdx.begin(), compressedToCartesianIdx.end(), 0);
+    auto materialLawManager = std::make_shared<Opm::SaturationPropsFromDeck::MaterialLawManager>();
+    materialLawManager->initFromDeck(deck, eclipseState, compressedToCartesianIdx);
+
+    Opm::SaturationPropsFromDeck satprops;
+    satprops.init(deck, materialLawManager);
+    const auto& satnum = eclipseState.get3DProperties().getIntGridProperty("SATNUM").getData();
+    std::vector<int> satRegion(numCells);
+    for (int c = 0; c < numCells; ++c) {
+        satRegion[c] = satnum[c] - 1;
+    }
+    satprops.setCellRegions(satRegion);
+
+    const int np = 3;
+    BOOST_REQUIRE(np == satprops.numPhases());
+
+    // Every cell twice, with different saturations.
+    const int n = 2*numCells;
+    const int order[numCells] = { 3, 0, 7, 9, 1, 4, 8, 2, 6, 5 };
+    std::vector<int> cells(n);
+    std::vector<double> s(n*np);
+    for (int i = 0; i < n; ++i) {
+        cells[i] = order[i % numCells];
+        const double sw = 0.15 + 0.04*i;
+        const double sg = 0.3*(1.0 - sw)*(i % 3)/2.0;
+        s[i*np + 0] = sw;
+        s[i*np + 1] = 1.0 - sw - sg;
+        s[i*np + 2] = sg;
+    }
+
+    std::vector<double> kr(n*np), dkrds(n*np*np), pc(n*np), dpcds(n*np*np);
+    satprops.relperm(n, s.data(), cells.data(), kr.data(), dkrds.data());
+    satprops.capPress(n, s.data(), cells.data(), pc.data(), dpcds.data());
+
+    const double reltol = 1.0e-10;
+    for (int i = 0; i < n; ++i) {
+        double kr1[np], dkrds1[np*np], pc1[np], dpcds1[np*np];
+        satprops.relperm(1, &s[i*np], &cells[i], kr1, dkrds1);
+        satprops.capPress(1, &s[i*np], &cells[i], pc1, dpcds1);
+        for (int p = 0; p < np; ++p) {
+            CHECK(kr[i*np + p], kr1[p], reltol);
+            CHECK(pc[i*np + p], pc1[p], reltol);
+        }
+        for (int k = 0; k < np*np; ++k) {
+            CHECK(dkrds[i*np*np + k], dkrds1[k], reltol);
+            CHECK(dpcds[i*np*np + k], dpcds1[k], reltol);
+        }
+    }
+
+    // All cells in natural order use the grouping of setCellRegions().
+    std::vector<int> allCells(numCells);
+    std::iota(allCells.begin(), allCells.end(), 0);
+    std::vector<double> sAll(numCells*np);
+    for (int i = 0; i < numCells; ++i) {
+        const int j = std::find(cells.begin(), cells.end(), i) - cells.begin();
+        std::copy(&s[j*np], &s[j*np] + np, &sAll[i*np]);
+    }
+    std::vector<double> krAll(numCells*np), dkrdsAll(numCells*np*np);
+    satprops.relperm(numCells, sAll.data(), allCells.data(), krAll.data(), dkrdsAll.data());
+    for (int i = 0; i < numCells; ++i) {
+        const int j = std::find(cells.begin(), cells.end(), i) - cells.begin();
+        for (int p = 0; p < np; ++p) {
+            CHECK(krAll[i*np + p], kr[j*np + p], reltol);
+        }
+        for (int k = 0; k < np*np; ++k) {
+            CHECK(dkrdsAll[i*np*np + k], dkrds[j*np*np + k], reltol);
+        }
+    }
+
+    // The regions use different tables.
+    const double s0[np] = { 0.5, 0.5, 0.0 };
+    const int cell1 = 0;
+    const int cell2 = 1;
+    BOOST_REQUIRE(satRegion[cell1] != satRegion[cell2]);
+    double kr_1[np], kr_2[np];
+    satprops.relperm(1, s0, &cell1, kr_1, nullptr);
+    satprops.relperm(1, s0, &cell2, kr_2, nullptr);
+    BOOST_CHECK(std::fabs(kr_1[0] - kr_2[0]) > 1.0e-3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE SparsityPatternCacheTest
+
+#include <opm/autodiff/AutoDiffMatrix.hpp>
+#include <opm/autodiff/SparsityPatternCache.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace Opm;
+
+namespace {
+
+    typedef Eigen::SparseMatrix<double> Sp;
+
+    // Two point gradient on a line of n cells.
+    Sp gradient(const int n)
+    {
+        Sp grad(n - 1, n);
+        for (int f = 0; f < n - 1; ++f) {
+            grad.insert(f, f) = -1.0;
+            grad.insert(f, f + 1) = 1.0;
+        }
+        grad.makeCompressed();
+        return grad;
+    }
+
+    void checkEqual(const Sp& a, const Sp& b)
+    {
+        BOOST_REQUIRE_EQUAL(a.rows(), b.rows());
+        BOOST_REQUIRE_EQUAL(a.cols(), b.cols());
+        const Eigen::MatrixXd da(a);
+        const Eigen::MatrixXd db(b);
+        BOOST_CHECK_SMALL((da - db).cwiseAbs().maxCoeff(), 1e-14);
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(ProductReusesPattern)
+{
+    const int n = 6;
+    const Sp grad = gradient(n);
+    const Sp div = grad.transpose();
+
+    SparsityPatternCache::clear();
+    const SparsityPatternCache::Statistics before = SparsityPatternCache::statistics();
+    for (int it = 0; it < 3; ++it) {
+        // Scale the flux derivatives differently in each iteration,
+        // including an exactly zero entry.
+        Sp flux = grad;
+        for (int k = 0; k < flux.nonZeros(); ++k) {
+            flux.valuePtr()[k] *= (it == 1 && k == 0) ? 0.0 : (1.0 + it + k);
+        }
+        Sp cached;
+        SparsityPatternCache::product(div, flux, cached);
+        const Sp expected = div * flux;
+        checkEqual(cached, expected);
+    }
+    const SparsityPatternCache::Statistics after = SparsityPatternCache::statistics();
+    BOOST_CHECK_EQUAL(after.misses - before.misses, 1u);
+    BOOST_CHECK_EQUAL(after.hits - before.hits, 2u);
+}
+
+
+BOOST_AUTO_TEST_CASE(SumOfDifferentPatterns)
+{
+    const int n = 5;
+    const Sp grad = gradient(n);
+    const Sp a = Sp(grad.transpose()) * grad;
+    Sp b(n, n);
+    b.insert(0, n - 1) = 2.0;
+    b.insert(2, 2) = -1.0;
+    b.makeCompressed();
+
+    SparsityPatternCache::clear();
+    Sp res;
+    SparsityPatternCache::sum(a, b, res);
+    checkEqual(res, Sp(a + b));
+
+    // In place, as used by AutoDiffMatrix.
+    Sp lhs = a;
+    SparsityPatternCache::sum(lhs, b, lhs);
+    checkEqual(lhs, Sp(a + b));
+}
+
+
+BOOST_AUTO_TEST_CASE(UpwindChangeWithSameSize)
+{
+    // Upwind selection keeps the dimensions and the number of nonzeros
+    // when a face changes direction, so only the indices tell the
+    // patterns apart.
+    const int n = 200;
+    const Sp grad = gradient(n);
+    auto upwind = [n](const int flipped) {
+        Sp up(n - 1, n);
+        for (int f = 0; f < n - 1; ++f) {
+            up.insert(f, f == flipped ? f + 1 : f) = 1.0;
+        }
+        up.makeCompressed();
+        return up;
+    };
+
+    SparsityPatternCache::clear();
+    SparsityPatternCache::resetStatistics();
+    for (const int flipped : { -1, 101, -1 }) {
+        const Sp up = upwind(flipped);
+        const Sp up_t = up.transpose();
+        Sp cached;
+        SparsityPatternCache::product(up_t, grad, cached);
+        const Sp expected = up_t * grad;
+        checkEqual(cached, expected);
+    }
+    const SparsityPatternCache::Statistics stats = SparsityPatternCache::statistics();
+    BOOST_CHECK_EQUAL(stats.misses, 2u);
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+}
+
+
+BOOST_AUTO_TEST_CASE(AutoDiffMatrixOperations)
+{
+    const int n = 7;
+    const Sp grad = gradient(n);
+    const Sp div = grad.transpose();
+    const AutoDiffMatrix jac(grad);
+    Sp extra(n, n);
+    extra.insert(n - 1, 0) = 3.0;
+    extra.makeCompressed();
+
+    SparsityPatternCache::setEnabled(false);
+    const AutoDiffMatrix prod_ref = div * jac;
+    const AutoDiffMatrix sum_ref = prod_ref + AutoDiffMatrix(extra);
+
+    SparsityPatternCache::setEnabled(true);
+    for (int it = 0; it < 2; ++it) {
+        const AutoDiffMatrix prod = div * jac;
+        const AutoDiffMatrix sum = prod + AutoDiffMatrix(extra);
+        AutoDiffMatrix acc = prod;
+        acc += AutoDiffMatrix(extra);
+        checkEqual(prod.getSparse(), prod_ref.getSparse());
+        checkEqual(sum.getSparse(), sum_ref.getSparse());
+        checkEqual(acc.getSparse(), sum_ref.getSparse());
+    }
+    SparsityPatternCache::setEnabled(false);
+}
+
+
+BOOST_AUTO_TEST_CASE(StatisticsSumOverThreads)
+{
+    const int num_threads = 4;
+    const int num_products = 3;
+    const Sp grad = gradient(10);
+    const Sp div = grad.transpose();
+
+    SparsityPatternCache::resetStatistics();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&grad, &div]() {
+            for (int i = 0; i < num_products; ++i) {
+                Sp res;
+                SparsityPatternCache::product(div, grad, res);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // Each thread has its own cache, and the counts of threads that
+    // have exited are kept.
+    const SparsityPatternCache::Statistics stats = SparsityPatternCache::statistics();
+    BOOST_CHECK_EQUAL(stats.misses, std::size_t(num_threads));
+    BOOST_CHECK_EQUAL(stats.hits, std::size_t(num_threads * (num_products - 1)));
+
+    SparsityPatternCache::resetStatistics();
+    BOOST_CHECK_EQUAL(SparsityPatternCache::statistics().hits, std::size_t(0));
+}
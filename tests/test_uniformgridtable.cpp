@@ -0,0 +1,89 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE UniformGridTableTest
+
+#include <opm/core/utility/UniformGridTable.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+using Opm::UniformGridTable;
+
+BOOST_AUTO_TEST_CASE(InterpolatesSamples)
+{
+    const UniformGridTable table(1.0, 3.0, { 0.0, 2.0, 3.0 });
+    BOOST_CHECK_EQUAL(table.numIntervals(), 2);
+    BOOST_CHECK_CLOSE(table(1.0), 0.0, 1e-12);
+    BOOST_CHECK_CLOSE(table(1.5), 1.0, 1e-12);
+    BOOST_CHECK_CLOSE(table(2.5), 2.5, 1e-12);
+    BOOST_CHECK_CLOSE(table(3.0), 3.0, 1e-12);
+    BOOST_CHECK_CLOSE(table.derivative(1.5), 2.0, 1e-12);
+    BOOST_CHECK_CLOSE(table.derivative(2.5), 1.0, 1e-12);
+
+    // Linear extrapolation of the end intervals.
+    BOOST_CHECK(!table.contains(0.0));
+    BOOST_CHECK_CLOSE(table(0.0), -2.0, 1e-12);
+    BOOST_CHECK_CLOSE(table(4.0), 4.0, 1e-12);
+
+    const std::vector<double> x = { 0.0, 1.5, 2.5, 4.0 };
+    std::vector<double> y(x.size());
+    std::vector<double> dydx(x.size());
+    table.evaluate(x.size(), x.data(), y.data(), dydx.data());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        BOOST_CHECK_CLOSE(y[i], table(x[i]), 1e-12);
+        BOOST_CHECK_CLOSE(dydx[i], table.derivative(x[i]), 1e-12);
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(ResamplesToTolerance)
+{
+    auto f = [](const double x) { return std::exp(x); };
+    const double tolerance = 1e-6;
+    const UniformGridTable table = UniformGridTable::fromFunction(f, 0.0, 2.0, tolerance);
+    BOOST_CHECK(table.maxError() <= tolerance);
+    for (int i = 0; i <= 100; ++i) {
+        const double x = 0.02 * i;
+        BOOST_CHECK(std::fabs(table(x) - f(x)) <= 2.0 * tolerance * std::exp(2.0));
+    }
+
+    // Limited resolution.
+    const UniformGridTable coarse = UniformGridTable::fromFunction(f, 0.0, 2.0, tolerance, 4, 8);
+    BOOST_CHECK_EQUAL(coarse.numIntervals(), 8);
+    BOOST_CHECK(coarse.maxError() > tolerance);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(ChecksKnots)
+{
+    // Piecewise linear function with a kink at 0.3, which does not
+    // coincide with a midpoint for a small number of intervals.
+    const std::vector<double> knots = { 0.0, 0.3, 1.0 };
+    auto f = [](const double x) { return x < 0.3 ? x : 0.3 + 10.0 * (x - 0.3); };
+    const UniformGridTable table = UniformGridTable::fromFunction(f, 0.0, 1.0, 1e-3, 2, 1 << 16, knots);
+    BOOST_CHECK(table.maxError() <= 1e-3);
+    BOOST_CHECK(std::fabs(table(0.3) - 0.3) <= 1e-3 * 7.3);
+}
@@ -0,0 +1,132 @@
+/*
+  Copyright 2019 SINTEF Digital, Mathematics and Cybernetics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#define BOOST_TEST_MODULE WellSchurComplementTest
+
+#include <opm/autodiff/WellSchurComplement.hpp>
+#include <opm/autodiff/NewtonIterationUtilities.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace Opm;
+
+namespace {
+
+    typedef AutoDiffBlock<double> ADB;
+    typedef Eigen::SparseMatrix<double> Sp;
+
+    // Two reservoir equations on four cells, with two wells: well 0
+    // perforated in cells 0 and 1, well 1 in cell 3. The well unknowns
+    // are the phase rates (phase major) and the bottom hole pressures.
+    std::vector<ADB> wellSystem()
+    {
+        const int nc = 4;
+        const int nw = 2;
+        ADB::V p(nc);
+        p << 100.0, 110.0, 120.0, 130.0;
+        ADB::V s(nc);
+        s << 0.1, 0.2, 0.3, 0.4;
+        ADB::V qs(2 * nw);
+        qs << 1.0, -2.0, 0.5, -0.7;
+        ADB::V bhp(nw);
+        bhp << 90.0, 150.0;
+        const std::vector<ADB> vars = ADB::variables({ p, s, qs, bhp });
+
+        Sp grad(nc - 1, nc);
+        for (int f = 0; f < nc - 1; ++f) {
+            grad.insert(f, f) = -1.0;
+            grad.insert(f, f + 1) = 1.0;
+        }
+        const Sp div = grad.transpose();
+
+        // Perforation to well map, and the rates of each phase.
+        Sp wells(nc, nw);
+        wells.insert(0, 0) = 1.0;
+        wells.insert(1, 0) = 1.0;
+        wells.insert(3, 1) = 1.0;
+        const Sp wellsT = wells.transpose();
+        std::vector<Sp> phase(2, Sp(nw, 2 * nw));
+        std::vector<Sp> phaseT(2);
+        for (int ph = 0; ph < 2; ++ph) {
+            for (int w = 0; w < nw; ++w) {
+                phase[ph].insert(w, ph * nw + w) = 1.0;
+            }
+            phaseT[ph] = phase[ph].transpose();
+        }
+
+        const ADB& pv = vars[0];
+        const ADB& sv = vars[1];
+        const ADB& qv = vars[2];
+        const ADB& bv = vars[3];
+        const ADB drawdown = wells * bv - pv;
+        std::vector<ADB> eqs;
+        eqs.push_back(div * (grad * pv) + pv * sv + wells * (phase[0] * qv));
+        eqs.push_back(sv * sv + pv * 2.0 + wells * (phase[1] * qv));
+        eqs.push_back(qv - phaseT[0] * (wellsT * (drawdown * 0.5))
+                         - phaseT[1] * (wellsT * (drawdown * sv)));
+        eqs.push_back(bv + (phase[0] * qv) * 0.1 - ADB::V::Constant(nw, 100.0));
+        return eqs;
+    }
+
+    Eigen::MatrixXd dense(const AutoDiffMatrix& m)
+    {
+        Sp s;
+        m.toSparse(s);
+        return Eigen::MatrixXd(s);
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE(MatchesSequentialElimination)
+{
+    const int np = 2;
+    const std::vector<ADB> eqs = wellSystem();
+
+    // Reference: eliminate the rates, then the bottom hole pressures.
+    std::vector<ADB> elim_eqs;
+    std::vector<ADB> ref = eqs;
+    elim_eqs.push_back(ref[np]);
+    ref = eliminateVariable(ref, np);
+    elim_eqs.push_back(ref[np]);
+    ref = eliminateVariable(ref, np);
+
+    const WellSchurComplement schur(eqs, np);
+    BOOST_CHECK_EQUAL(schur.numBlocks(), 2);
+    const std::vector<ADB>& reduced = schur.reducedEquations();
+    BOOST_REQUIRE_EQUAL(reduced.size(), ref.size());
+    for (int eq = 0; eq < np; ++eq) {
+        BOOST_CHECK(reduced[eq].value().isApprox(ref[eq].value(), 1e-12));
+        BOOST_REQUIRE_EQUAL(reduced[eq].numBlocks(), np);
+        for (int var = 0; var < np; ++var) {
+            const Eigen::MatrixXd diff = dense(reduced[eq].derivative()[var]) - dense(ref[eq].derivative()[var]);
+            BOOST_CHECK_SMALL(diff.cwiseAbs().maxCoeff(), 1e-10);
+        }
+    }
+
+    ADB::V x(8);
+    x << 0.1, -0.2, 0.3, 0.4, -0.5, 0.6, 0.7, -0.8;
+    ADB::V ref_sol = recoverVariable(elim_eqs[1], x, np);
+    ref_sol = recoverVariable(elim_eqs[0], ref_sol, np);
+    const ADB::V sol = schur.recover(x);
+    BOOST_REQUIRE_EQUAL(sol.size(), ref_sol.size());
+    BOOST_CHECK(sol.isApprox(ref_sol, 1e-12));
+}